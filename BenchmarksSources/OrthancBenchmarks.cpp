@@ -0,0 +1,657 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+/**
+ * This executable measures the throughput and the latency of the hot
+ * paths of Orthanc on synthetic DICOM instances, and reports them as
+ * JSON, so that regressions can be detected between two builds:
+ *
+ *   ./OrthancBenchmarks [--instances N] [--iterations N] [--filter TEXT]
+ *                       [--storage-path PATH] [--output FILE]
+ *
+ * The ingestion and the reading of the instances are measured both
+ * with an in-memory storage area and with the filesystem storage
+ * area. The latter is a fresh subdirectory of "--storage-path" that
+ * is removed at the end, the rest of this path being left untouched.
+ * The SQLite index is always kept in memory.
+ **/
+
+
+#include "../OrthancServer/PrecompiledHeadersServer.h"
+
+#include "../Core/Compression/ZlibCompressor.h"
+#include "../Core/DicomParsing/Internals/DicomImageDecoder.h"
+#include "../Core/DicomParsing/ParsedDicomFile.h"
+#include "../Core/FileStorage/FilesystemStorage.h"
+#include "../Core/FileStorage/MemoryStorageArea.h"
+#include "../Core/Images/Image.h"
+#include "../Core/Images/ImageProcessing.h"
+#include "../Core/Logging.h"
+#include "../Core/OrthancException.h"
+#include "../Core/SystemToolbox.h"
+#include "../Core/Toolbox.h"
+#include "../OrthancServer/DatabaseWrapper.h"
+#include "../OrthancServer/OrthancInitialization.h"
+#include "../OrthancServer/Search/LookupResource.h"
+#include "../OrthancServer/ServerContext.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+
+
+using namespace Orthanc;
+
+
+namespace
+{
+  class Parameters : public boost::noncopyable
+  {
+  public:
+    unsigned int  countInstances_;
+    unsigned int  countIterations_;
+    unsigned int  countPatients_;
+    std::string   filter_;
+    std::string   storagePath_;
+    std::string   output_;
+
+    Parameters() :
+      countInstances_(200),
+      countIterations_(50),
+      countPatients_(20),
+      storagePath_("OrthancBenchmarksStorage")
+    {
+    }
+  };
+
+
+  // Uniquely-named subdirectory of the storage path, that is removed
+  // with its content once the benchmarks are over. Only this
+  // subdirectory is deleted, never the user-provided path itself.
+  class ScratchDirectory : public boost::noncopyable
+  {
+  private:
+    boost::filesystem::path  path_;
+
+  public:
+    explicit ScratchDirectory(const std::string& parent) :
+      path_(boost::filesystem::path(parent) / ("benchmarks-" + Toolbox::GenerateUuid()))
+    {
+      bool created;
+
+      try
+      {
+        boost::filesystem::create_directories(parent);
+        created = boost::filesystem::create_directory(path_);
+      }
+      catch (boost::filesystem::filesystem_error&)
+      {
+        created = false;
+      }
+
+      if (!created)
+      {
+        LOG(ERROR) << "Cannot create a fresh directory for the benchmarks: " << path_.string();
+        throw OrthancException(ErrorCode_MakeDirectory);
+      }
+    }
+
+    ~ScratchDirectory()
+    {
+      try
+      {
+        boost::filesystem::remove_all(path_);
+      }
+      catch (boost::filesystem::filesystem_error&)
+      {
+        LOG(WARNING) << "Cannot remove the directory of the benchmarks: " << path_.string();
+      }
+    }
+
+    std::string GetPath() const
+    {
+      return path_.string();
+    }
+  };
+
+
+  // Collects the latency of each iteration of one benchmark
+  class Benchmark : public boost::noncopyable
+  {
+  private:
+    std::string                 name_;
+    std::vector<double>         latencies_;   // In microseconds
+    uint64_t                    bytes_;
+    boost::posix_time::ptime    start_;
+
+    double GetPercentile(double percentile) const
+    {
+      // "latencies_" is sorted, "nearest rank" method
+      size_t rank = static_cast<size_t>(std::ceil(percentile / 100.0 * static_cast<double>(latencies_.size())));
+      if (rank > 0)
+      {
+        rank--;
+      }
+
+      return latencies_[std::min(rank, latencies_.size() - 1)];
+    }
+
+  public:
+    Benchmark(const std::string& name) :
+      name_(name),
+      bytes_(0)
+    {
+    }
+
+    const std::string& GetName() const
+    {
+      return name_;
+    }
+
+    void Start()
+    {
+      start_ = boost::posix_time::microsec_clock::universal_time();
+    }
+
+    // "bytes" is the size of the data that was processed by this
+    // iteration, or 0 if the throughput in MB/s is not relevant
+    void Stop(size_t bytes)
+    {
+      boost::posix_time::time_duration elapsed =
+        boost::posix_time::microsec_clock::universal_time() - start_;
+      latencies_.push_back(static_cast<double>(elapsed.total_microseconds()));
+      bytes_ += bytes;
+    }
+
+    void Format(Json::Value& target)
+    {
+      if (latencies_.empty())
+      {
+        throw OrthancException(ErrorCode_BadSequenceOfCalls);
+      }
+
+      std::sort(latencies_.begin(), latencies_.end());
+
+      double total = 0;
+      for (size_t i = 0; i < latencies_.size(); i++)
+      {
+        total += latencies_[i];
+      }
+
+      const double seconds = total / 1000000.0;
+
+      target = Json::objectValue;
+      target["Name"] = name_;
+      target["Iterations"] = static_cast<unsigned int>(latencies_.size());
+      target["TotalSeconds"] = seconds;
+      target["OperationsPerSecond"] = (seconds > 0 ? static_cast<double>(latencies_.size()) / seconds : 0.0);
+
+      if (bytes_ != 0)
+      {
+        target["MegabytesPerSecond"] = (seconds > 0 ? static_cast<double>(bytes_) / (1024.0 * 1024.0) / seconds : 0.0);
+      }
+
+      Json::Value latency = Json::objectValue;
+      latency["Min"] = latencies_.front();
+      latency["Mean"] = total / static_cast<double>(latencies_.size());
+      latency["P50"] = GetPercentile(50);
+      latency["P90"] = GetPercentile(90);
+      latency["P99"] = GetPercentile(99);
+      latency["Max"] = latencies_.back();
+      target["LatencyMicroseconds"] = latency;
+    }
+  };
+
+
+  class BenchmarksRunner : public boost::noncopyable
+  {
+  private:
+    const Parameters&  parameters_;
+    Json::Value        results_;
+
+  public:
+    BenchmarksRunner(const Parameters& parameters) :
+      parameters_(parameters),
+      results_(Json::arrayValue)
+    {
+    }
+
+    const Parameters& GetParameters() const
+    {
+      return parameters_;
+    }
+
+    bool IsEnabled(const std::string& name) const
+    {
+      return (parameters_.filter_.empty() ||
+              name.find(parameters_.filter_) != std::string::npos);
+    }
+
+    void Add(Benchmark& benchmark)
+    {
+      Json::Value result;
+      benchmark.Format(result);
+      results_.append(result);
+
+      LOG(WARNING) << "Benchmark \"" << benchmark.GetName() << "\": "
+                   << result["LatencyMicroseconds"]["P50"].asDouble() << " us (median)";
+    }
+
+    const Json::Value& GetResults() const
+    {
+      return results_;
+    }
+  };
+
+
+  static void CreateSyntheticImage(ImageAccessor& target,
+                                   unsigned int seed)
+  {
+    // Smooth gradient with a pseudo-random noise, so that the
+    // compression ratio is close to the one of real-world images
+    uint32_t noise = 2166136261u ^ seed;
+
+    for (unsigned int y = 0; y < target.GetHeight(); y++)
+    {
+      uint16_t* p = reinterpret_cast<uint16_t*>(target.GetRow(y));
+      for (unsigned int x = 0; x < target.GetWidth(); x++, p++)
+      {
+        noise = noise * 1664525u + 1013904223u;
+        *p = static_cast<uint16_t>((x * 7 + y * 3) % 3000 + (noise >> 28));
+      }
+    }
+  }
+
+
+  static void CreateSyntheticInstance(std::string& target,
+                                      const Parameters& parameters,
+                                      unsigned int index)
+  {
+    const std::string patient = boost::lexical_cast<std::string>(index % parameters.countPatients_);
+
+    ParsedDicomFile dicom(true);  // Generates a random SOP instance UID
+    dicom.ReplacePlainString(DICOM_TAG_PATIENT_ID, "BENCHMARK-" + patient);
+    dicom.ReplacePlainString(DICOM_TAG_PATIENT_NAME, "BENCHMARK^" + patient);
+    dicom.ReplacePlainString(DICOM_TAG_STUDY_INSTANCE_UID, "1.2.826.0.1.3680043.8.498.1." + patient);
+    dicom.ReplacePlainString(DICOM_TAG_SERIES_INSTANCE_UID, "1.2.826.0.1.3680043.8.498.2." + patient);
+    dicom.ReplacePlainString(DICOM_TAG_MODALITY, "CT");
+    dicom.ReplacePlainString(DICOM_TAG_STUDY_DESCRIPTION, "Synthetic study");
+    dicom.ReplacePlainString(DICOM_TAG_INSTANCE_NUMBER, boost::lexical_cast<std::string>(index));
+
+    Image image(PixelFormat_Grayscale16, 512, 512, false);
+    CreateSyntheticImage(image, index);
+    dicom.EmbedImage(image);
+
+    dicom.SaveToMemoryBuffer(target);
+  }
+
+
+  static void RunStorageBenchmarks(BenchmarksRunner& runner,
+                                   IStorageArea& storage,
+                                   const std::string& storageName,
+                                   const std::vector<std::string>& instances)
+  {
+    const std::string storeName = "ServerContext::Store (" + storageName + ")";
+    const std::string readName = "ServerContext::ReadDicomAsJson (" + storageName + ")";
+    const std::string lookupName = "LookupResource::FindCandidates (" + storageName + ")";
+
+    if (!runner.IsEnabled(storeName) &&
+        !runner.IsEnabled(readName) &&
+        !runner.IsEnabled(lookupName))
+    {
+      return;
+    }
+
+    DatabaseWrapper db;   // The SQLite DB is in memory
+    db.Open();
+
+    {
+      ServerContext context(db, storage, true /* benchmarks */, false /* don't reload jobs */);
+
+      // "ServerIndex::Store()" together with the parsing of the DICOM
+      // file and the writing of the attachments. Always run, as the
+      // other benchmarks need the instances.
+      std::vector<std::string> ids;
+      ids.reserve(instances.size());
+
+      Benchmark store(storeName);
+
+      for (size_t i = 0; i < instances.size(); i++)
+      {
+        DicomInstanceToStore toStore;
+        toStore.SetOrigin(DicomInstanceOrigin::FromPlugins());
+        toStore.SetBuffer(instances[i]);
+
+        std::string id;
+
+        store.Start();
+        StoreStatus status = context.Store(id, toStore);
+        store.Stop(instances[i].size());
+
+        if (status != StoreStatus_Success)
+        {
+          throw OrthancException(ErrorCode_InternalError);
+        }
+
+        ids.push_back(id);
+      }
+
+      if (runner.IsEnabled(storeName))
+      {
+        runner.Add(store);
+      }
+
+      if (runner.IsEnabled(readName))
+      {
+        Benchmark read(readName);
+
+        for (unsigned int i = 0; i < runner.GetParameters().countIterations_; i++)
+        {
+          std::string json;
+
+          read.Start();
+          context.ReadDicomAsJson(json, ids[i % ids.size()]);
+          read.Stop(json.size());
+        }
+
+        runner.Add(read);
+      }
+
+      if (runner.IsEnabled(lookupName))
+      {
+        Benchmark lookup(lookupName);
+
+        for (unsigned int i = 0; i < runner.GetParameters().countIterations_; i++)
+        {
+          // Alternate between an exact match on one patient, and a
+          // wildcard match on the patient name
+          LookupResource query(ResourceType_Instance);
+          if (i % 2 == 0)
+          {
+            query.AddDicomConstraint(DICOM_TAG_PATIENT_ID, "BENCHMARK-" + boost::lexical_cast<std::string>
+                                     (i % runner.GetParameters().countPatients_), true);
+          }
+          else
+          {
+            query.AddDicomConstraint(DICOM_TAG_PATIENT_NAME, "BENCHMARK^1*", false);
+          }
+
+          std::vector<std::string> resources, matches;
+
+          lookup.Start();
+          context.GetIndex().FindCandidates(resources, matches, query);
+          lookup.Stop(0);
+        }
+
+        runner.Add(lookup);
+      }
+
+      context.Stop();
+    }
+
+    db.Close();
+  }
+
+
+  static void RunDecodingBenchmarks(BenchmarksRunner& runner,
+                                    const std::vector<std::string>& instances)
+  {
+    const unsigned int countIterations = runner.GetParameters().countIterations_;
+
+    if (runner.IsEnabled("DicomImageDecoder::Decode"))
+    {
+      ParsedDicomFile dicom(instances[0]);
+
+      Benchmark decode("DicomImageDecoder::Decode");
+
+      for (unsigned int i = 0; i < countIterations; i++)
+      {
+        decode.Start();
+        std::auto_ptr<ImageAccessor> image(DicomImageDecoder::Decode(dicom, 0));
+        decode.Stop(image->GetPitch() * image->GetHeight());
+      }
+
+      runner.Add(decode);
+    }
+
+    if (runner.IsEnabled("ZlibCompressor::Compress"))
+    {
+      ZlibCompressor compressor;
+
+      Benchmark compress("ZlibCompressor::Compress");
+
+      for (unsigned int i = 0; i < countIterations; i++)
+      {
+        const std::string& source = instances[i % instances.size()];
+        std::string compressed;
+
+        compress.Start();
+        compressor.Compress(compressed, source.c_str(), source.size());
+        compress.Stop(source.size());
+      }
+
+      runner.Add(compress);
+    }
+  }
+
+
+  static void RunImageProcessingBenchmarks(BenchmarksRunner& runner)
+  {
+    const unsigned int countIterations = runner.GetParameters().countIterations_;
+
+    Image source(PixelFormat_Grayscale16, 2048, 2048, false);
+    CreateSyntheticImage(source, 0);
+
+    Image target(PixelFormat_Grayscale8, source.GetWidth(), source.GetHeight(), false);
+
+    const bool simd = ImageProcessing::IsSimdEnabled();
+
+    // Compare the SIMD implementation with the scalar one
+    for (unsigned int pass = 0; pass < 2; pass++)
+    {
+      const bool enabled = (pass == 0);
+      if (enabled && std::string(ImageProcessing::GetSimdInstructionSet()) == "None")
+      {
+        continue;
+      }
+
+      ImageProcessing::SetSimdEnabled(enabled);
+
+      const std::string suffix = (enabled ? " (" + std::string(ImageProcessing::GetSimdInstructionSet()) + ")" :
+                                  " (scalar)");
+
+      if (runner.IsEnabled("ImageProcessing::Convert" + suffix))
+      {
+        Benchmark convert("ImageProcessing::Convert" + suffix);
+
+        for (unsigned int i = 0; i < countIterations; i++)
+        {
+          convert.Start();
+          ImageProcessing::Convert(target, source);
+          convert.Stop(source.GetPitch() * source.GetHeight());
+        }
+
+        runner.Add(convert);
+      }
+
+      if (runner.IsEnabled("ImageProcessing::ShiftScale" + suffix))
+      {
+        Image image(PixelFormat_Grayscale16, source.GetWidth(), source.GetHeight(), false);
+
+        Benchmark shiftScale("ImageProcessing::ShiftScale" + suffix);
+
+        for (unsigned int i = 0; i < countIterations; i++)
+        {
+          ImageProcessing::Copy(image, source);
+
+          shiftScale.Start();
+          ImageProcessing::ShiftScale(image, -100.0f, 0.5f, false);
+          shiftScale.Stop(image.GetPitch() * image.GetHeight());
+        }
+
+        runner.Add(shiftScale);
+      }
+    }
+
+    ImageProcessing::SetSimdEnabled(simd);
+  }
+
+
+  static bool ParseParameters(Parameters& parameters,
+                              int argc,
+                              char* argv[])
+  {
+    for (int i = 1; i < argc; i++)
+    {
+      const std::string arg = argv[i];
+
+      if (i + 1 >= argc)
+      {
+        return false;   // All the options have one value
+      }
+
+      const std::string value = argv[++i];
+
+      try
+      {
+        if (arg == "--instances")
+        {
+          parameters.countInstances_ = boost::lexical_cast<unsigned int>(value);
+        }
+        else if (arg == "--iterations")
+        {
+          parameters.countIterations_ = boost::lexical_cast<unsigned int>(value);
+        }
+        else if (arg == "--filter")
+        {
+          parameters.filter_ = value;
+        }
+        else if (arg == "--storage-path")
+        {
+          parameters.storagePath_ = value;
+        }
+        else if (arg == "--output")
+        {
+          parameters.output_ = value;
+        }
+        else
+        {
+          return false;
+        }
+      }
+      catch (boost::bad_lexical_cast&)
+      {
+        return false;
+      }
+    }
+
+    return (parameters.countInstances_ > 0 &&
+            parameters.countIterations_ > 0);
+  }
+}
+
+
+int main(int argc, char* argv[])
+{
+  Parameters parameters;
+  if (!ParseParameters(parameters, argc, argv))
+  {
+    std::cerr << "Usage: " << argv[0] << " [--instances N] [--iterations N] [--filter TEXT] "
+              << "[--storage-path PATH] [--output FILE]" << std::endl;
+    return -1;
+  }
+
+  Logging::Initialize();
+  Toolbox::DetectEndianness();
+  OrthancInitialize();
+
+  int status = 0;
+
+  try
+  {
+    BenchmarksRunner runner(parameters);
+
+    std::vector<std::string> instances(parameters.countInstances_);
+    for (size_t i = 0; i < instances.size(); i++)
+    {
+      CreateSyntheticInstance(instances[i], parameters, static_cast<unsigned int>(i));
+    }
+
+    {
+      MemoryStorageArea storage;
+      RunStorageBenchmarks(runner, storage, "memory", instances);
+    }
+
+    {
+      ScratchDirectory directory(parameters.storagePath_);
+      FilesystemStorage storage(directory.GetPath());
+      RunStorageBenchmarks(runner, storage, "filesystem", instances);
+    }
+
+    RunDecodingBenchmarks(runner, instances);
+    RunImageProcessingBenchmarks(runner);
+
+    Json::Value result = Json::objectValue;
+    result["Version"] = ORTHANC_VERSION;
+    result["SimdInstructionSet"] = ImageProcessing::GetSimdInstructionSet();
+    result["Instances"] = parameters.countInstances_;
+    result["Benchmarks"] = runner.GetResults();
+
+    std::string s = result.toStyledString();
+
+    if (parameters.output_.empty())
+    {
+      std::cout << s;
+    }
+    else
+    {
+      SystemToolbox::WriteFile(s, parameters.output_);
+    }
+  }
+  catch (OrthancException& e)
+  {
+    LOG(ERROR) << "Error while running the benchmarks: " << e.What();
+    status = -1;
+  }
+
+  OrthancFinalize();
+  Logging::Finalize();
+
+  return status;
+}
@@ -0,0 +1,167 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "MemoryStringCache.h"
+
+
+namespace Orthanc
+{
+  void MemoryStringCache::RemoveInternal(Content::iterator it)
+  {
+    assert(it != content_.end() &&
+           it->second != NULL &&
+           currentSize_ >= it->second->size());
+
+    currentSize_ -= it->second->size();
+    lru_.Invalidate(it->first);
+    delete it->second;
+    content_.erase(it);
+  }
+
+
+  MemoryStringCache::MemoryStringCache(size_t maxSize) :
+    maxSize_(maxSize),
+    currentSize_(0),
+    hits_(0),
+    misses_(0),
+    evictions_(0)
+  {
+  }
+
+
+  MemoryStringCache::~MemoryStringCache()
+  {
+    for (Content::iterator it = content_.begin(); it != content_.end(); ++it)
+    {
+      assert(it->second != NULL);
+      delete it->second;
+    }
+  }
+
+
+  void MemoryStringCache::Add(const std::string& key,
+                              const std::string& value)
+  {
+    if (value.size() > maxSize_)
+    {
+      return;
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Content::iterator found = content_.find(key);
+    if (found != content_.end())
+    {
+      RemoveInternal(found);
+    }
+
+    while (currentSize_ + value.size() > maxSize_)
+    {
+      assert(!lru_.IsEmpty());
+      Content::iterator oldest = content_.find(lru_.GetOldest());
+      RemoveInternal(oldest);
+      evictions_++;
+    }
+
+    content_[key] = new std::string(value);
+    currentSize_ += value.size();
+    lru_.Add(key);
+  }
+
+
+  bool MemoryStringCache::Fetch(std::string& value,
+                                const std::string& key)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Content::const_iterator found = content_.find(key);
+    if (found == content_.end())
+    {
+      misses_++;
+      return false;
+    }
+    else
+    {
+      hits_++;
+      lru_.MakeMostRecent(key);
+      value = *found->second;
+      return true;
+    }
+  }
+
+
+  void MemoryStringCache::Invalidate(const std::string& key)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Content::iterator found = content_.find(key);
+    if (found != content_.end())
+    {
+      RemoveInternal(found);
+    }
+  }
+
+
+  void MemoryStringCache::InvalidatePrefix(const std::string& prefix)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Content::iterator it = content_.lower_bound(prefix);
+    while (it != content_.end() &&
+           it->first.compare(0, prefix.size(), prefix) == 0)
+    {
+      Content::iterator next = it;
+      ++next;
+      RemoveInternal(it);
+      it = next;
+    }
+  }
+
+
+  void MemoryStringCache::GetStatistics(uint64_t& hits,
+                                        uint64_t& misses,
+                                        uint64_t& evictions,
+                                        size_t& countEntries,
+                                        size_t& memorySize)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    hits = hits_;
+    misses = misses_;
+    evictions = evictions_;
+    countEntries = content_.size();
+    memorySize = currentSize_;
+  }
+}
@@ -0,0 +1,456 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "ShardedMemoryCache.h"
+
+#include "../Logging.h"
+#include "../OrthancException.h"
+
+#include <boost/functional/hash.hpp>
+
+
+namespace Orthanc
+{
+  class ShardedMemoryCache::Entry : public boost::noncopyable
+  {
+  public:
+    boost::mutex                   mutex_;          // Held by the accessors
+    std::auto_ptr<IDynamicObject>  content_;        // Protected by "mutex_"
+    size_t                         size_;           // Protected by "mutex_"
+    unsigned int                   references_;     // Protected by the shard
+    size_t                         accountedSize_;  // Protected by the shard
+    bool                           isInvalidated_;  // Protected by the shard
+
+    Entry() :
+      size_(0),
+      references_(0),
+      accountedSize_(0),
+      isInvalidated_(false)
+    {
+    }
+  };
+
+
+  class ShardedMemoryCache::Shard : public boost::noncopyable
+  {
+  public:
+    typedef std::map<std::string, Entry*>  Entries;
+
+    // The payload of "unused_" is the stamp of the release of the
+    // entry, which orders the entries across all the shards
+    typedef LeastRecentlyUsedIndex<std::string, uint64_t>  UnusedEntries;
+
+    ShardedMemoryCache&  cache_;
+    boost::mutex   mutex_;
+    Entries        entries_;  // All the entries, including those in use
+    UnusedEntries  unused_;   // Entries that can be evicted
+    size_t         memorySize_;
+    uint64_t       hits_;
+    uint64_t       misses_;
+    uint64_t       evictions_;
+
+    explicit Shard(ShardedMemoryCache& cache) :
+      cache_(cache),
+      memorySize_(0),
+      hits_(0),
+      misses_(0),
+      evictions_(0)
+    {
+    }
+
+    ~Shard()
+    {
+      for (Entries::iterator it = entries_.begin(); it != entries_.end(); ++it)
+      {
+        assert(it->second != NULL &&
+               it->second->references_ == 0);
+        delete it->second;
+      }
+    }
+
+    void Account(Entry* entry)
+    {
+      // WARNING: "mutex_" must be locked
+      entry->accountedSize_ = entry->size_;
+      memorySize_ += entry->size_;
+      cache_.IncreaseMemorySize(entry->size_);
+    }
+
+    void Remove(const std::string& id,
+                Entry* entry)
+    {
+      // WARNING: "mutex_" must be locked
+      assert(memorySize_ >= entry->accountedSize_);
+      memorySize_ -= entry->accountedSize_;
+      cache_.DecreaseMemorySize(entry->accountedSize_);
+      entry->accountedSize_ = 0;
+      entries_.erase(id);
+    }
+
+    void EvictOldest()
+    {
+      // WARNING: "mutex_" must be locked
+      std::string id = unused_.RemoveOldest();
+
+      Entries::iterator it = entries_.find(id);
+      assert(it != entries_.end() &&
+             it->second->references_ == 0);
+
+      Entry* entry = it->second;
+      Remove(id, entry);
+      delete entry;
+
+      evictions_++;
+    }
+  };
+
+
+  void ShardedMemoryCache::IncreaseMemorySize(size_t size)
+  {
+    boost::mutex::scoped_lock lock(budgetMutex_);
+    memorySize_ += size;
+  }
+
+
+  void ShardedMemoryCache::DecreaseMemorySize(size_t size)
+  {
+    boost::mutex::scoped_lock lock(budgetMutex_);
+    assert(memorySize_ >= size);
+    memorySize_ -= size;
+  }
+
+
+  uint64_t ShardedMemoryCache::GenerateStamp()
+  {
+    boost::mutex::scoped_lock lock(budgetMutex_);
+    lastStamp_++;
+    return lastStamp_;
+  }
+
+
+  void ShardedMemoryCache::EnforceMemoryBudget()
+  {
+    for (;;)
+    {
+      {
+        boost::mutex::scoped_lock lock(budgetMutex_);
+        if (memorySize_ <= maxMemorySize_)
+        {
+          return;
+        }
+      }
+
+      // Look for the shard containing the least recently used entry
+      // of the whole cache. The mutexes of the shards are locked one
+      // at a time, so this is only an approximation under contention.
+      Shard* victim = NULL;
+      uint64_t oldest = 0;
+
+      for (size_t i = 0; i < shards_.size(); i++)
+      {
+        boost::mutex::scoped_lock lock(shards_[i]->mutex_);
+
+        if (!shards_[i]->unused_.IsEmpty() &&
+            (victim == NULL ||
+             shards_[i]->unused_.GetOldestPayload() < oldest))
+        {
+          victim = shards_[i];
+          oldest = shards_[i]->unused_.GetOldestPayload();
+        }
+      }
+
+      if (victim == NULL)
+      {
+        return;  // All the entries are in use
+      }
+
+      {
+        boost::mutex::scoped_lock lock(budgetMutex_);
+        if (oldest == lastStamp_)
+        {
+          // This is the most recently released entry: Keep it, so
+          // that an entry larger than the budget is still cached
+          return;
+        }
+      }
+
+      boost::mutex::scoped_lock lock(victim->mutex_);
+
+      if (!victim->unused_.IsEmpty() &&
+          victim->unused_.GetOldestPayload() == oldest)
+      {
+        victim->EvictOldest();
+      }
+
+      // Otherwise, the entry was used or evicted in the meantime: Retry
+    }
+  }
+
+
+  ShardedMemoryCache::Shard& ShardedMemoryCache::GetShard(const std::string& id)
+  {
+    assert(!shards_.empty());
+    size_t hash = boost::hash<std::string>()(id);
+    return *shards_[hash % shards_.size()];
+  }
+
+
+  void ShardedMemoryCache::Accessor::Release()
+  {
+    // The lock on the entry must be released before deleting it
+    lock_.reset(NULL);
+
+    bool released = false;
+
+    {
+      boost::mutex::scoped_lock lock(shard_.mutex_);
+
+      assert(entry_->references_ > 0);
+      entry_->references_ --;
+
+      if (entry_->references_ == 0)
+      {
+        if (entry_->isInvalidated_)
+        {
+          // This entry was already removed from the shard by "Invalidate()"
+          assert(entry_->accountedSize_ == 0);
+          delete entry_;
+        }
+        else if (entry_->content_.get() == NULL ||
+                 that_.maxMemorySize_ == 0)
+        {
+          // The provider has failed, or the cache is disabled
+          shard_.Remove(id_, entry_);
+          delete entry_;
+        }
+        else
+        {
+          shard_.unused_.Add(id_, that_.GenerateStamp());
+          released = true;
+        }
+      }
+
+      entry_ = NULL;
+    }
+
+    if (released)
+    {
+      that_.EnforceMemoryBudget();
+    }
+  }
+
+
+  ShardedMemoryCache::Accessor::Accessor(ShardedMemoryCache& that,
+                                         const std::string& id) :
+    that_(that),
+    shard_(that.GetShard(id)),
+    id_(id),
+    entry_(NULL)
+  {
+    {
+      boost::mutex::scoped_lock lock(shard_.mutex_);
+
+      Shard::Entries::iterator found = shard_.entries_.find(id);
+      if (found == shard_.entries_.end())
+      {
+        entry_ = new Entry;
+        shard_.entries_[id] = entry_;
+      }
+      else
+      {
+        entry_ = found->second;
+
+        if (entry_->references_ == 0 &&
+            shard_.unused_.Contains(id))
+        {
+          // This entry must not be evicted while in use
+          shard_.unused_.Invalidate(id);
+        }
+      }
+
+      entry_->references_ ++;
+    }
+
+    // Wait for the other users of this entry (if any) to release it
+    lock_.reset(new boost::mutex::scoped_lock(entry_->mutex_));
+
+    bool hit = (entry_->content_.get() != NULL);
+
+    if (!hit)
+    {
+      try
+      {
+        size_t size = 0;
+        entry_->content_.reset(that_.provider_.Provide(size, id));
+        entry_->size_ = size;
+
+        if (entry_->content_.get() == NULL)
+        {
+          throw OrthancException(ErrorCode_NullPointer);
+        }
+      }
+      catch (...)
+      {
+        entry_->content_.reset(NULL);
+        Release();
+        throw;
+      }
+    }
+
+    {
+      boost::mutex::scoped_lock lock(shard_.mutex_);
+
+      if (hit)
+      {
+        shard_.hits_++;
+      }
+      else
+      {
+        shard_.misses_++;
+
+        if (!entry_->isInvalidated_)
+        {
+          shard_.Account(entry_);
+        }
+      }
+    }
+
+    if (!hit)
+    {
+      // Make some room for the newly loaded entry
+      that_.EnforceMemoryBudget();
+    }
+  }
+
+
+  ShardedMemoryCache::Accessor::~Accessor()
+  {
+    if (entry_ != NULL)
+    {
+      Release();
+    }
+  }
+
+
+  IDynamicObject& ShardedMemoryCache::Accessor::GetContent()
+  {
+    assert(entry_ != NULL &&
+           entry_->content_.get() != NULL);
+    return *entry_->content_;
+  }
+
+
+  ShardedMemoryCache::ShardedMemoryCache(IProvider& provider,
+                                         size_t maxMemorySize,
+                                         unsigned int countShards) :
+    provider_(provider),
+    maxMemorySize_(maxMemorySize),
+    memorySize_(0),
+    lastStamp_(0)
+  {
+    if (countShards == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    shards_.resize(countShards);
+    for (size_t i = 0; i < shards_.size(); i++)
+    {
+      shards_[i] = new Shard(*this);
+    }
+  }
+
+
+  ShardedMemoryCache::~ShardedMemoryCache()
+  {
+    for (size_t i = 0; i < shards_.size(); i++)
+    {
+      assert(shards_[i] != NULL);
+      delete shards_[i];
+    }
+  }
+
+
+  void ShardedMemoryCache::Invalidate(const std::string& id)
+  {
+    Shard& shard = GetShard(id);
+    boost::mutex::scoped_lock lock(shard.mutex_);
+
+    Shard::Entries::iterator found = shard.entries_.find(id);
+    if (found != shard.entries_.end())
+    {
+      VLOG(1) << "Invalidating a cache entry";
+
+      Entry* entry = found->second;
+      shard.Remove(id, entry);
+
+      if (entry->references_ == 0)
+      {
+        shard.unused_.Invalidate(id);
+        delete entry;
+      }
+      else
+      {
+        // The last accessor will delete this entry
+        entry->isInvalidated_ = true;
+      }
+    }
+  }
+
+
+  void ShardedMemoryCache::GetStatistics(uint64_t& hits,
+                                         uint64_t& misses,
+                                         uint64_t& evictions,
+                                         size_t& countEntries,
+                                         size_t& memorySize)
+  {
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+    countEntries = 0;
+    memorySize = 0;
+
+    for (size_t i = 0; i < shards_.size(); i++)
+    {
+      boost::mutex::scoped_lock lock(shards_[i]->mutex_);
+      hits += shards_[i]->hits_;
+      misses += shards_[i]->misses_;
+      evictions += shards_[i]->evictions_;
+      countEntries += shards_[i]->entries_.size();
+      memorySize += shards_[i]->memorySize_;
+    }
+  }
+}
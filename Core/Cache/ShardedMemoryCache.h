@@ -0,0 +1,142 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#pragma once
+
+#if !defined(ORTHANC_SANDBOXED)
+#  error The macro ORTHANC_SANDBOXED must be defined
+#endif
+
+#if ORTHANC_SANDBOXED == 1
+#  error The class ShardedMemoryCache cannot be used in sandboxed environments
+#endif
+
+#include "LeastRecentlyUsedIndex.h"
+#include "../IDynamicObject.h"
+
+#include <map>
+#include <vector>
+#include <boost/thread.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace Orthanc
+{
+  /**
+   * Thread-safe cache whose size is bounded by the memory that is
+   * consumed by its entries. The identifiers are distributed over
+   * several shards, each of which has its own mutex, but the memory
+   * budget is global: The least recently used entries are evicted
+   * whatever their shard, and the most recently released entry is
+   * always kept, even if it exceeds the budget on its own. A budget of
+   * zero disables the cache: The entries are only shared while they
+   * are in use. Each entry is reference-counted and protected by its
+   * own mutex, so that different entries can be loaded and accessed
+   * concurrently, while one given entry is accessed by one single
+   * thread at a time.
+   **/
+  class ShardedMemoryCache : public boost::noncopyable
+  {
+  public:
+    class IProvider : public boost::noncopyable
+    {
+    public:
+      virtual ~IProvider()
+      {
+      }
+
+      // "memorySize" must be set to an estimation of the memory
+      // that is consumed by the returned object
+      virtual IDynamicObject* Provide(size_t& memorySize,
+                                      const std::string& id) = 0;
+    };
+
+  private:
+    class Entry;
+    class Shard;
+
+    IProvider&           provider_;
+    size_t               maxMemorySize_;
+    std::vector<Shard*>  shards_;
+    boost::mutex         budgetMutex_;  // Always locked after the mutex of a shard
+    size_t               memorySize_;   // Protected by "budgetMutex_"
+    uint64_t             lastStamp_;    // Protected by "budgetMutex_"
+
+    Shard& GetShard(const std::string& id);
+
+    void IncreaseMemorySize(size_t size);
+
+    void DecreaseMemorySize(size_t size);
+
+    uint64_t GenerateStamp();
+
+    // No mutex must be locked by the caller
+    void EnforceMemoryBudget();
+
+  public:
+    class Accessor : public boost::noncopyable
+    {
+    private:
+      ShardedMemoryCache&                       that_;
+      Shard&                                    shard_;
+      std::string                               id_;
+      Entry*                                    entry_;
+      std::auto_ptr<boost::mutex::scoped_lock>  lock_;
+
+      void Release();
+
+    public:
+      Accessor(ShardedMemoryCache& that,
+               const std::string& id);
+
+      ~Accessor();
+
+      IDynamicObject& GetContent();
+    };
+
+    ShardedMemoryCache(IProvider& provider,
+                       size_t maxMemorySize,
+                       unsigned int countShards);
+
+    ~ShardedMemoryCache();
+
+    void Invalidate(const std::string& id);
+
+    void GetStatistics(uint64_t& hits,
+                       uint64_t& misses,
+                       uint64_t& evictions,
+                       size_t& countEntries,
+                       size_t& memorySize);
+  };
+}
@@ -34,6 +34,7 @@
 #include "../PrecompiledHeaders.h"
 #include "HierarchicalZipWriter.h"
 
+#include "../Logging.h"
 #include "../Toolbox.h"
 #include "../OrthancException.h"
 
@@ -159,9 +160,22 @@ namespace Orthanc
     writer_.Open();
   }
 
+  HierarchicalZipWriter::HierarchicalZipWriter(ZipWriter::IOutputStream* stream,
+                                               bool isZip64)
+  {
+    writer_.AcquireOutputStream(stream, isZip64);
+  }
+
   HierarchicalZipWriter::~HierarchicalZipWriter()
   {
-    writer_.Close();
+    try
+    {
+      writer_.Close();
+    }
+    catch (OrthancException&)
+    {
+      LOG(ERROR) << "Error while closing a ZIP archive";
+    }
   }
 
   void HierarchicalZipWriter::OpenFile(const char* name)
@@ -97,8 +97,19 @@ namespace Orthanc
   public:
     HierarchicalZipWriter(const char* path);
 
+    // Takes the ownership of "stream"
+    HierarchicalZipWriter(ZipWriter::IOutputStream* stream,
+                          bool isZip64);
+
     ~HierarchicalZipWriter();
 
+    // Writes the central directory. Must be called explicitly so that
+    // errors are reported, as the destructor can only log them.
+    void Close()
+    {
+      writer_.Close();
+    }
+
     void SetZip64(bool isZip64)
     {
       writer_.SetZip64(isZip64);
@@ -0,0 +1,631 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "ZipReader.h"
+
+#include "../Logging.h"
+#include "../OrthancException.h"
+
+#include <limits>
+#include <sstream>
+#include <string.h>
+#include <vector>
+#include <zlib.h>
+#include <boost/filesystem/fstream.hpp>
+
+
+namespace Orthanc
+{
+  static const uint32_t SIGNATURE_LOCAL_FILE_HEADER = 0x04034b50;
+  static const uint32_t SIGNATURE_CENTRAL_FILE_HEADER = 0x02014b50;
+  static const uint32_t SIGNATURE_END_OF_CENTRAL_DIRECTORY = 0x06054b50;
+  static const uint32_t SIGNATURE_ZIP64_END_OF_CENTRAL_DIRECTORY = 0x06064b50;
+  static const uint32_t SIGNATURE_ZIP64_LOCATOR = 0x07064b50;
+
+  static const size_t END_OF_CENTRAL_DIRECTORY_SIZE = 22;
+  static const size_t ZIP64_LOCATOR_SIZE = 20;
+  static const size_t ZIP64_END_OF_CENTRAL_DIRECTORY_SIZE = 56;
+  static const size_t CENTRAL_FILE_HEADER_SIZE = 46;
+  static const size_t LOCAL_FILE_HEADER_SIZE = 30;
+  static const size_t MAX_COMMENT_SIZE = 65535;
+  static const size_t INFLATE_CHUNK_SIZE = 64 * 1024;
+
+  // The "deflate" method cannot compress better than about 1032:1
+  // (one 258-byte match per 2 bits): A larger ratio announced by the
+  // central directory is the signature of a "ZIP bomb"
+  static const uint64_t MAX_DEFLATE_RATIO = 1032;
+
+
+  static uint64_t ReadLittleEndian(const std::string& buffer,
+                                   size_t offset,
+                                   size_t size)
+  {
+    if (offset + size > buffer.size())
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+      value |= (static_cast<uint64_t>(static_cast<uint8_t>(buffer[offset + i])) << (8 * i));
+    }
+
+    return value;
+  }
+
+
+  static uint16_t ReadUint16(const std::string& buffer,
+                             size_t offset)
+  {
+    return static_cast<uint16_t>(ReadLittleEndian(buffer, offset, 2));
+  }
+
+
+  static uint32_t ReadUint32(const std::string& buffer,
+                             size_t offset)
+  {
+    return static_cast<uint32_t>(ReadLittleEndian(buffer, offset, 4));
+  }
+
+
+  static uint64_t ReadUint64(const std::string& buffer,
+                             size_t offset)
+  {
+    return ReadLittleEndian(buffer, offset, 8);
+  }
+
+
+  namespace
+  {
+    class InflateStream : public boost::noncopyable
+    {
+    private:
+      z_stream  stream_;
+
+    public:
+      InflateStream()
+      {
+        memset(&stream_, 0, sizeof(stream_));
+
+        // Negative window bits: Raw deflate data, without zlib header
+        if (inflateInit2(&stream_, -MAX_WBITS) != Z_OK)
+        {
+          throw OrthancException(ErrorCode_NotEnoughMemory);
+        }
+      }
+
+      ~InflateStream()
+      {
+        inflateEnd(&stream_);
+      }
+
+      z_stream& GetStream()
+      {
+        return stream_;
+      }
+    };
+  }
+
+
+  struct ZipReader::PImpl
+  {
+    struct Entry
+    {
+      std::string  filename_;
+      uint16_t     flags_;
+      uint16_t     method_;
+      uint32_t     crc32_;
+      uint64_t     compressedSize_;
+      uint64_t     uncompressedSize_;
+      uint64_t     localHeaderOffset_;
+    };
+
+    std::auto_ptr<std::istream>  stream_;
+    uint64_t                     size_;
+    std::vector<Entry>           entries_;
+    uint64_t                     maximumFileSize_;
+
+    PImpl() :
+      size_(0),
+      maximumFileSize_(0)
+    {
+    }
+
+    void Read(std::string& target,
+              uint64_t offset,
+              uint64_t size)
+    {
+      if (offset > size_ ||
+          size > size_ - offset)
+      {
+        LOG(ERROR) << "Truncated ZIP archive";
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+
+      target.resize(static_cast<size_t>(size));
+
+      if (size > 0)
+      {
+        stream_->clear();
+        stream_->seekg(static_cast<std::streamoff>(offset));
+        stream_->read(&target[0], static_cast<std::streamsize>(size));
+
+        if (!stream_->good() ||
+            stream_->gcount() != static_cast<std::streamsize>(size))
+        {
+          throw OrthancException(ErrorCode_CorruptedFile);
+        }
+      }
+    }
+
+    void ReadCentralDirectory();
+
+    void ParseZip64Extra(Entry& entry,
+                         const std::string& extra);
+
+    void Inflate(std::string& content,
+                 const Entry& entry,
+                 uint64_t dataOffset);
+  };
+
+
+  void ZipReader::PImpl::ParseZip64Extra(Entry& entry,
+                                         const std::string& extra)
+  {
+    size_t pos = 0;
+    while (pos + 4 <= extra.size())
+    {
+      uint16_t id = ReadUint16(extra, pos);
+      uint16_t length = ReadUint16(extra, pos + 2);
+      pos += 4;
+
+      if (id == 0x0001)
+      {
+        // The ZIP64 extended information only contains the fields
+        // that are saturated in the central file header, in this order
+        size_t field = pos;
+
+        if (entry.uncompressedSize_ == 0xffffffffu)
+        {
+          entry.uncompressedSize_ = ReadUint64(extra, field);
+          field += 8;
+        }
+
+        if (entry.compressedSize_ == 0xffffffffu)
+        {
+          entry.compressedSize_ = ReadUint64(extra, field);
+          field += 8;
+        }
+
+        if (entry.localHeaderOffset_ == 0xffffffffu)
+        {
+          entry.localHeaderOffset_ = ReadUint64(extra, field);
+          field += 8;
+        }
+
+        if (field > pos + length)
+        {
+          throw OrthancException(ErrorCode_BadFileFormat);
+        }
+      }
+
+      pos += length;
+    }
+  }
+
+
+  void ZipReader::PImpl::ReadCentralDirectory()
+  {
+    // Locate the "end of central directory" record, that is followed
+    // by a comment of at most 64KB
+    if (size_ < END_OF_CENTRAL_DIRECTORY_SIZE)
+    {
+      LOG(ERROR) << "Not a ZIP archive";
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    const uint64_t tailSize = std::min(size_, static_cast<uint64_t>(END_OF_CENTRAL_DIRECTORY_SIZE + MAX_COMMENT_SIZE));
+    const uint64_t tailOffset = size_ - tailSize;
+
+    std::string tail;
+    Read(tail, tailOffset, tailSize);
+
+    bool found = false;
+    size_t pos = tail.size() - END_OF_CENTRAL_DIRECTORY_SIZE;
+
+    for (;;)
+    {
+      if (ReadUint32(tail, pos) == SIGNATURE_END_OF_CENTRAL_DIRECTORY &&
+          pos + END_OF_CENTRAL_DIRECTORY_SIZE + ReadUint16(tail, pos + 20) <= tail.size())
+      {
+        found = true;
+        break;
+      }
+
+      if (pos == 0)
+      {
+        break;
+      }
+
+      pos--;
+    }
+
+    if (!found)
+    {
+      LOG(ERROR) << "Not a ZIP archive, or truncated ZIP archive";
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    if (ReadUint16(tail, pos + 4) != 0 ||
+        ReadUint16(tail, pos + 6) != 0)
+    {
+      LOG(ERROR) << "Multi-disk ZIP archives are not supported";
+      throw OrthancException(ErrorCode_NotImplemented);
+    }
+
+    uint64_t countEntries = ReadUint16(tail, pos + 10);
+    uint64_t directorySize = ReadUint32(tail, pos + 12);
+    uint64_t directoryOffset = ReadUint32(tail, pos + 16);
+
+    const uint64_t endOffset = tailOffset + pos;
+
+    if (endOffset >= ZIP64_LOCATOR_SIZE)
+    {
+      std::string locator;
+      Read(locator, endOffset - ZIP64_LOCATOR_SIZE, ZIP64_LOCATOR_SIZE);
+
+      if (ReadUint32(locator, 0) == SIGNATURE_ZIP64_LOCATOR)
+      {
+        std::string end;
+        Read(end, ReadUint64(locator, 8), ZIP64_END_OF_CENTRAL_DIRECTORY_SIZE);
+
+        if (ReadUint32(end, 0) != SIGNATURE_ZIP64_END_OF_CENTRAL_DIRECTORY)
+        {
+          throw OrthancException(ErrorCode_BadFileFormat);
+        }
+
+        countEntries = ReadUint64(end, 32);
+        directorySize = ReadUint64(end, 40);
+        directoryOffset = ReadUint64(end, 48);
+      }
+    }
+
+    std::string directory;
+    Read(directory, directoryOffset, directorySize);
+
+    entries_.reserve(static_cast<size_t>(std::min(countEntries, static_cast<uint64_t>(directory.size() / CENTRAL_FILE_HEADER_SIZE))));
+
+    pos = 0;
+    for (uint64_t i = 0; i < countEntries; i++)
+    {
+      if (ReadUint32(directory, pos) != SIGNATURE_CENTRAL_FILE_HEADER)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+
+      Entry entry;
+      entry.flags_ = ReadUint16(directory, pos + 8);
+      entry.method_ = ReadUint16(directory, pos + 10);
+      entry.crc32_ = ReadUint32(directory, pos + 16);
+      entry.compressedSize_ = ReadUint32(directory, pos + 20);
+      entry.uncompressedSize_ = ReadUint32(directory, pos + 24);
+      entry.localHeaderOffset_ = ReadUint32(directory, pos + 42);
+
+      const size_t filenameLength = ReadUint16(directory, pos + 28);
+      const size_t extraLength = ReadUint16(directory, pos + 30);
+      const size_t commentLength = ReadUint16(directory, pos + 32);
+
+      const size_t next = (pos + CENTRAL_FILE_HEADER_SIZE +
+                           filenameLength + extraLength + commentLength);
+      if (next > directory.size())
+      {
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+
+      entry.filename_ = directory.substr(pos + CENTRAL_FILE_HEADER_SIZE, filenameLength);
+      ParseZip64Extra(entry, directory.substr(pos + CENTRAL_FILE_HEADER_SIZE + filenameLength, extraLength));
+
+      if (entry.filename_.empty() ||
+          entry.filename_[entry.filename_.size() - 1] != '/')
+      {
+        entries_.push_back(entry);   // This is not a directory
+      }
+
+      pos = next;
+    }
+  }
+
+
+  void ZipReader::PImpl::Inflate(std::string& content,
+                                 const Entry& entry,
+                                 uint64_t dataOffset)
+  {
+    InflateStream inflater;
+    z_stream& stream = inflater.GetStream();
+
+    // The output buffer is grown as the data is actually inflated,
+    // instead of being allocated upfront from the size that is
+    // announced by the central directory
+    const size_t declaredSize = static_cast<size_t>(entry.uncompressedSize_);
+
+    content.resize(std::min(declaredSize, INFLATE_CHUNK_SIZE));
+
+    char dummy;
+    stream.next_out = reinterpret_cast<Bytef*>(content.empty() ? &dummy : &content[0]);
+    stream.avail_out = static_cast<uInt>(content.size());
+
+    uint64_t remaining = entry.compressedSize_;
+    uint64_t offset = dataOffset;
+
+    std::string chunk;
+    for (;;)
+    {
+      if (stream.avail_in == 0)
+      {
+        if (remaining == 0)
+        {
+          LOG(ERROR) << "Truncated compressed data in ZIP archive: " << entry.filename_;
+          throw OrthancException(ErrorCode_CorruptedFile);
+        }
+
+        Read(chunk, offset, std::min(remaining, static_cast<uint64_t>(INFLATE_CHUNK_SIZE)));
+        offset += chunk.size();
+        remaining -= chunk.size();
+
+        stream.next_in = reinterpret_cast<Bytef*>(&chunk[0]);
+        stream.avail_in = static_cast<uInt>(chunk.size());
+      }
+
+      if (stream.avail_out == 0 &&
+          content.size() < declaredSize)
+      {
+        // Double the output buffer, without exceeding the announced size
+        const size_t used = content.size();
+        content.resize(std::min(declaredSize, 2 * used));
+
+        stream.next_out = reinterpret_cast<Bytef*>(&content[used]);
+        stream.avail_out = static_cast<uInt>(content.size() - used);
+      }
+
+      int code = inflate(&stream, Z_NO_FLUSH);
+      if (code == Z_STREAM_END)
+      {
+        break;
+      }
+      else if (code != Z_OK)
+      {
+        // This notably includes "Z_BUF_ERROR", if the decompressed
+        // data is larger than announced in the central directory
+        LOG(ERROR) << "Corrupted compressed data in ZIP archive: " << entry.filename_;
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
+    }
+
+    if (stream.total_out != declaredSize)
+    {
+      LOG(ERROR) << "Corrupted compressed data in ZIP archive: " << entry.filename_;
+      throw OrthancException(ErrorCode_CorruptedFile);
+    }
+  }
+
+
+  ZipReader::ZipReader(std::istream* stream) :
+    pimpl_(new PImpl)
+  {
+    pimpl_->stream_.reset(stream);
+
+    if (stream == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+
+    if (!stream->good())
+    {
+      throw OrthancException(ErrorCode_InexistentFile);
+    }
+
+    stream->seekg(0, std::ios::end);
+    std::streamoff size = stream->tellg();
+    if (size < 0)
+    {
+      throw OrthancException(ErrorCode_CorruptedFile);
+    }
+
+    pimpl_->size_ = static_cast<uint64_t>(size);
+    pimpl_->ReadCentralDirectory();
+  }
+
+
+  ZipReader* ZipReader::CreateFromFile(const std::string& path)
+  {
+    return new ZipReader(new boost::filesystem::ifstream(path, std::ios::in | std::ios::binary));
+  }
+
+
+  ZipReader* ZipReader::CreateFromMemory(const void* buffer,
+                                         size_t size)
+  {
+    return new ZipReader(new std::istringstream(std::string(reinterpret_cast<const char*>(buffer), size),
+                                                std::ios::in | std::ios::binary));
+  }
+
+
+  ZipReader* ZipReader::CreateFromMemory(const std::string& buffer)
+  {
+    return new ZipReader(new std::istringstream(buffer, std::ios::in | std::ios::binary));
+  }
+
+
+  bool ZipReader::IsZipMemoryBuffer(const void* buffer,
+                                    size_t size)
+  {
+    if (size < 4)
+    {
+      return false;
+    }
+    else
+    {
+      // Either a local file header, or the end of an empty archive
+      const uint8_t* c = reinterpret_cast<const uint8_t*>(buffer);
+      return (c[0] == 'P' &&
+              c[1] == 'K' &&
+              ((c[2] == 3 && c[3] == 4) ||
+               (c[2] == 5 && c[3] == 6)));
+    }
+  }
+
+
+  size_t ZipReader::GetFilesCount() const
+  {
+    return pimpl_->entries_.size();
+  }
+
+
+  const std::string& ZipReader::GetFilename(size_t index) const
+  {
+    if (index >= pimpl_->entries_.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    return pimpl_->entries_[index].filename_;
+  }
+
+
+  uint64_t ZipReader::GetUncompressedSize(size_t index) const
+  {
+    if (index >= pimpl_->entries_.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    return pimpl_->entries_[index].uncompressedSize_;
+  }
+
+
+  void ZipReader::SetMaximumFileSize(uint64_t size)
+  {
+    pimpl_->maximumFileSize_ = size;
+  }
+
+
+  uint64_t ZipReader::GetMaximumFileSize() const
+  {
+    return pimpl_->maximumFileSize_;
+  }
+
+
+  void ZipReader::ReadFile(std::string& content,
+                           size_t index)
+  {
+    if (index >= pimpl_->entries_.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    const PImpl::Entry& entry = pimpl_->entries_[index];
+
+    if (entry.flags_ & 0x0001)
+    {
+      LOG(ERROR) << "Encrypted files in ZIP archives are not supported: " << entry.filename_;
+      throw OrthancException(ErrorCode_NotImplemented);
+    }
+
+    if (entry.uncompressedSize_ > static_cast<uint64_t>(std::numeric_limits<uInt>::max()) ||
+        (pimpl_->maximumFileSize_ != 0 &&
+         entry.uncompressedSize_ > pimpl_->maximumFileSize_))
+    {
+      LOG(ERROR) << "Too large file in ZIP archive (" << entry.uncompressedSize_
+                 << " bytes): " << entry.filename_;
+      throw OrthancException(ErrorCode_NotEnoughMemory);
+    }
+
+    if (entry.method_ == 8 &&
+        entry.uncompressedSize_ / MAX_DEFLATE_RATIO > entry.compressedSize_)
+    {
+      LOG(ERROR) << "Impossible compression ratio in ZIP archive (" << entry.compressedSize_
+                 << " bytes inflated to " << entry.uncompressedSize_ << "): " << entry.filename_;
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    std::string header;
+    pimpl_->Read(header, entry.localHeaderOffset_, LOCAL_FILE_HEADER_SIZE);
+
+    if (ReadUint32(header, 0) != SIGNATURE_LOCAL_FILE_HEADER)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    // The length of the extra field may differ from the one in the
+    // central directory
+    const uint64_t dataOffset = (entry.localHeaderOffset_ + LOCAL_FILE_HEADER_SIZE +
+                                 ReadUint16(header, 26) + ReadUint16(header, 28));
+
+    switch (entry.method_)
+    {
+      case 0:  // Stored
+        if (entry.compressedSize_ != entry.uncompressedSize_)
+        {
+          throw OrthancException(ErrorCode_BadFileFormat);
+        }
+
+        pimpl_->Read(content, dataOffset, entry.uncompressedSize_);
+        break;
+
+      case 8:  // Deflate
+        pimpl_->Inflate(content, entry, dataOffset);
+        break;
+
+      default:
+        LOG(ERROR) << "Unsupported compression method (" << entry.method_
+                   << ") in ZIP archive: " << entry.filename_;
+        throw OrthancException(ErrorCode_NotImplemented);
+    }
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+    if (!content.empty())
+    {
+      crc = crc32(crc, reinterpret_cast<const Bytef*>(content.c_str()), static_cast<uInt>(content.size()));
+    }
+
+    if (crc != entry.crc32_)
+    {
+      LOG(ERROR) << "Bad CRC32 in ZIP archive: " << entry.filename_;
+      throw OrthancException(ErrorCode_CorruptedFile);
+    }
+  }
+}
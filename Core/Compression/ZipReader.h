@@ -0,0 +1,98 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#pragma once
+
+#if !defined(ORTHANC_ENABLE_ZLIB)
+#  error The macro ORTHANC_ENABLE_ZLIB must be defined
+#endif
+
+#if ORTHANC_ENABLE_ZLIB != 1
+#  error ZLIB support must be enabled to include this file
+#endif
+
+
+#include <stdint.h>
+#include <istream>
+#include <string>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace Orthanc
+{
+  /**
+   * Reader of the files of a ZIP archive, as created by ZipWriter.
+   * The central directory is parsed once at construction, then each
+   * file is decompressed on request, so that only one uncompressed
+   * file is held in RAM at a time. Only the "stored" and "deflate"
+   * methods are supported, as well as ZIP64 archives. This class is
+   * not thread-safe.
+   **/
+  class ZipReader : public boost::noncopyable
+  {
+  private:
+    struct PImpl;
+    boost::shared_ptr<PImpl> pimpl_;
+
+    explicit ZipReader(std::istream* stream);  // Takes ownership
+
+  public:
+    static ZipReader* CreateFromFile(const std::string& path);
+
+    static ZipReader* CreateFromMemory(const void* buffer,
+                                       size_t size);
+
+    static ZipReader* CreateFromMemory(const std::string& buffer);
+
+    static bool IsZipMemoryBuffer(const void* buffer,
+                                  size_t size);
+
+    // The directories of the archive are not counted
+    size_t GetFilesCount() const;
+
+    const std::string& GetFilename(size_t index) const;
+
+    uint64_t GetUncompressedSize(size_t index) const;
+
+    // Upper bound on the uncompressed size of the files that can be
+    // read, in bytes ("0" means no limit, which is the default)
+    void SetMaximumFileSize(uint64_t size);
+
+    uint64_t GetMaximumFileSize() const;
+
+    void ReadFile(std::string& content,
+                  size_t index);
+  };
+}
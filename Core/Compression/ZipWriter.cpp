@@ -39,7 +39,9 @@
 
 #include "ZipWriter.h"
 
+#include <algorithm>
 #include <limits>
+#include <vector>
 #include <boost/filesystem.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 
@@ -77,9 +79,418 @@ static void PrepareFileInfo(zip_fileinfo& zfi)
 
 namespace Orthanc
 {
+  namespace
+  {
+    /**
+     * Writer of a ZIP archive into an output stream, that cannot be
+     * seeked. Each entry is compressed on-the-fly, and its bytes are
+     * pushed to the stream as soon as enough of them are
+     * available. As the local header of an entry cannot be patched
+     * afterwards, its CRC32 and its sizes are stored in a "data
+     * descriptor" that follows the compressed data (bit 3 of the
+     * general purpose flag, with 64bit sizes in ZIP64 mode). The
+     * central directory is written once the archive is closed.
+     **/
+    class StreamWriter : public boost::noncopyable
+    {
+    private:
+      struct Entry
+      {
+        std::string  filename_;
+        uint16_t     time_;
+        uint16_t     date_;
+        uint32_t     crc32_;
+        uint64_t     compressedSize_;
+        uint64_t     uncompressedSize_;
+        uint64_t     offset_;
+      };
+
+      static const size_t FLUSH_THRESHOLD = 64 * 1024;
+
+      std::auto_ptr<ZipWriter::IOutputStream>  stream_;
+      bool                isZip64_;
+      bool                isClosed_;
+      uint64_t            position_;   // Number of bytes sent to the stream
+      std::string         buffer_;     // Bytes that are not sent yet
+      std::vector<Entry>  entries_;
+      bool                hasEntry_;
+      z_stream            zlib_;
+
+      void Append(const void* data,
+                  size_t size)
+      {
+        if (size > 0)
+        {
+          buffer_.append(reinterpret_cast<const char*>(data), size);
+        }
+      }
+
+      void AppendUint16(uint64_t value)
+      {
+        uint8_t b[2];
+        b[0] = static_cast<uint8_t>(value & 0xff);
+        b[1] = static_cast<uint8_t>((value >> 8) & 0xff);
+        Append(b, sizeof(b));
+      }
+
+      void AppendUint32(uint64_t value)
+      {
+        AppendUint16(value & 0xffff);
+        AppendUint16((value >> 16) & 0xffff);
+      }
+
+      void AppendUint64(uint64_t value)
+      {
+        AppendUint32(value & 0xffffffffu);
+        AppendUint32(value >> 32);
+      }
+
+      void Flush(bool force)
+      {
+        if (!buffer_.empty() &&
+            (force || buffer_.size() >= FLUSH_THRESHOLD))
+        {
+          stream_->Write(buffer_);
+          position_ += buffer_.size();
+          buffer_.clear();
+        }
+      }
+
+      uint64_t GetPosition() const
+      {
+        return position_ + buffer_.size();
+      }
+
+      uint16_t GetVersion() const
+      {
+        // 4.5 for ZIP64, 2.0 for deflate
+        return isZip64_ ? 45 : 20;
+      }
+
+      void CheckLimit(uint64_t value) const
+      {
+        if (!isZip64_ &&
+            value >= 0xffffffffu)
+        {
+          LOG(ERROR) << "Too large ZIP archive, ZIP64 is needed";
+          throw OrthancException(ErrorCode_CannotWriteFile);
+        }
+      }
+
+      void Deflate(int flush)
+      {
+        uint8_t output[16384];
+
+        for (;;)
+        {
+          zlib_.next_out = output;
+          zlib_.avail_out = sizeof(output);
+
+          int code = deflate(&zlib_, flush);
+          if (code != Z_OK &&
+              code != Z_STREAM_END &&
+              code != Z_BUF_ERROR)
+          {
+            throw OrthancException(ErrorCode_CannotWriteFile);
+          }
+
+          size_t produced = sizeof(output) - zlib_.avail_out;
+          Append(output, produced);
+          entries_.back().compressedSize_ += produced;
+
+          if (code == Z_STREAM_END ||
+              (flush == Z_NO_FLUSH && zlib_.avail_out != 0))
+          {
+            break;
+          }
+        }
+
+        Flush(false);
+      }
+
+      void CloseEntry()
+      {
+        if (!hasEntry_)
+        {
+          return;
+        }
+
+        hasEntry_ = false;
+
+        zlib_.next_in = NULL;
+        zlib_.avail_in = 0;
+
+        try
+        {
+          Deflate(Z_FINISH);
+        }
+        catch (OrthancException&)
+        {
+          deflateEnd(&zlib_);
+          throw;
+        }
+
+        deflateEnd(&zlib_);
+
+        const Entry& entry = entries_.back();
+        CheckLimit(entry.compressedSize_);
+        CheckLimit(entry.uncompressedSize_);
+
+        // Data descriptor
+        AppendUint32(0x08074b50);
+        AppendUint32(entry.crc32_);
+
+        if (isZip64_)
+        {
+          AppendUint64(entry.compressedSize_);
+          AppendUint64(entry.uncompressedSize_);
+        }
+        else
+        {
+          AppendUint32(entry.compressedSize_);
+          AppendUint32(entry.uncompressedSize_);
+        }
+
+        Flush(false);
+      }
+
+    public:
+      StreamWriter(ZipWriter::IOutputStream* stream,
+                   bool isZip64) :
+        stream_(stream),
+        isZip64_(isZip64),
+        isClosed_(false),
+        position_(0),
+        hasEntry_(false)
+      {
+        if (stream == NULL)
+        {
+          throw OrthancException(ErrorCode_NullPointer);
+        }
+
+        memset(&zlib_, 0, sizeof(zlib_));
+      }
+
+      ~StreamWriter()
+      {
+        if (hasEntry_)
+        {
+          deflateEnd(&zlib_);
+        }
+      }
+
+      void OpenEntry(const char* path,
+                     uint8_t compressionLevel)
+      {
+        if (isClosed_)
+        {
+          throw OrthancException(ErrorCode_BadSequenceOfCalls);
+        }
+
+        CloseEntry();
+
+        if (!isZip64_ &&
+            entries_.size() >= 0xffff)
+        {
+          LOG(ERROR) << "Too many files in the ZIP archive, ZIP64 is needed";
+          throw OrthancException(ErrorCode_CannotWriteFile);
+        }
+
+        zip_fileinfo zfi;
+        PrepareFileInfo(zfi);
+
+        Entry entry;
+        entry.filename_ = path;
+        entry.time_ = static_cast<uint16_t>((zfi.tmz_date.tm_hour << 11) |
+                                            (zfi.tmz_date.tm_min << 5) |
+                                            (zfi.tmz_date.tm_sec / 2));
+        entry.date_ = static_cast<uint16_t>(((zfi.tmz_date.tm_year - 1980) << 9) |
+                                            ((zfi.tmz_date.tm_mon + 1) << 5) |
+                                            zfi.tmz_date.tm_mday);
+        entry.crc32_ = crc32(0L, Z_NULL, 0);
+        entry.compressedSize_ = 0;
+        entry.uncompressedSize_ = 0;
+        entry.offset_ = GetPosition();
+        CheckLimit(entry.offset_);
+
+        if (entry.filename_.size() > 0xffff)
+        {
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
+        }
+
+        memset(&zlib_, 0, sizeof(zlib_));
+        if (deflateInit2(&zlib_, compressionLevel, Z_DEFLATED,
+                         -MAX_WBITS /* raw deflate */, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+          throw OrthancException(ErrorCode_NotEnoughMemory);
+        }
+
+        entries_.push_back(entry);
+        hasEntry_ = true;
+
+        // Local file header, whose CRC32 and sizes are left empty
+        AppendUint32(0x04034b50);
+        AppendUint16(GetVersion());
+        AppendUint16(0x0008);  // The sizes are in the data descriptor
+        AppendUint16(Z_DEFLATED);
+        AppendUint16(entry.time_);
+        AppendUint16(entry.date_);
+        AppendUint32(0);
+        AppendUint32(isZip64_ ? 0xffffffffu : 0);
+        AppendUint32(isZip64_ ? 0xffffffffu : 0);
+        AppendUint16(entry.filename_.size());
+        AppendUint16(isZip64_ ? 20 : 0);
+        Append(entry.filename_.c_str(), entry.filename_.size());
+
+        if (isZip64_)
+        {
+          AppendUint16(0x0001);  // ZIP64 extended information
+          AppendUint16(16);
+          AppendUint64(0);
+          AppendUint64(0);
+        }
+
+        Flush(false);
+      }
+
+      bool HasEntry() const
+      {
+        return hasEntry_;
+      }
+
+      void Write(const char* data,
+                 size_t length)
+      {
+        if (!hasEntry_)
+        {
+          throw OrthancException(ErrorCode_BadSequenceOfCalls);
+        }
+
+        const size_t maxBytesInAStep = std::numeric_limits<uInt>::max();
+
+        while (length > 0)
+        {
+          uInt bytes = static_cast<uInt>(length <= maxBytesInAStep ? length : maxBytesInAStep);
+
+          Entry& entry = entries_.back();
+          entry.crc32_ = crc32(entry.crc32_, reinterpret_cast<const Bytef*>(data), bytes);
+          entry.uncompressedSize_ += bytes;
+
+          zlib_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+          zlib_.avail_in = bytes;
+          Deflate(Z_NO_FLUSH);
+
+          data += bytes;
+          length -= bytes;
+        }
+      }
+
+      void Close(const std::string& comment)
+      {
+        if (isClosed_)
+        {
+          return;
+        }
+
+        CloseEntry();
+        isClosed_ = true;
+
+        const uint64_t directoryOffset = GetPosition();
+        CheckLimit(directoryOffset);
+
+        for (size_t i = 0; i < entries_.size(); i++)
+        {
+          const Entry& entry = entries_[i];
+
+          AppendUint32(0x02014b50);
+          AppendUint16(GetVersion());  // Version made by
+          AppendUint16(GetVersion());  // Version needed to extract
+          AppendUint16(0x0008);
+          AppendUint16(Z_DEFLATED);
+          AppendUint16(entry.time_);
+          AppendUint16(entry.date_);
+          AppendUint32(entry.crc32_);
+
+          if (isZip64_)
+          {
+            AppendUint32(0xffffffffu);
+            AppendUint32(0xffffffffu);
+          }
+          else
+          {
+            AppendUint32(entry.compressedSize_);
+            AppendUint32(entry.uncompressedSize_);
+          }
+
+          AppendUint16(entry.filename_.size());
+          AppendUint16(isZip64_ ? 28 : 0);  // Extra field length
+          AppendUint16(0);  // Comment length
+          AppendUint16(0);  // Disk number
+          AppendUint16(0);  // Internal attributes
+          AppendUint32(0);  // External attributes
+          AppendUint32(isZip64_ ? 0xffffffffu : entry.offset_);
+          Append(entry.filename_.c_str(), entry.filename_.size());
+
+          if (isZip64_)
+          {
+            AppendUint16(0x0001);
+            AppendUint16(24);
+            AppendUint64(entry.uncompressedSize_);
+            AppendUint64(entry.compressedSize_);
+            AppendUint64(entry.offset_);
+          }
+
+          Flush(false);
+        }
+
+        const uint64_t directoryEnd = GetPosition();
+        const uint64_t directorySize = directoryEnd - directoryOffset;
+        CheckLimit(directorySize);
+
+        if (isZip64_)
+        {
+          // ZIP64 end of central directory record
+          AppendUint32(0x06064b50);
+          AppendUint64(44);
+          AppendUint16(GetVersion());
+          AppendUint16(GetVersion());
+          AppendUint32(0);
+          AppendUint32(0);
+          AppendUint64(entries_.size());
+          AppendUint64(entries_.size());
+          AppendUint64(directorySize);
+          AppendUint64(directoryOffset);
+
+          // ZIP64 end of central directory locator
+          AppendUint32(0x07064b50);
+          AppendUint32(0);
+          AppendUint64(directoryEnd);
+          AppendUint32(1);
+        }
+
+        const uint64_t count = std::min<uint64_t>(entries_.size(), 0xffff);
+
+        AppendUint32(0x06054b50);
+        AppendUint16(0);  // Number of this disk
+        AppendUint16(0);  // Disk where the central directory starts
+        AppendUint16(count);
+        AppendUint16(count);
+        AppendUint32(std::min<uint64_t>(directorySize, 0xffffffffu));
+        AppendUint32(std::min<uint64_t>(directoryOffset, 0xffffffffu));
+        AppendUint16(comment.size());
+        Append(comment.c_str(), comment.size());
+
+        Flush(true);
+        stream_->Close();
+      }
+    };
+  }
+
+
   struct ZipWriter::PImpl
   {
     zipFile file_;
+    std::auto_ptr<StreamWriter>  stream_;
 
     PImpl() : file_(NULL)
     {
@@ -97,22 +508,47 @@ namespace Orthanc
 
   ZipWriter::~ZipWriter()
   {
-    Close();
+    try
+    {
+      Close();
+    }
+    catch (OrthancException&)
+    {
+      LOG(ERROR) << "Error while closing a ZIP archive";
+    }
   }
 
   void ZipWriter::Close()
   {
-    if (IsOpen())
+    if (pimpl_->stream_.get() != NULL)
     {
-      zipClose(pimpl_->file_, "Created by Orthanc");
+      // The output stream cannot be reopened
+      std::auto_ptr<StreamWriter> stream(pimpl_->stream_.release());
+      hasFileInZip_ = false;
+      stream->Close("Created by Orthanc");
+    }
+    else if (IsOpen())
+    {
+      int result = zipClose(pimpl_->file_, "Created by Orthanc");
       pimpl_->file_ = NULL;
       hasFileInZip_ = false;
+
+      if (result != 0)
+      {
+        throw OrthancException(ErrorCode_CannotWriteFile);
+      }
     }
   }
 
+  bool ZipWriter::IsStreaming() const
+  {
+    return pimpl_->stream_.get() != NULL;
+  }
+
   bool ZipWriter::IsOpen() const
   {
-    return pimpl_->file_ != NULL;
+    return (pimpl_->file_ != NULL ||
+            pimpl_->stream_.get() != NULL);
   }
 
   void ZipWriter::Open()
@@ -122,14 +558,14 @@ namespace Orthanc
       return;
     }
 
+    hasFileInZip_ = false;
+
     if (path_.size() == 0)
     {
       LOG(ERROR) << "Please call SetOutputPath() before creating the file";
       throw OrthancException(ErrorCode_BadSequenceOfCalls);
     }
 
-    hasFileInZip_ = false;
-
     int mode = APPEND_STATUS_CREATE;
     if (append_ && 
         boost::filesystem::exists(path_))
@@ -155,11 +591,40 @@ namespace Orthanc
   void ZipWriter::SetOutputPath(const char* path)
   {
     Close();
+    pimpl_->stream_.reset(NULL);
     path_ = path;
   }
 
+  void ZipWriter::AcquireOutputStream(IOutputStream* stream,
+                                      bool isZip64)
+  {
+    std::auto_ptr<IOutputStream> protection(stream);
+
+    if (stream == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+
+    Close();
+    path_.clear();
+    isZip64_ = isZip64;
+    append_ = false;
+    pimpl_->stream_.reset(new StreamWriter(protection.release(), isZip64));
+  }
+
   void ZipWriter::SetZip64(bool isZip64)
   {
+    if (IsStreaming())
+    {
+      if (isZip64 != isZip64_)
+      {
+        // The archive has already started to be streamed
+        throw OrthancException(ErrorCode_BadSequenceOfCalls);
+      }
+
+      return;
+    }
+
     Close();
     isZip64_ = isZip64;
   }
@@ -172,12 +637,24 @@ namespace Orthanc
       throw OrthancException(ErrorCode_ParameterOutOfRange);
     }
 
-    Close();
+    if (!IsStreaming())
+    {
+      Close();
+    }
+
+    // With an output stream, the level applies to the next entries
     compressionLevel_ = level;
   }
 
   void ZipWriter::OpenFile(const char* path)
   {
+    if (pimpl_->stream_.get() != NULL)
+    {
+      pimpl_->stream_->OpenEntry(path, compressionLevel_);
+      hasFileInZip_ = true;
+      return;
+    }
+
     Open();
 
     zip_fileinfo zfi;
@@ -232,6 +709,12 @@ namespace Orthanc
       throw OrthancException(ErrorCode_BadSequenceOfCalls);
     }
 
+    if (pimpl_->stream_.get() != NULL)
+    {
+      pimpl_->stream_->Write(data, length);
+      return;
+    }
+
     const size_t maxBytesInAStep = std::numeric_limits<int32_t>::max();
 
     while (length > 0)
@@ -251,6 +734,12 @@ namespace Orthanc
 
   void ZipWriter::SetAppendToExisting(bool append)
   {
+    if (IsStreaming())
+    {
+      LOG(ERROR) << "Cannot append to an existing archive while writing to an output stream";
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
     Close();
     append_ = append;
   }
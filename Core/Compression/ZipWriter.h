@@ -45,11 +45,31 @@
 #include <stdint.h>
 #include <string>
 #include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
 
 namespace Orthanc
 {
   class ZipWriter
   {
+  public:
+    /**
+     * Sink receiving the bytes of the ZIP archive, as an alternative
+     * to writing the archive into a file. The compressed bytes are
+     * pushed by chunks while the entries are written, the size and
+     * the CRC32 of each entry being stored in a data descriptor.
+     **/
+    class IOutputStream : public boost::noncopyable
+    {
+    public:
+      virtual ~IOutputStream()
+      {
+      }
+
+      virtual void Write(const std::string& chunk) = 0;
+
+      virtual void Close() = 0;
+    };
+
   private:
     struct PImpl;
     boost::shared_ptr<PImpl> pimpl_;
@@ -99,6 +119,12 @@ namespace Orthanc
       return path_;
     }
 
+    // Takes the ownership of "stream", that replaces the output path
+    void AcquireOutputStream(IOutputStream* stream,
+                             bool isZip64);
+
+    bool IsStreaming() const;
+
     void OpenFile(const char* path);
 
     void Write(const char* data, size_t length);
@@ -0,0 +1,578 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "DicomBinarySummary.h"
+
+#include "../OrthancException.h"
+
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <string.h>
+#include <vector>
+
+
+/**
+ * Layout of the binary summary (all the integers are little-endian):
+ *
+ * - Header (16 bytes): The magic string "OSUM", the version of the
+ *   format (currently 1), the offset of the top-level dataset, and
+ *   the total size of the summary.
+ *
+ * - Dataset: The number of tags (4 bytes), followed by one entry of
+ *   20 bytes per tag, sorted by increasing tag: group (2 bytes),
+ *   element (2 bytes), type (1 byte), padding (3 bytes), offset of
+ *   the name, offset of the value, and offset of the private creator.
+ *   A null offset denotes a missing field.
+ *
+ * - String: Its length (4 bytes), followed by its content.
+ *
+ * - Sequence: The number of items (4 bytes), followed by the offsets
+ *   of the datasets of the items. A nested dataset is always located
+ *   after its parent, which prevents loops in corrupted summaries.
+ **/
+
+namespace Orthanc
+{
+  static const char     MAGIC[4] = { 'O', 'S', 'U', 'M' };
+  static const uint32_t VERSION = 1;
+  static const uint32_t HEADER_SIZE = 16;
+  static const uint32_t ENTRY_SIZE = 20;
+
+
+  namespace
+  {
+    class Encoder : public boost::noncopyable
+    {
+    private:
+      typedef std::map<std::string, uint32_t>  Strings;
+
+      std::string&  target_;
+      Strings       pool_;   // Avoids repeating the names of the tags
+
+      uint32_t GetPosition() const
+      {
+        if (static_cast<uint64_t>(target_.size()) > 0xffffffffllu)
+        {
+          throw OrthancException(ErrorCode_NotEnoughMemory);
+        }
+
+        return static_cast<uint32_t>(target_.size());
+      }
+
+      void WriteUInt16(size_t position,
+                       uint16_t value)
+      {
+        target_[position] = static_cast<char>(value & 0xff);
+        target_[position + 1] = static_cast<char>(value >> 8);
+      }
+
+      void WriteUInt32(size_t position,
+                       uint32_t value)
+      {
+        for (size_t i = 0; i < 4; i++)
+        {
+          target_[position + i] = static_cast<char>((value >> (8 * i)) & 0xff);
+        }
+      }
+
+      void AppendUInt32(uint32_t value)
+      {
+        size_t position = target_.size();
+        target_.resize(position + 4);
+        WriteUInt32(position, value);
+      }
+
+      uint32_t AppendString(const std::string& value)
+      {
+        uint32_t position = GetPosition();
+        AppendUInt32(static_cast<uint32_t>(value.size()));
+        target_.append(value);
+        return position;
+      }
+
+      uint32_t AppendPooledString(const std::string& value)
+      {
+        Strings::const_iterator found = pool_.find(value);
+        if (found == pool_.end())
+        {
+          uint32_t position = AppendString(value);
+          pool_[value] = position;
+          return position;
+        }
+        else
+        {
+          return found->second;
+        }
+      }
+
+      static DicomBinarySummary::TagType ParseType(const Json::Value& node)
+      {
+        if (node.type() != Json::objectValue ||
+            !node.isMember("Type") ||
+            node["Type"].type() != Json::stringValue)
+        {
+          throw OrthancException(ErrorCode_BadFileFormat);
+        }
+
+        const std::string type = node["Type"].asString();
+        if (type == "Null")
+        {
+          return DicomBinarySummary::TagType_Null;
+        }
+        else if (type == "String")
+        {
+          return DicomBinarySummary::TagType_String;
+        }
+        else if (type == "TooLong")
+        {
+          return DicomBinarySummary::TagType_TooLong;
+        }
+        else if (type == "Binary")
+        {
+          return DicomBinarySummary::TagType_Binary;
+        }
+        else if (type == "Sequence")
+        {
+          return DicomBinarySummary::TagType_Sequence;
+        }
+        else
+        {
+          throw OrthancException(ErrorCode_BadFileFormat);
+        }
+      }
+
+      uint32_t EncodeSequence(const Json::Value& items)
+      {
+        if (items.type() != Json::arrayValue)
+        {
+          throw OrthancException(ErrorCode_BadFileFormat);
+        }
+
+        uint32_t sequence = GetPosition();
+        AppendUInt32(items.size());
+        target_.resize(target_.size() + 4 * items.size());
+
+        for (Json::Value::ArrayIndex i = 0; i < items.size(); i++)
+        {
+          uint32_t item = EncodeDataset(items[i]);
+          WriteUInt32(sequence + 4 + 4 * i, item);
+        }
+
+        return sequence;
+      }
+
+      uint32_t EncodeDataset(const Json::Value& source)
+      {
+        if (source.type() != Json::objectValue)
+        {
+          throw OrthancException(ErrorCode_BadFileFormat);
+        }
+
+        typedef std::vector< std::pair<DicomTag, std::string> >  Tags;
+
+        Tags tags;
+        tags.reserve(source.size());
+
+        Json::Value::Members members = source.getMemberNames();
+        for (size_t i = 0; i < members.size(); i++)
+        {
+          DicomTag tag(0, 0);
+          if (!DicomTag::ParseHexadecimal(tag, members[i].c_str()))
+          {
+            throw OrthancException(ErrorCode_BadFileFormat);
+          }
+
+          tags.push_back(std::make_pair(tag, members[i]));
+        }
+
+        std::sort(tags.begin(), tags.end());
+
+        uint32_t dataset = GetPosition();
+        AppendUInt32(static_cast<uint32_t>(tags.size()));
+        target_.resize(target_.size() + ENTRY_SIZE * tags.size(), '\0');
+
+        for (size_t i = 0; i < tags.size(); i++)
+        {
+          const Json::Value& node = source[tags[i].second];
+          DicomBinarySummary::TagType type = ParseType(node);
+
+          if (!node.isMember("Name") ||
+              node["Name"].type() != Json::stringValue)
+          {
+            throw OrthancException(ErrorCode_BadFileFormat);
+          }
+
+          size_t entry = dataset + 4 + ENTRY_SIZE * i;
+          WriteUInt16(entry, tags[i].first.GetGroup());
+          WriteUInt16(entry + 2, tags[i].first.GetElement());
+          target_[entry + 4] = static_cast<char>(type);
+          WriteUInt32(entry + 8, AppendPooledString(node["Name"].asString()));
+
+          if (node.isMember("PrivateCreator"))
+          {
+            WriteUInt32(entry + 16, AppendPooledString(node["PrivateCreator"].asString()));
+          }
+
+          switch (type)
+          {
+            case DicomBinarySummary::TagType_String:
+            case DicomBinarySummary::TagType_Binary:
+              WriteUInt32(entry + 12, AppendString(node["Value"].asString()));
+              break;
+
+            case DicomBinarySummary::TagType_Sequence:
+              WriteUInt32(entry + 12, EncodeSequence(node["Value"]));
+              break;
+
+            default:
+              break;
+          }
+        }
+
+        return dataset;
+      }
+
+    public:
+      explicit Encoder(std::string& target) :
+        target_(target)
+      {
+      }
+
+      void Encode(const Json::Value& source)
+      {
+        target_.assign(MAGIC, sizeof(MAGIC));
+        AppendUInt32(VERSION);
+        AppendUInt32(0);  // Offset of the top-level dataset, set below
+        AppendUInt32(0);  // Total size, set below
+        assert(target_.size() == HEADER_SIZE);
+
+        uint32_t root = EncodeDataset(source);
+        WriteUInt32(8, root);
+        WriteUInt32(12, GetPosition());
+      }
+    };
+  }
+
+
+  void DicomBinarySummary::Setup(const void* data,
+                                 size_t size)
+  {
+    data_ = reinterpret_cast<const uint8_t*>(data);
+    size_ = size;
+
+    if (!IsBinarySummary(data, size) ||
+        ReadUInt32(4) != VERSION ||
+        ReadUInt32(12) != size)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    root_ = ReadUInt32(8);
+    if (root_ < HEADER_SIZE)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    GetDatasetSize(root_);  // Sanity check of the top-level table
+  }
+
+
+  uint32_t DicomBinarySummary::ReadUInt32(uint64_t offset) const
+  {
+    if (offset + 4 > size_)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    const uint8_t* p = data_ + offset;
+    return (static_cast<uint32_t>(p[0]) |
+            (static_cast<uint32_t>(p[1]) << 8) |
+            (static_cast<uint32_t>(p[2]) << 16) |
+            (static_cast<uint32_t>(p[3]) << 24));
+  }
+
+
+  uint16_t DicomBinarySummary::ReadUInt16(uint64_t offset) const
+  {
+    if (offset + 2 > size_)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    const uint8_t* p = data_ + offset;
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+  }
+
+
+  void DicomBinarySummary::ReadString(std::string& target,
+                                      uint32_t offset) const
+  {
+    uint32_t length = ReadUInt32(offset);
+
+    if (static_cast<uint64_t>(offset) + 4 + length > size_)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    target.assign(reinterpret_cast<const char*>(data_) + offset + 4, length);
+  }
+
+
+  uint32_t DicomBinarySummary::GetDatasetSize(uint32_t dataset) const
+  {
+    uint32_t count = ReadUInt32(dataset);
+
+    if (static_cast<uint64_t>(dataset) + 4 + static_cast<uint64_t>(count) * ENTRY_SIZE > size_)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    return count;
+  }
+
+
+  uint32_t DicomBinarySummary::GetEntry(uint32_t dataset,
+                                        uint32_t index) const
+  {
+    // "GetDatasetSize()" has checked that the table fits in the buffer
+    return dataset + 4 + index * ENTRY_SIZE;
+  }
+
+
+  DicomTag DicomBinarySummary::GetEntryTag(uint32_t entry) const
+  {
+    return DicomTag(ReadUInt16(entry), ReadUInt16(entry + 2));
+  }
+
+
+  DicomBinarySummary::TagType DicomBinarySummary::GetEntryType(uint32_t entry) const
+  {
+    uint8_t type = data_[entry + 4];
+
+    if (type > TagType_Sequence)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    return static_cast<TagType>(type);
+  }
+
+
+  bool DicomBinarySummary::LookupEntry(uint32_t& entry,
+                                       const DicomTag& tag) const
+  {
+    // Binary search in the sorted table of the top-level dataset
+    uint32_t low = 0;
+    uint32_t high = GetDatasetSize(root_);
+
+    while (low < high)
+    {
+      uint32_t middle = low + (high - low) / 2;
+      uint32_t candidate = GetEntry(root_, middle);
+      DicomTag current = GetEntryTag(candidate);
+
+      if (current == tag)
+      {
+        entry = candidate;
+        return true;
+      }
+      else if (current < tag)
+      {
+        low = middle + 1;
+      }
+      else
+      {
+        high = middle;
+      }
+    }
+
+    return false;
+  }
+
+
+  void DicomBinarySummary::DatasetToJson(Json::Value& target,
+                                         uint32_t dataset) const
+  {
+    target = Json::objectValue;
+
+    uint32_t count = GetDatasetSize(dataset);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+      uint32_t entry = GetEntry(dataset, i);
+
+      Json::Value& node = target[GetEntryTag(entry).Format()];
+      node = Json::objectValue;
+
+      std::string s;
+      ReadString(s, ReadUInt32(entry + 8));
+      node["Name"] = s;
+
+      uint32_t privateCreator = ReadUInt32(entry + 16);
+      if (privateCreator != 0)
+      {
+        ReadString(s, privateCreator);
+        node["PrivateCreator"] = s;
+      }
+
+      switch (GetEntryType(entry))
+      {
+        case TagType_Null:
+          node["Type"] = "Null";
+          node["Value"] = Json::nullValue;
+          break;
+
+        case TagType_String:
+          ReadString(s, ReadUInt32(entry + 12));
+          node["Type"] = "String";
+          node["Value"] = s;
+          break;
+
+        case TagType_TooLong:
+          node["Type"] = "TooLong";
+          node["Value"] = Json::nullValue;
+          break;
+
+        case TagType_Binary:
+          ReadString(s, ReadUInt32(entry + 12));
+          node["Type"] = "Binary";
+          node["Value"] = s;
+          break;
+
+        case TagType_Sequence:
+        {
+          uint32_t sequence = ReadUInt32(entry + 12);
+          if (sequence <= dataset)
+          {
+            throw OrthancException(ErrorCode_BadFileFormat);
+          }
+
+          uint32_t items = ReadUInt32(sequence);
+          if (static_cast<uint64_t>(sequence) + 4 + 4 * static_cast<uint64_t>(items) > size_)
+          {
+            throw OrthancException(ErrorCode_BadFileFormat);
+          }
+
+          node["Type"] = "Sequence";
+          node["Value"] = Json::arrayValue;
+
+          for (uint32_t j = 0; j < items; j++)
+          {
+            uint32_t item = ReadUInt32(sequence + 4 + 4 * j);
+            if (item <= sequence)
+            {
+              throw OrthancException(ErrorCode_BadFileFormat);
+            }
+
+            DatasetToJson(node["Value"].append(Json::objectValue), item);
+          }
+
+          break;
+        }
+
+        default:
+          throw OrthancException(ErrorCode_InternalError);
+      }
+    }
+  }
+
+
+  DicomTag DicomBinarySummary::GetTag(size_t index) const
+  {
+    if (index >= GetTagsCount())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    return GetEntryTag(GetEntry(root_, static_cast<uint32_t>(index)));
+  }
+
+
+  bool DicomBinarySummary::LookupTagType(TagType& type,
+                                         const DicomTag& tag) const
+  {
+    uint32_t entry;
+    if (LookupEntry(entry, tag))
+    {
+      type = GetEntryType(entry);
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+
+  bool DicomBinarySummary::LookupStringValue(std::string& target,
+                                             const DicomTag& tag) const
+  {
+    uint32_t entry;
+    if (LookupEntry(entry, tag) &&
+        GetEntryType(entry) == TagType_String)
+    {
+      ReadString(target, ReadUInt32(entry + 12));
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+
+  void DicomBinarySummary::ToJson(Json::Value& target) const
+  {
+    DatasetToJson(target, root_);
+  }
+
+
+  bool DicomBinarySummary::IsBinarySummary(const void* data,
+                                           size_t size)
+  {
+    return (data != NULL &&
+            size >= HEADER_SIZE &&
+            memcmp(data, MAGIC, sizeof(MAGIC)) == 0);
+  }
+
+
+  void DicomBinarySummary::Encode(std::string& target,
+                                  const Json::Value& dicomAsJson)
+  {
+    Encoder encoder(target);
+    encoder.Encode(dicomAsJson);
+  }
+}
@@ -0,0 +1,134 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "DicomTag.h"
+
+#include <stdint.h>
+#include <string>
+#include <boost/noncopyable.hpp>
+#include <json/value.h>
+
+namespace Orthanc
+{
+  /**
+   * Compact binary encoding of the "DICOM-as-JSON" summary of an
+   * instance (i.e. the "Full" JSON format). Each dataset is stored as
+   * a table of fixed-size entries that is sorted by tag, followed by
+   * the strings and the nested sequences it refers to. A tag can
+   * thus be looked up in place by binary search, without any JSON
+   * parsing. This class does not copy the buffer, that must remain
+   * valid during the lifetime of the object.
+   **/
+  class DicomBinarySummary : public boost::noncopyable
+  {
+  public:
+    enum TagType
+    {
+      TagType_Null = 0,
+      TagType_String = 1,
+      TagType_TooLong = 2,
+      TagType_Binary = 3,
+      TagType_Sequence = 4
+    };
+
+  private:
+    const uint8_t*  data_;
+    size_t          size_;
+    uint32_t        root_;
+
+    void Setup(const void* data,
+               size_t size);
+
+    uint32_t ReadUInt32(uint64_t offset) const;
+
+    uint16_t ReadUInt16(uint64_t offset) const;
+
+    void ReadString(std::string& target,
+                    uint32_t offset) const;
+
+    uint32_t GetDatasetSize(uint32_t dataset) const;
+
+    uint32_t GetEntry(uint32_t dataset,
+                      uint32_t index) const;
+
+    DicomTag GetEntryTag(uint32_t entry) const;
+
+    TagType GetEntryType(uint32_t entry) const;
+
+    bool LookupEntry(uint32_t& entry,
+                     const DicomTag& tag) const;
+
+    void DatasetToJson(Json::Value& target,
+                       uint32_t dataset) const;
+
+  public:
+    DicomBinarySummary(const void* data,
+                       size_t size)
+    {
+      Setup(data, size);
+    }
+
+    explicit DicomBinarySummary(const std::string& data)
+    {
+      Setup(data.empty() ? NULL : data.c_str(), data.size());
+    }
+
+    // Number of tags in the top-level dataset
+    size_t GetTagsCount() const
+    {
+      return GetDatasetSize(root_);
+    }
+
+    DicomTag GetTag(size_t index) const;
+
+    bool LookupTagType(TagType& type,
+                       const DicomTag& tag) const;
+
+    // Returns "false" if the top-level tag is absent, or if it is not
+    // a string that was small enough to be stored
+    bool LookupStringValue(std::string& target,
+                           const DicomTag& tag) const;
+
+    // Converts back to the "Full" JSON format
+    void ToJson(Json::Value& target) const;
+
+    static bool IsBinarySummary(const void* data,
+                                size_t size);
+
+    static void Encode(std::string& target,
+                       const Json::Value& dicomAsJson);
+  };
+}
@@ -58,15 +58,51 @@ namespace Orthanc
 
     protection->ChangeEncoding(encoding_);
 
-    answers_.push_back(protection.release());
+    if (stream_ == NULL)
+    {
+      answers_.push_back(protection.release());
+    }
+    else if (!IsCancelled())
+    {
+      if (stream_->Push(protection.release()))
+      {
+        streamedCount_++;
+      }
+      else
+      {
+        cancelled_ = true;
+      }
+    }
   }
 
 
   DicomFindAnswers::DicomFindAnswers(bool isWorklist) : 
     encoding_(GetDefaultDicomEncoding()),
     isWorklist_(isWorklist),
-    complete_(true)
+    complete_(true),
+    stream_(NULL),
+    streamedCount_(0),
+    cancelled_(false)
+  {
+  }
+
+
+  bool DicomFindAnswers::IsCancelled() const
   {
+    return (cancelled_ ||
+            (stream_ != NULL &&
+             stream_->IsCancelled()));
+  }
+
+
+  void DicomFindAnswers::SetStream(IStream& stream)
+  {
+    if (GetSize() != 0)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    stream_ = &stream;
   }
 
 
@@ -84,7 +120,7 @@ namespace Orthanc
 
   void DicomFindAnswers::SetWorklist(bool isWorklist)
   {
-    if (answers_.empty())
+    if (GetSize() == 0)
     {
       isWorklist_ = isWorklist;
     }
@@ -105,6 +141,7 @@ namespace Orthanc
     }
 
     answers_.clear();
+    streamedCount_ = 0;
   }
 
 
@@ -39,11 +39,33 @@ namespace Orthanc
 {
   class DicomFindAnswers : public boost::noncopyable
   {
+  public:
+    // Receives the answers as soon as they are added, while the
+    // handler of the C-FIND request is still running
+    class IStream : public boost::noncopyable
+    {
+    public:
+      virtual ~IStream()
+      {
+      }
+
+      // Takes the ownership of the answer. Returns "false" if the
+      // remote modality has cancelled the C-FIND request.
+      virtual bool Push(ParsedDicomFile* answer) = 0;
+
+      // Returns "true" as soon as the remote modality has cancelled
+      // the C-FIND request, even if no answer was pushed since then
+      virtual bool IsCancelled() const = 0;
+    };
+
   private:
     Encoding                      encoding_;
     bool                          isWorklist_;
     std::vector<ParsedDicomFile*> answers_;
     bool                          complete_;
+    IStream*                      stream_;
+    size_t                        streamedCount_;
+    bool                          cancelled_;
 
     void AddAnswerInternal(ParsedDicomFile* answer);
 
@@ -80,9 +102,23 @@ namespace Orthanc
     void Add(const void* dicom,
              size_t size);
 
+    // In streaming mode, the answers are not stored in this object,
+    // but forwarded to the stream (that must outlive this object)
+    void SetStream(IStream& stream);
+
+    bool IsStreaming() const
+    {
+      return stream_ != NULL;
+    }
+
+    // Can be polled by the handlers of C-FIND requests, in order to
+    // stop their lookup as soon as the remote modality has cancelled
+    // the request. The subsequent answers are discarded.
+    bool IsCancelled() const;
+
     size_t GetSize() const
     {
-      return answers_.size();
+      return answers_.size() + streamedCount_;
     }
 
     ParsedDicomFile& GetAnswer(size_t index) const;
@@ -40,6 +40,7 @@
 #include "../../Core/Toolbox.h"
 #include "Internals/CommandDispatcher.h"
 
+#include <boost/lexical_cast.hpp>
 #include <boost/thread.hpp>
 
 #if defined(__linux__)
@@ -51,18 +52,82 @@ namespace Orthanc
 {
   struct DicomServer::PImpl
   {
+    struct ModalityStatistics
+    {
+      uint64_t  associations_;
+      uint64_t  instances_;
+      uint64_t  receivedBytes_;
+      uint64_t  durationMs_;
+
+      ModalityStatistics() :
+        associations_(0),
+        instances_(0),
+        receivedBytes_(0),
+        durationMs_(0)
+      {
+      }
+    };
+
+    typedef std::map<std::string, ModalityStatistics>  Modalities;
+
     boost::thread  thread_;
     T_ASC_Network *network_;
     std::auto_ptr<RunnableWorkersPool>  workers_;
+
+    // Statistics about the associations, protected by "mutex_"
+    boost::mutex               mutex_;
+    boost::condition_variable  associationReleased_;
+    unsigned int               activeAssociations_;
+    unsigned int               peakAssociations_;
+    uint64_t                   totalAssociations_;
+    uint64_t                   rejectedAssociations_;
+    Modalities                 modalities_;
+
+    PImpl() :
+      network_(NULL),
+      activeAssociations_(0),
+      peakAssociations_(0),
+      totalAssociations_(0),
+      rejectedAssociations_(0)
+    {
+    }
   };
 
 
+  void DicomServer::WaitForAvailableAssociation()
+  {
+    if (maximumAssociations_ == 0 ||
+        rejectAssociationsOverflow_)
+    {
+      return;
+    }
+
+    boost::mutex::scoped_lock lock(pimpl_->mutex_);
+
+    while (continue_ &&
+           pimpl_->activeAssociations_ >= maximumAssociations_)
+    {
+      // Wake up regularly to check whether the server is stopping
+      pimpl_->associationReleased_.timed_wait(lock, boost::posix_time::milliseconds(100));
+    }
+  }
+
+
   void DicomServer::ServerThread(DicomServer* server)
   {
     LOG(INFO) << "DICOM server started";
 
     while (server->continue_)
     {
+      // Backpressure: Don't accept new associations as long as the
+      // maximum number of simultaneous associations is reached
+      server->WaitForAvailableAssociation();
+
+      if (!server->continue_)
+      {
+        break;
+      }
+
       /* receive an association and acknowledge or reject it. If the association was */
       /* acknowledged, offer corresponding services and invoke one or more if required. */
       std::auto_ptr<Internals::CommandDispatcher> dispatcher(Internals::AcceptAssociation(*server, server->pimpl_->network_));
@@ -97,6 +162,10 @@ namespace Orthanc
     applicationEntityFilter_ = NULL;
     checkCalledAet_ = true;
     associationTimeout_ = 30;
+    threadsCount_ = 4;
+    maximumAssociations_ = 0;
+    rejectAssociationsOverflow_ = false;
+    streamingFindAnswers_ = false;
     continue_ = false;
   }
 
@@ -135,6 +204,58 @@ namespace Orthanc
   }
 
 
+  void DicomServer::SetThreadsCount(unsigned int count)
+  {
+    if (count == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    LOG(INFO) << "Number of threads handling the DICOM associations: " << count;
+
+    Stop();
+    threadsCount_ = count;
+  }
+
+  unsigned int DicomServer::GetThreadsCount() const
+  {
+    return threadsCount_;
+  }
+
+  void DicomServer::SetMaximumAssociations(unsigned int count)
+  {
+    Stop();
+    maximumAssociations_ = count;
+  }
+
+  unsigned int DicomServer::GetMaximumAssociations() const
+  {
+    return maximumAssociations_;
+  }
+
+  void DicomServer::SetRejectAssociationsOverflow(bool reject)
+  {
+    Stop();
+    rejectAssociationsOverflow_ = reject;
+  }
+
+  bool DicomServer::IsRejectAssociationsOverflow() const
+  {
+    return rejectAssociationsOverflow_;
+  }
+
+  void DicomServer::SetStreamingFindAnswers(bool streaming)
+  {
+    Stop();
+    streamingFindAnswers_ = streaming;
+  }
+
+  bool DicomServer::IsStreamingFindAnswers() const
+  {
+    return streamingFindAnswers_;
+  }
+
+
   void DicomServer::SetCalledApplicationEntityTitleCheck(bool check)
   {
     Stop();
@@ -332,7 +453,7 @@ namespace Orthanc
     }
 
     continue_ = true;
-    pimpl_->workers_.reset(new RunnableWorkersPool(4));   // Use 4 workers - TODO as a parameter?
+    pimpl_->workers_.reset(new RunnableWorkersPool(threadsCount_));
     pimpl_->thread_ = boost::thread(ServerThread, this);
   }
 
@@ -379,4 +500,89 @@ namespace Orthanc
     }
   }
 
+
+
+  bool DicomServer::ReserveAssociation() const
+  {
+    boost::mutex::scoped_lock lock(pimpl_->mutex_);
+
+    if (maximumAssociations_ != 0 &&
+        pimpl_->activeAssociations_ >= maximumAssociations_)
+    {
+      return false;
+    }
+    else
+    {
+      pimpl_->activeAssociations_++;
+      pimpl_->totalAssociations_++;
+      pimpl_->peakAssociations_ = std::max(pimpl_->peakAssociations_, pimpl_->activeAssociations_);
+      return true;
+    }
+  }
+
+
+  void DicomServer::SignalRejectedAssociation() const
+  {
+    boost::mutex::scoped_lock lock(pimpl_->mutex_);
+    pimpl_->rejectedAssociations_++;
+  }
+
+
+  void DicomServer::SignalStoredInstance(const std::string& remoteAet,
+                                         uint64_t size) const
+  {
+    boost::mutex::scoped_lock lock(pimpl_->mutex_);
+
+    PImpl::ModalityStatistics& modality = pimpl_->modalities_[remoteAet];
+    modality.instances_++;
+    modality.receivedBytes_ += size;
+  }
+
+
+  void DicomServer::ReleaseAssociation(const std::string& remoteAet,
+                                       uint64_t durationMs) const
+  {
+    {
+      boost::mutex::scoped_lock lock(pimpl_->mutex_);
+
+      assert(pimpl_->activeAssociations_ > 0);
+      pimpl_->activeAssociations_--;
+
+      PImpl::ModalityStatistics& modality = pimpl_->modalities_[remoteAet];
+      modality.associations_++;
+      modality.durationMs_ += durationMs;
+    }
+
+    pimpl_->associationReleased_.notify_one();
+  }
+
+
+  void DicomServer::GetStatistics(Json::Value& target) const
+  {
+    boost::mutex::scoped_lock lock(pimpl_->mutex_);
+
+    target = Json::objectValue;
+    target["ThreadsCount"] = threadsCount_;
+    target["MaximumAssociations"] = maximumAssociations_;
+    target["ActiveAssociations"] = pimpl_->activeAssociations_;
+    target["PeakAssociations"] = pimpl_->peakAssociations_;
+    target["TotalAssociations"] = boost::lexical_cast<std::string>(pimpl_->totalAssociations_);
+    target["RejectedAssociations"] = boost::lexical_cast<std::string>(pimpl_->rejectedAssociations_);
+
+    Json::Value modalities = Json::objectValue;
+
+    for (PImpl::Modalities::const_iterator it = pimpl_->modalities_.begin();
+         it != pimpl_->modalities_.end(); ++it)
+    {
+      Json::Value item = Json::objectValue;
+      item["Associations"] = boost::lexical_cast<std::string>(it->second.associations_);
+      item["Instances"] = boost::lexical_cast<std::string>(it->second.instances_);
+      item["ReceivedSize"] = boost::lexical_cast<std::string>(it->second.receivedBytes_);
+      item["ReceivedSizeMB"] = static_cast<unsigned int>(it->second.receivedBytes_ / (1024 * 1024));
+      item["DurationMs"] = boost::lexical_cast<std::string>(it->second.durationMs_);
+      modalities[it->first] = item;
+    }
+
+    target["Modalities"] = modalities;
+  }
 }
@@ -46,6 +46,7 @@
 
 #include <boost/shared_ptr.hpp>
 #include <boost/noncopyable.hpp>
+#include <json/value.h>
 
 
 namespace Orthanc
@@ -77,6 +78,10 @@ namespace Orthanc
     uint16_t port_;
     bool continue_;
     uint32_t associationTimeout_;
+    unsigned int threadsCount_;
+    unsigned int maximumAssociations_;
+    bool rejectAssociationsOverflow_;
+    bool streamingFindAnswers_;
     IRemoteModalities* modalities_;
     IFindRequestHandlerFactory* findRequestHandlerFactory_;
     IMoveRequestHandlerFactory* moveRequestHandlerFactory_;
@@ -86,6 +91,8 @@ namespace Orthanc
 
     static void ServerThread(DicomServer* server);
 
+    void WaitForAvailableAssociation();
+
   public:
     DicomServer();
 
@@ -97,6 +104,26 @@ namespace Orthanc
     void SetAssociationTimeout(uint32_t seconds);
     uint32_t GetAssociationTimeout() const;
 
+    void SetThreadsCount(unsigned int count);
+    unsigned int GetThreadsCount() const;
+
+    // Maximum number of simultaneous associations (0 means no limit)
+    void SetMaximumAssociations(unsigned int count);
+    unsigned int GetMaximumAssociations() const;
+
+    // Once the maximum number of associations is reached, the new
+    // associations are either rejected with a transient
+    // A-ASSOCIATE-RJ ("true"), or left pending in the TCP backlog
+    // until one association is released ("false", default)
+    void SetRejectAssociationsOverflow(bool reject);
+    bool IsRejectAssociationsOverflow() const;
+
+    // If "true", the answers to the incoming C-FIND requests are sent
+    // to the remote modality while the handler is still running, and
+    // the handler is interrupted as soon as a C-CANCEL is received
+    void SetStreamingFindAnswers(bool streaming);
+    bool IsStreamingFindAnswers() const;
+
     void SetCalledApplicationEntityTitleCheck(bool check);
     bool HasCalledApplicationEntityTitleCheck() const;
 
@@ -131,6 +158,20 @@ namespace Orthanc
     void Stop();
 
     bool IsMyAETitle(const std::string& aet) const;
+
+    // The 4 methods below are invoked by the command dispatchers
+    // (they are thread-safe)
+    bool ReserveAssociation() const;
+
+    void SignalRejectedAssociation() const;
+
+    void SignalStoredInstance(const std::string& remoteAet,
+                              uint64_t size) const;
+
+    void ReleaseAssociation(const std::string& remoteAet,
+                            uint64_t durationMs) const;
+
+    void GetStatistics(Json::Value& target) const;
   };
 
 }
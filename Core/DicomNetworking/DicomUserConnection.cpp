@@ -94,6 +94,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <dcmtk/dcmdata/dcmetinf.h>
 #include <dcmtk/dcmnet/diutil.h>
 
+#include <map>
 #include <set>
 
 
@@ -146,6 +147,18 @@ namespace Orthanc
     T_ASC_Parameters* params_;
     T_ASC_Association* assoc_;
 
+    // Pipelined C-STORE requests, indexed by their message ID
+    typedef std::map<DIC_US, std::string>  PendingStores;
+
+    unsigned int   maxPendingStores_;
+    PendingStores  pendingStores_;   // Values are SOP instance UIDs
+
+    // SOP instance UIDs of the pipelined C-STORE requests that have
+    // failed, until they are retrieved by "DrainFailedStores()"
+    std::list<std::string>  failedStores_;
+
+    void ForgetPendingStores();
+
     bool IsOpen() const
     {
       return assoc_ != NULL;
@@ -153,6 +166,10 @@ namespace Orthanc
 
     void CheckIsOpen() const;
 
+    void ReceiveStoreResponse();
+
+    void WaitPendingStores();
+
     void Store(DcmInputStream& is, 
                DicomUserConnection& connection,
                const std::string& moveOriginatorAET,
@@ -312,6 +329,10 @@ namespace Orthanc
 
     if (renegotiate)
     {
+      // Report the failures of pipelined requests before the
+      // association is closed
+      WaitPendingStores();
+
       if (isGeneric)
       {
         connection.ResetPreferredTransferSyntax();
@@ -364,6 +385,32 @@ namespace Orthanc
       request.opts |= O_STORE_MOVEORIGINATORID;
     }
 
+    if (maxPendingStores_ > 1)
+    {
+      // Asynchronous mode: Send the request without waiting for its
+      // response, as long as the window of outstanding requests is
+      // not full
+      while (pendingStores_.size() >= maxPendingStores_)
+      {
+        ReceiveStoreResponse();
+      }
+
+      T_DIMSE_Message message;
+      memset(&message, 0, sizeof(message));
+      message.CommandField = DIMSE_C_STORE_RQ;
+      message.msg.CStoreRQ = request;
+
+      Check(DIMSE_sendMessageUsingMemoryData(assoc_, presID, &message, NULL, dcmff.getDataset(),
+                                             /*progressCallback*/ NULL, NULL));
+
+      pendingStores_[request.MessageID] = sopInstance;
+      return;
+    }
+
+    // Synchronous mode: The window may have been reduced while
+    // some requests were still outstanding
+    WaitPendingStores();
+
     // Finally conduct transmission of data
     T_DIMSE_C_StoreRSP rsp;
     DcmDataset* statusDetail = NULL;
@@ -379,6 +426,89 @@ namespace Orthanc
   }
 
 
+  void DicomUserConnection::PImpl::ReceiveStoreResponse()
+  {
+    assert(!pendingStores_.empty());
+
+    if (!IsOpen())
+    {
+      ForgetPendingStores();
+      CheckIsOpen();  // Throws an exception
+    }
+
+    T_ASC_PresentationContextID presID;
+    T_DIMSE_Message response;
+    DcmDataset* statusDetail = NULL;
+
+    OFCondition cond = DIMSE_receiveCommand(assoc_, /*opt_blockMode*/ DIMSE_BLOCKING,
+                                            /*opt_dimse_timeout*/ dimseTimeout_,
+                                            &presID, &response, &statusDetail);
+
+    if (statusDetail != NULL) 
+    {
+      delete statusDetail;
+    }
+
+    if (cond.bad() ||
+        response.CommandField != DIMSE_C_STORE_RSP)
+    {
+      // The association is not usable anymore: The requests that are
+      // still pending are considered as failed
+      LOG(ERROR) << "DicomUserConnection: No proper C-STORE response, " 
+                 << pendingStores_.size() << " pending C-STORE request(s) are lost";
+      ForgetPendingStores();
+      Check(cond);
+      throw OrthancException(ErrorCode_NetworkProtocol);
+    }
+
+    const T_DIMSE_C_StoreRSP& rsp = response.msg.CStoreRSP;
+    
+    PendingStores::iterator found = pendingStores_.find(rsp.MessageIDBeingRespondedTo);
+    if (found == pendingStores_.end())
+    {
+      LOG(ERROR) << "DicomUserConnection: C-STORE response to an unknown message ID: "
+                 << rsp.MessageIDBeingRespondedTo;
+      ForgetPendingStores();
+      throw OrthancException(ErrorCode_NetworkProtocol);
+    }
+
+    const std::string sopInstance = found->second;
+    pendingStores_.erase(found);
+
+    // Warning statuses are of the form 0xBxxx. A rejection is
+    // reported for the instance it concerns, not to the caller that
+    // happens to collect the response.
+    if (rsp.DimseStatus != STATUS_Success &&
+        (rsp.DimseStatus & 0xf000) != 0xb000)
+    {
+      LOG(ERROR) << "DicomUserConnection: The remote modality has rejected instance "
+                 << sopInstance << " (status: 0x" << std::hex << rsp.DimseStatus << std::dec << ")";
+      failedStores_.push_back(sopInstance);
+    }
+  }
+
+
+  void DicomUserConnection::PImpl::ForgetPendingStores()
+  {
+    for (PendingStores::const_iterator it = pendingStores_.begin();
+         it != pendingStores_.end(); ++it)
+    {
+      failedStores_.push_back(it->second);
+    }
+
+    pendingStores_.clear();
+  }
+
+
+  void DicomUserConnection::PImpl::WaitPendingStores()
+  {
+    while (!pendingStores_.empty())
+    {
+      ReceiveStoreResponse();
+    }
+  }
+
+
   namespace
   {
     struct FindPayload
@@ -595,6 +725,7 @@ namespace Orthanc
     FixFindQuery(fields, level, originalFields);
 
     CheckIsOpen();
+    pimpl_->WaitPendingStores();
 
     std::auto_ptr<ParsedDicomFile> query(ConvertQueryFields(fields, manufacturer_));
     DcmDataset* dataset = query->GetDcmtkObject().getDataset();
@@ -688,6 +819,7 @@ namespace Orthanc
                                          const DicomMap& fields)
   {
     CheckIsOpen();
+    pimpl_->WaitPendingStores();
 
     std::auto_ptr<ParsedDicomFile> query(ConvertQueryFields(fields, manufacturer_));
     DcmDataset* dataset = query->GetDcmtkObject().getDataset();
@@ -808,6 +940,7 @@ namespace Orthanc
     pimpl_->net_ = NULL;
     pimpl_->params_ = NULL;
     pimpl_->assoc_ = NULL;
+    pimpl_->maxPendingStores_ = 1;
 
     // SOP classes for C-ECHO, C-FIND and C-MOVE (**)
     reservedStorageSOPClasses_.push_back(UID_VerificationSOPClass);
@@ -969,6 +1102,24 @@ namespace Orthanc
   {
     if (pimpl_->assoc_ != NULL)
     {
+      if (!pimpl_->pendingStores_.empty())
+      {
+        try
+        {
+          pimpl_->WaitPendingStores();
+        }
+        catch (OrthancException&)
+        {
+          // The pending requests are now in "failedStores_"
+        }
+      }
+
+      if (!pimpl_->failedStores_.empty())
+      {
+        LOG(ERROR) << "DicomUserConnection: " << pimpl_->failedStores_.size()
+                   << " C-STORE request(s) have failed before closing the association";
+      }
+
       ASC_releaseAssociation(pimpl_->assoc_);
       ASC_destroyAssociation(&pimpl_->assoc_);
       pimpl_->assoc_ = NULL;
@@ -1028,9 +1179,42 @@ namespace Orthanc
     pimpl_->Store(is, *this, moveOriginatorAET, moveOriginatorID);
   }
 
+  void DicomUserConnection::SetMaximumPendingStores(unsigned int count)
+  {
+    if (count == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+    else
+    {
+      pimpl_->maxPendingStores_ = count;
+    }
+  }
+
+
+  unsigned int DicomUserConnection::GetMaximumPendingStores() const
+  {
+    return pimpl_->maxPendingStores_;
+  }
+
+
+  void DicomUserConnection::WaitPendingStores()
+  {
+    pimpl_->WaitPendingStores();
+  }
+
+
+  void DicomUserConnection::DrainFailedStores(std::list<std::string>& sopInstanceUids)
+  {
+    sopInstanceUids.clear();
+    sopInstanceUids.swap(pimpl_->failedStores_);
+  }
+
+
   bool DicomUserConnection::Echo()
   {
     CheckIsOpen();
+    pimpl_->WaitPendingStores();
     DIC_US status;
     Check(DIMSE_echoUser(pimpl_->assoc_, pimpl_->assoc_->nextMsgID++, 
                          /*opt_blockMode*/ DIMSE_BLOCKING, 
@@ -1230,6 +1414,7 @@ namespace Orthanc
                                          ParsedDicomFile& query)
   {
     CheckIsOpen();
+    pimpl_->WaitPendingStores();
 
     DcmDataset* dataset = query.GetDcmtkObject().getDataset();
     const char* sopClass = UID_FINDModalityWorklistInformationModel;
@@ -174,6 +174,30 @@ namespace Orthanc
       StoreFile(path, "", 0);  // Not a C-Move
     }
 
+    // Maximum number of C-STORE requests that can be outstanding on
+    // the association, i.e. sent without having received their
+    // response yet. The default value "1" corresponds to synchronous
+    // C-STORE. Larger values pipeline the requests, which hides the
+    // network latency, but require the remote modality to accept
+    // asynchronous operations.
+    void SetMaximumPendingStores(unsigned int count);
+
+    unsigned int GetMaximumPendingStores() const;
+
+    // Wait for the responses to all the outstanding C-STORE
+    // requests. An exception is only thrown if the association is
+    // broken, in which case all the outstanding requests are
+    // considered as failed. This method is implicitly called by
+    // "Close()" and before any other DIMSE command.
+    void WaitPendingStores();
+
+    // Retrieves (and forgets) the SOP instance UIDs of the pipelined
+    // C-STORE requests that have failed so far, either because the
+    // remote modality has rejected them, or because the association
+    // was broken before their response was received. The failures
+    // remain available after "Close()".
+    void DrainFailedStores(std::list<std::string>& sopInstanceUids);
+
     void Find(DicomFindAnswers& result,
               ResourceType level,
               const DicomMap& fields);
@@ -401,6 +401,62 @@ namespace Orthanc
 
 
 
+    namespace
+    {
+      /**
+       * Slot of the DICOM server that is reserved for an incoming
+       * association. The slot is released on destruction, unless its
+       * ownership has been handed over to a "CommandDispatcher"
+       * (whose destructor releases it), which prevents leaking a slot
+       * if an exception is thrown while accepting the association.
+       **/
+      class AssociationReservation : public boost::noncopyable
+      {
+      private:
+        const DicomServer&  server_;
+        std::string         remoteAet_;
+        bool                reserved_;
+
+      public:
+        AssociationReservation(const DicomServer& server,
+                               const std::string& remoteAet) :
+          server_(server),
+          remoteAet_(remoteAet),
+          reserved_(false)
+        {
+        }
+
+        ~AssociationReservation()
+        {
+          if (reserved_)
+          {
+            try
+            {
+              server_.ReleaseAssociation(remoteAet_, 0);
+            }
+            catch (...)
+            {
+              LOG(ERROR) << "Cannot release the slot of an association";
+            }
+          }
+        }
+
+        bool Reserve()
+        {
+          assert(!reserved_);
+          reserved_ = server_.ReserveAssociation();
+          return reserved_;
+        }
+
+        void HandOver()
+        {
+          assert(reserved_);
+          reserved_ = false;
+        }
+      };
+    }
+
+
     CommandDispatcher* AcceptAssociation(const DicomServer& server, T_ASC_Network *net)
     {
       DcmAssociationConfiguration asccfg;
@@ -678,13 +734,34 @@ namespace Orthanc
         return NULL;
       }
 
+      AssociationReservation reservation(server, remoteAet);
+
+      if (!reservation.Reserve())
+      {
+        // Backpressure: The maximum number of simultaneous
+        // associations is reached (only in the "reject" policy)
+        LOG(WARNING) << "Rejected association for remote AET " << remoteAet << " on IP " << remoteIp
+                     << ", as the maximum number of simultaneous associations is reached ("
+                     << server.GetMaximumAssociations() << ")";
+        T_ASC_RejectParameters rej =
+          {
+            ASC_RESULT_REJECTEDTRANSIENT,
+            ASC_SOURCE_SERVICEPROVIDER_PRESENTATION_RELATED,
+            ASC_REASON_SP_PRES_LOCALLIMITEXCEEDED
+          };
+        ASC_rejectAssociation(assoc, &rej);
+        AssociationCleanup(assoc);
+        server.SignalRejectedAssociation();
+        return NULL;
+      }
+
       {
         cond = ASC_acknowledgeAssociation(assoc);
         if (cond.bad())
         {
           LOG(ERROR) << cond.text();
           AssociationCleanup(assoc);
-          return NULL;
+          return NULL;  // The reservation is released
         }
         LOG(INFO) << "Association Acknowledged (Max Send PDV: " << assoc->sendPDVLength << ")";
         if (ASC_countAcceptedPresentationContexts(assoc->params) == 0)
@@ -692,7 +769,13 @@ namespace Orthanc
       }
 
       IApplicationEntityFilter* filter = server.HasApplicationEntityFilter() ? &server.GetApplicationEntityFilter() : NULL;
-      return new CommandDispatcher(server, assoc, remoteIp, remoteAet, calledAet, filter);
+
+      std::auto_ptr<CommandDispatcher> dispatcher
+        (new CommandDispatcher(server, assoc, remoteIp, remoteAet, calledAet, filter));
+
+      // From now on, the slot is released by the destructor of the dispatcher
+      reservation.HandOver();
+      return dispatcher.release();
     }
 
 
@@ -707,7 +790,10 @@ namespace Orthanc
       remoteIp_(remoteIp),
       remoteAet_(remoteAet),
       calledAet_(calledAet),
-      filter_(filter)
+      filter_(filter),
+      start_(boost::posix_time::microsec_clock::universal_time()),
+      storedInstances_(0),
+      storedBytes_(0)
     {
       associationTimeout_ = server.GetAssociationTimeout();
       elapsedTimeSinceLastCommand_ = 0;
@@ -724,6 +810,15 @@ namespace Orthanc
       {
         LOG(ERROR) << "Some association was not cleanly aborted";
       }
+
+      const uint64_t duration = static_cast<uint64_t>
+        ((boost::posix_time::microsec_clock::universal_time() - start_).total_milliseconds());
+
+      LOG(INFO) << "Association from AET " << remoteAet_ << " on IP " << remoteIp_
+                << " is closed after " << duration << "ms (" << storedInstances_
+                << " instance(s) received, " << storedBytes_ << " bytes)";
+
+      server_.ReleaseAssociation(remoteAet_, duration);
     }
 
 
@@ -837,7 +932,15 @@ namespace Orthanc
 
                 if (handler.get() != NULL)
                 {
-                  cond = Internals::storeScp(assoc_, &msg, presID, *handler, remoteIp_);
+                  size_t storedSize = 0;
+                  cond = Internals::storeScp(assoc_, &msg, presID, *handler, remoteIp_, storedSize);
+
+                  if (storedSize > 0)
+                  {
+                    storedInstances_++;
+                    storedBytes_ += storedSize;
+                    server_.SignalStoredInstance(remoteAet_, storedSize);
+                  }
                 }
               }
               break;
@@ -873,7 +976,8 @@ namespace Orthanc
 
                 cond = Internals::findScp(assoc_, &msg, presID, server_.GetRemoteModalities(),
                                           findHandler.get(), worklistHandler.get(),
-                                          remoteIp_, remoteAet_, calledAet_);
+                                          remoteIp_, remoteAet_, calledAet_,
+                                          server_.IsStreamingFindAnswers());
               }
               break;
 
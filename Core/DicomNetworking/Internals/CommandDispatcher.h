@@ -37,6 +37,7 @@
 #include "../../MultiThreading/IRunnableBySteps.h"
 
 #include <dcmtk/dcmnet/dimse.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
 namespace Orthanc
 {
@@ -56,6 +57,11 @@ namespace Orthanc
       std::string calledAet_;
       IApplicationEntityFilter* filter_;
 
+      // Metrics about this association
+      boost::posix_time::ptime  start_;
+      uint64_t  storedInstances_;
+      uint64_t  storedBytes_;
+
     public:
       CommandDispatcher(const DicomServer& server,
                         T_ASC_Association* assoc,
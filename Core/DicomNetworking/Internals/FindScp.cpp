@@ -90,6 +90,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <dcmtk/dcmdata/dcfilefo.h>
 #include <dcmtk/dcmdata/dcdeftag.h>
+#include <boost/thread.hpp>
+#include <deque>
 
 
 
@@ -136,6 +138,109 @@ namespace Orthanc
 {
   namespace
   {  
+    // Maximum number of answers that are computed in advance by the
+    // handler, while waiting for the remote modality to receive them
+    static const size_t MAX_PENDING_ANSWERS = 64;
+
+
+    // Transfers the answers from the thread that runs the handler of
+    // the C-FIND request, to the DCMTK callback that sends them
+    class AnswersQueue : public DicomFindAnswers::IStream
+    {
+    private:
+      mutable boost::mutex          mutex_;
+      boost::condition_variable     answerAvailable_;
+      boost::condition_variable     spaceAvailable_;
+      std::deque<ParsedDicomFile*>  queue_;
+      bool                          done_;
+      bool                          cancelled_;
+
+    public:
+      AnswersQueue() :
+        done_(false),
+        cancelled_(false)
+      {
+      }
+
+      virtual ~AnswersQueue()
+      {
+        for (size_t i = 0; i < queue_.size(); i++)
+        {
+          delete queue_[i];
+        }
+      }
+
+      virtual bool Push(ParsedDicomFile* answer)
+      {
+        std::auto_ptr<ParsedDicomFile> protection(answer);
+
+        boost::mutex::scoped_lock lock(mutex_);
+
+        while (!cancelled_ &&
+               queue_.size() >= MAX_PENDING_ANSWERS)
+        {
+          spaceAvailable_.wait(lock);
+        }
+
+        if (cancelled_)
+        {
+          return false;
+        }
+        else
+        {
+          queue_.push_back(protection.release());
+          answerAvailable_.notify_one();
+          return true;
+        }
+      }
+
+      virtual bool IsCancelled() const
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        return cancelled_;
+      }
+
+      // Returns NULL once the handler has completed, and all its
+      // answers have been popped
+      ParsedDicomFile* Pop()
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        while (queue_.empty() &&
+               !done_)
+        {
+          answerAvailable_.wait(lock);
+        }
+
+        if (queue_.empty())
+        {
+          return NULL;
+        }
+        else
+        {
+          ParsedDicomFile* answer = queue_.front();
+          queue_.pop_front();
+          spaceAvailable_.notify_one();
+          return answer;
+        }
+      }
+
+      void SignalDone()
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        done_ = true;
+        answerAvailable_.notify_all();
+      }
+
+      void Cancel()
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        cancelled_ = true;
+        spaceAvailable_.notify_all();
+      }
+    };
+
+
     struct FindScpData
     {
       DicomServer::IRemoteModalities* modalities_;
@@ -146,8 +251,22 @@ namespace Orthanc
       const std::string* remoteIp_;
       const std::string* remoteAet_;
       const std::string* calledAet_;
-
-      FindScpData() : answers_(false)
+      bool streaming_;
+
+      // The C-FIND request, as given to the handler
+      ModalityManufacturer manufacturer_;
+      std::auto_ptr<ParsedDicomFile> worklistQuery_;
+      DicomMap findQuery_;
+      std::list<DicomTag> sequencesToReturn_;
+
+      // Only used in streaming mode
+      AnswersQueue queue_;
+      std::auto_ptr<boost::thread> handlerThread_;
+      bool handlerSuccess_;
+
+      FindScpData() : 
+        answers_(false),
+        handlerSuccess_(false)
       {
       }
     };
@@ -166,6 +285,60 @@ namespace Orthanc
     }
 
 
+    static void RunHandler(FindScpData& data)
+    {
+      if (data.answers_.IsWorklist())
+      {
+        assert(data.worklistHandler_ != NULL &&
+               data.worklistQuery_.get() != NULL);
+        data.worklistHandler_->Handle(data.answers_, *data.worklistQuery_,
+                                      *data.remoteIp_, *data.remoteAet_,
+                                      *data.calledAet_, data.manufacturer_);
+      }
+      else
+      {
+        assert(data.findHandler_ != NULL);
+        data.findHandler_->Handle(data.answers_, data.findQuery_, data.sequencesToReturn_,
+                                  *data.remoteIp_, *data.remoteAet_,
+                                  *data.calledAet_, data.manufacturer_);
+      }
+    }
+
+
+    static void HandlerThread(FindScpData* data)
+    {
+      try
+      {
+        RunHandler(*data);
+        data->handlerSuccess_ = true;
+      }
+      catch (OrthancException& e)
+      {
+        LOG(ERROR) <<  "C-FIND request handler has failed: " << e.What();
+      }
+      catch (...)
+      {
+        LOG(ERROR) <<  "C-FIND request handler has failed because of a native exception";
+      }
+
+      data->queue_.SignalDone();
+    }
+
+
+    static void StopHandlerThread(FindScpData& data)
+    {
+      if (data.handlerThread_.get() != NULL)
+      {
+        data.queue_.Cancel();
+
+        if (data.handlerThread_->joinable())
+        {
+          data.handlerThread_->join();
+        }
+      }
+    }
+
+
 
     void FindScpCallback(
       /* in */ 
@@ -205,6 +378,7 @@ namespace Orthanc
             throw OrthancException(ErrorCode_UnknownModality);
           }
 
+          data.manufacturer_ = modality.GetManufacturer();
           
           if (sopClassUid == UID_FINDModalityWorklistInformationModel)
           {
@@ -212,12 +386,8 @@ namespace Orthanc
 
             if (data.worklistHandler_ != NULL)
             {
-              ParsedDicomFile query(*requestIdentifiers);
-              FixWorklistQuery(query);
-
-              data.worklistHandler_->Handle(data.answers_, query,
-                                            *data.remoteIp_, *data.remoteAet_,
-                                            *data.calledAet_, modality.GetManufacturer());
+              data.worklistQuery_.reset(new ParsedDicomFile(*requestIdentifiers));
+              FixWorklistQuery(*data.worklistQuery_);
               ok = true;
             }
             else
@@ -231,8 +401,6 @@ namespace Orthanc
 
             if (data.findHandler_ != NULL)
             {
-              std::list<DicomTag> sequencesToReturn;
-
               for (unsigned long i = 0; i < requestIdentifiers->card(); i++)
               {
                 DcmElement* element = requestIdentifiers->getElement(i);
@@ -248,16 +416,11 @@ namespace Orthanc
                                  << ") " << FromDcmtkBridge::GetTagName(*element);
                   }
 
-                  sequencesToReturn.push_back(tag);
+                  data.sequencesToReturn_.push_back(tag);
                 }
               }
 
-              DicomMap input;
-              FromDcmtkBridge::ExtractDicomSummary(input, *requestIdentifiers);
-
-              data.findHandler_->Handle(data.answers_, input, sequencesToReturn,
-                                        *data.remoteIp_, *data.remoteAet_,
-                                        *data.calledAet_, modality.GetManufacturer());
+              FromDcmtkBridge::ExtractDicomSummary(data.findQuery_, *requestIdentifiers);
               ok = true;
             }
             else
@@ -265,11 +428,27 @@ namespace Orthanc
               LOG(ERROR) << "No C-Find handler is installed, cannot handle this request";
             }
           }
+
+          if (ok)
+          {
+            if (data.streaming_)
+            {
+              // The answers are sent while the handler is still
+              // looking for the next ones
+              data.answers_.SetStream(data.queue_);
+              data.handlerThread_.reset(new boost::thread(HandlerThread, &data));
+            }
+            else
+            {
+              RunHandler(data);
+            }
+          }
         }
         catch (OrthancException& e)
         {
           // Internal error!
           LOG(ERROR) <<  "C-FIND request handler has failed: " << e.What();
+          ok = false;
         }
 
         if (!ok)
@@ -289,13 +468,46 @@ namespace Orthanc
         return;
       }
 
-      if (responseCount <= static_cast<int>(data.answers_.GetSize()))
+      if (cancelled)
+      {
+        // The remote modality has sent a C-CANCEL request
+        LOG(INFO) << "An incoming C-FIND request was cancelled by the remote modality";
+        StopHandlerThread(data);
+        response->DimseStatus = STATUS_FIND_Cancel_MatchingTerminatedDueToCancelRequest;
+        *responseIdentifiers = NULL;
+        return;
+      }
+
+      if (data.streaming_)
+      {
+        std::auto_ptr<ParsedDicomFile> answer(data.queue_.Pop());
+
+        if (answer.get() != NULL)
+        {
+          response->DimseStatus = STATUS_Pending;
+          *responseIdentifiers = new DcmDataset(*answer->GetDcmtkObject().getDataset());
+          return;
+        }
+
+        // The handler has completed, and all its answers have been sent
+        StopHandlerThread(data);
+
+        if (!data.handlerSuccess_)
+        {
+          response->DimseStatus = STATUS_FIND_Failed_UnableToProcess;
+          *responseIdentifiers = NULL;
+          return;
+        }
+      }
+      else if (responseCount <= static_cast<int>(data.answers_.GetSize()))
       {
         // There are pending results that are still to be sent
         response->DimseStatus = STATUS_Pending;
         *responseIdentifiers = data.answers_.ExtractDcmDataset(responseCount - 1);
+        return;
       }
-      else if (data.answers_.IsComplete())
+
+      if (data.answers_.IsComplete())
       {
         // Success: All the results have been sent
         response->DimseStatus = STATUS_Success;
@@ -320,7 +532,8 @@ namespace Orthanc
                                  IWorklistRequestHandler* worklistHandler,
                                  const std::string& remoteIp,
                                  const std::string& remoteAet,
-                                 const std::string& calledAet)
+                                 const std::string& calledAet,
+                                 bool streaming)
   {
     FindScpData data;
     data.modalities_ = &modalities;
@@ -330,12 +543,17 @@ namespace Orthanc
     data.remoteIp_ = &remoteIp;
     data.remoteAet_ = &remoteAet;
     data.calledAet_ = &calledAet;
+    data.streaming_ = streaming;
 
     OFCondition cond = DIMSE_findProvider(assoc, presID, &msg->msg.CFindRQ, 
                                           FindScpCallback, &data,
                                           /*opt_blockMode*/ DIMSE_BLOCKING, 
                                           /*opt_dimse_timeout*/ 0);
 
+    // The association might have been aborted while the handler was
+    // still running
+    StopHandlerThread(data);
+
     // if some error occured, dump corresponding information and remove the outfile if necessary
     if (cond.bad())
     {
@@ -108,6 +108,7 @@ namespace Orthanc
       const char* modality;
       const char* affectedSOPInstanceUID;
       uint32_t messageID;
+      size_t storedSize;
     };
 
     
@@ -163,14 +164,15 @@ namespace Orthanc
         {
           DicomMap summary;
           Json::Value dicomJson;
+          Json::Value simplifiedTags;
           std::string buffer;
 
           try
           {
             std::set<DicomTag> ignoreTagLength;
             
-            FromDcmtkBridge::ExtractDicomSummary(summary, **imageDataSet);
-            FromDcmtkBridge::ExtractDicomAsJson(dicomJson, **imageDataSet, ignoreTagLength);
+            FromDcmtkBridge::ExtractDicomSummaryAndJson(summary, dicomJson, simplifiedTags,
+                                                        **imageDataSet, ignoreTagLength);
 
             if (!FromDcmtkBridge::SaveToMemoryBuffer(buffer, **imageDataSet))
             {
@@ -205,7 +207,8 @@ namespace Orthanc
             {
               try
               {
-                cbdata->handler->Handle(buffer, summary, dicomJson, *cbdata->remoteIp, cbdata->remoteAET, cbdata->calledAET);
+                cbdata->handler->Handle(buffer, summary, dicomJson, simplifiedTags, *cbdata->remoteIp, cbdata->remoteAET, cbdata->calledAET);
+                cbdata->storedSize = buffer.size();
               }
               catch (OrthancException& e)
               {
@@ -241,8 +244,11 @@ namespace Orthanc
                                   T_DIMSE_Message * msg, 
                                   T_ASC_PresentationContextID presID,
                                   IStoreRequestHandler& handler,
-                                  const std::string& remoteIp)
+                                  const std::string& remoteIp,
+                                  size_t& storedSize)
   {
+    storedSize = 0;
+
     OFCondition cond = EC_Normal;
     T_DIMSE_C_StoreRQ *req;
 
@@ -259,6 +265,7 @@ namespace Orthanc
 
     data.affectedSOPInstanceUID = req->AffectedSOPInstanceUID;
     data.messageID = req->MessageID;
+    data.storedSize = 0;
     if (assoc && assoc->params)
     {
       data.remoteAET = assoc->params->DULparams.callingAPTitle;
@@ -294,6 +301,11 @@ namespace Orthanc
       LOG(ERROR) << "Store SCP Failed: " << cond.text();
     }
 
+    if (cond.good())
+    {
+      storedSize = data.storedSize;
+    }
+
     // return return value
     return cond;
   }
@@ -44,6 +44,25 @@ namespace Orthanc
     return boost::posix_time::microsec_clock::universal_time();
   }
 
+
+  static void CloseConnection(std::auto_ptr<DicomUserConnection>& connection)
+  {
+    // Collect the responses to the pipelined C-STORE requests, and
+    // report the failures that are known only now
+    connection->Close();
+
+    std::list<std::string> failed;
+    connection->DrainFailedStores(failed);
+
+    for (std::list<std::string>::const_iterator it = failed.begin(); it != failed.end(); ++it)
+    {
+      LOG(ERROR) << "Unable to send instance with SOP instance UID " << *it
+                 << " to modality: " << connection->GetRemoteApplicationEntityTitle();
+    }
+
+    connection.reset(NULL);
+  }
+
   class TimeoutDicomConnectionManager::Resource : public IDicomConnectionManager::IResource
   {
   private:
@@ -108,7 +127,7 @@ namespace Orthanc
       LOG(INFO) << "Closing inactive DICOM association with modality: "
                 << connection_->GetRemoteApplicationEntityTitle();
 
-      connection_.reset(NULL);
+      CloseConnection(connection_);
     }
   }
 
@@ -126,6 +145,11 @@ namespace Orthanc
     if (connection_.get() == NULL ||
         !connection_->IsSameAssociation(localAet, remote))
     {
+      if (connection_.get() != NULL)
+      {
+        CloseConnection(connection_);
+      }
+
       connection_.reset(new DicomUserConnection(localAet, remote));
     }
 
@@ -959,6 +959,117 @@ DCMTK_TO_CTYPE_CONVERTER(DcmtkToFloat64Converter, Float64, DcmFloatingPointDoubl
   }
 
 
+  void FromDcmtkBridge::DatasetToFullAndHumanJson(Json::Value& full,
+                                                  Json::Value& human,
+                                                  DicomMap* summary,
+                                                  DcmItem& item,
+                                                  unsigned int maxStringLength,
+                                                  Encoding encoding,
+                                                  const std::set<DicomTag>& ignoreTagLength)
+  {
+    assert(full.type() == Json::objectValue &&
+           human.type() == Json::objectValue);
+
+    // No element is filtered out, which corresponds to
+    // "DicomToJsonFlags_Default" in "DatasetToJson()"
+    for (unsigned long i = 0; i < item.card(); i++)
+    {
+      DcmElement* element = item.getElement(i);
+      if (element == NULL)
+      {
+        throw OrthancException(ErrorCode_InternalError);
+      }
+
+      DicomTag tag(GetTag(*element));
+      std::string tagName = GetTagName(*element);
+
+      Json::Value& fullNode = full[tag.Format()];
+      fullNode = Json::objectValue;
+      fullNode["Name"] = tagName;
+
+      Json::Value& humanNode = human[tagName];
+      humanNode = Json::nullValue;
+
+      if (element->isLeaf())
+      {
+        if (element->getTag().getPrivateCreator() != NULL)
+        {
+          fullNode["PrivateCreator"] = element->getTag().getPrivateCreator();
+        }
+
+        // The "0" below lets "LeafValueToJson()" take care of "TooLong"
+        // values, the element being converted only once
+        std::auto_ptr<DicomValue> value(ConvertLeafElement(*element, DicomToJsonFlags_Default,
+                                                           0, encoding, ignoreTagLength));
+
+        unsigned int jsonMaxLength = maxStringLength;
+        if (ignoreTagLength.find(tag) != ignoreTagLength.end())
+        {
+          jsonMaxLength = 0;
+        }
+
+        LeafValueToJson(fullNode, *value, DicomToJsonFormat_Full, DicomToJsonFlags_Default, jsonMaxLength);
+        LeafValueToJson(humanNode, *value, DicomToJsonFormat_Human, DicomToJsonFlags_Default, jsonMaxLength);
+
+        if (summary != NULL)
+        {
+          // Same rule as "ConvertLeafElement()": Only the strings are
+          // truncated, whatever the "ignoreTagLength" argument
+          if (maxStringLength != 0 &&
+              !value->IsNull() &&
+              !value->IsBinary() &&
+              value->GetContent().size() > maxStringLength &&
+              (element->isaString() || element->getVR() == EVR_UN))
+          {
+            summary->SetValue(tag, new DicomValue);  // Too long, create a NULL value
+          }
+          else
+          {
+            summary->SetValue(tag, value.release());
+          }
+        }
+      }
+      else
+      {
+        fullNode["Type"] = "Sequence";
+        fullNode["Value"] = Json::arrayValue;
+        humanNode = Json::arrayValue;
+
+        DcmSequenceOfItems& sequence = dynamic_cast<DcmSequenceOfItems&>(*element);
+
+        for (unsigned long j = 0; j < sequence.card(); j++)
+        {
+          DcmItem* child = sequence.getItem(j);
+          Json::Value& fullChild = fullNode["Value"].append(Json::objectValue);
+          Json::Value& humanChild = humanNode.append(Json::objectValue);
+
+          // The summary only contains the leaves of the top-level dataset
+          DatasetToFullAndHumanJson(fullChild, humanChild, NULL, *child,
+                                    maxStringLength, encoding, ignoreTagLength);
+        }
+      }
+    }
+  }
+
+
+  void FromDcmtkBridge::ExtractDicomSummaryAndJson(DicomMap& summary,
+                                                   Json::Value& json,
+                                                   Json::Value& simplified,
+                                                   DcmDataset& dataset,
+                                                   unsigned int maxStringLength,
+                                                   Encoding defaultEncoding,
+                                                   const std::set<DicomTag>& ignoreTagLength)
+  {
+    Encoding encoding = DetectEncoding(dataset, defaultEncoding);
+
+    summary.Clear();
+    json = Json::objectValue;
+    simplified = Json::objectValue;
+    DatasetToFullAndHumanJson(json, simplified, &summary, dataset,
+                              maxStringLength, encoding, ignoreTagLength);
+  }
+
+
   void FromDcmtkBridge::ExtractHeaderAsJson(Json::Value& target, 
                                             DcmMetaInfo& dataset,
                                             DicomToJsonFormat format,
@@ -1914,6 +2025,23 @@ DCMTK_TO_CTYPE_CONVERTER(DcmtkToFloat64Converter, Float64, DcmFloatingPointDoubl
   }
 
 
+#if ORTHANC_SANDBOXED == 0
+  DcmFileFormat* FromDcmtkBridge::LoadFromFile(const std::string& path,
+                                               uint32_t maxReadLength)
+  {
+    std::auto_ptr<DcmFileFormat> result(new DcmFileFormat);
+
+    if (!result->loadFile(path.c_str(), EXS_Unknown, EGL_noChange, maxReadLength).good())
+    {
+      LOG(ERROR) << "Cannot parse an invalid DICOM file: " << path;
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    return result.release();
+  }
+#endif
+
+
   void FromDcmtkBridge::FromJson(DicomMap& target,
                                  const Json::Value& source)
   {
@@ -2066,6 +2194,19 @@ DCMTK_TO_CTYPE_CONVERTER(DcmtkToFloat64Converter, Float64, DcmFloatingPointDoubl
   }
 
 
+  void FromDcmtkBridge::ExtractDicomSummaryAndJson(DicomMap& summary,
+                                                   Json::Value& json,
+                                                   Json::Value& simplified,
+                                                   DcmDataset& dataset,
+                                                   const std::set<DicomTag>& ignoreTagLength)
+  {
+    ExtractDicomSummaryAndJson(summary, json, simplified, dataset,
+                               ORTHANC_MAXIMUM_TAG_LENGTH,
+                               GetDefaultDicomEncoding(),
+                               ignoreTagLength);
+  }
+
+
   void FromDcmtkBridge::InitializeCodecs()
   {
 #if ORTHANC_ENABLE_DCMTK_JPEG_LOSSLESS == 1
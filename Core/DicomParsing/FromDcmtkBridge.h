@@ -110,6 +110,22 @@ namespace Orthanc
                                    Encoding defaultEncoding,
                                    const std::set<DicomTag>& ignoreTagLength);
 
+    static void DatasetToFullAndHumanJson(Json::Value& full,
+                                          Json::Value& human,
+                                          DicomMap* summary,
+                                          DcmItem& item,
+                                          unsigned int maxStringLength,
+                                          Encoding encoding,
+                                          const std::set<DicomTag>& ignoreTagLength);
+
+    static void ExtractDicomSummaryAndJson(DicomMap& summary,
+                                           Json::Value& json,
+                                           Json::Value& simplified,
+                                           DcmDataset& dataset,
+                                           unsigned int maxStringLength,
+                                           Encoding defaultEncoding,
+                                           const std::set<DicomTag>& ignoreTagLength);
+
     static void ChangeStringEncoding(DcmItem& dataset,
                                      Encoding source,
                                      Encoding target);
@@ -220,6 +236,13 @@ namespace Orthanc
     static DcmFileFormat* LoadFromMemoryBuffer(const void* buffer,
                                                size_t size);
 
+#if ORTHANC_SANDBOXED == 0
+    // The values that are longer than "maxReadLength" bytes are only
+    // read from the file when they are accessed
+    static DcmFileFormat* LoadFromFile(const std::string& path,
+                                       uint32_t maxReadLength);
+#endif
+
     static void FromJson(DicomMap& values,
                          const Json::Value& result);
 
@@ -238,6 +261,16 @@ namespace Orthanc
                                    DcmDataset& dataset,
                                    const std::set<DicomTag>& ignoreTagLength);
 
+    // Equivalent to "ExtractDicomSummary()", followed by
+    // "ExtractDicomAsJson()" and by the simplification of the
+    // resulting JSON in the "Human" format, but walks the dataset
+    // only once
+    static void ExtractDicomSummaryAndJson(DicomMap& summary,
+                                           Json::Value& json,
+                                           Json::Value& simplified,
+                                           DcmDataset& dataset,
+                                           const std::set<DicomTag>& ignoreTagLength);
+
     static void InitializeCodecs();
 
     static void FinalizeCodecs();
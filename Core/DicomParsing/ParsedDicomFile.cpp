@@ -229,6 +229,7 @@ namespace Orthanc
       DcmElement&  element_;
       uint32_t     length_;
       uint32_t     offset_;
+      uint32_t     end_;
       std::string  chunk_;
       size_t       chunkSize_;
       
@@ -238,6 +239,7 @@ namespace Orthanc
         element_(element),
         length_(element.getLength(transferSyntax)),
         offset_(0),
+        end_(length_),
         chunkSize_(0)
       {
         static const size_t CHUNK_SIZE = 64 * 1024;  // Use chunks of max 64KB
@@ -261,24 +263,43 @@ namespace Orthanc
         return "";
       }
 
+      virtual bool HasContentLength()
+      {
+        return true;
+      }
+
       virtual uint64_t  GetContentLength()
       {
         return length_;
       }
+
+      virtual bool SetRange(uint64_t start,
+                            uint64_t end)
+      {
+        if (start > end ||
+            end > length_)
+        {
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
+        }
+
+        offset_ = static_cast<uint32_t>(start);
+        end_ = static_cast<uint32_t>(end);
+        return true;
+      }
  
       virtual bool ReadNextChunk()
       {
-        assert(offset_ <= length_);
+        assert(offset_ <= end_);
 
-        if (offset_ == length_)
+        if (offset_ == end_)
         {
           return false;
         }
         else
         {
-          if (length_ - offset_ < chunk_.size())
+          if (end_ - offset_ < chunk_.size())
           {
-            chunkSize_ = length_ - offset_;
+            chunkSize_ = end_ - offset_;
           }
           else
           {
@@ -896,6 +917,15 @@ namespace Orthanc
     SaveToMemoryBuffer(content);
     SystemToolbox::WriteFile(content, path);
   }
+
+
+  ParsedDicomFile* ParsedDicomFile::CreateFromFile(const std::string& path,
+                                                   uint32_t maxReadLength)
+  {
+    std::auto_ptr<ParsedDicomFile> result(new ParsedDicomFile(false));
+    result->pimpl_->file_.reset(FromDcmtkBridge::LoadFromFile(path, maxReadLength));
+    return result.release();
+  }
 #endif
 
 
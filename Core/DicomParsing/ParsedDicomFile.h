@@ -167,6 +167,12 @@ namespace Orthanc
 
 #if ORTHANC_SANDBOXED == 0
     void SaveToFile(const std::string& path);
+
+    // The large values (e.g. the pixel data) are left on the disk
+    // until they are accessed: The file must neither be modified nor
+    // removed during the lifetime of the returned object
+    static ParsedDicomFile* CreateFromFile(const std::string& path,
+                                           uint32_t maxReadLength);
 #endif
 
     void EmbedContent(const std::string& dataUriScheme);
@@ -602,6 +602,8 @@ namespace Orthanc
     FileContentType_Unknown = 0,
     FileContentType_Dicom = 1,
     FileContentType_DicomAsJson = 2,
+    FileContentType_DicomSummary = 3,
+    FileContentType_RenderedFrame = 4,
 
     // Make sure that the value "65535" can be stored into this enumeration
     FileContentType_StartUser = 1024,
@@ -104,20 +104,20 @@ namespace Orthanc
       case FileContentType_DicomAsJson:
         return "JSON summary of DICOM";
 
+      case FileContentType_DicomSummary:
+        return "Binary summary of DICOM";
+
+      case FileContentType_RenderedFrame:
+        return "Rendered frame";
+
       default:
         return "User-defined";
     }
   }
 
 
-  void FilesystemStorage::Create(const std::string& uuid,
-                                 const void* content, 
-                                 size_t size,
-                                 FileContentType type)
+  boost::filesystem::path FilesystemStorage::PrepareNewFile(const std::string& uuid) const
   {
-    LOG(INFO) << "Creating attachment \"" << uuid << "\" of \"" << GetDescriptionInternal(type) 
-              << "\" type (size: " << (size / (1024 * 1024) + 1) << "MB)";
-
     boost::filesystem::path path;
     
     path = GetPath(uuid);
@@ -144,7 +144,46 @@ namespace Orthanc
       }
     }
 
-    SystemToolbox::WriteFile(content, size, path.string());
+    return path;
+  }
+
+
+  void FilesystemStorage::Create(const std::string& uuid,
+                                 const void* content, 
+                                 size_t size,
+                                 FileContentType type)
+  {
+    LOG(INFO) << "Creating attachment \"" << uuid << "\" of \"" << GetDescriptionInternal(type) 
+              << "\" type (size: " << (size / (1024 * 1024) + 1) << "MB)";
+
+    SystemToolbox::WriteFile(content, size, PrepareNewFile(uuid).string());
+  }
+
+
+  void FilesystemStorage::CreateFromFile(const std::string& uuid,
+                                         const std::string& path,
+                                         FileContentType type)
+  {
+    LOG(INFO) << "Creating attachment \"" << uuid << "\" of \"" << GetDescriptionInternal(type) 
+              << "\" type from file: " << path;
+
+    boost::filesystem::path target = PrepareNewFile(uuid);
+
+    try
+    {
+      // The file is copied by the operating system, without going
+      // through the memory of Orthanc
+      boost::filesystem::copy_file(path, target);
+    }
+    catch (boost::filesystem::filesystem_error& e)
+    {
+      LOG(ERROR) << "Cannot copy file " << path << " into the storage area: " << e.what();
+
+      boost::system::error_code ignored;
+      boost::filesystem::remove(target, ignored);
+
+      throw OrthancException(ErrorCode_FileStorageCannotWrite);
+    }
   }
 
 
@@ -160,6 +199,20 @@ namespace Orthanc
   }
 
 
+  void FilesystemStorage::ReadRange(std::string& content,
+                                    const std::string& uuid,
+                                    FileContentType type,
+                                    uint64_t start,
+                                    uint64_t end)
+  {
+    LOG(TRACE) << "Reading bytes [" << start << "," << end << ") of attachment \""
+               << uuid << "\" of \"" << GetDescriptionInternal(type) << "\" content type";
+
+    content.clear();
+    SystemToolbox::ReadFileRange(content, GetPath(uuid).string(), start, end);
+  }
+
+
   uintmax_t FilesystemStorage::GetSize(const std::string& uuid) const
   {
     boost::filesystem::path path = GetPath(uuid);
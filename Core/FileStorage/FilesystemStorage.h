@@ -60,6 +60,8 @@ namespace Orthanc
 
     boost::filesystem::path GetPath(const std::string& uuid) const;
 
+    boost::filesystem::path PrepareNewFile(const std::string& uuid) const;
+
   public:
     explicit FilesystemStorage(std::string root);
 
@@ -72,6 +74,26 @@ namespace Orthanc
                       const std::string& uuid,
                       FileContentType type);
 
+    virtual void ReadRange(std::string& content,
+                           const std::string& uuid,
+                           FileContentType type,
+                           uint64_t start,
+                           uint64_t end);
+
+    virtual bool HasReadRange() const
+    {
+      return true;
+    }
+
+    virtual void CreateFromFile(const std::string& uuid,
+                                const std::string& path,
+                                FileContentType type);
+
+    virtual bool HasCreateFromFile() const
+    {
+      return true;
+    }
+
     virtual void Remove(const std::string& uuid,
                         FileContentType type);
 
@@ -35,6 +35,7 @@
 
 #include "../Enumerations.h"
 
+#include <stdint.h>
 #include <string>
 #include <boost/noncopyable.hpp>
 
@@ -56,6 +57,28 @@ namespace Orthanc
                       const std::string& uuid,
                       FileContentType type) = 0;
 
+    // Reads the bytes in the range [start, end) of the attachment
+    virtual void ReadRange(std::string& content,
+                           const std::string& uuid,
+                           FileContentType type,
+                           uint64_t start,
+                           uint64_t end) = 0;
+
+    // Whether "ReadRange()" avoids loading the full attachment. If
+    // "false", "ReadRange()" is only a convenience wrapper around
+    // "Read()", and partial reads should be avoided.
+    virtual bool HasReadRange() const = 0;
+
+    // Creates the attachment by copying the content of a file
+    virtual void CreateFromFile(const std::string& uuid,
+                                const std::string& path,
+                                FileContentType type) = 0;
+
+    // Whether "CreateFromFile()" avoids loading the full file in
+    // memory. If "false", "CreateFromFile()" is only a convenience
+    // wrapper around "Create()".
+    virtual bool HasCreateFromFile() const = 0;
+
     virtual void Remove(const std::string& uuid,
                         FileContentType type) = 0;
   };
@@ -36,6 +36,10 @@
 
 #include "../OrthancException.h"
 
+#if ORTHANC_SANDBOXED != 1
+#  include "../SystemToolbox.h"
+#endif
+
 namespace Orthanc
 {
   MemoryStorageArea::~MemoryStorageArea()
@@ -71,6 +75,20 @@ namespace Orthanc
     }
   }
 
+
+  void MemoryStorageArea::CreateFromFile(const std::string& uuid,
+                                         const std::string& path,
+                                         FileContentType type)
+  {
+#if ORTHANC_SANDBOXED == 1
+    throw OrthancException(ErrorCode_NotImplemented);
+#else
+    std::string content;
+    SystemToolbox::ReadFile(content, path);
+    Create(uuid, content.empty() ? NULL : content.c_str(), content.size(), type);
+#endif
+  }
+
   
   void MemoryStorageArea::Read(std::string& content,
                                const std::string& uuid,
@@ -93,6 +111,37 @@ namespace Orthanc
       content.assign(*found->second);
     }
   }
+
+
+  void MemoryStorageArea::ReadRange(std::string& content,
+                                    const std::string& uuid,
+                                    FileContentType type,
+                                    uint64_t start,
+                                    uint64_t end)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Content::const_iterator found = content_.find(uuid);
+
+    if (found == content_.end())
+    {
+      throw OrthancException(ErrorCode_InexistentFile);
+    }
+    else if (found->second == NULL)
+    {
+      throw OrthancException(ErrorCode_InternalError);
+    }
+    else if (start > end ||
+             end > found->second->size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+    else
+    {
+      content.assign(*found->second, static_cast<size_t>(start),
+                     static_cast<size_t>(end - start));
+    }
+  }
       
 
   void MemoryStorageArea::Remove(const std::string& uuid,
@@ -60,6 +60,26 @@ namespace Orthanc
                       const std::string& uuid,
                       FileContentType type);
 
+    virtual void ReadRange(std::string& content,
+                           const std::string& uuid,
+                           FileContentType type,
+                           uint64_t start,
+                           uint64_t end);
+
+    virtual bool HasReadRange() const
+    {
+      return true;
+    }
+
+    virtual void CreateFromFile(const std::string& uuid,
+                                const std::string& path,
+                                FileContentType type);
+
+    virtual bool HasCreateFromFile() const
+    {
+      return false;
+    }
+
     virtual void Remove(const std::string& uuid,
                         FileContentType type);
   };
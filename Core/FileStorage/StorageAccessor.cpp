@@ -36,8 +36,10 @@
 
 #include "../Compression/ZlibCompressor.h"
 #include "../OrthancException.h"
+#include "../SystemToolbox.h"
 #include "../Toolbox.h"
-#include "../Toolbox.h"
+
+#include <boost/filesystem/fstream.hpp>
 
 #if ORTHANC_ENABLE_CIVETWEB == 1 || ORTHANC_ENABLE_MONGOOSE == 1
 #  include "../HttpServer/HttpStreamTranscoder.h"
@@ -45,6 +47,47 @@
 
 namespace Orthanc
 {
+  void StorageAccessor::CreateInArea(const std::string& uuid,
+                                     const void* data,
+                                     size_t size,
+                                     FileContentType type)
+  {
+    if (metrics_ == NULL)
+    {
+      area_.Create(uuid, data, size, type);
+    }
+    else
+    {
+      {
+        MetricsRegistry::Timer timer(*metrics_, "orthanc_storage_write_seconds");
+        area_.Create(uuid, data, size, type);
+      }
+
+      metrics_->IncrementCounter("orthanc_storage_written_bytes_total", size);
+    }
+  }
+
+
+  void StorageAccessor::ReadFromArea(std::string& content,
+                                     const std::string& uuid,
+                                     FileContentType type)
+  {
+    if (metrics_ == NULL)
+    {
+      area_.Read(content, uuid, type);
+    }
+    else
+    {
+      {
+        MetricsRegistry::Timer timer(*metrics_, "orthanc_storage_read_seconds");
+        area_.Read(content, uuid, type);
+      }
+
+      metrics_->IncrementCounter("orthanc_storage_read_bytes_total", content.size());
+    }
+  }
+
+
   FileInfo StorageAccessor::Write(const void* data,
                                   size_t size,
                                   FileContentType type,
@@ -64,7 +107,7 @@ namespace Orthanc
     {
       case CompressionType_None:
       {
-        area_.Create(uuid, data, size, type);
+        CreateInArea(uuid, data, size, type);
         return FileInfo(uuid, type, size, md5);
       }
 
@@ -84,11 +127,11 @@ namespace Orthanc
 
         if (compressed.size() > 0)
         {
-          area_.Create(uuid, &compressed[0], compressed.size(), type);
+          CreateInArea(uuid, &compressed[0], compressed.size(), type);
         }
         else
         {
-          area_.Create(uuid, NULL, 0, type);
+          CreateInArea(uuid, NULL, 0, type);
         }
 
         return FileInfo(uuid, type, size, md5,
@@ -101,6 +144,54 @@ namespace Orthanc
   }
 
 
+  FileInfo StorageAccessor::WriteFromFile(const std::string& path,
+                                          FileContentType type,
+                                          CompressionType compression,
+                                          bool storeMd5)
+  {
+    if (compression != CompressionType_None ||
+        !area_.HasCreateFromFile())
+    {
+      // The compression and the storage area need the whole content
+      std::string content;
+      SystemToolbox::ReadFile(content, path);
+      return Write(content, type, compression, storeMd5);
+    }
+
+    std::string uuid = Toolbox::GenerateUuid();
+    uint64_t size = SystemToolbox::GetFileSize(path);
+
+    std::string md5;
+
+    if (storeMd5)
+    {
+      boost::filesystem::ifstream f(path, std::ios::in | std::ios::binary);
+      if (!f.good())
+      {
+        throw OrthancException(ErrorCode_InexistentFile);
+      }
+
+      Toolbox::ComputeMD5(md5, f);
+    }
+
+    if (metrics_ == NULL)
+    {
+      area_.CreateFromFile(uuid, path, type);
+    }
+    else
+    {
+      {
+        MetricsRegistry::Timer timer(*metrics_, "orthanc_storage_write_seconds");
+        area_.CreateFromFile(uuid, path, type);
+      }
+
+      metrics_->IncrementCounter("orthanc_storage_written_bytes_total", size);
+    }
+
+    return FileInfo(uuid, type, size, md5);
+  }
+
+
   void StorageAccessor::Read(std::string& content,
                              const FileInfo& info)
   {
@@ -108,7 +199,7 @@ namespace Orthanc
     {
       case CompressionType_None:
       {
-        area_.Read(content, info.GetUuid(), info.GetContentType());
+        ReadFromArea(content, info.GetUuid(), info.GetContentType());
         break;
       }
 
@@ -117,7 +208,7 @@ namespace Orthanc
         ZlibCompressor zlib;
 
         std::string compressed;
-        area_.Read(compressed, info.GetUuid(), info.GetContentType());
+        ReadFromArea(compressed, info.GetUuid(), info.GetContentType());
         IBufferCompressor::Uncompress(content, zlib, compressed);
         break;
       }
@@ -147,11 +238,100 @@ namespace Orthanc
 
 
 #if ORTHANC_ENABLE_CIVETWEB == 1 || ORTHANC_ENABLE_MONGOOSE == 1
-  void StorageAccessor::SetupSender(BufferHttpSender& sender,
+  namespace
+  {
+    /**
+     * Sends an uncompressed attachment by reading it chunk by chunk
+     * from the storage area, so that the full attachment is never
+     * loaded in memory. HTTP range requests only read the requested
+     * bytes.
+     **/
+    class StorageAreaHttpSender : public HttpFileSender
+    {
+    private:
+      static const uint64_t  CHUNK_SIZE = 1024 * 1024;   // Use 1MB chunks
+
+      IStorageArea&    area_;
+      std::string      uuid_;
+      FileContentType  type_;
+      uint64_t         size_;
+      uint64_t         position_;
+      uint64_t         end_;
+      std::string      chunk_;
+
+    public:
+      StorageAreaHttpSender(IStorageArea& area,
+                            const FileInfo& info) :
+        area_(area),
+        uuid_(info.GetUuid()),
+        type_(info.GetContentType()),
+        size_(info.GetCompressedSize()),
+        position_(0),
+        end_(info.GetCompressedSize())
+      {
+        if (info.GetCompressionType() != CompressionType_None)
+        {
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
+        }
+      }
+
+      virtual uint64_t GetContentLength()
+      {
+        return size_;
+      }
+
+      virtual bool SetRange(uint64_t start,
+                            uint64_t end)
+      {
+        if (start > end ||
+            end > size_)
+        {
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
+        }
+
+        position_ = start;
+        end_ = end;
+        return true;
+      }
+
+      virtual bool ReadNextChunk()
+      {
+        if (position_ == end_)
+        {
+          return false;
+        }
+
+        uint64_t next = (end_ - position_ > CHUNK_SIZE ? position_ + CHUNK_SIZE : end_);
+        area_.ReadRange(chunk_, uuid_, type_, position_, next);
+
+        if (chunk_.size() != next - position_)
+        {
+          throw OrthancException(ErrorCode_CorruptedFile);
+        }
+
+        position_ = next;
+        return true;
+      }
+
+      virtual const char* GetChunkContent()
+      {
+        return chunk_.c_str();
+      }
+
+      virtual size_t GetChunkSize()
+      {
+        return chunk_.size();
+      }
+    };
+  }
+#endif
+
+
+#if ORTHANC_ENABLE_CIVETWEB == 1 || ORTHANC_ENABLE_MONGOOSE == 1
+  void StorageAccessor::SetupSender(HttpFileSender& sender,
                                     const FileInfo& info,
                                     const std::string& mime)
   {
-    area_.Read(sender.GetBuffer(), info.GetUuid(), info.GetContentType());
     sender.SetContentType(mime);
 
     const char* extension;
@@ -175,16 +355,36 @@ namespace Orthanc
 #endif
 
 
+#if ORTHANC_ENABLE_CIVETWEB == 1 || ORTHANC_ENABLE_MONGOOSE == 1
+  bool StorageAccessor::HasStreamedRead(const FileInfo& info) const
+  {
+    // Compressed attachments must be entirely read to be transcoded
+    return (info.GetCompressionType() == CompressionType_None &&
+            area_.HasReadRange());
+  }
+#endif
+
+
 #if ORTHANC_ENABLE_CIVETWEB == 1 || ORTHANC_ENABLE_MONGOOSE == 1
   void StorageAccessor::AnswerFile(HttpOutput& output,
                                    const FileInfo& info,
                                    const std::string& mime)
   {
-    BufferHttpSender sender;
-    SetupSender(sender, info, mime);
+    if (HasStreamedRead(info))
+    {
+      StorageAreaHttpSender sender(area_, info);
+      SetupSender(sender, info, mime);
+      output.Answer(sender);
+    }
+    else
+    {
+      BufferHttpSender sender;
+      SetupSender(sender, info, mime);
+      ReadFromArea(sender.GetBuffer(), info.GetUuid(), info.GetContentType());
   
-    HttpStreamTranscoder transcoder(sender, info.GetCompressionType());
-    output.Answer(transcoder);
+      HttpStreamTranscoder transcoder(sender, info.GetCompressionType());
+      output.Answer(transcoder);
+    }
   }
 #endif
 
@@ -194,11 +394,21 @@ namespace Orthanc
                                    const FileInfo& info,
                                    const std::string& mime)
   {
-    BufferHttpSender sender;
-    SetupSender(sender, info, mime);
+    if (HasStreamedRead(info))
+    {
+      StorageAreaHttpSender sender(area_, info);
+      SetupSender(sender, info, mime);
+      output.AnswerStream(sender);
+    }
+    else
+    {
+      BufferHttpSender sender;
+      SetupSender(sender, info, mime);
+      ReadFromArea(sender.GetBuffer(), info.GetUuid(), info.GetContentType());
   
-    HttpStreamTranscoder transcoder(sender, info.GetCompressionType());
-    output.AnswerStream(transcoder);
+      HttpStreamTranscoder transcoder(sender, info.GetCompressionType());
+      output.AnswerStream(transcoder);
+    }
   }
 #endif
 }
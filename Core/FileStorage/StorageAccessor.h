@@ -50,6 +50,7 @@
 #endif
 
 #include "IStorageArea.h"
+#include "../MetricsRegistry.h"
 #include "FileInfo.h"
 
 #if ORTHANC_ENABLE_CIVETWEB == 1 || ORTHANC_ENABLE_MONGOOSE == 1
@@ -68,16 +69,39 @@ namespace Orthanc
   class StorageAccessor : boost::noncopyable
   {
   private:
-    IStorageArea&  area_;
+    IStorageArea&     area_;
+    MetricsRegistry*  metrics_;
+
+    void CreateInArea(const std::string& uuid,
+                      const void* data,
+                      size_t size,
+                      FileContentType type);
+
+    void ReadFromArea(std::string& content,
+                      const std::string& uuid,
+                      FileContentType type);
 
 #if ORTHANC_ENABLE_CIVETWEB == 1 || ORTHANC_ENABLE_MONGOOSE == 1
-    void SetupSender(BufferHttpSender& sender,
+    void SetupSender(HttpFileSender& sender,
                      const FileInfo& info,
                      const std::string& mime);
+
+    bool HasStreamedRead(const FileInfo& info) const;
 #endif
 
   public:
-    StorageAccessor(IStorageArea& area) : area_(area)
+    StorageAccessor(IStorageArea& area) :
+      area_(area),
+      metrics_(NULL)
+    {
+    }
+
+    // The reads and writes of the storage area are recorded into
+    // "metrics" (sizes and latencies)
+    StorageAccessor(IStorageArea& area,
+                    MetricsRegistry& metrics) :
+      area_(area),
+      metrics_(&metrics)
     {
     }
 
@@ -96,6 +120,14 @@ namespace Orthanc
                    data.size(), type, compression, storeMd5);
     }
 
+    // Writes the content of a file. If the storage area supports it,
+    // and if no compression is requested, the file is copied without
+    // being loaded in memory.
+    FileInfo WriteFromFile(const std::string& path,
+                           FileContentType type,
+                           CompressionType compression,
+                           bool storeMd5);
+
     void Read(std::string& content,
               const FileInfo& info);
 
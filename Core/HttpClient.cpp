@@ -43,7 +43,9 @@
 #include <string.h>
 #include <curl/curl.h>
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/noncopyable.hpp>
 #include <boost/thread/mutex.hpp>
+#include <list>
 
 
 #if ORTHANC_ENABLE_PKCS11 == 1
@@ -96,11 +98,13 @@ namespace Orthanc
     std::string     proxy_;
     long            timeout_;
     bool            verbose_;
+    bool            http2_;
 
     GlobalParameters() : 
       httpsVerifyPeers_(true),
       timeout_(0),
-      verbose_(false)
+      verbose_(false),
+      http2_(false)
     {
     }
 
@@ -185,6 +189,148 @@ namespace Orthanc
     {
       verbose_ = verbose;
     }
+
+    bool IsHttp2Enabled()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      return http2_;
+    }
+
+    void SetHttp2Enabled(bool enabled)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      http2_ = enabled;
+    }
+  };
+
+
+  /**
+   * Pool of cURL handles that are kept alive once their HttpClient is
+   * destructed. Each handle owns a cache of live connections, so
+   * reusing it avoids a new TCP (and TLS) handshake for the next
+   * request to the same Orthanc peer or Web service. The handles are
+   * indexed by the parameters of the Web service that created them.
+   **/
+  class HttpClient::ConnectionPool : public boost::noncopyable
+  {
+  private:
+    typedef std::map<std::string, std::list<CURL*> >  Handles;
+
+    boost::mutex   mutex_;
+    unsigned int   size_;
+    Handles        handles_;
+
+    ConnectionPool() :
+      size_(4)
+    {
+    }
+
+    void ClearInternal()
+    {
+      for (Handles::iterator it = handles_.begin(); it != handles_.end(); ++it)
+      {
+        for (std::list<CURL*>::iterator handle = it->second.begin();
+             handle != it->second.end(); ++handle)
+        {
+          curl_easy_cleanup(*handle);
+        }
+      }
+
+      handles_.clear();
+    }
+
+  public:
+    // Singleton pattern
+    static ConnectionPool& GetInstance()
+    {
+      static ConnectionPool pool;
+      return pool;
+    }
+
+    void SetSize(unsigned int size)
+    {
+      LOG(INFO) << "Setting the size of the pool of HTTP client connections: " << size;
+
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        size_ = size;
+
+        if (size_ == 0)
+        {
+          ClearInternal();
+        }
+      }
+    }
+
+    CURL* Acquire(const std::string& key)
+    {
+      if (!key.empty())
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        Handles::iterator found = handles_.find(key);
+        if (found != handles_.end())
+        {
+          assert(!found->second.empty());
+          CURL* handle = found->second.front();
+          found->second.pop_front();
+
+          if (found->second.empty())
+          {
+            handles_.erase(found);
+          }
+
+          // Restore the default options, but keep the live connections
+          curl_easy_reset(handle);
+          return handle;
+        }
+      }
+
+      return curl_easy_init();
+    }
+
+    void Release(const std::string& key,
+                 CURL* handle)
+    {
+      if (!key.empty())
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        std::list<CURL*>& handles = handles_[key];
+        if (handles.size() < size_)
+        {
+          handles.push_back(handle);
+          return;
+        }
+        else if (handles.empty())
+        {
+          handles_.erase(key);
+        }
+      }
+
+      curl_easy_cleanup(handle);
+    }
+
+    void Clear()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      ClearInternal();
+    }
+
+    size_t GetCount(const std::string& key)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      Handles::const_iterator found = handles_.find(key);
+      if (found == handles_.end())
+      {
+        return 0;
+      }
+      else
+      {
+        return found->second.size();
+      }
+    }
   };
 
 
@@ -193,6 +339,7 @@ namespace Orthanc
     CURL* curl_;
     struct curl_slist *defaultPostHeaders_;
     struct curl_slist *userHeaders_;
+    std::string poolKey_;  // Empty if the cURL handle is not pooled
   };
 
 
@@ -328,16 +475,17 @@ namespace Orthanc
   }
 
 
-  void HttpClient::Setup()
+  void HttpClient::Setup(const std::string& poolKey)
   {
     pimpl_->userHeaders_ = NULL;
     pimpl_->defaultPostHeaders_ = NULL;
+    pimpl_->poolKey_ = poolKey;
     if ((pimpl_->defaultPostHeaders_ = curl_slist_append(pimpl_->defaultPostHeaders_, "Expect:")) == NULL)
     {
       throw OrthancException(ErrorCode_NotEnoughMemory);
     }
 
-    pimpl_->curl_ = curl_easy_init();
+    pimpl_->curl_ = ConnectionPool::GetInstance().Acquire(poolKey);
     if (!pimpl_->curl_)
     {
       curl_slist_free_all(pimpl_->defaultPostHeaders_);
@@ -353,6 +501,22 @@ namespace Orthanc
     // http://stackoverflow.com/questions/9191668/error-longjmp-causes-uninitialized-stack-frame
     CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_NOSIGNAL, 1));
 
+#if LIBCURL_VERSION_NUM >= 0x071900
+    // Keep the pooled connections alive between two requests
+    CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_TCP_KEEPALIVE, 1L));
+#endif
+
+#if LIBCURL_VERSION_NUM >= 0x072f00
+    if (!poolKey.empty() &&
+        GlobalParameters::GetInstance().IsHttp2Enabled())
+    {
+      // Negotiate HTTP/2 over HTTPS with the Web services, if
+      // available. The return code is ignored, as it is an error if
+      // libcurl is built without HTTP/2, in which case HTTP/1.1 is used.
+      curl_easy_setopt(pimpl_->curl_, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    }
+#endif
+
     url_ = "";
     method_ = HttpMethod_Get;
     lastStatus_ = HttpStatus_200_Ok;
@@ -370,7 +534,7 @@ namespace Orthanc
     headersToLowerCase_(true),
     redirectionFollowed_(true)
   {
-    Setup();
+    Setup("");
   }
 
 
@@ -381,7 +545,9 @@ namespace Orthanc
     headersToLowerCase_(true),
     redirectionFollowed_(true)
   {
-    Setup();
+    // The connections to the same Web service, with the same
+    // credentials, are shared through the pool of cURL handles
+    Setup(GetConnectionPoolKey(service));
 
     if (service.GetUsername().size() != 0 && 
         service.GetPassword().size() != 0)
@@ -405,7 +571,7 @@ namespace Orthanc
 
   HttpClient::~HttpClient()
   {
-    curl_easy_cleanup(pimpl_->curl_);
+    ConnectionPool::GetInstance().Release(pimpl_->poolKey_, pimpl_->curl_);
     curl_slist_free_all(pimpl_->defaultPostHeaders_);
     ClearHeaders();
   }
@@ -754,6 +920,7 @@ namespace Orthanc
 
   void HttpClient::GlobalFinalize()
   {
+    ConnectionPool::GetInstance().Clear();
     curl_global_cleanup();
 
 #if ORTHANC_ENABLE_PKCS11 == 1
@@ -762,6 +929,32 @@ namespace Orthanc
   }
   
 
+  void HttpClient::SetConnectionPoolSize(unsigned int size)
+  {
+    ConnectionPool::GetInstance().SetSize(size);
+  }
+
+
+  void HttpClient::SetHttp2Enabled(bool enabled)
+  {
+    GlobalParameters::GetInstance().SetHttp2Enabled(enabled);
+  }
+
+
+  std::string HttpClient::GetConnectionPoolKey(const WebServiceParameters& service)
+  {
+    return (service.GetUrl() + "\n" + service.GetUsername() + "\n" +
+            service.GetCertificateFile() + "\n" +
+            (service.IsPkcs11Enabled() ? "pkcs11" : ""));
+  }
+
+
+  size_t HttpClient::GetPooledConnectionsCount(const std::string& poolKey)
+  {
+    return ConnectionPool::GetInstance().GetCount(poolKey);
+  }
+
+
   void HttpClient::SetDefaultVerbose(bool verbose)
   {
     GlobalParameters::GetInstance().SetDefaultVerbose(verbose);
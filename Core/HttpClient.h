@@ -58,6 +58,7 @@ namespace Orthanc
 
   private:
     class GlobalParameters;
+    class ConnectionPool;
 
     struct PImpl;
     boost::shared_ptr<PImpl> pimpl_;
@@ -79,7 +80,7 @@ namespace Orthanc
     bool headersToLowerCase_;
     bool redirectionFollowed_;
 
-    void Setup();
+    void Setup(const std::string& poolKey);
 
     void operator= (const HttpClient&);  // Assignment forbidden
     HttpClient(const HttpClient& base);  // Copy forbidden
@@ -281,6 +282,20 @@ namespace Orthanc
 
     static void SetDefaultTimeout(long timeout);
 
+    static void SetConnectionPoolSize(unsigned int size);
+
+    // Negotiate HTTP/2 over HTTPS for the connections to the Web
+    // services (disabled by default)
+    static void SetHttp2Enabled(bool enabled);
+
+    // Diagnostics (for unit tests) -------------------------------------------
+
+    static std::string GetConnectionPoolKey(const WebServiceParameters& service);
+
+    static size_t GetPooledConnectionsCount(const std::string& poolKey);
+
+    // ------------------------------------------------------------------------
+
     void ApplyAndThrowException(std::string& answerBody);
 
     void ApplyAndThrowException(Json::Value& answerBody);
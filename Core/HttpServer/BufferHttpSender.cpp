@@ -41,25 +41,47 @@ namespace Orthanc
 {
   BufferHttpSender::BufferHttpSender() :
     position_(0), 
+    end_(0),
+    hasRange_(false),
     chunkSize_(0),
     currentChunkSize_(0)
   {
   }
 
 
+  bool BufferHttpSender::SetRange(uint64_t start,
+                                  uint64_t end)
+  {
+    if (start > end ||
+        end > buffer_.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    position_ = static_cast<size_t>(start);
+    end_ = static_cast<size_t>(end);
+    hasRange_ = true;
+    currentChunkSize_ = 0;
+
+    return true;
+  }
+
+
   bool BufferHttpSender::ReadNextChunk()
   {
-    assert(position_ + currentChunkSize_ <= buffer_.size());
+    const size_t end = (hasRange_ ? end_ : buffer_.size());
+
+    assert(position_ + currentChunkSize_ <= end);
 
     position_ += currentChunkSize_;
 
-    if (position_ == buffer_.size())
+    if (position_ == end)
     {
       return false;
     }
     else
     {
-      currentChunkSize_ = buffer_.size() - position_;
+      currentChunkSize_ = end - position_;
 
       if (chunkSize_ != 0 &&
           currentChunkSize_ > chunkSize_)
@@ -41,6 +41,8 @@ namespace Orthanc
   private:
     std::string  buffer_;
     size_t       position_;
+    size_t       end_;
+    bool         hasRange_;
     size_t       chunkSize_;
     size_t       currentChunkSize_;
 
@@ -74,6 +76,9 @@ namespace Orthanc
       return buffer_.size();
     }
 
+    virtual bool SetRange(uint64_t start,
+                          uint64_t end);
+
     virtual bool ReadNextChunk();
 
     virtual const char* GetChunkContent();
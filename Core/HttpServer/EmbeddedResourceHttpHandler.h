@@ -62,5 +62,16 @@ namespace Orthanc
       const GetArguments& arguments,
       const char* /*bodyData*/,
       size_t /*bodySize*/);
+
+    virtual bool CreateChunkedRequestReader(std::auto_ptr<IChunkedRequestReader>& target,
+                                            RequestOrigin origin,
+                                            const char* remoteIp,
+                                            const char* username,
+                                            HttpMethod method,
+                                            const UriComponents& uri,
+                                            const Arguments& headers)
+    {
+      return false;
+    }
   };
 }
@@ -65,6 +65,17 @@ namespace Orthanc
       const char* /*bodyData*/,
       size_t /*bodySize*/);
 
+    virtual bool CreateChunkedRequestReader(std::auto_ptr<IChunkedRequestReader>& target,
+                                            RequestOrigin origin,
+                                            const char* remoteIp,
+                                            const char* username,
+                                            HttpMethod method,
+                                            const UriComponents& uri,
+                                            const Arguments& headers)
+    {
+      return false;
+    }
+
     bool IsListDirectoryContent() const
     {
       return listDirectoryContent_;
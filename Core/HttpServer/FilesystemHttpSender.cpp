@@ -52,6 +52,24 @@ namespace Orthanc
     file_.seekg(0, file_.end);
     size_ = file_.tellg();
     file_.seekg(0, file_.beg);
+
+    remaining_ = size_;
+  }
+
+
+  bool FilesystemHttpSender::SetRange(uint64_t start,
+                                      uint64_t end)
+  {
+    if (start > end ||
+        end > size_)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    file_.seekg(start, file_.beg);
+    remaining_ = end - start;
+
+    return true;
   }
 
 
@@ -62,7 +80,19 @@ namespace Orthanc
       chunk_.resize(CHUNK_SIZE);
     }
 
-    file_.read(&chunk_[0], chunk_.size());
+    if (remaining_ == 0)
+    {
+      chunkSize_ = 0;
+      return false;
+    }
+
+    size_t toRead = chunk_.size();
+    if (remaining_ < toRead)
+    {
+      toRead = static_cast<size_t>(remaining_);
+    }
+
+    file_.read(&chunk_[0], toRead);
 
     if ((file_.flags() & std::istream::failbit) ||
         file_.gcount() < 0)
@@ -71,6 +101,7 @@ namespace Orthanc
     }
 
     chunkSize_ = static_cast<size_t>(file_.gcount());
+    remaining_ -= chunkSize_;
 
     return chunkSize_ > 0;
   }
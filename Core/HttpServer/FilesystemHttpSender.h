@@ -45,6 +45,7 @@ namespace Orthanc
   private:
     std::ifstream    file_;
     uint64_t         size_;
+    uint64_t         remaining_;   // Bytes remaining to be sent
     std::string      chunk_;
     size_t           chunkSize_;
 
@@ -76,6 +77,9 @@ namespace Orthanc
       return size_;
     }
 
+    virtual bool SetRange(uint64_t start,
+                          uint64_t end);
+
     virtual bool ReadNextChunk();
 
     virtual const char* GetChunkContent()
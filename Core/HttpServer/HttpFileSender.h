@@ -75,5 +75,10 @@ namespace Orthanc
     virtual bool HasContentFilename(std::string& filename);
     
     virtual std::string GetContentType();
+
+    virtual bool HasContentLength()
+    {
+      return true;
+    }
   };
 }
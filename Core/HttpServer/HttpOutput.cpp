@@ -39,6 +39,7 @@
 #include "../Toolbox.h"
 #include "../Compression/GzipCompressor.h"
 #include "../Compression/ZlibCompressor.h"
+#include "HttpToolbox.h"
 
 #include <iostream>
 #include <vector>
@@ -156,7 +157,8 @@ namespace Orthanc
       }
     }
 
-    if (state_ == State_WritingMultipart)
+    if (state_ == State_WritingMultipart ||
+        state_ == State_WritingStream)
     {
       throw OrthancException(ErrorCode_InternalError);
     }
@@ -183,7 +185,8 @@ namespace Orthanc
         s += *it;
       }
 
-      if (status_ != HttpStatus_200_Ok)
+      if (status_ != HttpStatus_200_Ok &&
+          status_ != HttpStatus_206_PartialContent)
       {
         hasContentLength_ = false;
       }
@@ -243,6 +246,10 @@ namespace Orthanc
         LOG(ERROR) << "Cannot invoke CloseBody() with multipart outputs";
         throw OrthancException(ErrorCode_BadSequenceOfCalls);
 
+      case State_WritingStream:
+        LOG(ERROR) << "Cannot invoke CloseBody() with streamed outputs";
+        throw OrthancException(ErrorCode_BadSequenceOfCalls);
+
       case State_Done:
         return;  // Ignore
 
@@ -535,9 +542,91 @@ namespace Orthanc
   }
 
 
+  void HttpOutput::StateMachine::StartStream()
+  {
+    if (state_ != State_WritingHeader)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (status_ != HttpStatus_200_Ok)
+    {
+      SendBody(NULL, 0);
+      return;
+    }
+
+    stream_.OnHttpStatusReceived(status_);
+
+    std::string header = "HTTP/1.1 200 OK\r\n";
+
+    if (keepAlive_)
+    {
+      header += "Connection: keep-alive\r\n";
+    }
+
+    for (std::list<std::string>::const_iterator
+           it = headers_.begin(); it != headers_.end(); ++it)
+    {
+      header += *it;
+    }
+
+    header += "Transfer-Encoding: chunked\r\n\r\n";
+
+    stream_.Send(true, header.c_str(), header.size());
+    state_ = State_WritingStream;
+  }
+
+
+  void HttpOutput::StateMachine::SendStreamItem(const void* data,
+                                                size_t size)
+  {
+    if (state_ != State_WritingStream)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (size > 0)  // An empty chunk would mark the end of the body
+    {
+      char header[32];
+      sprintf(header, "%lx\r\n", static_cast<unsigned long>(size));
+
+      // The chunk delimiters belong to the transport layer, hence
+      // they are flagged as headers for "StringHttpOutput"
+      stream_.Send(true, header, strlen(header));
+      stream_.Send(false, data, size);
+      stream_.Send(true, "\r\n", 2);
+    }
+  }
+
+
+  void HttpOutput::StateMachine::CloseStream()
+  {
+    if (state_ != State_WritingStream)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    // As for multipart answers, an error at this point means that
+    // the client has closed the connection, and is ignored
+    try
+    {
+      stream_.Send(true, "0\r\n\r\n", 5);
+    }
+    catch (OrthancException&)
+    {
+    }
+
+    state_ = State_Done;
+  }
+
+
   void HttpOutput::Answer(IHttpStreamAnswer& stream)
   {
-    HttpCompression compression = stream.SetupHttpCompression(isGzipAllowed_, isDeflateAllowed_);
+    // HTTP compression is disabled for range requests, as the
+    // ranges refer to the bytes of the uncompressed content
+    const bool hasRange = !requestedRange_.empty();
+    HttpCompression compression = stream.SetupHttpCompression(isGzipAllowed_ && !hasRange,
+                                                              isDeflateAllowed_ && !hasRange);
 
     switch (compression)
     {
@@ -556,7 +645,36 @@ namespace Orthanc
         throw OrthancException(ErrorCode_ParameterOutOfRange);
     }
 
-    stateMachine_.SetContentLength(stream.GetContentLength());
+    const bool hasContentLength = stream.HasContentLength();
+    if (hasContentLength)
+    {
+      uint64_t length = stream.GetContentLength();
+
+      bool isSatisfiable;
+      uint64_t start, end;
+      if (hasRange &&
+          compression == HttpCompression_None &&
+          HttpToolbox::ParseRange(isSatisfiable, start, end, requestedRange_, length))
+      {
+        if (!isSatisfiable)
+        {
+          stateMachine_.SetHttpStatus(HttpStatus_416_RequestedRangeNotSatisfiable);
+          stateMachine_.AddHeader("Content-Range", "bytes */" + boost::lexical_cast<std::string>(length));
+          stateMachine_.SendBody(NULL, 0);
+          return;
+        }
+        else if (stream.SetRange(start, end))
+        {
+          stateMachine_.SetHttpStatus(HttpStatus_206_PartialContent);
+          stateMachine_.AddHeader("Content-Range", "bytes " + boost::lexical_cast<std::string>(start) + "-" +
+                                  boost::lexical_cast<std::string>(end - 1) + "/" +
+                                  boost::lexical_cast<std::string>(length));
+          length = end - start;
+        }
+      }
+
+      stateMachine_.SetContentLength(length);
+    }
 
     std::string contentType = stream.GetContentType();
     if (contentType.empty())
@@ -572,13 +690,29 @@ namespace Orthanc
       SetContentFilename(filename.c_str());
     }
 
-    while (stream.ReadNextChunk())
+    if (hasContentLength)
     {
-      stateMachine_.SendBody(stream.GetChunkContent(),
-                             stream.GetChunkSize());
+      while (stream.ReadNextChunk())
+      {
+        stateMachine_.SendBody(stream.GetChunkContent(),
+                               stream.GetChunkSize());
+      }
+
+      stateMachine_.CloseBody();
     }
+    else
+    {
+      // The size of the answer is unknown: Use the chunked transfer encoding
+      stateMachine_.StartStream();
 
-    stateMachine_.CloseBody();
+      while (stream.ReadNextChunk())
+      {
+        stateMachine_.SendStreamItem(stream.GetChunkContent(),
+                                     stream.GetChunkSize());
+      }
+
+      stateMachine_.CloseStream();
+    }
   }
 
 }
@@ -57,6 +57,7 @@ namespace Orthanc
         State_WritingHeader,      
         State_WritingBody,
         State_WritingMultipart,
+        State_WritingStream,
         State_Done
       };
 
@@ -107,6 +108,13 @@ namespace Orthanc
 
       void CloseMultipart();
 
+      void StartStream();
+
+      void SendStreamItem(const void* data,
+                          size_t size);
+
+      void CloseStream();
+
       void CloseBody();
 
       State GetState() const
@@ -118,6 +126,7 @@ namespace Orthanc
     StateMachine stateMachine_;
     bool         isDeflateAllowed_;
     bool         isGzipAllowed_;
+    std::string  requestedRange_;
 
     HttpCompression GetPreferredCompression(size_t bodySize) const;
 
@@ -150,6 +159,18 @@ namespace Orthanc
       return isGzipAllowed_;
     }
 
+    // Value of the "Range" header of the request, which is taken into
+    // consideration by "Answer(IHttpStreamAnswer&)"
+    void SetRequestedRange(const std::string& range)
+    {
+      requestedRange_ = range;
+    }
+
+    const std::string& GetRequestedRange() const
+    {
+      return requestedRange_;
+    }
+
     void SendStatus(HttpStatus status,
 		    const char* message,
 		    size_t messageSize);
@@ -223,6 +244,23 @@ namespace Orthanc
       return stateMachine_.GetState() == StateMachine::State_WritingMultipart;
     }
 
+    // Send a body of unknown size, using the chunked transfer encoding
+    void StartStream()
+    {
+      stateMachine_.StartStream();
+    }
+
+    void SendStreamItem(const void* data,
+                        size_t size)
+    {
+      stateMachine_.SendStreamItem(data, size);
+    }
+
+    void CloseStream()
+    {
+      stateMachine_.CloseStream();
+    }
+
     void Answer(IHttpStreamAnswer& stream);
   };
 }
@@ -158,6 +158,30 @@ namespace Orthanc
   }
 
 
+  bool HttpStreamTranscoder::SetRange(uint64_t start,
+                                      uint64_t end)
+  {
+    if (!ready_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (uncompressed_.get() != NULL)
+    {
+      return uncompressed_->SetRange(start, end);
+    }
+    else if (bytesToSkip_ == 0)
+    {
+      // The source is sent as such
+      return source_.SetRange(start, end);
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+
   bool HttpStreamTranscoder::ReadNextChunk()
   {
     if (!ready_)
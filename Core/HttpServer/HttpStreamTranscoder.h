@@ -81,8 +81,16 @@ namespace Orthanc
       return source_.GetContentType();
     }
 
+    virtual bool HasContentLength()
+    {
+      return true;
+    }
+
     virtual uint64_t GetContentLength();
 
+    virtual bool SetRange(uint64_t start,
+                          uint64_t end);
+
     virtual bool ReadNextChunk();
 
     virtual const char* GetChunkContent();
@@ -37,6 +37,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <iostream>
+#include <boost/lexical_cast.hpp>
 
 #include "HttpOutput.h"
 #include "StringHttpOutput.h"
@@ -187,6 +188,106 @@ namespace Orthanc
   }
 
 
+  static bool ParseRangeBound(uint64_t& target,
+                              const std::string& s)
+  {
+    if (s.empty())
+    {
+      return false;
+    }
+
+    for (size_t i = 0; i < s.size(); i++)
+    {
+      if (s[i] < '0' || s[i] > '9')
+      {
+        return false;
+      }
+    }
+
+    try
+    {
+      target = boost::lexical_cast<uint64_t>(s);
+      return true;
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+      return false;  // Overflow
+    }
+  }
+
+
+  bool HttpToolbox::ParseRange(bool& isSatisfiable,
+                               uint64_t& start,
+                               uint64_t& end,
+                               const std::string& header,
+                               uint64_t size)
+  {
+    static const char* const PREFIX = "bytes=";
+
+    std::string s = Toolbox::StripSpaces(header);
+    if (!Toolbox::StartsWith(s, PREFIX) ||
+        s.find(',') != std::string::npos)  // Multiple ranges are not supported
+    {
+      return false;
+    }
+
+    s = s.substr(strlen(PREFIX));
+
+    size_t dash = s.find('-');
+    if (dash == std::string::npos)
+    {
+      return false;
+    }
+
+    std::string first = Toolbox::StripSpaces(s.substr(0, dash));
+    std::string last = Toolbox::StripSpaces(s.substr(dash + 1));
+
+    if (first.empty())
+    {
+      // Suffix range: "bytes=-500" designates the last 500 bytes
+      uint64_t suffix;
+      if (!ParseRangeBound(suffix, last))
+      {
+        return false;
+      }
+
+      isSatisfiable = (suffix > 0 && size > 0);
+      start = (suffix < size ? size - suffix : 0);
+      end = size;
+    }
+    else
+    {
+      uint64_t a, b;
+      if (!ParseRangeBound(a, first))
+      {
+        return false;
+      }
+
+      if (last.empty())
+      {
+        b = (size == 0 ? 0 : size - 1);   // "bytes=500-" goes up to the end
+      }
+      else if (!ParseRangeBound(b, last) ||
+               b < a)
+      {
+        return false;
+      }
+
+      isSatisfiable = (a < size);
+      start = a;
+      end = (b < size ? b + 1 : size);
+    }
+
+    if (!isSatisfiable)
+    {
+      start = 0;
+      end = 0;
+    }
+
+    return true;
+  }
+
+
   void HttpToolbox::CompileGetArguments(IHttpHandler::Arguments& compiled,
                                         const IHttpHandler::GetArguments& source)
   {
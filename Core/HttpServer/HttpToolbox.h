@@ -58,6 +58,20 @@ namespace Orthanc
     static void ParseCookies(IHttpHandler::Arguments& result, 
                              const IHttpHandler::Arguments& httpHeaders);
 
+    /**
+     * Parses the value of a HTTP "Range" header (RFC 7233), given
+     * the size of the full content. Only one range of bytes is
+     * supported. Returns "false" if the header must be ignored (bad
+     * syntax or multiple ranges), in which case the full content is
+     * to be sent. Otherwise, "isSatisfiable" tells whether the range
+     * overlaps the content, and the bytes to be sent are [start, end).
+     **/
+    static bool ParseRange(bool& isSatisfiable,
+                           uint64_t& start,
+                           uint64_t& end,
+                           const std::string& header,
+                           uint64_t size);
+
     static void CompileGetArguments(IHttpHandler::Arguments& compiled,
                                     const IHttpHandler::GetArguments& source);
 
@@ -37,6 +37,7 @@
 #include "HttpOutput.h"
 
 #include <map>
+#include <memory>
 #include <set>
 #include <vector>
 #include <string>
@@ -49,10 +50,41 @@ namespace Orthanc
     typedef std::map<std::string, std::string>                  Arguments;
     typedef std::vector< std::pair<std::string, std::string> >  GetArguments;
 
+    /**
+     * Receiver of the body of a POST or PUT request, as a sequence of
+     * chunks read from the network, so that the body of large uploads
+     * is never fully loaded in RAM by the HTTP server.
+     **/
+    class IChunkedRequestReader : public boost::noncopyable
+    {
+    public:
+      virtual ~IChunkedRequestReader()
+      {
+      }
+
+      virtual void AddBodyChunk(const void* data,
+                                size_t size) = 0;
+
+      virtual void Execute(HttpOutput& output) = 0;
+    };
+
     virtual ~IHttpHandler()
     {
     }
 
+    /**
+     * Returns "true" iff this handler processes the body of the given
+     * request chunk by chunk. In this case, "target" is filled with
+     * the reader receiving the body, and "Handle()" is not called.
+     **/
+    virtual bool CreateChunkedRequestReader(std::auto_ptr<IChunkedRequestReader>& target,
+                                            RequestOrigin origin,
+                                            const char* remoteIp,
+                                            const char* username,
+                                            HttpMethod method,
+                                            const UriComponents& uri,
+                                            const Arguments& headers) = 0;
+
     virtual bool Handle(HttpOutput& output,
                         RequestOrigin origin,
                         const char* remoteIp,
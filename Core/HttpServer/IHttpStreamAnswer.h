@@ -56,8 +56,21 @@ namespace Orthanc
 
     virtual std::string GetContentType() = 0;
 
+    // If "false" is returned, the answer is sent using the chunked
+    // transfer encoding, and "GetContentLength()" is not called
+    virtual bool HasContentLength() = 0;
+
     virtual uint64_t GetContentLength() = 0;
 
+    // Restricts the chunks to the bytes in the range [start, end) of
+    // the content, in order to answer HTTP "Range" requests. This is
+    // called after "SetupHttpCompression()" if no compression is
+    // used, and before "ReadNextChunk()". Returns "false" if partial
+    // content is not supported. "GetContentLength()" keeps returning
+    // the size of the full content.
+    virtual bool SetRange(uint64_t start,
+                          uint64_t end) = 0;
+
     virtual bool ReadNextChunk() = 0;
 
     virtual const char* GetChunkContent() = 0;
@@ -52,6 +52,7 @@
 #endif
 
 #include <algorithm>
+#include <limits>
 #include <string.h>
 #include <boost/lexical_cast.hpp>
 #include <boost/algorithm/string.hpp>
@@ -277,24 +278,22 @@ namespace Orthanc
 
 
 
-  static PostDataStatus ReadBody(std::string& postData,
-                                 struct mg_connection *connection,
-                                 const IHttpHandler::Arguments& headers)
+  static bool GetContentLength(int64_t& length,
+                               const IHttpHandler::Arguments& headers)
   {
     IHttpHandler::Arguments::const_iterator cs = headers.find("content-length");
     if (cs == headers.end())
     {
-      return PostDataStatus_NoLength;
+      return false;
     }
 
-    int length;      
     try
     {
-      length = boost::lexical_cast<int>(cs->second);
+      length = boost::lexical_cast<int64_t>(cs->second);
     }
     catch (boost::bad_lexical_cast)
     {
-      return PostDataStatus_NoLength;
+      return false;
     }
 
     if (length < 0)
@@ -302,6 +301,28 @@ namespace Orthanc
       length = 0;
     }
 
+    return true;
+  }
+
+
+  static PostDataStatus ReadBody(std::string& postData,
+                                 struct mg_connection *connection,
+                                 const IHttpHandler::Arguments& headers)
+  {
+    int64_t tmp;
+    if (!GetContentLength(tmp, headers))
+    {
+      return PostDataStatus_NoLength;
+    }
+
+    if (static_cast<uint64_t>(tmp) > static_cast<uint64_t>(std::numeric_limits<int>::max()))
+    {
+      LOG(ERROR) << "Too large body in a HTTP request: " << tmp << " bytes";
+      return PostDataStatus_Failure;
+    }
+
+    int length = static_cast<int>(tmp);
+
     postData.resize(length);
 
     size_t pos = 0;
@@ -323,6 +344,40 @@ namespace Orthanc
 
 
 
+  static PostDataStatus ReadBodyByChunks(IHttpHandler::IChunkedRequestReader& reader,
+                                         struct mg_connection *connection,
+                                         const IHttpHandler::Arguments& headers)
+  {
+    static const int CHUNK_SIZE = 64 * 1024;
+
+    int64_t length;
+    if (!GetContentLength(length, headers))
+    {
+      return PostDataStatus_NoLength;
+    }
+
+    std::string buffer;
+    buffer.resize(static_cast<size_t>(std::min(length, static_cast<int64_t>(CHUNK_SIZE))));
+
+    while (length > 0)
+    {
+      int r = mg_read(connection, &buffer[0], 
+                      static_cast<size_t>(std::min(length, static_cast<int64_t>(buffer.size()))));
+      if (r <= 0)
+      {
+        return PostDataStatus_Failure;
+      }
+
+      assert(r <= length);
+      reader.AddBodyChunk(buffer.c_str(), r);
+      length -= r;
+    }
+
+    return PostDataStatus_Success;
+  }
+
+
+
   static PostDataStatus ParseMultipartPost(std::string &completedFile,
                                            struct mg_connection *connection,
                                            const IHttpHandler::Arguments& headers,
@@ -639,6 +694,13 @@ namespace Orthanc
     if (!strcmp(request->request_method, "GET"))
     {
       HttpToolbox::ParseGetArguments(argumentsGET, request->query_string);
+
+      // Partial content is only served for GET requests
+      IHttpHandler::Arguments::const_iterator range = headers.find("range");
+      if (range != headers.end())
+      {
+        output.SetRequestedRange(range->second);
+      }
     }
 
 
@@ -689,34 +751,54 @@ namespace Orthanc
     }
 
 
+    // Decompose the URI into its components
+    UriComponents uri;
+    try
+    {
+      Toolbox::SplitUriComponents(uri, request->uri);
+    }
+    catch (OrthancException&)
+    {
+      output.SendStatus(HttpStatus_400_BadRequest);
+      return;
+    }
+
+
     // Extract the body of the request for PUT and POST
 
     // TODO Avoid unneccessary memcopy of the body
 
     std::string body;
+    std::auto_ptr<IHttpHandler::IChunkedRequestReader> reader;
+
     if (method == HttpMethod_Post ||
         method == HttpMethod_Put)
     {
       PostDataStatus status;
 
       IHttpHandler::Arguments::const_iterator ct = headers.find("content-type");
-      if (ct == headers.end())
+      if (ct != headers.end() &&
+          ct->second.size() >= multipartLength &&
+          !memcmp(ct->second.c_str(), multipart, multipartLength))
       {
-        // No content-type specified. Assume no multi-part content occurs at this point.
-        status = ReadBody(body, connection, headers);          
+        status = ParseMultipartPost(body, connection, headers, ct->second, server.GetChunkStore());
       }
-      else
+      else if (server.HasHandler() &&
+               server.GetHandler().CreateChunkedRequestReader(reader, RequestOrigin_RestApi, remoteIp,
+                                                              username.c_str(), method, uri, headers))
       {
-        std::string contentType = ct->second;
-        if (contentType.size() >= multipartLength &&
-            !memcmp(contentType.c_str(), multipart, multipartLength))
-        {
-          status = ParseMultipartPost(body, connection, headers, contentType, server.GetChunkStore());
-        }
-        else
+        // The handler processes the body while it is received
+        if (reader.get() == NULL)
         {
-          status = ReadBody(body, connection, headers);
+          throw OrthancException(ErrorCode_InternalError);
         }
+
+        status = ReadBodyByChunks(*reader, connection, headers);
+      }
+      else
+      {
+        // No multi-part content occurs at this point
+        status = ReadBody(body, connection, headers);
       }
 
       switch (status)
@@ -739,21 +821,14 @@ namespace Orthanc
     }
 
 
-    // Decompose the URI into its components
-    UriComponents uri;
-    try
-    {
-      Toolbox::SplitUriComponents(uri, request->uri);
-    }
-    catch (OrthancException&)
+    LOG(INFO) << EnumerationToString(method) << " " << Toolbox::FlattenUri(uri);
+
+    if (reader.get() != NULL)
     {
-      output.SendStatus(HttpStatus_400_BadRequest);
+      reader->Execute(output);
       return;
     }
 
-
-    LOG(INFO) << EnumerationToString(method) << " " << Toolbox::FlattenUri(uri);
-
     bool found = false;
 
     if (server.HasHandler())
@@ -37,27 +37,783 @@
 #include "PixelTraits.h"
 
 #include <boost/math/special_functions/round.hpp>
+#include <boost/noncopyable.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <string.h>
 #include <limits>
 #include <stdint.h>
+#include <vector>
+
+#if !defined(ORTHANC_ENABLE_SIMD)
+#  error The macro ORTHANC_ENABLE_SIMD must be defined
+#endif
+
+#if ORTHANC_ENABLE_SIMD == 1
+#  if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define ORTHANC_HAS_SSE2  1
+#    include <emmintrin.h>
+#  endif
+
+// AVX2 is not part of the baseline of the x86 targets, so its kernels
+// are compiled for this specific target, and selected at runtime if
+// the CPU supports them (only available with GCC and clang)
+#  if defined(ORTHANC_HAS_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    define ORTHANC_HAS_AVX2  1
+#    define ORTHANC_AVX2_FUNCTION  __attribute__((target("avx2")))
+#    include <immintrin.h>
+#  endif
+#endif
+
+#if !defined(ORTHANC_HAS_SSE2)
+#  define ORTHANC_HAS_SSE2  0
+#endif
+
+#if !defined(ORTHANC_HAS_AVX2)
+#  define ORTHANC_HAS_AVX2  0
+#endif
+
 
 namespace Orthanc
 {
+  /**
+   * SIMD kernels. Each of them processes the beginning of one row of
+   * pixels, and returns the number of pixels it has processed. The
+   * remaining pixels are processed by the scalar loops below, that
+   * are also used if the CPU has no SIMD instruction set. The results
+   * are exactly the same as those of the scalar loops.
+   **/
+
+  namespace
+  {
+    enum SimdLevel
+    {
+      SimdLevel_None,
+      SimdLevel_SSE2,
+      SimdLevel_AVX2
+    };
+
+    static SimdLevel DetectSimdLevel()
+    {
+#if ORTHANC_HAS_AVX2 == 1
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx2"))
+      {
+        return SimdLevel_AVX2;
+      }
+#endif
+
+#if ORTHANC_HAS_SSE2 == 1
+      return SimdLevel_SSE2;
+#else
+      return SimdLevel_None;
+#endif
+    }
+
+    // Before its dynamic initialization, this variable is zero, which
+    // corresponds to "SimdLevel_None" (i.e. the scalar loops are used)
+    static const SimdLevel  detectedSimdLevel_ = DetectSimdLevel();
+    static bool             simdEnabled_ = true;
+
+    static SimdLevel GetSimdLevel()
+    {
+      return simdEnabled_ ? detectedSimdLevel_ : SimdLevel_None;
+    }
+  }
+
+
+  template <typename PixelType>
+  static unsigned int GetMinMaxRowSimd(PixelType& /*minValue*/,
+                                       PixelType& /*maxValue*/,
+                                       const PixelType* /*p*/,
+                                       unsigned int /*width*/)
+  {
+    return 0;  // No SIMD kernel for this pixel type
+  }
+
+  template <typename TargetType, typename SourceType>
+  static unsigned int ConvertRowSimd(TargetType* /*t*/,
+                                     const SourceType* /*s*/,
+                                     unsigned int /*width*/)
+  {
+    return 0;  // No SIMD kernel for this pair of pixel types
+  }
+
+  template <typename PixelType>
+  static unsigned int ShiftScaleRowSimd(PixelType* /*p*/,
+                                        unsigned int /*width*/,
+                                        float /*offset*/,
+                                        float /*scaling*/,
+                                        bool /*useRound*/)
+  {
+    return 0;  // No SIMD kernel for this pixel type
+  }
+
+
+#if ORTHANC_HAS_SSE2 == 1
+  // Minimum and maximum of 8-bit and 16-bit pixels. The unsigned
+  // 16-bit pixels are flipped to signed values, as SSE2 only
+  // provides the comparison of signed 16-bit integers.
+
+  template <typename PixelType>
+  static void UpdateMinMax(PixelType& minValue,
+                           PixelType& maxValue,
+                           const PixelType* lanesMin,
+                           const PixelType* lanesMax,
+                           size_t count)
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      if (lanesMin[i] < minValue)
+      {
+        minValue = lanesMin[i];
+      }
+
+      if (lanesMax[i] > maxValue)
+      {
+        maxValue = lanesMax[i];
+      }
+    }
+  }
+
+  static unsigned int GetMinMaxRowSSE2(uint8_t& minValue,
+                                       uint8_t& maxValue,
+                                       const uint8_t* p,
+                                       unsigned int width)
+  {
+    unsigned int x = 0;
+
+    if (width >= 16)
+    {
+      __m128i vmin = _mm_set1_epi8(static_cast<char>(minValue));
+      __m128i vmax = _mm_set1_epi8(static_cast<char>(maxValue));
+
+      for (; x + 16 <= width; x += 16)
+      {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + x));
+        vmin = _mm_min_epu8(vmin, v);
+        vmax = _mm_max_epu8(vmax, v);
+      }
+
+      uint8_t a[16], b[16];
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(a), vmin);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(b), vmax);
+      UpdateMinMax(minValue, maxValue, a, b, 16);
+    }
+
+    return x;
+  }
+
+  static unsigned int GetMinMaxRowSSE2(int16_t& minValue,
+                                       int16_t& maxValue,
+                                       const int16_t* p,
+                                       unsigned int width)
+  {
+    unsigned int x = 0;
+
+    if (width >= 8)
+    {
+      __m128i vmin = _mm_set1_epi16(minValue);
+      __m128i vmax = _mm_set1_epi16(maxValue);
+
+      for (; x + 8 <= width; x += 8)
+      {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + x));
+        vmin = _mm_min_epi16(vmin, v);
+        vmax = _mm_max_epi16(vmax, v);
+      }
+
+      int16_t a[8], b[8];
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(a), vmin);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(b), vmax);
+      UpdateMinMax(minValue, maxValue, a, b, 8);
+    }
+
+    return x;
+  }
+
+  static unsigned int GetMinMaxRowSSE2(uint16_t& minValue,
+                                       uint16_t& maxValue,
+                                       const uint16_t* p,
+                                       unsigned int width)
+  {
+    unsigned int x = 0;
+
+    if (width >= 8)
+    {
+      const __m128i flip = _mm_set1_epi16(static_cast<short>(0x8000));
+      __m128i vmin = _mm_set1_epi16(static_cast<short>(minValue ^ 0x8000));
+      __m128i vmax = _mm_set1_epi16(static_cast<short>(maxValue ^ 0x8000));
+
+      for (; x + 8 <= width; x += 8)
+      {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + x)), flip);
+        vmin = _mm_min_epi16(vmin, v);
+        vmax = _mm_max_epi16(vmax, v);
+      }
+
+      uint16_t a[8], b[8];
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(a), _mm_xor_si128(vmin, flip));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(b), _mm_xor_si128(vmax, flip));
+      UpdateMinMax(minValue, maxValue, a, b, 8);
+    }
+
+    return x;
+  }
+
+
+  // Saturated conversions between the integer grayscale formats, with
+  // the same clamping as "ConvertInternal()"
+
+  static unsigned int ConvertRowSSE2(uint16_t* t,
+                                     const uint8_t* s,
+                                     unsigned int width)
+  {
+    const __m128i zero = _mm_setzero_si128();
+    unsigned int x = 0;
+
+    for (; x + 16 <= width; x += 16)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(t + x), _mm_unpacklo_epi8(v, zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(t + x + 8), _mm_unpackhi_epi8(v, zero));
+    }
+
+    return x;
+  }
+
+  template <>
+  unsigned int ConvertRowSimd<uint16_t, uint8_t>(uint16_t* t,
+                                                 const uint8_t* s,
+                                                 unsigned int width)
+  {
+    return (GetSimdLevel() == SimdLevel_None) ? 0 : ConvertRowSSE2(t, s, width);
+  }
+
+  template <>
+  unsigned int ConvertRowSimd<int16_t, uint8_t>(int16_t* t,
+                                                const uint8_t* s,
+                                                unsigned int width)
+  {
+    // The 8-bit values are always in the range of signed 16-bit integers
+    return (GetSimdLevel() == SimdLevel_None) ? 0 :
+      ConvertRowSSE2(reinterpret_cast<uint16_t*>(t), s, width);
+  }
+
+  template <>
+  unsigned int ConvertRowSimd<uint8_t, uint16_t>(uint8_t* t,
+                                                 const uint16_t* s,
+                                                 unsigned int width)
+  {
+    if (GetSimdLevel() == SimdLevel_None)
+    {
+      return 0;
+    }
+
+    // min(v, 255) == v - max(v - 255, 0), with unsigned saturation
+    const __m128i limit = _mm_set1_epi16(255);
+    unsigned int x = 0;
+
+    for (; x + 16 <= width; x += 16)
+    {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x + 8));
+      a = _mm_sub_epi16(a, _mm_subs_epu16(a, limit));
+      b = _mm_sub_epi16(b, _mm_subs_epu16(b, limit));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(t + x), _mm_packus_epi16(a, b));
+    }
+
+    return x;
+  }
+
+  template <>
+  unsigned int ConvertRowSimd<uint8_t, int16_t>(uint8_t* t,
+                                                const int16_t* s,
+                                                unsigned int width)
+  {
+    if (GetSimdLevel() == SimdLevel_None)
+    {
+      return 0;
+    }
+
+    unsigned int x = 0;
+
+    for (; x + 16 <= width; x += 16)
+    {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x + 8));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(t + x), _mm_packus_epi16(a, b));
+    }
+
+    return x;
+  }
+
+  template <>
+  unsigned int ConvertRowSimd<int16_t, uint16_t>(int16_t* t,
+                                                 const uint16_t* s,
+                                                 unsigned int width)
+  {
+    if (GetSimdLevel() == SimdLevel_None)
+    {
+      return 0;
+    }
+
+    // min(v, 32767), computed as above
+    const __m128i limit = _mm_set1_epi16(32767);
+    unsigned int x = 0;
+
+    for (; x + 8 <= width; x += 8)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x));
+      v = _mm_sub_epi16(v, _mm_subs_epu16(v, limit));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(t + x), v);
+    }
+
+    return x;
+  }
+
+  template <>
+  unsigned int ConvertRowSimd<uint16_t, int16_t>(uint16_t* t,
+                                                 const int16_t* s,
+                                                 unsigned int width)
+  {
+    if (GetSimdLevel() == SimdLevel_None)
+    {
+      return 0;
+    }
+
+    // The negative values are clamped to zero
+    const __m128i zero = _mm_setzero_si128();
+    unsigned int x = 0;
+
+    for (; x + 8 <= width; x += 8)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(t + x), _mm_max_epi16(v, zero));
+    }
+
+    return x;
+  }
+
+
+  // Shift-scale of 8 pixels, that are converted to single-precision
+  // floats as in "ShiftScaleInternal()". The rounding is half away
+  // from zero, as "boost::math::iround()".
+
+  static __m128 ShiftScaleSSE2(__m128i v,
+                               __m128 offset,
+                               __m128 scaling,
+                               __m128 minValue,
+                               __m128 maxValue)
+  {
+    __m128 f = _mm_mul_ps(_mm_add_ps(_mm_cvtepi32_ps(v), offset), scaling);
+    return _mm_min_ps(_mm_max_ps(f, minValue), maxValue);
+  }
+
+  static __m128i ToIntegerSSE2(__m128 f,
+                               bool useRound)
+  {
+    __m128i t = _mm_cvttps_epi32(f);  // Truncation
+
+    if (useRound)
+    {
+      __m128 fraction = _mm_sub_ps(f, _mm_cvtepi32_ps(t));
+      // The comparisons return -1 in the lanes where they are true
+      t = _mm_sub_epi32(t, _mm_castps_si128(_mm_cmpge_ps(fraction, _mm_set1_ps(0.5f))));
+      t = _mm_add_epi32(t, _mm_castps_si128(_mm_cmple_ps(fraction, _mm_set1_ps(-0.5f))));
+    }
+
+    return t;
+  }
+
+  template <typename PixelType>
+  static unsigned int ShiftScaleRowSSE2(PixelType* p,
+                                        unsigned int width,
+                                        float offset,
+                                        float scaling,
+                                        bool useRound)
+  {
+    const __m128 vOffset = _mm_set1_ps(offset);
+    const __m128 vScaling = _mm_set1_ps(scaling);
+    const __m128 vMin = _mm_set1_ps(static_cast<float>(std::numeric_limits<PixelType>::min()));
+    const __m128 vMax = _mm_set1_ps(static_cast<float>(std::numeric_limits<PixelType>::max()));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias32 = _mm_set1_epi32(32768);
+    const __m128i bias16 = _mm_set1_epi16(static_cast<short>(0x8000));
+
+    unsigned int x = 0;
+
+    for (; x + 8 <= width; x += 8)
+    {
+      __m128i lo, hi;
+
+      // Load 8 pixels as 32-bit integers
+      if (sizeof(PixelType) == 1)
+      {
+        __m128i v = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + x)), zero);
+        lo = _mm_unpacklo_epi16(v, zero);
+        hi = _mm_unpackhi_epi16(v, zero);
+      }
+      else if (std::numeric_limits<PixelType>::is_signed)
+      {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + x));
+        lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+      }
+      else
+      {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + x));
+        lo = _mm_unpacklo_epi16(v, zero);
+        hi = _mm_unpackhi_epi16(v, zero);
+      }
+
+      lo = ToIntegerSSE2(ShiftScaleSSE2(lo, vOffset, vScaling, vMin, vMax), useRound);
+      hi = ToIntegerSSE2(ShiftScaleSSE2(hi, vOffset, vScaling, vMin, vMax), useRound);
+
+      // Store the 8 pixels, whose values are already in the range of
+      // the pixel type
+      if (sizeof(PixelType) == 1)
+      {
+        __m128i v = _mm_packs_epi32(lo, hi);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(p + x), _mm_packus_epi16(v, v));
+      }
+      else if (std::numeric_limits<PixelType>::is_signed)
+      {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p + x), _mm_packs_epi32(lo, hi));
+      }
+      else
+      {
+        // SSE2 has no unsigned saturation from 32-bit to 16-bit
+        __m128i v = _mm_packs_epi32(_mm_sub_epi32(lo, bias32), _mm_sub_epi32(hi, bias32));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p + x), _mm_xor_si128(v, bias16));
+      }
+    }
+
+    return x;
+  }
+
+
+  static unsigned int InvertRowSSE2(uint8_t* p,
+                                    unsigned int width)
+  {
+    // "255 - v" is the same as "v XOR 255"
+    const __m128i mask = _mm_set1_epi8(static_cast<char>(0xff));
+    unsigned int x = 0;
+
+    for (; x + 16 <= width; x += 16)
+    {
+      __m128i* q = reinterpret_cast<__m128i*>(p + x);
+      _mm_storeu_si128(q, _mm_xor_si128(_mm_loadu_si128(q), mask));
+    }
+
+    return x;
+  }
+#endif
+
+
+#if ORTHANC_HAS_AVX2 == 1
+  // The AVX2 kernels are restricted to the computations that are
+  // bound by the CPU, namely the min/max and the shift-scale
+
+  ORTHANC_AVX2_FUNCTION
+  static unsigned int GetMinMaxRowAVX2(uint8_t& minValue,
+                                       uint8_t& maxValue,
+                                       const uint8_t* p,
+                                       unsigned int width)
+  {
+    unsigned int x = 0;
+
+    if (width >= 32)
+    {
+      __m256i vmin = _mm256_set1_epi8(static_cast<char>(minValue));
+      __m256i vmax = _mm256_set1_epi8(static_cast<char>(maxValue));
+
+      for (; x + 32 <= width; x += 32)
+      {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + x));
+        vmin = _mm256_min_epu8(vmin, v);
+        vmax = _mm256_max_epu8(vmax, v);
+      }
+
+      uint8_t a[32], b[32];
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(a), vmin);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(b), vmax);
+      UpdateMinMax(minValue, maxValue, a, b, 32);
+    }
+
+    return x;
+  }
+
+  ORTHANC_AVX2_FUNCTION
+  static unsigned int GetMinMaxRowAVX2(uint16_t& minValue,
+                                       uint16_t& maxValue,
+                                       const uint16_t* p,
+                                       unsigned int width)
+  {
+    unsigned int x = 0;
+
+    if (width >= 16)
+    {
+      __m256i vmin = _mm256_set1_epi16(static_cast<short>(minValue));
+      __m256i vmax = _mm256_set1_epi16(static_cast<short>(maxValue));
+
+      for (; x + 16 <= width; x += 16)
+      {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + x));
+        vmin = _mm256_min_epu16(vmin, v);
+        vmax = _mm256_max_epu16(vmax, v);
+      }
+
+      uint16_t a[16], b[16];
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(a), vmin);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(b), vmax);
+      UpdateMinMax(minValue, maxValue, a, b, 16);
+    }
+
+    return x;
+  }
+
+  ORTHANC_AVX2_FUNCTION
+  static unsigned int GetMinMaxRowAVX2(int16_t& minValue,
+                                       int16_t& maxValue,
+                                       const int16_t* p,
+                                       unsigned int width)
+  {
+    unsigned int x = 0;
+
+    if (width >= 16)
+    {
+      __m256i vmin = _mm256_set1_epi16(minValue);
+      __m256i vmax = _mm256_set1_epi16(maxValue);
+
+      for (; x + 16 <= width; x += 16)
+      {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + x));
+        vmin = _mm256_min_epi16(vmin, v);
+        vmax = _mm256_max_epi16(vmax, v);
+      }
+
+      int16_t a[16], b[16];
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(a), vmin);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(b), vmax);
+      UpdateMinMax(minValue, maxValue, a, b, 16);
+    }
+
+    return x;
+  }
+
+
+  template <typename PixelType>
+  ORTHANC_AVX2_FUNCTION
+  static unsigned int ShiftScaleRowAVX2(PixelType* p,
+                                        unsigned int width,
+                                        float offset,
+                                        float scaling,
+                                        bool useRound)
+  {
+    const __m256 vOffset = _mm256_set1_ps(offset);
+    const __m256 vScaling = _mm256_set1_ps(scaling);
+    const __m256 vMin = _mm256_set1_ps(static_cast<float>(std::numeric_limits<PixelType>::min()));
+    const __m256 vMax = _mm256_set1_ps(static_cast<float>(std::numeric_limits<PixelType>::max()));
+    const __m256 vHalf = _mm256_set1_ps(0.5f);
+    const __m256 vMinusHalf = _mm256_set1_ps(-0.5f);
+
+    unsigned int x = 0;
+
+    for (; x + 8 <= width; x += 8)
+    {
+      __m256i v;
+
+      // Load 8 pixels as 32-bit integers
+      if (sizeof(PixelType) == 1)
+      {
+        v = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + x)));
+      }
+      else if (std::numeric_limits<PixelType>::is_signed)
+      {
+        v = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + x)));
+      }
+      else
+      {
+        v = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + x)));
+      }
+
+      __m256 f = _mm256_mul_ps(_mm256_add_ps(_mm256_cvtepi32_ps(v), vOffset), vScaling);
+      f = _mm256_min_ps(_mm256_max_ps(f, vMin), vMax);
+
+      v = _mm256_cvttps_epi32(f);
+
+      if (useRound)
+      {
+        __m256 fraction = _mm256_sub_ps(f, _mm256_cvtepi32_ps(v));
+        v = _mm256_sub_epi32(v, _mm256_castps_si256(_mm256_cmp_ps(fraction, vHalf, _CMP_GE_OQ)));
+        v = _mm256_add_epi32(v, _mm256_castps_si256(_mm256_cmp_ps(fraction, vMinusHalf, _CMP_LE_OQ)));
+      }
+
+      // Store the 8 pixels
+      __m128i lo = _mm256_castsi256_si128(v);
+      __m128i hi = _mm256_extracti128_si256(v, 1);
+
+      if (sizeof(PixelType) == 1)
+      {
+        __m128i w = _mm_packs_epi32(lo, hi);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(p + x), _mm_packus_epi16(w, w));
+      }
+      else if (std::numeric_limits<PixelType>::is_signed)
+      {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p + x), _mm_packs_epi32(lo, hi));
+      }
+      else
+      {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p + x), _mm_packus_epi32(lo, hi));
+      }
+    }
+
+    return x;
+  }
+#endif
+
+
+#if ORTHANC_HAS_SSE2 == 1
+  template <typename PixelType>
+  static unsigned int GetMinMaxRowDispatch(PixelType& minValue,
+                                           PixelType& maxValue,
+                                           const PixelType* p,
+                                           unsigned int width)
+  {
+    switch (GetSimdLevel())
+    {
+#if ORTHANC_HAS_AVX2 == 1
+      case SimdLevel_AVX2:
+        return GetMinMaxRowAVX2(minValue, maxValue, p, width);
+#endif
+
+      case SimdLevel_SSE2:
+        return GetMinMaxRowSSE2(minValue, maxValue, p, width);
+
+      default:
+        return 0;
+    }
+  }
+
+  template <>
+  unsigned int GetMinMaxRowSimd<uint8_t>(uint8_t& minValue,
+                                         uint8_t& maxValue,
+                                         const uint8_t* p,
+                                         unsigned int width)
+  {
+    return GetMinMaxRowDispatch(minValue, maxValue, p, width);
+  }
+
+  template <>
+  unsigned int GetMinMaxRowSimd<uint16_t>(uint16_t& minValue,
+                                          uint16_t& maxValue,
+                                          const uint16_t* p,
+                                          unsigned int width)
+  {
+    return GetMinMaxRowDispatch(minValue, maxValue, p, width);
+  }
+
+  template <>
+  unsigned int GetMinMaxRowSimd<int16_t>(int16_t& minValue,
+                                         int16_t& maxValue,
+                                         const int16_t* p,
+                                         unsigned int width)
+  {
+    return GetMinMaxRowDispatch(minValue, maxValue, p, width);
+  }
+
+
+  template <typename PixelType>
+  static unsigned int ShiftScaleRowDispatch(PixelType* p,
+                                            unsigned int width,
+                                            float offset,
+                                            float scaling,
+                                            bool useRound)
+  {
+    switch (GetSimdLevel())
+    {
+#if ORTHANC_HAS_AVX2 == 1
+      case SimdLevel_AVX2:
+        return ShiftScaleRowAVX2<PixelType>(p, width, offset, scaling, useRound);
+#endif
+
+      case SimdLevel_SSE2:
+        return ShiftScaleRowSSE2<PixelType>(p, width, offset, scaling, useRound);
+
+      default:
+        return 0;
+    }
+  }
+
+  template <>
+  unsigned int ShiftScaleRowSimd<uint8_t>(uint8_t* p,
+                                          unsigned int width,
+                                          float offset,
+                                          float scaling,
+                                          bool useRound)
+  {
+    return ShiftScaleRowDispatch(p, width, offset, scaling, useRound);
+  }
+
+  template <>
+  unsigned int ShiftScaleRowSimd<uint16_t>(uint16_t* p,
+                                           unsigned int width,
+                                           float offset,
+                                           float scaling,
+                                           bool useRound)
+  {
+    return ShiftScaleRowDispatch(p, width, offset, scaling, useRound);
+  }
+
+  template <>
+  unsigned int ShiftScaleRowSimd<int16_t>(int16_t* p,
+                                          unsigned int width,
+                                          float offset,
+                                          float scaling,
+                                          bool useRound)
+  {
+    return ShiftScaleRowDispatch(p, width, offset, scaling, useRound);
+  }
+#endif
+
+
+  static unsigned int InvertRowSimd(uint8_t* p,
+                                    unsigned int width)
+  {
+#if ORTHANC_HAS_SSE2 == 1
+    if (GetSimdLevel() != SimdLevel_None)
+    {
+      return InvertRowSSE2(p, width);
+    }
+#else
+    (void) p;
+    (void) width;
+#endif
+
+    return 0;
+  }
+
+
   template <typename TargetType, typename SourceType>
   static void ConvertInternal(ImageAccessor& target,
                               const ImageAccessor& source)
   {
     const TargetType minValue = std::numeric_limits<TargetType>::min();
     const TargetType maxValue = std::numeric_limits<TargetType>::max();
+    const unsigned int width = source.GetWidth();
 
     for (unsigned int y = 0; y < source.GetHeight(); y++)
     {
       TargetType* t = reinterpret_cast<TargetType*>(target.GetRow(y));
       const SourceType* s = reinterpret_cast<const SourceType*>(source.GetConstRow(y));
 
-      for (unsigned int x = 0; x < source.GetWidth(); x++, t++, s++)
+      unsigned int x = ConvertRowSimd<TargetType, SourceType>(t, s, width);
+      t += x;
+      s += x;
+
+      for (; x < width; x++, t++, s++)
       {
         if (static_cast<int32_t>(*s) < static_cast<int32_t>(minValue))
         {
@@ -172,7 +928,10 @@ namespace Orthanc
     {
       const PixelType* p = reinterpret_cast<const PixelType*>(source.GetConstRow(y));
 
-      for (unsigned int x = 0; x < width; x++, p++)
+      unsigned int x = GetMinMaxRowSimd(minValue, maxValue, p, width);
+      p += x;
+
+      for (; x < width; x++, p++)
       {
         if (*p < minValue)
         {
@@ -293,7 +1052,10 @@ namespace Orthanc
     {
       PixelType* p = reinterpret_cast<PixelType*>(image.GetRow(y));
 
-      for (unsigned int x = 0; x < width; x++, p++)
+      unsigned int x = ShiftScaleRowSimd(p, width, offset, scaling, UseRound);
+      p += x;
+
+      for (; x < width; x++, p++)
       {
         float v = (static_cast<float>(*p) + offset) * scaling;
 
@@ -319,6 +1081,214 @@ namespace Orthanc
   }
 
 
+  namespace
+  {
+    // For each pixel of the target, range "[start, end)" of the source
+    // pixels that are averaged by the box filter along one axis
+    class BoxFilterRanges : public boost::noncopyable
+    {
+    private:
+      std::vector<unsigned int>  start_;
+      std::vector<unsigned int>  end_;
+
+    public:
+      BoxFilterRanges(unsigned int sourceSize,
+                      unsigned int targetSize) :
+        start_(targetSize),
+        end_(targetSize)
+      {
+        assert(sourceSize > 0);
+
+        for (unsigned int i = 0; i < targetSize; i++)
+        {
+          start_[i] = static_cast<unsigned int>(static_cast<uint64_t>(i) * sourceSize / targetSize);
+          end_[i] = static_cast<unsigned int>(static_cast<uint64_t>(i + 1) * sourceSize / targetSize);
+
+          if (end_[i] <= start_[i])
+          {
+            // Upscaling: Nearest neighbor
+            end_[i] = start_[i] + 1;
+          }
+        }
+      }
+
+      unsigned int GetStart(unsigned int i) const
+      {
+        return start_[i];
+      }
+
+      unsigned int GetEnd(unsigned int i) const
+      {
+        return end_[i];
+      }
+    };
+
+
+    class IdentityLookup
+    {
+    public:
+      uint8_t operator() (uint8_t value) const
+      {
+        return value;
+      }
+    };
+
+
+    template <typename SourceType>
+    class TableLookup
+    {
+    private:
+      const std::vector<uint8_t>&  table_;
+
+    public:
+      TableLookup(const std::vector<uint8_t>& table) :
+        table_(table)
+      {
+        assert(table_.size() == static_cast<size_t>(std::numeric_limits<SourceType>::max()) -
+               static_cast<size_t>(std::numeric_limits<SourceType>::min()) + 1);
+      }
+
+      uint8_t operator() (SourceType value) const
+      {
+        return table_[static_cast<int32_t>(value) -
+                      static_cast<int32_t>(std::numeric_limits<SourceType>::min())];
+      }
+    };
+  }
+
+
+  /**
+   * Box filter (i.e. average of the area of the source that is
+   * covered by each target pixel), whose source pixels are mapped to
+   * 8-bit values through "lookup" before being averaged. Each source
+   * pixel is read only once.
+   **/
+  template <typename SourceType,
+            unsigned int Channels,
+            typename Lookup>
+  static void ResizeInternal(ImageAccessor& target,
+                             const ImageAccessor& source,
+                             const Lookup& lookup)
+  {
+    const unsigned int width = target.GetWidth();
+    const BoxFilterRanges columns(source.GetWidth(), width);
+    const BoxFilterRanges rows(source.GetHeight(), target.GetHeight());
+
+    std::vector<uint64_t> sums(width * Channels);
+
+    for (unsigned int y = 0; y < target.GetHeight(); y++)
+    {
+      std::fill(sums.begin(), sums.end(), 0);
+
+      for (unsigned int sy = rows.GetStart(y); sy < rows.GetEnd(y); sy++)
+      {
+        const SourceType* s = reinterpret_cast<const SourceType*>(source.GetConstRow(sy));
+
+        for (unsigned int x = 0; x < width; x++)
+        {
+          uint64_t* sum = &sums[x * Channels];
+
+          for (unsigned int sx = columns.GetStart(x); sx < columns.GetEnd(x); sx++)
+          {
+            for (unsigned int c = 0; c < Channels; c++)
+            {
+              sum[c] += lookup(s[sx * Channels + c]);
+            }
+          }
+        }
+      }
+
+      uint8_t* t = reinterpret_cast<uint8_t*>(target.GetRow(y));
+      const uint64_t height = rows.GetEnd(y) - rows.GetStart(y);
+
+      for (unsigned int x = 0; x < width; x++)
+      {
+        const uint64_t count = height * (columns.GetEnd(x) - columns.GetStart(x));
+
+        for (unsigned int c = 0; c < Channels; c++, t++)
+        {
+          *t = static_cast<uint8_t>((sums[x * Channels + c] + count / 2) / count);
+        }
+      }
+    }
+  }
+
+
+  template <typename SourceType>
+  static void ApplyWindowingInternal(ImageAccessor& target,
+                                     const ImageAccessor& source,
+                                     float windowCenter,
+                                     float windowWidth,
+                                     float rescaleSlope,
+                                     float rescaleIntercept,
+                                     bool invert)
+  {
+    // Linear VOI LUT function of DICOM (PS 3.3, C.11.2.1.2), computed
+    // once for all the possible values of the source pixels
+    const int32_t minValue = std::numeric_limits<SourceType>::min();
+    const int32_t maxValue = std::numeric_limits<SourceType>::max();
+
+    const float center = windowCenter - 0.5f;
+    const float width = windowWidth - 1.0f;
+    const float low = center - width / 2.0f;
+    const float high = center + width / 2.0f;
+
+    std::vector<uint8_t> table(maxValue - minValue + 1);
+
+    for (int32_t i = minValue; i <= maxValue; i++)
+    {
+      const float x = static_cast<float>(i) * rescaleSlope + rescaleIntercept;
+
+      uint8_t y;
+      if (x <= low)
+      {
+        y = 0;
+      }
+      else if (x > high)
+      {
+        y = 255;
+      }
+      else
+      {
+        int v = boost::math::iround(((x - center) / width + 0.5f) * 255.0f);
+        y = static_cast<uint8_t>(std::max(0, std::min(255, v)));
+      }
+
+      table[i - minValue] = (invert ? 255 - y : y);
+    }
+
+    ResizeInternal<SourceType, 1>(target, source, TableLookup<SourceType>(table));
+  }
+
+
+  void ImageProcessing::SetSimdEnabled(bool enabled)
+  {
+    simdEnabled_ = enabled;
+  }
+
+
+  bool ImageProcessing::IsSimdEnabled()
+  {
+    return GetSimdLevel() != SimdLevel_None;
+  }
+
+
+  const char* ImageProcessing::GetSimdInstructionSet()
+  {
+    switch (GetSimdLevel())
+    {
+      case SimdLevel_SSE2:
+        return "SSE2";
+
+      case SimdLevel_AVX2:
+        return "AVX2";
+
+      default:
+        return "none";
+    }
+  }
+
+
   void ImageProcessing::Copy(ImageAccessor& target,
                              const ImageAccessor& source)
   {
@@ -1004,7 +1974,10 @@ namespace Orthanc
         {
           uint8_t* p = reinterpret_cast<uint8_t*>(image.GetRow(y));
 
-          for (unsigned int x = 0; x < image.GetWidth(); x++, p++)
+          unsigned int x = InvertRowSimd(p, image.GetWidth());
+          p += x;
+
+          for (; x < image.GetWidth(); x++, p++)
           {
             *p = 255 - (*p);
           }
@@ -1019,6 +1992,97 @@ namespace Orthanc
   }
 
 
+  void ImageProcessing::Resize(ImageAccessor& target,
+                               const ImageAccessor& source)
+  {
+    if (target.GetFormat() != source.GetFormat())
+    {
+      throw OrthancException(ErrorCode_IncompatibleImageFormat);
+    }
+
+    if (target.GetWidth() == 0 ||
+        target.GetHeight() == 0)
+    {
+      return;
+    }
+
+    if (source.GetWidth() == 0 ||
+        source.GetHeight() == 0)
+    {
+      throw OrthancException(ErrorCode_IncompatibleImageSize);
+    }
+
+    switch (source.GetFormat())
+    {
+      case PixelFormat_Grayscale8:
+        ResizeInternal<uint8_t, 1>(target, source, IdentityLookup());
+        break;
+
+      case PixelFormat_RGB24:
+        ResizeInternal<uint8_t, 3>(target, source, IdentityLookup());
+        break;
+
+      default:
+        throw OrthancException(ErrorCode_NotImplemented);
+    }
+  }
+
+
+  void ImageProcessing::ApplyWindowing(ImageAccessor& target,
+                                       const ImageAccessor& source,
+                                       float windowCenter,
+                                       float windowWidth,
+                                       float rescaleSlope,
+                                       float rescaleIntercept,
+                                       bool invert)
+  {
+    if (target.GetFormat() != PixelFormat_Grayscale8)
+    {
+      throw OrthancException(ErrorCode_IncompatibleImageFormat);
+    }
+
+    if (windowWidth < 1.0f)
+    {
+      // Forbidden by the DICOM standard
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    if (target.GetWidth() == 0 ||
+        target.GetHeight() == 0)
+    {
+      return;
+    }
+
+    if (source.GetWidth() == 0 ||
+        source.GetHeight() == 0)
+    {
+      throw OrthancException(ErrorCode_IncompatibleImageSize);
+    }
+
+    switch (source.GetFormat())
+    {
+      case PixelFormat_Grayscale8:
+        ApplyWindowingInternal<uint8_t>(target, source, windowCenter, windowWidth,
+                                        rescaleSlope, rescaleIntercept, invert);
+        break;
+
+      case PixelFormat_Grayscale16:
+        ApplyWindowingInternal<uint16_t>(target, source, windowCenter, windowWidth,
+                                         rescaleSlope, rescaleIntercept, invert);
+        break;
+
+      case PixelFormat_SignedGrayscale16:
+        ApplyWindowingInternal<int16_t>(target, source, windowCenter, windowWidth,
+                                        rescaleSlope, rescaleIntercept, invert);
+        break;
+
+      default:
+        throw OrthancException(ErrorCode_NotImplemented);
+    }
+  }
+
+
+
 
   namespace
   {
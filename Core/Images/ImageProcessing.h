@@ -41,6 +41,15 @@ namespace Orthanc
 {
   namespace ImageProcessing
   {
+    // The SIMD kernels (SSE2 or AVX2, depending on the CPU) are used
+    // by default. Disabling them is only meant for benchmarks and
+    // tests, as both implementations give the same results.
+    void SetSimdEnabled(bool enabled);
+
+    bool IsSimdEnabled();
+
+    const char* GetSimdInstructionSet();
+
     void Copy(ImageAccessor& target,
               const ImageAccessor& source);
 
@@ -83,6 +92,23 @@ namespace Orthanc
 
     void Invert(ImageAccessor& image);
 
+    // Box filter (area averaging), adapted to the creation of
+    // thumbnails. The target must have the same format as the source
+    // (only Grayscale8 and RGB24 are supported).
+    void Resize(ImageAccessor& target,
+                const ImageAccessor& source);
+
+    // Applies the rescale slope/intercept and the linear windowing of
+    // DICOM to a grayscale image, and resizes it to the size of the
+    // Grayscale8 target, in one single pass over the source
+    void ApplyWindowing(ImageAccessor& target,
+                        const ImageAccessor& source,
+                        float windowCenter,
+                        float windowWidth,
+                        float rescaleSlope,
+                        float rescaleIntercept,
+                        bool invert);
+
     void DrawLineSegment(ImageAccessor& image,
                          int x0,
                          int y0,
@@ -576,6 +576,21 @@ namespace Orthanc
   }
 
 
+  void JobsRegistry::GetStatistics(std::map<JobState, unsigned int>& target)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    CheckInvariants();
+
+    target.clear();
+
+    for (JobsIndex::const_iterator it = jobsIndex_.begin();
+         it != jobsIndex_.end(); ++it)
+    {
+      target[it->second->GetState()] += 1;
+    }
+  }
+
+
   bool JobsRegistry::GetJobInfo(JobInfo& target,
                                 const std::string& id)
   {
@@ -149,6 +149,9 @@ namespace Orthanc
     
     void ListJobs(std::set<std::string>& target);
 
+    // Counts the jobs in each state
+    void GetStatistics(std::map<JobState, unsigned int>& target);
+
     bool GetJobInfo(JobInfo& target,
                     const std::string& id);
 
@@ -34,18 +34,192 @@
 #include "../PrecompiledHeaders.h"
 #include "SetOfInstancesJob.h"
 
+#include "../Logging.h"
 #include "../OrthancException.h"
 #include "../SerializationToolbox.h"
 
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <cassert>
+#include <list>
+
 namespace Orthanc
 {
+  struct SetOfInstancesJob::LaneOutcome
+  {
+    enum Status
+    {
+      Status_Success,
+      Status_Failure,
+      Status_Exception
+    };
+
+    size_t      index_;
+    Status      status_;
+    ErrorCode   errorCode_;
+    HttpStatus  httpStatus_;
+
+    LaneOutcome() :
+      index_(0),
+      status_(Status_Exception),
+      errorCode_(ErrorCode_InternalError),
+      httpStatus_(HttpStatus_500_InternalServerError)
+    {
+    }
+  };
+
+
+  /**
+   * Long-lived worker threads, one per lane, that are started by the
+   * first step of a parallelizable job. Each lane walks its own
+   * subset of the pending instances (lane "k" handling the pending
+   * instances "k", "k + lanesCount", "k + 2 * lanesCount"...), without
+   * waiting for the other lanes. The outcomes are queued, and merged
+   * by "ExecuteParallelStep()" in the worker thread of the jobs engine.
+   **/
+  class SetOfInstancesJob::Lanes : public boost::noncopyable
+  {
+  private:
+    SetOfInstancesJob&           job_;
+    boost::mutex                 mutex_;
+    boost::condition_variable    outcomeAvailable_;
+    bool                         stopping_;
+    size_t                       activeLanes_;
+    std::list<LaneOutcome>       outcomes_;
+    std::vector<boost::thread*>  threads_;
+
+    void Worker(size_t lane,
+                const std::vector<size_t>& indices)
+    {
+      for (size_t i = 0; i < indices.size(); i++)
+      {
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          if (stopping_)
+          {
+            break;
+          }
+        }
+
+        LaneOutcome outcome;
+        outcome.index_ = indices[i];
+
+        // "ProcessLane()" catches all the exceptions
+        job_.ProcessLane(outcome, lane, job_.instances_[indices[i]]);
+
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          outcomes_.push_back(outcome);
+        }
+
+        outcomeAvailable_.notify_one();
+      }
+
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        assert(activeLanes_ > 0);
+        activeLanes_ --;
+      }
+
+      outcomeAvailable_.notify_one();
+    }
+
+  public:
+    Lanes(SetOfInstancesJob& job,
+          const std::vector<size_t>& pending,
+          size_t lanesCount) :
+      job_(job),
+      stopping_(false),
+      activeLanes_(0)
+    {
+      assert(lanesCount > 0);
+
+      const size_t count = std::min(lanesCount, pending.size());
+      activeLanes_ = count;
+
+      for (size_t lane = 0; lane < count; lane++)
+      {
+        std::vector<size_t> indices;
+        indices.reserve(pending.size() / count + 1);
+
+        for (size_t i = lane; i < pending.size(); i += count)
+        {
+          indices.push_back(pending[i]);
+        }
+
+        threads_.push_back(new boost::thread(boost::bind(&Lanes::Worker, this, lane, indices)));
+      }
+    }
+
+    ~Lanes()
+    {
+      Stop();
+    }
+
+    void Stop()
+    {
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        stopping_ = true;
+      }
+
+      // The lanes complete the instance they are handling
+      for (size_t i = 0; i < threads_.size(); i++)
+      {
+        if (threads_[i]->joinable())
+        {
+          threads_[i]->join();
+        }
+
+        delete threads_[i];
+      }
+
+      threads_.clear();
+    }
+
+    // Blocks until at least one outcome is available, or until all
+    // the lanes are over. Returns "false" in the latter case.
+    bool WaitOutcomes(std::list<LaneOutcome>& target)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      while (outcomes_.empty() &&
+             activeLanes_ > 0)
+      {
+        outcomeAvailable_.wait(lock);
+      }
+
+      target.clear();
+      target.swap(outcomes_);
+
+      return !target.empty();
+    }
+  };
+
+
   SetOfInstancesJob::SetOfInstancesJob() :
     started_(false),
     permissive_(false),
-    position_(0)
+    position_(0),
+    lanesCount_(1)
   {
   }
 
+
+  SetOfInstancesJob::~SetOfInstancesJob()
+  {
+    // Safety net, as the subclass is already destroyed at this point
+    StopLanes();
+  }
+
+
+  void SetOfInstancesJob::StopLanes()
+  {
+    // The outcomes that are not merged yet are lost, and the
+    // corresponding instances will be handled again
+    lanes_.reset(NULL);
+  }
+
     
   void SetOfInstancesJob::Reserve(size_t size)
   {
@@ -86,12 +260,223 @@ namespace Orthanc
   }
 
 
+  void SetOfInstancesJob::SetLanesCount(size_t count)
+  {
+    if (IsStarted())
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+    else if (count == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+    else
+    {
+      lanesCount_ = count;
+    }
+  }
+
+
+  bool SetOfInstancesJob::HandleInstanceInLane(size_t lane,
+                                               const std::string& instance)
+  {
+    // Only reached if a subclass declares itself as parallelizable
+    // without providing the lane-aware handler
+    throw OrthancException(ErrorCode_NotImplemented);
+  }
+
+
+  void SetOfInstancesJob::ProcessLane(LaneOutcome& outcome,
+                                      size_t lane,
+                                      const std::string& instance)
+  {
+    // This method runs in the thread of the lane: No exception must
+    // escape from it
+    try
+    {
+      outcome.status_ = (HandleInstanceInLane(lane, instance) ?
+                         LaneOutcome::Status_Success :
+                         LaneOutcome::Status_Failure);
+    }
+    catch (OrthancException& e)
+    {
+      outcome.status_ = LaneOutcome::Status_Exception;
+      outcome.errorCode_ = e.GetErrorCode();
+      outcome.httpStatus_ = e.GetHttpStatus();
+    }
+    catch (std::bad_alloc&)
+    {
+      outcome.status_ = LaneOutcome::Status_Exception;
+      outcome.errorCode_ = ErrorCode_NotEnoughMemory;
+      outcome.httpStatus_ = HttpStatus_500_InternalServerError;
+    }
+    catch (...)
+    {
+      LOG(ERROR) << "Native exception while handling instance " << instance
+                 << " in lane " << lane;
+      outcome.status_ = LaneOutcome::Status_Exception;
+      outcome.errorCode_ = ErrorCode_InternalError;
+      outcome.httpStatus_ = HttpStatus_500_InternalServerError;
+    }
+  }
+
+
+  JobStepResult SetOfInstancesJob::GetStepResult() const
+  {
+    if (position_ == instances_.size() &&
+        !HasTrailingStep())
+    {
+      // We're done
+      return JobStepResult::Success();
+    }
+    else
+    {
+      return JobStepResult::Continue();
+    }
+  }
+
+
+  JobStepResult SetOfInstancesJob::ExecuteTrailingStep()
+  {
+    assert(position_ == instances_.size() &&
+           HasTrailingStep());
+
+    bool ok;
+
+    try
+    {
+      ok = HandleTrailingStep();
+    }
+    catch (OrthancException&)
+    {
+      if (permissive_)
+      {
+        ok = false;
+      }
+      else
+      {
+        throw;
+      }
+    }
+
+    if (!ok && !permissive_)
+    {
+      return JobStepResult::Failure(ErrorCode_InternalError);
+    }
+
+    position_ += 1;
+    return JobStepResult::Success();
+  }
+
+
+  bool SetOfInstancesJob::HandleTrailingStep()
+  {
+    // Only reached if a subclass declares a trailing step without
+    // providing its handler
+    throw OrthancException(ErrorCode_NotImplemented);
+  }
+
+
+  JobStepResult SetOfInstancesJob::ExecuteParallelStep()
+  {
+    assert(position_ < instances_.size() &&
+           lanesCount_ > 1);
+
+    if (lanes_.get() == NULL)
+    {
+      // Start the lanes over the instances that have not been
+      // handled yet. The lanes live until all these instances are
+      // handled, or until the job is paused, canceled or resubmitted.
+      handled_.resize(instances_.size(), false);
+
+      std::vector<size_t> pending;
+      pending.reserve(instances_.size() - position_);
+
+      for (size_t i = position_; i < instances_.size(); i++)
+      {
+        if (!handled_[i])
+        {
+          pending.push_back(i);
+        }
+      }
+
+      lanes_.reset(new Lanes(*this, pending, lanesCount_));
+    }
+
+    std::list<LaneOutcome> outcomes;
+    if (!lanes_->WaitOutcomes(outcomes))
+    {
+      // All the lanes are over, but some instance was not handled
+      StopLanes();
+      throw OrthancException(ErrorCode_InternalError);
+    }
+
+    const LaneOutcome* failure = NULL;
+
+    for (std::list<LaneOutcome>::const_iterator
+           it = outcomes.begin(); it != outcomes.end(); ++it)
+    {
+      assert(it->index_ < instances_.size());
+      const std::string& instance = instances_[it->index_];
+
+      if (it->status_ == LaneOutcome::Status_Success)
+      {
+        handled_[it->index_] = true;
+      }
+      else if (permissive_)
+      {
+        LOG(WARNING) << "Cannot handle instance " << instance
+                     << ", going on as the job is permissive";
+        failedInstances_.insert(instance);
+        handled_[it->index_] = true;
+      }
+      else if (failure == NULL ||
+               it->index_ < failure->index_)
+      {
+        failure = &(*it);
+      }
+    }
+
+    // "position_" always designates the first instance that has not
+    // been handled yet, which keeps the serialization of the job
+    // resumable (the instances that follow it and that were already
+    // handled by other lanes will be handled again)
+    while (position_ < instances_.size() &&
+           handled_[position_])
+    {
+      position_ += 1;
+    }
+
+    if (failure != NULL)
+    {
+      LOG(ERROR) << "Cannot handle instance " << instances_[failure->index_]
+                 << ", stopping the job";
+      StopLanes();
+
+      return JobStepResult::Failure(failure->status_ == LaneOutcome::Status_Exception ?
+                                    failure->errorCode_ : ErrorCode_InternalError);
+    }
+
+    if (position_ == instances_.size())
+    {
+      StopLanes();
+    }
+
+    return GetStepResult();
+  }
+
+
   void SetOfInstancesJob::SignalResubmit()
   {
     if (started_)
     {
+      StopLanes();
       position_ = 0;
       failedInstances_.clear();
+      handled_.clear();
+
+      boost::mutex::scoped_lock lock(signaledFailuresMutex_);
+      signaledFailures_.clear();
     }
     else
     {
@@ -108,8 +493,26 @@ namespace Orthanc
     }
     else
     {
-      return (static_cast<float>(position_) /
-              static_cast<float>(instances_.size()));
+      size_t count = instances_.size();
+      
+      if (HasTrailingStep())
+      {
+        count += 1;
+      }
+
+      // Take into account the instances that were handled by the
+      // lanes after the current position
+      size_t done = position_;
+      for (size_t i = position_; i < handled_.size(); i++)
+      {
+        if (handled_[i])
+        {
+          done += 1;
+        }
+      }
+
+      return (static_cast<float>(done) /
+              static_cast<float>(count));
     }
   }
 
@@ -127,7 +530,53 @@ namespace Orthanc
   }
       
 
+  void SetOfInstancesJob::SignalFailedInstance(const std::string& instance)
+  {
+    boost::mutex::scoped_lock lock(signaledFailuresMutex_);
+    signaledFailures_.push_back(instance);
+  }
+
+
+  bool SetOfInstancesJob::MergeSignaledFailures()
+  {
+    std::list<std::string> failures;
+
+    {
+      boost::mutex::scoped_lock lock(signaledFailuresMutex_);
+      failures.swap(signaledFailures_);
+    }
+
+    for (std::list<std::string>::const_iterator
+           it = failures.begin(); it != failures.end(); ++it)
+    {
+      LOG(WARNING) << "Instance " << *it << " has failed after being handled";
+      failedInstances_.insert(*it);
+    }
+
+    return (permissive_ || failures.empty());
+  }
+
+
   JobStepResult SetOfInstancesJob::ExecuteStep()
+  {
+    JobStepResult result = ExecuteStepInternal();
+
+    if (!MergeSignaledFailures() &&
+        result.GetCode() != JobStepCode_Failure)
+    {
+      // Non-permissive job: The failing instances are listed in
+      // "FailedInstances" for diagnosis
+      StopLanes();
+      return JobStepResult::Failure(ErrorCode_InternalError);
+    }
+    else
+    {
+      return result;
+    }
+  }
+
+
+  JobStepResult SetOfInstancesJob::ExecuteStepInternal()
   {
     if (!started_)
     {
@@ -142,12 +591,24 @@ namespace Orthanc
       return JobStepResult::Success();
     }
 
+    if (position_ == instances_.size() &&
+        HasTrailingStep())
+    {
+      return ExecuteTrailingStep();
+    }
+
     if (position_ >= instances_.size())
     {
       // Already done
       throw OrthancException(ErrorCode_BadSequenceOfCalls);
     }
 
+    if (lanesCount_ > 1 &&
+        IsParallelizable())
+    {
+      return ExecuteParallelStep();
+    }
+
     const std::string currentInstance = instances_[position_];
     
     bool ok;
@@ -180,15 +641,7 @@ namespace Orthanc
 
     position_ += 1;
 
-    if (position_ == instances_.size())
-    {
-      // We're done
-      return JobStepResult::Success();
-    }
-    else
-    {
-      return JobStepResult::Continue();
-    }
+    return GetStepResult();
   }
 
     
@@ -211,6 +664,7 @@ namespace Orthanc
     value["Permissive"] = permissive_;
     value["Position"] = static_cast<unsigned int>(position_);
     value["Description"] = description_;
+    value["LanesCount"] = static_cast<unsigned int>(lanesCount_);
 
     SerializationToolbox::WriteArrayOfStrings(value, instances_, "Instances");
     SerializationToolbox::WriteSetOfStrings(value, failedInstances_, "FailedInstances");
@@ -223,12 +677,25 @@ namespace Orthanc
     started_(false),
     permissive_(SerializationToolbox::ReadBoolean(value, "Permissive")),
     position_(SerializationToolbox::ReadUnsignedInteger(value, "Position")),
-    description_(SerializationToolbox::ReadString(value, "Description"))
+    description_(SerializationToolbox::ReadString(value, "Description")),
+    lanesCount_(1)
   {
+    if (value.isMember("LanesCount"))  // New in Orthanc 1.4.2
+    {
+      lanesCount_ = SerializationToolbox::ReadUnsignedInteger(value, "LanesCount");
+      
+      if (lanesCount_ == 0)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+    }
+
     SerializationToolbox::ReadArrayOfStrings(instances_, value, "Instances");
     SerializationToolbox::ReadSetOfStrings(failedInstances_, value, "FailedInstances");
 
-    if (position_ > instances_.size())
+    // The position is one past the last instance once the trailing
+    // step (if any) has been handled
+    if (position_ > instances_.size() + 1)
     {
       throw OrthancException(ErrorCode_BadFileFormat);
     }
@@ -35,7 +35,10 @@
 
 #include "IJob.h"
 
+#include <list>
+#include <memory>
 #include <set>
+#include <boost/thread/mutex.hpp>
 
 namespace Orthanc
 {
@@ -48,15 +51,75 @@ namespace Orthanc
     size_t                    position_;
     std::set<std::string>     failedInstances_;
     std::string               description_;
+    size_t                    lanesCount_;
+
+    struct LaneOutcome;
+    class Lanes;
+
+    std::vector<bool>         handled_;  // Instances handled by the lanes
+    std::auto_ptr<Lanes>      lanes_;
+
+    boost::mutex              signaledFailuresMutex_;
+    std::list<std::string>    signaledFailures_;
+
+    void ProcessLane(LaneOutcome& outcome,
+                     size_t lane,
+                     const std::string& instance);
+
+    JobStepResult ExecuteParallelStep();
+
+    JobStepResult ExecuteTrailingStep();
+
+    JobStepResult GetStepResult() const;
+
+    bool MergeSignaledFailures();
+
+    JobStepResult ExecuteStepInternal();
 
   protected:
     virtual bool HandleInstance(const std::string& instance) = 0;
 
+    // Waits for the threads of the lanes to stop. Parallelizable
+    // subclasses must call this method in their destructor and in
+    // "ReleaseResources()", before freeing the resources that are
+    // used by "HandleInstanceInLane()".
+    void StopLanes();
+
+    // Reports the failure of an instance that was previously
+    // considered as successfully handled, because its failure is only
+    // known asynchronously (e.g. pipelined C-STORE). The failure is
+    // taken into account by the next step of the job. Thread-safe.
+    void SignalFailedInstance(const std::string& instance);
+
+    // Subclasses whose "HandleInstanceInLane()" can be invoked
+    // concurrently from several threads (each with a distinct lane
+    // index) must override this method to return "true", and must
+    // call "StopLanes()" as explained above
+    virtual bool IsParallelizable() const
+    {
+      return false;
+    }
+
+    virtual bool HandleInstanceInLane(size_t lane,
+                                      const std::string& instance);
+
+    // If this method returns "true", "HandleTrailingStep()" is invoked
+    // once all the instances have been handled, before the job is
+    // reported as successful
+    virtual bool HasTrailingStep() const
+    {
+      return false;
+    }
+
+    virtual bool HandleTrailingStep();
+
   public:
     SetOfInstancesJob();
 
     SetOfInstancesJob(const Json::Value& s);  // Unserialization
 
+    virtual ~SetOfInstancesJob();
+
     size_t GetPosition() const
     {
       return position_;
@@ -88,6 +151,13 @@ namespace Orthanc
 
     void SetPermissive(bool permissive);
 
+    size_t GetLanesCount() const
+    {
+      return lanesCount_;
+    }
+
+    void SetLanesCount(size_t count);
+
     virtual void SignalResubmit();
     
     virtual void Start()
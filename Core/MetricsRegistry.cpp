@@ -0,0 +1,406 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "PrecompiledHeaders.h"
+#include "MetricsRegistry.h"
+
+#include "OrthancException.h"
+
+#include <cassert>
+#include <iomanip>
+#include <sstream>
+#include <boost/functional/hash.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+
+namespace Orthanc
+{
+  static const unsigned int SHARDS_COUNT = 16;
+
+  // Upper bounds of the buckets of the histograms, in seconds
+  static const double BUCKETS[] = {
+    0.00001, 0.00005, 0.0001, 0.0005, 0.001, 0.005,
+    0.01, 0.05, 0.1, 0.5, 1, 5, 10
+  };
+
+  static const size_t BUCKETS_COUNT = sizeof(BUCKETS) / sizeof(double);
+
+
+  struct MetricsRegistry::Histogram
+  {
+    uint64_t  buckets_[BUCKETS_COUNT + 1];  // The last bucket is "+Inf"
+    uint64_t  count_;
+    double    sum_;
+
+    Histogram() :
+      count_(0),
+      sum_(0)
+    {
+      for (size_t i = 0; i <= BUCKETS_COUNT; i++)
+      {
+        buckets_[i] = 0;
+      }
+    }
+
+    void Observe(double seconds)
+    {
+      size_t i = 0;
+      while (i < BUCKETS_COUNT &&
+             seconds > BUCKETS[i])
+      {
+        i++;
+      }
+
+      buckets_[i]++;
+      count_++;
+      sum_ += seconds;
+    }
+
+    void Merge(const Histogram& other)
+    {
+      for (size_t i = 0; i <= BUCKETS_COUNT; i++)
+      {
+        buckets_[i] += other.buckets_[i];
+      }
+
+      count_ += other.count_;
+      sum_ += other.sum_;
+    }
+  };
+
+
+  class MetricsRegistry::Shard : public boost::noncopyable
+  {
+  public:
+    // The names are string literals: They are compared by address
+    // on the hot path, and by value when the shards are merged
+    typedef std::pair<const char*, std::string>  Key;
+
+    boost::mutex                  mutex_;
+    std::map<Key, uint64_t>       counters_;
+    std::map<Key, Histogram>      histograms_;
+  };
+
+
+  MetricsRegistry::Shard& MetricsRegistry::GetShard()
+  {
+    size_t hash = boost::hash<boost::thread::id>()(boost::this_thread::get_id());
+    return *shards_[hash % shards_.size()];
+  }
+
+
+  MetricsRegistry::Timer::Timer(MetricsRegistry& registry,
+                                const char* name) :
+    registry_(registry),
+    name_(name),
+    active_(registry.IsEnabled())
+  {
+    if (active_)
+    {
+      start_ = boost::posix_time::microsec_clock::universal_time();
+    }
+  }
+
+
+  MetricsRegistry::Timer::Timer(MetricsRegistry& registry,
+                                const char* name,
+                                const std::string& labels) :
+    registry_(registry),
+    name_(name),
+    labels_(labels),
+    active_(registry.IsEnabled())
+  {
+    if (active_)
+    {
+      start_ = boost::posix_time::microsec_clock::universal_time();
+    }
+  }
+
+
+  MetricsRegistry::Timer::~Timer()
+  {
+    if (active_)
+    {
+      try
+      {
+        registry_.ObserveDuration(name_, labels_, boost::posix_time::microsec_clock::universal_time() - start_);
+      }
+      catch (...)
+      {
+        // Never throw in a destructor
+      }
+    }
+  }
+
+
+  void MetricsRegistry::Timer::Restart(const char* name)
+  {
+    if (active_)
+    {
+      boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+      registry_.ObserveDuration(name_, labels_, now - start_);
+      start_ = now;
+    }
+
+    name_ = name;
+  }
+
+
+  MetricsRegistry::MetricsRegistry() :
+    enabled_(true)
+  {
+    shards_.resize(SHARDS_COUNT);
+    for (size_t i = 0; i < shards_.size(); i++)
+    {
+      shards_[i] = new Shard;
+    }
+  }
+
+
+  MetricsRegistry::~MetricsRegistry()
+  {
+    for (size_t i = 0; i < shards_.size(); i++)
+    {
+      assert(shards_[i] != NULL);
+      delete shards_[i];
+    }
+  }
+
+
+  void MetricsRegistry::IncrementCounter(const char* name,
+                                         const std::string& labels,
+                                         uint64_t delta)
+  {
+    if (enabled_)
+    {
+      Shard& shard = GetShard();
+      boost::mutex::scoped_lock lock(shard.mutex_);
+      shard.counters_[Shard::Key(name, labels)] += delta;
+    }
+  }
+
+
+  void MetricsRegistry::ObserveDuration(const char* name,
+                                        const std::string& labels,
+                                        const boost::posix_time::time_duration& duration)
+  {
+    if (enabled_)
+    {
+      const double seconds = static_cast<double>(duration.total_microseconds()) / 1000000.0;
+
+      Shard& shard = GetShard();
+      boost::mutex::scoped_lock lock(shard.mutex_);
+      shard.histograms_[Shard::Key(name, labels)].Observe(seconds);
+    }
+  }
+
+
+  void MetricsRegistry::SetGauge(const std::string& name,
+                                 const std::string& labels,
+                                 double value)
+  {
+    boost::mutex::scoped_lock lock(gaugesMutex_);
+    gauges_[SeriesKey(name, labels)] = value;
+  }
+
+
+  void MetricsRegistry::SetCounter(const std::string& name,
+                                   const std::string& labels,
+                                   uint64_t value)
+  {
+    boost::mutex::scoped_lock lock(gaugesMutex_);
+    externalCounters_[SeriesKey(name, labels)] = value;
+  }
+
+
+  static std::string FormatValue(double value)
+  {
+    // "boost::lexical_cast<std::string>()" would print all the
+    // digits, e.g. "5.0000000000000002e-05"
+    std::ostringstream s;
+    s << std::setprecision(12) << value;
+    return s.str();
+  }
+
+
+  static void FormatSeries(std::string& target,
+                           const std::string& name,
+                           const std::string& labels,
+                           const std::string& extraLabel,
+                           const std::string& value)
+  {
+    target += name;
+
+    if (!labels.empty() ||
+        !extraLabel.empty())
+    {
+      target += "{" + labels;
+
+      if (!labels.empty() &&
+          !extraLabel.empty())
+      {
+        target += ",";
+      }
+
+      target += extraLabel + "}";
+    }
+
+    target += " " + value + "\n";
+  }
+
+
+  static void FormatType(std::string& target,
+                         std::string& lastName,
+                         const std::string& name,
+                         const char* type)
+  {
+    if (name != lastName)
+    {
+      target += "# TYPE " + name + " " + type + "\n";
+      lastName = name;
+    }
+  }
+
+
+  void MetricsRegistry::ExportPrometheusText(std::string& target)
+  {
+    std::map<SeriesKey, uint64_t> counters;
+    std::map<SeriesKey, Histogram> histograms;
+
+    for (size_t i = 0; i < shards_.size(); i++)
+    {
+      boost::mutex::scoped_lock lock(shards_[i]->mutex_);
+
+      for (std::map<Shard::Key, uint64_t>::const_iterator
+             it = shards_[i]->counters_.begin(); it != shards_[i]->counters_.end(); ++it)
+      {
+        counters[SeriesKey(it->first.first, it->first.second)] += it->second;
+      }
+
+      for (std::map<Shard::Key, Histogram>::const_iterator
+             it = shards_[i]->histograms_.begin(); it != shards_[i]->histograms_.end(); ++it)
+      {
+        histograms[SeriesKey(it->first.first, it->first.second)].Merge(it->second);
+      }
+    }
+
+    {
+      // Merged with the other counters, so that all the series of one
+      // counter are grouped under the same "TYPE" line
+      boost::mutex::scoped_lock lock(gaugesMutex_);
+
+      for (std::map<SeriesKey, uint64_t>::const_iterator
+             it = externalCounters_.begin(); it != externalCounters_.end(); ++it)
+      {
+        counters[it->first] += it->second;
+      }
+    }
+
+    target.clear();
+
+    std::string lastName;
+
+    for (std::map<SeriesKey, uint64_t>::const_iterator
+           it = counters.begin(); it != counters.end(); ++it)
+    {
+      FormatType(target, lastName, it->first.first, "counter");
+      FormatSeries(target, it->first.first, it->first.second, "",
+                   boost::lexical_cast<std::string>(it->second));
+    }
+
+    {
+      boost::mutex::scoped_lock lock(gaugesMutex_);
+
+      for (std::map<SeriesKey, double>::const_iterator
+             it = gauges_.begin(); it != gauges_.end(); ++it)
+      {
+        FormatType(target, lastName, it->first.first, "gauge");
+        FormatSeries(target, it->first.first, it->first.second, "",
+                     FormatValue(it->second));
+      }
+    }
+
+    for (std::map<SeriesKey, Histogram>::const_iterator
+           it = histograms.begin(); it != histograms.end(); ++it)
+    {
+      const std::string& name = it->first.first;
+      const std::string& labels = it->first.second;
+
+      FormatType(target, lastName, name, "histogram");
+
+      uint64_t cumulative = 0;
+      for (size_t i = 0; i <= BUCKETS_COUNT; i++)
+      {
+        cumulative += it->second.buckets_[i];
+
+        const std::string le = (i == BUCKETS_COUNT ? "+Inf" : FormatValue(BUCKETS[i]));
+        FormatSeries(target, name + "_bucket", labels, "le=\"" + le + "\"",
+                     boost::lexical_cast<std::string>(cumulative));
+      }
+
+      FormatSeries(target, name + "_sum", labels, "", FormatValue(it->second.sum_));
+      FormatSeries(target, name + "_count", labels, "", boost::lexical_cast<std::string>(it->second.count_));
+    }
+  }
+
+
+  std::string MetricsRegistry::FormatLabel(const std::string& name,
+                                           const std::string& value)
+  {
+    std::string s = name + "=\"";
+
+    for (size_t i = 0; i < value.size(); i++)
+    {
+      switch (value[i])
+      {
+        case '\\':
+          s += "\\\\";
+          break;
+
+        case '"':
+          s += "\\\"";
+          break;
+
+        case '\n':
+          s += "\\n";
+          break;
+
+        default:
+          s += value[i];
+      }
+    }
+
+    return s + "\"";
+  }
+}
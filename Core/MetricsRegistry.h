@@ -0,0 +1,191 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#if !defined(ORTHANC_SANDBOXED)
+#  error The macro ORTHANC_SANDBOXED must be defined
+#endif
+
+#if ORTHANC_SANDBOXED == 1
+#  error The class MetricsRegistry cannot be used in sandboxed environments
+#endif
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/thread.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+namespace Orthanc
+{
+  /**
+   * Thread-safe registry of the metrics that are exported using the
+   * text format of Prometheus. Counters and histograms are updated in
+   * one of several shards, that is chosen after the identifier of the
+   * calling thread, so that concurrent threads seldom contend for the
+   * same mutex. The shards are only merged when the metrics are
+   * exported. Gauges, as well as the counters that are maintained
+   * outside of the registry (e.g. by the caches), are meant to be set
+   * just before the export.
+   *
+   * The names of the metrics must be string literals. The labels are
+   * formatted by the caller, e.g. using "FormatLabel()".
+   **/
+  class MetricsRegistry : public boost::noncopyable
+  {
+  private:
+    class Shard;
+    struct Histogram;
+
+    typedef std::pair<std::string, std::string>  SeriesKey;   // Name, labels
+
+    bool                  enabled_;
+    std::vector<Shard*>   shards_;
+
+    boost::mutex                     gaugesMutex_;
+    std::map<SeriesKey, double>      gauges_;
+    std::map<SeriesKey, uint64_t>    externalCounters_;   // Also protected by "gaugesMutex_"
+
+    Shard& GetShard();
+
+  public:
+    // Measures a duration in seconds, that is recorded in a histogram
+    // when the timer is destructed. Does nothing if the registry is
+    // disabled.
+    class Timer : public boost::noncopyable
+    {
+    private:
+      MetricsRegistry&          registry_;
+      const char*               name_;
+      std::string               labels_;
+      bool                      active_;
+      boost::posix_time::ptime  start_;
+
+    public:
+      Timer(MetricsRegistry& registry,
+            const char* name);
+
+      Timer(MetricsRegistry& registry,
+            const char* name,
+            const std::string& labels);
+
+      ~Timer();
+
+      // Records the current measure, and starts a new one in the
+      // histogram "name", with the same labels
+      void Restart(const char* name);
+    };
+
+
+    // Locks a mutex, recording the time spent waiting for the mutex
+    // and the time during which it is held
+    class TimedLock : public boost::noncopyable
+    {
+    private:
+      Timer                      timer_;
+      boost::mutex::scoped_lock  lock_;
+
+    public:
+      TimedLock(MetricsRegistry& registry,
+                boost::mutex& mutex,
+                const char* waitName,
+                const char* holdName) :
+        timer_(registry, waitName),
+        lock_(mutex)
+      {
+        timer_.Restart(holdName);
+      }
+    };
+
+
+    MetricsRegistry();
+
+    ~MetricsRegistry();
+
+    void SetEnabled(bool enabled)
+    {
+      enabled_ = enabled;
+    }
+
+    bool IsEnabled() const
+    {
+      return enabled_;
+    }
+
+    void IncrementCounter(const char* name,
+                          const std::string& labels,
+                          uint64_t delta);
+
+    void IncrementCounter(const char* name,
+                          uint64_t delta)
+    {
+      IncrementCounter(name, std::string(), delta);
+    }
+
+    void ObserveDuration(const char* name,
+                         const std::string& labels,
+                         const boost::posix_time::time_duration& duration);
+
+    void SetGauge(const std::string& name,
+                  const std::string& labels,
+                  double value);
+
+    void SetGauge(const std::string& name,
+                  double value)
+    {
+      SetGauge(name, std::string(), value);
+    }
+
+    // Sets the current value of a counter that is accumulated by
+    // another component. This value must never decrease, and the name
+    // should end with "_total", as for the other counters.
+    void SetCounter(const std::string& name,
+                    const std::string& labels,
+                    uint64_t value);
+
+    void SetCounter(const std::string& name,
+                    uint64_t value)
+    {
+      SetCounter(name, std::string(), value);
+    }
+
+    void ExportPrometheusText(std::string& target);
+
+    // Formats one label, escaping its value: "name="value""
+    static std::string FormatLabel(const std::string& name,
+                                   const std::string& value);
+  };
+}
@@ -35,6 +35,7 @@
 #include "RestApi.h"
 
 #include "../Logging.h"
+#include "../MetricsRegistry.h"
 
 #include <stdlib.h>   // To define "_exit()" under Windows
 #include <stdio.h>
@@ -89,6 +90,15 @@ namespace Orthanc
       {
         if (resource.HasHandler(method_))
         {
+          std::auto_ptr<MetricsRegistry::Timer> timer;
+          if (api_.GetMetricsRegistry() != NULL)
+          {
+            timer.reset(new MetricsRegistry::Timer(
+                          *api_.GetMetricsRegistry(), "orthanc_rest_api_duration_seconds",
+                          MetricsRegistry::FormatLabel("method", EnumerationToString(method_)) + "," +
+                          MetricsRegistry::FormatLabel("route", resource.GetRoute())));
+          }
+
           switch (method_)
           {
             case HttpMethod_Get:
@@ -39,14 +39,34 @@
 
 namespace Orthanc
 {
+  class MetricsRegistry;
+
   class RestApi : public IHttpHandler
   {
   private:
     RestApiHierarchy root_;
+    MetricsRegistry* metrics_;
 
   public:
+    RestApi() :
+      metrics_(NULL)
+    {
+    }
+
     static void AutoListChildren(RestApiGetCall& call);
 
+    // The duration of the calls is recorded into "metrics", for each
+    // route and HTTP method
+    void SetMetricsRegistry(MetricsRegistry& metrics)
+    {
+      metrics_ = &metrics;
+    }
+
+    MetricsRegistry* GetMetricsRegistry() const
+    {
+      return metrics_;
+    }
+
     virtual bool Handle(HttpOutput& output,
                         RequestOrigin origin,
                         const char* remoteIp,
@@ -58,6 +78,18 @@ namespace Orthanc
                         const char* bodyData,
                         size_t bodySize);
 
+    // By default, the REST API handles the full body of the requests
+    virtual bool CreateChunkedRequestReader(std::auto_ptr<IChunkedRequestReader>& target,
+                                            RequestOrigin origin,
+                                            const char* remoteIp,
+                                            const char* username,
+                                            HttpMethod method,
+                                            const UriComponents& uri,
+                                            const Arguments& headers)
+    {
+      return false;
+    }
+
     void Register(const std::string& path,
                   RestApiGetCall::Handler handler);
 
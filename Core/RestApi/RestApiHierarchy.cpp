@@ -170,6 +170,7 @@ namespace Orthanc
 
   template <typename Handler>
   void RestApiHierarchy::RegisterInternal(const RestApiPath& path,
+                                          const std::string& route,
                                           Handler handler,
                                           size_t level)
   {
@@ -178,10 +179,12 @@ namespace Orthanc
       if (path.IsUniversalTrailing())
       {
         universalHandlers_.Register(handler);
+        universalHandlers_.SetRoute(route);
       }
       else
       {
         handlers_.Register(handler);
+        handlers_.SetRoute(route);
       }
     }
     else
@@ -196,7 +199,7 @@ namespace Orthanc
         child = &AddChild(children_, path.GetLevelName(level));
       }
 
-      child->RegisterInternal(path, handler, level + 1);
+      child->RegisterInternal(path, route, handler, level + 1);
     }
   }
 
@@ -338,28 +341,28 @@ namespace Orthanc
                                   RestApiGetCall::Handler handler)
   {
     RestApiPath path(uri);
-    RegisterInternal(path, handler, 0);
+    RegisterInternal(path, uri, handler, 0);
   }
 
   void RestApiHierarchy::Register(const std::string& uri,
                                   RestApiPutCall::Handler handler)
   {
     RestApiPath path(uri);
-    RegisterInternal(path, handler, 0);
+    RegisterInternal(path, uri, handler, 0);
   }
 
   void RestApiHierarchy::Register(const std::string& uri,
                                   RestApiPostCall::Handler handler)
   {
     RestApiPath path(uri);
-    RegisterInternal(path, handler, 0);
+    RegisterInternal(path, uri, handler, 0);
   }
 
   void RestApiHierarchy::Register(const std::string& uri,
                                   RestApiDeleteCall::Handler handler)
   {
     RestApiPath path(uri);
-    RegisterInternal(path, handler, 0);
+    RegisterInternal(path, uri, handler, 0);
   }
 
   void RestApiHierarchy::CreateSiteMap(Json::Value& target) const
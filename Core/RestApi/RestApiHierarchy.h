@@ -52,10 +52,23 @@ namespace Orthanc
       RestApiPostCall::Handler    postHandler_;
       RestApiPutCall::Handler     putHandler_;
       RestApiDeleteCall::Handler  deleteHandler_;
+      std::string                 route_;
 
     public:
       Resource();
 
+      // The path under which the handlers were registered, for
+      // instance "/instances/{id}/file"
+      const std::string& GetRoute() const
+      {
+        return route_;
+      }
+
+      void SetRoute(const std::string& route)
+      {
+        route_ = route;
+      }
+
       bool HasHandler(HttpMethod method) const;
 
       void Register(RestApiGetCall::Handler handler)
@@ -119,6 +132,7 @@ namespace Orthanc
 
     template <typename Handler>
     void RegisterInternal(const RestApiPath& path,
+                          const std::string& route,
                           Handler handler,
                           size_t level);
 
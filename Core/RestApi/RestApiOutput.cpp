@@ -196,4 +196,11 @@ namespace Orthanc
     // empty string
     SetCookie(name, "", 1);
   }
+
+  void RestApiOutput::AddHeader(const std::string& name,
+                                const std::string& value)
+  {
+    CheckStatus();
+    output_.AddHeader(name, value);
+  }
 }
@@ -94,6 +94,9 @@ namespace Orthanc
 
     void ResetCookie(const std::string& name);
 
+    void AddHeader(const std::string& name,
+                   const std::string& value);
+
     void Finalize();
   };
 }
@@ -192,6 +192,58 @@ namespace Orthanc
   }
 
 
+  void SystemToolbox::ReadFileRange(std::string& content,
+                                    const std::string& path,
+                                    uint64_t start,
+                                    uint64_t end)
+  {
+    if (start > end)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    if (!IsRegularFile(path))
+    {
+      LOG(ERROR) << "The path does not point to a regular file: " << path;
+      throw OrthancException(ErrorCode_RegularFileExpected);
+    }
+
+    boost::filesystem::ifstream f;
+    f.open(path, std::ifstream::in | std::ifstream::binary);
+    if (!f.good())
+    {
+      throw OrthancException(ErrorCode_InexistentFile);
+    }
+
+    std::streamsize size = GetStreamSize(f);
+    if (size < 0 ||
+        end > static_cast<uint64_t>(size))
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    const uint64_t length = end - start;
+    if (static_cast<uint64_t>(static_cast<size_t>(length)) != length)
+    {
+      throw OrthancException(ErrorCode_NotEnoughMemory);
+    }
+
+    content.resize(static_cast<size_t>(length));
+    if (length != 0)
+    {
+      f.seekg(start, std::ios::beg);
+      f.read(reinterpret_cast<char*>(&content[0]), length);
+
+      if (!f.good())
+      {
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
+    }
+
+    f.close();
+  }
+
+
   bool SystemToolbox::ReadHeader(std::string& header,
                                  const std::string& path,
                                  size_t headerSize)
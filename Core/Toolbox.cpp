@@ -394,6 +394,21 @@ namespace Orthanc
   }
 
 
+  static void FormatMD5(std::string& result,
+                        md5_state_s& state)
+  {
+    md5_byte_t actualHash[16];
+    md5_finish(&state, actualHash);
+
+    result.resize(32);
+    for (unsigned int i = 0; i < 16; i++)
+    {
+      result[2 * i] = GetHexadecimalCharacter(static_cast<uint8_t>(actualHash[i] / 16));
+      result[2 * i + 1] = GetHexadecimalCharacter(static_cast<uint8_t>(actualHash[i] % 16));
+    }
+  }
+
+
   void Toolbox::ComputeMD5(std::string& result,
                            const std::string& data)
   {
@@ -422,15 +437,36 @@ namespace Orthanc
                  static_cast<int>(size));
     }
 
-    md5_byte_t actualHash[16];
-    md5_finish(&state, actualHash);
+    FormatMD5(result, state);
+  }
 
-    result.resize(32);
-    for (unsigned int i = 0; i < 16; i++)
+
+  void Toolbox::ComputeMD5(std::string& result,
+                           std::istream& stream)
+  {
+    md5_state_s state;
+    md5_init(&state);
+
+    std::vector<char> chunk(64 * 1024);
+
+    while (stream.good())
     {
-      result[2 * i] = GetHexadecimalCharacter(static_cast<uint8_t>(actualHash[i] / 16));
-      result[2 * i + 1] = GetHexadecimalCharacter(static_cast<uint8_t>(actualHash[i] % 16));
+      stream.read(&chunk[0], chunk.size());
+
+      if (stream.gcount() > 0)
+      {
+        md5_append(&state, 
+                   reinterpret_cast<const md5_byte_t*>(&chunk[0]), 
+                   static_cast<int>(stream.gcount()));
+      }
     }
+
+    if (stream.bad())
+    {
+      throw OrthancException(ErrorCode_InexistentFile);
+    }
+
+    FormatMD5(result, state);
   }
 #endif
 
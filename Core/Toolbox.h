@@ -38,6 +38,7 @@
 #include <stdint.h>
 #include <vector>
 #include <string>
+#include <istream>
 #include <json/json.h>
 
 
@@ -129,6 +130,10 @@ namespace Orthanc
     void ComputeMD5(std::string& result,
                     const void* data,
                     size_t size);
+
+    // Reads the stream by chunks until its end
+    void ComputeMD5(std::string& result,
+                    std::istream& stream);
 #endif
 
     void ComputeSHA1(std::string& result,
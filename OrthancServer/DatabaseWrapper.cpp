@@ -183,6 +183,32 @@ namespace Orthanc
         return remainingType_;
       }
     };
+
+
+    // Bounds the length of the "IN" clauses of the set-oriented queries
+    static const size_t MAX_IDS_PER_STATEMENT = 256;
+
+    // The internal IDs are integers, so they can safely be written
+    // into the SQL statement. Such statements are not cached, as
+    // their text changes at each call.
+    static std::string FormatInternalIds(const std::vector<int64_t>& ids,
+                                         size_t start,
+                                         size_t end)
+    {
+      std::string s = "(";
+
+      for (size_t i = start; i < end; i++)
+      {
+        if (i != start)
+        {
+          s += ",";
+        }
+
+        s += boost::lexical_cast<std::string>(ids[i]);
+      }
+
+      return s + ")";
+    }
   }
 
 
@@ -200,8 +226,9 @@ namespace Orthanc
       ResourceType resourceType = static_cast<ResourceType>(s.ColumnInt(3));
       const std::string& date = s.ColumnString(4);
 
-      int64_t internalId = s.ColumnInt64(2);
-      std::string publicId = GetPublicId(internalId);
+      // The public ID is joined by the statement (the changes are
+      // deleted together with their resource)
+      const std::string& publicId = s.ColumnString(5);
 
       target.push_back(ServerIndexChange(seq, changeType, resourceType, publicId, date));
     }
@@ -311,7 +338,12 @@ namespace Orthanc
   DatabaseWrapper::DatabaseWrapper(const std::string& path) : 
     listener_(NULL), 
     signalRemainingAncestor_(NULL),
-    version_(0)
+    version_(0),
+    path_(path),
+    exclusiveLocking_(true),
+    isOpen_(false),
+    hasResourceStatistics_(false),
+    hasStudyAggregates_(false)
   {
     db_.Open(path);
   }
@@ -320,7 +352,11 @@ namespace Orthanc
   DatabaseWrapper::DatabaseWrapper() : 
     listener_(NULL), 
     signalRemainingAncestor_(NULL),
-    version_(0)
+    version_(0),
+    exclusiveLocking_(true),
+    isOpen_(false),
+    hasResourceStatistics_(false),
+    hasStudyAggregates_(false)
   {
     db_.OpenInMemory();
   }
@@ -334,10 +370,23 @@ namespace Orthanc
     // http://www.sqlite.org/pragma.html
     db_.Execute("PRAGMA SYNCHRONOUS=NORMAL;");
     db_.Execute("PRAGMA JOURNAL_MODE=WAL;");
-    db_.Execute("PRAGMA LOCKING_MODE=EXCLUSIVE;");
+
+    if (exclusiveLocking_)
+    {
+      db_.Execute("PRAGMA LOCKING_MODE=EXCLUSIVE;");
+    }
+    else
+    {
+      // The read-only connections must be able to access the
+      // write-ahead log concurrently with this connection
+      db_.Execute("PRAGMA LOCKING_MODE=NORMAL;");
+    }
+
     db_.Execute("PRAGMA WAL_AUTOCHECKPOINT=1000;");
     //db_.Execute("PRAGMA TEMP_STORE=memory");
 
+    isOpen_ = true;
+
     if (!db_.DoesTableExist("GlobalProperties"))
     {
       LOG(INFO) << "Creating the database";
@@ -372,6 +421,66 @@ namespace Orthanc
 
     signalRemainingAncestor_ = new Internals::SignalRemainingAncestor;
     db_.Register(signalRemainingAncestor_);
+
+    if (version_ == 6)
+    {
+      InstallResourceStatistics();
+      InstallStudyAggregates();
+    }
+  }
+
+
+  void DatabaseWrapper::OpenReadOnly()
+  {
+    // The database has already been created and upgraded by the
+    // primary connection: Only check its version
+    db_.Execute("PRAGMA QUERY_ONLY=1;");
+    db_.Execute("PRAGMA BUSY_TIMEOUT=10000;");
+
+    std::string tmp;
+    if (!LookupGlobalProperty(tmp, GlobalProperty_DatabaseSchemaVersion))
+    {
+      throw OrthancException(ErrorCode_IncompatibleDatabaseVersion);
+    }
+
+    try
+    {
+      version_ = boost::lexical_cast<unsigned int>(tmp);
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+      throw OrthancException(ErrorCode_IncompatibleDatabaseVersion);
+    }
+
+    hasResourceStatistics_ = db_.DoesTableExist("ResourceStatistics");
+    hasStudyAggregates_ = db_.DoesTableExist("StudyAggregates");
+    isOpen_ = true;
+  }
+
+
+  void DatabaseWrapper::SetExclusiveLocking(bool exclusive)
+  {
+    if (isOpen_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    exclusiveLocking_ = exclusive;
+  }
+
+
+  IDatabaseWrapper* DatabaseWrapper::OpenReadOnlyConnection()
+  {
+    if (path_.empty() ||      // In-memory database (unit tests)
+        exclusiveLocking_ ||
+        !isOpen_)
+    {
+      return NULL;
+    }
+
+    std::auto_ptr<DatabaseWrapper> reader(new DatabaseWrapper(path_));
+    reader->OpenReadOnly();
+    return reader.release();
   }
 
 
@@ -386,6 +495,37 @@ namespace Orthanc
   }
 
 
+  void DatabaseWrapper::InstallResourceStatistics()
+  {
+    hasResourceStatistics_ = db_.DoesTableExist("ResourceStatistics");
+
+    if (!hasResourceStatistics_)
+    {
+      // New in Orthanc 1.4.2, without change in the version of the DB
+      // schema. The statistics of the resources that are already
+      // stored are computed once for all.
+      LOG(WARNING) << "Computing the statistics of the resources stored in the database";
+      ExecuteUpgradeScript(db_, EmbeddedResources::INSTALL_RESOURCE_STATISTICS);
+      hasResourceStatistics_ = true;
+    }
+  }
+
+
+  void DatabaseWrapper::InstallStudyAggregates()
+  {
+    hasStudyAggregates_ = db_.DoesTableExist("StudyAggregates");
+
+    if (!hasStudyAggregates_)
+    {
+      // New in Orthanc 1.4.2, without change in the version of the DB
+      // schema
+      LOG(WARNING) << "Indexing the modalities and the SOP classes of the studies stored in the database";
+      ExecuteUpgradeScript(db_, EmbeddedResources::INSTALL_STUDY_AGGREGATES);
+      hasStudyAggregates_ = true;
+    }
+  }
+
+
   void DatabaseWrapper::Upgrade(unsigned int targetVersion,
                                 IStorageArea& storageArea)
   {
@@ -434,6 +574,9 @@ namespace Orthanc
       db_.CommitTransaction();
       version_ = 6;
     }
+
+    InstallResourceStatistics();
+    InstallStudyAggregates();
   }
 
 
@@ -492,6 +635,104 @@ namespace Orthanc
   }
 
 
+  void DatabaseWrapper::ReadResources(std::vector<std::string>* publicIds,
+                                      std::vector<ResourceType>* types,
+                                      std::vector<int64_t>* parents,
+                                      const std::vector<int64_t>& ids)
+  {
+    if (publicIds != NULL)
+    {
+      publicIds->resize(ids.size());
+    }
+
+    if (types != NULL)
+    {
+      types->resize(ids.size());
+    }
+
+    if (parents != NULL)
+    {
+      parents->resize(ids.size());
+    }
+
+    // The same resource might be requested several times
+    typedef std::multimap<int64_t, size_t>  Positions;
+    Positions positions;
+
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+      positions.insert(std::make_pair(ids[i], i));
+    }
+
+    size_t found = 0;
+
+    for (size_t start = 0; start < ids.size(); start += Internals::MAX_IDS_PER_STATEMENT)
+    {
+      size_t end = std::min(ids.size(), start + Internals::MAX_IDS_PER_STATEMENT);
+
+      SQLite::Statement s(db_, "SELECT internalId, publicId, resourceType, parentId "
+                          "FROM Resources WHERE internalId IN " +
+                          Internals::FormatInternalIds(ids, start, end));
+
+      while (s.Step())
+      {
+        std::pair<Positions::iterator, Positions::iterator> range =
+          positions.equal_range(s.ColumnInt64(0));
+
+        for (Positions::iterator it = range.first; it != range.second; ++it)
+        {
+          if (publicIds != NULL)
+          {
+            (*publicIds) [it->second] = s.ColumnString(1);
+          }
+
+          if (types != NULL)
+          {
+            (*types) [it->second] = static_cast<ResourceType>(s.ColumnInt(2));
+          }
+
+          if (parents != NULL)
+          {
+            (*parents) [it->second] = (s.ColumnIsNull(3) ? -1 : s.ColumnInt64(3));
+          }
+
+          found++;
+        }
+
+        // Each resource is only counted once, even if it appears in
+        // several chunks
+        positions.erase(range.first, range.second);
+      }
+    }
+
+    if (found != ids.size())
+    {
+      throw OrthancException(ErrorCode_UnknownResource);
+    }
+  }
+
+
+  void DatabaseWrapper::GetPublicIds(std::vector<std::string>& target,
+                                     const std::vector<int64_t>& ids)
+  {
+    ReadResources(&target, NULL, NULL, ids);
+  }
+
+
+  void DatabaseWrapper::GetResourceTypes(std::vector<ResourceType>& target,
+                                         const std::vector<int64_t>& ids)
+  {
+    ReadResources(NULL, &target, NULL, ids);
+  }
+
+
+  void DatabaseWrapper::LookupParents(std::vector<int64_t>& parents,
+                                      const std::vector<int64_t>& ids)
+  {
+    ReadResources(NULL, NULL, &parents, ids);
+  }
+
+
   std::string DatabaseWrapper::GetPublicId(int64_t resourceId)
   {
     SQLite::Statement s(db_, SQLITE_FROM_HERE, 
@@ -514,7 +755,8 @@ namespace Orthanc
                                    int64_t since,
                                    uint32_t maxResults)
   {
-    SQLite::Statement s(db_, SQLITE_FROM_HERE, "SELECT * FROM Changes WHERE seq>? ORDER BY seq LIMIT ?");
+    SQLite::Statement s(db_, SQLITE_FROM_HERE, "SELECT c.*, r.publicId FROM Changes AS c, Resources AS r "
+                        "WHERE c.seq>? AND r.internalId=c.internalId ORDER BY c.seq LIMIT ?");
     s.BindInt64(0, since);
     s.BindInt(1, maxResults + 1);
     GetChangesInternal(target, done, s, maxResults);
@@ -524,7 +766,8 @@ namespace Orthanc
   void DatabaseWrapper::GetLastChange(std::list<ServerIndexChange>& target /*out*/)
   {
     bool done;  // Ignored
-    SQLite::Statement s(db_, SQLITE_FROM_HERE, "SELECT * FROM Changes ORDER BY seq DESC LIMIT 1");
+    SQLite::Statement s(db_, SQLITE_FROM_HERE, "SELECT c.*, r.publicId FROM Changes AS c, Resources AS r "
+                        "WHERE r.internalId=c.internalId ORDER BY c.seq DESC LIMIT 1");
     GetChangesInternal(target, done, s, 1);
   }
 
@@ -805,6 +1048,49 @@ namespace Orthanc
   }
 
 
+  void DatabaseWrapper::GetMainDicomTags(std::vector<DicomMap*>& target,
+                                         const std::vector<int64_t>& ids)
+  {
+    if (target.size() != ids.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    // The same resource might be requested several times
+    typedef std::multimap<int64_t, DicomMap*>  Index;
+    Index index;
+
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+      if (target[i] == NULL)
+      {
+        throw OrthancException(ErrorCode_NullPointer);
+      }
+
+      target[i]->Clear();
+      index.insert(std::make_pair(ids[i], target[i]));
+    }
+
+    for (size_t start = 0; start < ids.size(); start += Internals::MAX_IDS_PER_STATEMENT)
+    {
+      size_t end = std::min(ids.size(), start + Internals::MAX_IDS_PER_STATEMENT);
+
+      SQLite::Statement s(db_, "SELECT * FROM MainDicomTags WHERE id IN " +
+                          Internals::FormatInternalIds(ids, start, end));
+      while (s.Step())
+      {
+        std::pair<Index::iterator, Index::iterator> range = index.equal_range(s.ColumnInt64(0));
+        for (Index::iterator it = range.first; it != range.second; ++it)
+        {
+          it->second->SetValue(s.ColumnInt(1),
+                               s.ColumnInt(2),
+                               s.ColumnString(3), false);
+        }
+      }
+    }
+  }
+
+
   void DatabaseWrapper::GetChildrenPublicId(std::list<std::string>& target,
                                             int64_t id)
   {
@@ -890,6 +1176,17 @@ namespace Orthanc
     
   uint64_t DatabaseWrapper::GetTotalCompressedSize()
   {
+    if (hasResourceStatistics_)
+    {
+      // The row "0" contains the statistics of the whole database
+      SQLite::Statement s(db_, SQLITE_FROM_HERE, 
+                          "SELECT compressedSize FROM ResourceStatistics WHERE id=0");
+      if (s.Step())
+      {
+        return static_cast<uint64_t>(s.ColumnInt64(0));
+      }
+    }
+
     SQLite::Statement s(db_, SQLITE_FROM_HERE, "SELECT SUM(compressedSize) FROM AttachedFiles");
     s.Run();
     return static_cast<uint64_t>(s.ColumnInt64(0));
@@ -898,6 +1195,16 @@ namespace Orthanc
     
   uint64_t DatabaseWrapper::GetTotalUncompressedSize()
   {
+    if (hasResourceStatistics_)
+    {
+      SQLite::Statement s(db_, SQLITE_FROM_HERE, 
+                          "SELECT uncompressedSize FROM ResourceStatistics WHERE id=0");
+      if (s.Step())
+      {
+        return static_cast<uint64_t>(s.ColumnInt64(0));
+      }
+    }
+
     SQLite::Statement s(db_, SQLITE_FROM_HERE, "SELECT SUM(uncompressedSize) FROM AttachedFiles");
     s.Run();
     return static_cast<uint64_t>(s.ColumnInt64(0));
@@ -906,6 +1213,41 @@ namespace Orthanc
 
   uint64_t DatabaseWrapper::GetResourceCount(ResourceType resourceType)
   {
+    if (hasResourceStatistics_)
+    {
+      int column;
+
+      switch (resourceType)
+      {
+        case ResourceType_Patient:
+          column = 0;
+          break;
+
+        case ResourceType_Study:
+          column = 1;
+          break;
+
+        case ResourceType_Series:
+          column = 2;
+          break;
+
+        case ResourceType_Instance:
+          column = 3;
+          break;
+
+        default:
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+
+      SQLite::Statement s(db_, SQLITE_FROM_HERE, 
+                          "SELECT countPatients, countStudies, countSeries, countInstances "
+                          "FROM ResourceStatistics WHERE id=0");
+      if (s.Step())
+      {
+        return static_cast<uint64_t>(s.ColumnInt64(column));
+      }
+    }
+
     SQLite::Statement s(db_, SQLITE_FROM_HERE, 
                         "SELECT COUNT(*) FROM Resources WHERE resourceType=?");
     s.BindInt(0, resourceType);
@@ -923,6 +1265,79 @@ namespace Orthanc
   }
 
 
+  bool DatabaseWrapper::LookupResourceStatistics(uint64_t& compressedSize,
+                                                 uint64_t& uncompressedSize,
+                                                 unsigned int& countStudies,
+                                                 unsigned int& countSeries,
+                                                 unsigned int& countInstances,
+                                                 int64_t id)
+  {
+    if (!hasResourceStatistics_)
+    {
+      return false;
+    }
+
+    SQLite::Statement s(db_, SQLITE_FROM_HERE, 
+                        "SELECT compressedSize, uncompressedSize, countStudies, countSeries, "
+                        "countInstances FROM ResourceStatistics WHERE id=?");
+    s.BindInt64(0, id);
+
+    if (!s.Step())
+    {
+      throw OrthancException(ErrorCode_UnknownResource);
+    }
+
+    compressedSize = static_cast<uint64_t>(s.ColumnInt64(0));
+    uncompressedSize = static_cast<uint64_t>(s.ColumnInt64(1));
+    countStudies = static_cast<unsigned int>(s.ColumnInt64(2));
+    countSeries = static_cast<unsigned int>(s.ColumnInt64(3));
+    countInstances = static_cast<unsigned int>(s.ColumnInt64(4));
+    return true;
+  }
+
+
+  bool DatabaseWrapper::LookupStudyAggregates(std::set<std::string>& modalities,
+                                              std::set<std::string>& sopClassUids,
+                                              unsigned int& countSopClassUids,
+                                              int64_t study)
+  {
+    modalities.clear();
+    sopClassUids.clear();
+    countSopClassUids = 0;
+
+    if (!hasStudyAggregates_)
+    {
+      return false;
+    }
+
+    // The values of "type" are documented in "InstallStudyAggregates.sql"
+    SQLite::Statement s(db_, SQLITE_FROM_HERE, 
+                        "SELECT type, value, COUNT(*) FROM StudyAggregates "
+                        "WHERE studyId=? GROUP BY type, value");
+    s.BindInt64(0, study);
+
+    while (s.Step())
+    {
+      switch (s.ColumnInt(0))
+      {
+        case 1:
+          modalities.insert(s.ColumnString(1));
+          break;
+
+        case 2:
+          sopClassUids.insert(s.ColumnString(1));
+          countSopClassUids += static_cast<unsigned int>(s.ColumnInt64(2));
+          break;
+
+        default:
+          throw OrthancException(ErrorCode_Database);
+      }
+    }
+
+    return true;
+  }
+
+
   void DatabaseWrapper::GetAllInternalIds(std::list<int64_t>& target,
                                           ResourceType resourceType)
   {
@@ -977,6 +1392,40 @@ namespace Orthanc
   }
 
 
+  void DatabaseWrapper::GetResourcesAfter(std::vector<int64_t>& internalIds,
+                                          std::vector<std::string>& publicIds,
+                                          ResourceType resourceType,
+                                          int64_t after,
+                                          size_t limit)
+  {
+    internalIds.clear();
+    publicIds.clear();
+
+    if (limit == 0)
+    {
+      return;
+    }
+
+    // The "internalId" column is the primary key of "Resources", so
+    // SQLite seeks directly to the start of the page
+    SQLite::Statement s(db_, SQLITE_FROM_HERE,
+                        "SELECT internalId, publicId FROM Resources WHERE "
+                        "resourceType=? AND internalId>? ORDER BY internalId LIMIT ?");
+    s.BindInt(0, resourceType);
+    s.BindInt64(1, after);
+    s.BindInt64(2, limit);
+
+    internalIds.reserve(limit);
+    publicIds.reserve(limit);
+
+    while (s.Step())
+    {
+      internalIds.push_back(s.ColumnInt64(0));
+      publicIds.push_back(s.ColumnString(1));
+    }
+  }
+
+
   bool DatabaseWrapper::SelectPatientToRecycle(int64_t& internalId)
   {
     SQLite::Statement s(db_, SQLITE_FROM_HERE,
@@ -57,6 +57,11 @@ namespace Orthanc
     SQLite::Connection db_;
     Internals::SignalRemainingAncestor* signalRemainingAncestor_;
     unsigned int version_;
+    std::string path_;
+    bool exclusiveLocking_;
+    bool isOpen_;
+    bool hasResourceStatistics_;
+    bool hasStudyAggregates_;
 
     void GetChangesInternal(std::list<ServerIndexChange>& target,
                             bool& done,
@@ -70,6 +75,17 @@ namespace Orthanc
 
     void ClearTable(const std::string& tableName);
 
+    void OpenReadOnly();
+
+    void InstallResourceStatistics();
+
+    void InstallStudyAggregates();
+
+    void ReadResources(std::vector<std::string>* publicIds,
+                       std::vector<ResourceType>* types,
+                       std::vector<int64_t>* parents,
+                       const std::vector<int64_t>& ids);
+
   public:
     DatabaseWrapper(const std::string& path);
 
@@ -80,6 +96,7 @@ namespace Orthanc
     virtual void Close()
     {
       db_.Close();
+      isOpen_ = false;
     }
 
     virtual void SetListener(IDatabaseListener& listener);
@@ -136,6 +153,48 @@ namespace Orthanc
     virtual void Upgrade(unsigned int targetVersion,
                          IStorageArea& storageArea);
 
+    virtual IDatabaseWrapper* OpenReadOnlyConnection();
+
+    virtual bool LookupResourceStatistics(uint64_t& compressedSize,
+                                          uint64_t& uncompressedSize,
+                                          unsigned int& countStudies,
+                                          unsigned int& countSeries,
+                                          unsigned int& countInstances,
+                                          int64_t id);
+
+    virtual bool LookupStudyAggregates(std::set<std::string>& modalities,
+                                       std::set<std::string>& sopClassUids,
+                                       unsigned int& countSopClassUids,
+                                       int64_t study);
+
+    virtual void GetResourcesAfter(std::vector<int64_t>& internalIds,
+                                   std::vector<std::string>& publicIds,
+                                   ResourceType resourceType,
+                                   int64_t after,
+                                   size_t limit);
+
+    virtual void GetMainDicomTags(std::vector<DicomMap*>& target,
+                                  const std::vector<int64_t>& ids);
+
+    virtual void GetPublicIds(std::vector<std::string>& target,
+                              const std::vector<int64_t>& ids);
+
+    virtual void GetResourceTypes(std::vector<ResourceType>& target,
+                                  const std::vector<int64_t>& ids);
+
+    virtual void LookupParents(std::vector<int64_t>& parents,
+                               const std::vector<int64_t>& ids);
+
+    // Must be called before "Open()". The exclusive locking mode of
+    // SQLite is faster, but it prevents the creation of read-only
+    // connections by "OpenReadOnlyConnection()".
+    void SetExclusiveLocking(bool exclusive);
+
+    bool IsExclusiveLocking() const
+    {
+      return exclusiveLocking_;
+    }
+
 
     /**
      * The methods declared below are for unit testing only!
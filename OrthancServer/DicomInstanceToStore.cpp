@@ -36,6 +36,8 @@
 
 #include "../Core/DicomParsing/FromDcmtkBridge.h"
 #include "../Core/Logging.h"
+#include "../Core/SystemToolbox.h"
+#include "ServerToolbox.h"
 
 #include <dcmtk/dcmdata/dcfilefo.h>
 #include <dcmtk/dcmdata/dcdeftag.h>
@@ -43,6 +45,12 @@
 
 namespace Orthanc
 {
+  // When parsing a DICOM file from the filesystem, the values that are
+  // longer than this number of bytes (notably the pixel data) are not
+  // loaded in memory, as they are not needed to index the instance
+  static const uint32_t MAX_LOADED_VALUE_LENGTH = 64 * 1024;
+
+
   void DicomInstanceToStore::AddMetadata(ResourceType level,
                                          MetadataType metadata,
                                          const std::string& value)
@@ -53,7 +61,7 @@ namespace Orthanc
 
   void DicomInstanceToStore::ComputeMissingInformation()
   {
-    if (buffer_.HasContent() &&
+    if ((buffer_.HasContent() || HasFile()) &&
         summary_.HasContent() &&
         json_.HasContent())
     {
@@ -61,7 +69,15 @@ namespace Orthanc
       return; 
     }
     
-    if (!buffer_.HasContent())
+    if (!buffer_.HasContent() &&
+        HasFile())
+    {
+      if (!parsed_.HasContent())
+      {
+        parsed_.TakeOwnership(ParsedDicomFile::CreateFromFile(file_, MAX_LOADED_VALUE_LENGTH));
+      }
+    }
+    else if (!buffer_.HasContent())
     {
       if (!parsed_.HasContent())
       {
@@ -92,8 +108,8 @@ namespace Orthanc
     }
 
     // At this point, we know that the DICOM file is available as a
-    // memory buffer, but that its summary or its JSON version is
-    // missing
+    // memory buffer or as a parsed file, but that its summary or its
+    // JSON version is missing
 
     if (!parsed_.HasContent())
     {
@@ -101,6 +117,23 @@ namespace Orthanc
     }
 
     // At this point, we have parsed the DICOM file
+
+    if (!summary_.HasContent() &&
+        !json_.HasContent())
+    {
+      // Walk the dataset only once to get all the information
+      summary_.Allocate();
+      json_.Allocate();
+      simplified_.Allocate();
+
+      std::set<DicomTag> ignoreTagLength;
+      FromDcmtkBridge::ExtractDicomSummaryAndJson(summary_.GetContent(),
+                                                  json_.GetContent(),
+                                                  simplified_.GetContent(),
+                                                  *parsed_.GetContent().GetDcmtkObject().getDataset(),
+                                                  ignoreTagLength);
+      return;
+    }
     
     if (!summary_.HasContent())
     {
@@ -122,9 +155,22 @@ namespace Orthanc
 
 
 
+  void DicomInstanceToStore::LoadFile()
+  {
+    if (!buffer_.HasContent() &&
+        HasFile())
+    {
+      LOG(INFO) << "Loading the DICOM file in memory: " << file_;
+      buffer_.Allocate();
+      SystemToolbox::ReadFile(buffer_.GetContent(), file_);
+    }
+  }
+
+
   const char* DicomInstanceToStore::GetBufferData()
   {
     ComputeMissingInformation();
+    LoadFile();
     
     if (!buffer_.HasContent())
     {
@@ -145,6 +191,7 @@ namespace Orthanc
   size_t DicomInstanceToStore::GetBufferSize()
   {
     ComputeMissingInformation();
+    LoadFile();
     
     if (!buffer_.HasContent())
     {
@@ -181,12 +228,62 @@ namespace Orthanc
   }
 
 
+  const Json::Value& DicomInstanceToStore::GetSimplifiedJson()
+  {
+    ComputeMissingInformation();
+
+    if (!simplified_.HasContent())
+    {
+      // The JSON was provided by the caller
+      simplified_.Allocate();
+      ServerToolbox::SimplifyTags(simplified_.GetContent(), GetJson(), DicomToJsonFormat_Human);
+    }
+
+    return simplified_.GetConstContent();
+  }
+
+
   bool DicomInstanceToStore::LookupTransferSyntax(std::string& result)
   {
     ComputeMissingInformation();
 
     DicomMap header;
-    if (DicomMap::ParseDicomMetaInformation(header, GetBufferData(), GetBufferSize()))
+    bool hasHeader;
+
+    if (!buffer_.HasContent() &&
+        HasFile())
+    {
+      // Only read the File Meta Information from the disk: The 132
+      // bytes of the preamble and the prefix, then the 12 bytes of
+      // the "File Meta Information Group Length" (0002,0000), whose
+      // value gives the size of the remaining meta header
+      static const size_t GROUP_LENGTH_END = 132 + 12;
+
+      std::string meta;
+      SystemToolbox::ReadHeader(meta, file_, GROUP_LENGTH_END);
+
+      if (meta.size() == GROUP_LENGTH_END &&
+          meta.compare(132, 6, std::string("\x02\x00\x00\x00UL", 6)) == 0)
+      {
+        const uint32_t groupLength = (static_cast<uint8_t>(meta[140]) |
+                                      (static_cast<uint8_t>(meta[141]) << 8) |
+                                      (static_cast<uint8_t>(meta[142]) << 16) |
+                                      (static_cast<uint8_t>(meta[143]) << 24));
+
+        if (groupLength < MAX_LOADED_VALUE_LENGTH)
+        {
+          SystemToolbox::ReadHeader(meta, file_, GROUP_LENGTH_END + groupLength);
+        }
+      }
+
+      hasHeader = DicomMap::ParseDicomMetaInformation(header, meta.c_str(), meta.size());
+    }
+    else
+    {
+      hasHeader = DicomMap::ParseDicomMetaInformation(header, GetBufferData(), GetBufferSize());
+    }
+
+    if (hasHeader)
     {
       const DicomValue* value = header.TestAndGetValue(DICOM_TAG_TRANSFER_SYNTAX_UID);
       if (value != NULL &&
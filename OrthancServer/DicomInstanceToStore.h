@@ -140,14 +140,18 @@ namespace Orthanc
     };
 
     DicomInstanceOrigin              origin_;
+    std::string                      file_;
     SmartContainer<std::string>      buffer_;
     SmartContainer<ParsedDicomFile>  parsed_;
     SmartContainer<DicomMap>         summary_;
     SmartContainer<Json::Value>      json_;
+    SmartContainer<Json::Value>      simplified_;
     ServerIndex::MetadataMap         metadata_;
 
     void ComputeMissingInformation();
 
+    void LoadFile();
+
   public:
     void SetOrigin(const DicomInstanceOrigin& origin)
     {
@@ -164,6 +168,25 @@ namespace Orthanc
       buffer_.SetConstReference(dicom);
     }
 
+    // The DICOM file is parsed from the filesystem, with its large
+    // values left on the disk, and it is only loaded in memory if its
+    // buffer is explicitly requested (e.g. by a plugin). The file
+    // must not be modified nor removed until this object is destroyed.
+    void SetFile(const std::string& path)
+    {
+      file_ = path;
+    }
+
+    bool HasFile() const
+    {
+      return !file_.empty();
+    }
+
+    const std::string& GetFile() const
+    {
+      return file_;
+    }
+
     void SetParsedDicomFile(ParsedDicomFile& parsed)
     {
       parsed_.SetReference(parsed);
@@ -179,6 +202,12 @@ namespace Orthanc
       json_.SetConstReference(json);
     }
 
+    // The simplified version of the JSON, in the "Human" format
+    void SetSimplifiedJson(const Json::Value& simplified)
+    {
+      simplified_.SetConstReference(simplified);
+    }
+
     void AddMetadata(ResourceType level,
                      MetadataType metadata,
                      const std::string& value);
@@ -201,6 +230,8 @@ namespace Orthanc
     
     const Json::Value& GetJson();
 
+    const Json::Value& GetSimplifiedJson();
+
     bool LookupTransferSyntax(std::string& result);
   };
 }
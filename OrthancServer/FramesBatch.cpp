@@ -0,0 +1,206 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "PrecompiledHeadersServer.h"
+#include "FramesBatch.h"
+
+#include "../Core/Logging.h"
+#include "../Core/OrthancException.h"
+#include "../Core/Toolbox.h"
+
+#include <algorithm>
+#include <limits>
+#include <boost/lexical_cast.hpp>
+
+
+namespace Orthanc
+{
+  const unsigned int FramesBatch::LAST_FRAME = std::numeric_limits<unsigned int>::max();
+
+
+  static unsigned int ParseFrameIndex(const std::string& value,
+                                      const std::string& ranges)
+  {
+    if (value.empty() ||
+        value.find_first_not_of("0123456789") != std::string::npos)
+    {
+      LOG(ERROR) << "Bad range of frames: " << ranges;
+      throw OrthancException(ErrorCode_BadRequest);
+    }
+
+    try
+    {
+      return boost::lexical_cast<unsigned int>(value);
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+      LOG(ERROR) << "Bad range of frames: " << ranges;
+      throw OrthancException(ErrorCode_BadRequest);
+    }
+  }
+
+
+  void FramesBatch::AddRange(unsigned int first,
+                             unsigned int last)
+  {
+    if (first > last)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    ranges_.push_back(std::make_pair(first, last));
+  }
+
+
+  void FramesBatch::AddFirstAndCount(unsigned int first,
+                                     unsigned int count)
+  {
+    if (count == 0 ||
+        count - 1 > LAST_FRAME - first)
+    {
+      AddRange(first, LAST_FRAME);
+    }
+    else
+    {
+      AddRange(first, first + count - 1);
+    }
+  }
+
+
+  void FramesBatch::ParseRanges(const std::string& ranges)
+  {
+    std::vector<std::string> tokens;
+    Toolbox::TokenizeString(tokens, ranges, ',');
+
+    for (size_t i = 0; i < tokens.size(); i++)
+    {
+      const std::string token = Toolbox::StripSpaces(tokens[i]);
+      const size_t dash = token.find('-');
+
+      unsigned int first, last;
+
+      if (dash == std::string::npos)
+      {
+        first = ParseFrameIndex(token, ranges);
+        last = first;
+      }
+      else
+      {
+        first = ParseFrameIndex(Toolbox::StripSpaces(token.substr(0, dash)), ranges);
+
+        const std::string end = Toolbox::StripSpaces(token.substr(dash + 1));
+        last = (end.empty() ? LAST_FRAME : ParseFrameIndex(end, ranges));
+      }
+
+      if (first > last)
+      {
+        LOG(ERROR) << "Reversed range of frames: " << token;
+        throw OrthancException(ErrorCode_BadRequest);
+      }
+
+      AddRange(first, last);
+    }
+  }
+
+
+  void FramesBatch::GetFrames(std::vector<unsigned int>& frames,
+                              unsigned int countFrames) const
+  {
+    frames.clear();
+
+    if (ranges_.empty())
+    {
+      frames.reserve(countFrames);
+      for (unsigned int i = 0; i < countFrames; i++)
+      {
+        frames.push_back(i);
+      }
+
+      return;
+    }
+
+    std::vector<Range> sorted(ranges_);
+    std::sort(sorted.begin(), sorted.end());
+
+    for (size_t i = 0; i < sorted.size(); i++)
+    {
+      if (sorted[i].first >= countFrames)
+      {
+        LOG(ERROR) << "Frame " << sorted[i].first << " is out of range, as the instance has "
+                   << countFrames << " frame(s)";
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+
+      // Skip the frames that are already selected by a previous
+      // (overlapping) range
+      unsigned int frame = sorted[i].first;
+      if (!frames.empty() &&
+          frames.back() >= frame)
+      {
+        frame = frames.back() + 1;
+      }
+
+      const unsigned int last = std::min(sorted[i].second, countFrames - 1);
+
+      for (; frame <= last; frame++)
+      {
+        frames.push_back(frame);
+      }
+    }
+  }
+
+
+  void FramesBatch::FormatPart(std::string& target,
+                               const std::string& boundary,
+                               const std::string& mime,
+                               const std::string& location,
+                               const std::string& content)
+  {
+    target = ("--" + boundary + "\r\n" +
+              "Content-Type: " + mime + "\r\n" +
+              "Content-Length: " + boost::lexical_cast<std::string>(content.size()) + "\r\n" +
+              "Content-Location: " + location + "\r\n" +
+              "MIME-Version: 1.0\r\n\r\n");
+    target.reserve(target.size() + content.size() + 2);
+    target.append(content);
+    target.append("\r\n");
+  }
+
+
+  void FramesBatch::FormatClosingBoundary(std::string& target,
+                                          const std::string& boundary)
+  {
+    target = "--" + boundary + "--\r\n";
+  }
+}
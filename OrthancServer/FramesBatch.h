@@ -0,0 +1,94 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace Orthanc
+{
+  /**
+   * Selection of the frames of one instance that are sent as one
+   * multipart answer by the "/instances/.../frames-batch/..." URIs,
+   * and formatting of the parts of this answer. The selection is a
+   * list of ranges of frame indices, that might overlap: Each
+   * selected frame is sent once, in increasing order.
+   **/
+  class FramesBatch
+  {
+  public:
+    // Upper bound of a range that extends up to the last frame
+    static const unsigned int LAST_FRAME;
+
+  private:
+    typedef std::pair<unsigned int, unsigned int>  Range;   // Inclusive
+
+    std::vector<Range>  ranges_;   // Empty means all the frames
+
+  public:
+    // Throws "ParameterOutOfRange" if "first > last"
+    void AddRange(unsigned int first,
+                  unsigned int last);
+
+    // "count == 0" means all the frames from "first"
+    void AddFirstAndCount(unsigned int first,
+                          unsigned int count);
+
+    // Parses a comma-separated list of frame indices or of inclusive
+    // ranges of indices, e.g. "0-9,20,30-". Throws "BadRequest" if
+    // the syntax is invalid or if a range is reversed.
+    void ParseRanges(const std::string& ranges);
+
+    bool IsAllFrames() const
+    {
+      return ranges_.empty();
+    }
+
+    // Throws "ParameterOutOfRange" if a range starts after the last
+    // frame. The ranges that extend beyond the last frame are
+    // truncated.
+    void GetFrames(std::vector<unsigned int>& frames,
+                   unsigned int countFrames) const;
+
+    static void FormatPart(std::string& target,
+                           const std::string& boundary,
+                           const std::string& mime,
+                           const std::string& location,
+                           const std::string& content);
+
+    static void FormatClosingBoundary(std::string& target,
+                                      const std::string& boundary);
+  };
+}
@@ -41,6 +41,7 @@
 #include "ExportedResource.h"
 
 #include <list>
+#include <set>
 #include <boost/noncopyable.hpp>
 
 namespace Orthanc
@@ -206,5 +207,63 @@ namespace Orthanc
 
     virtual void Upgrade(unsigned int targetVersion,
                          IStorageArea& storageArea) = 0;
+
+    // Opens an additional connection to the same database, that will
+    // only be used for read-only queries, concurrently with the
+    // primary connection. Returns NULL if the database engine does
+    // not support this feature. The caller takes the ownership of the
+    // returned object.
+    virtual IDatabaseWrapper* OpenReadOnlyConnection() = 0;
+
+    // Reads the statistics of a resource (aggregated over all its
+    // descendants) if the database engine maintains them
+    // incrementally. Returns "false" if this feature is not
+    // supported, in which case the caller must walk the hierarchy.
+    virtual bool LookupResourceStatistics(uint64_t& compressedSize,
+                                          uint64_t& uncompressedSize,
+                                          unsigned int& countStudies,
+                                          unsigned int& countSeries,
+                                          unsigned int& countInstances,
+                                          int64_t id) = 0;
+
+    // Reads the distinct modalities of the series of a study, and the
+    // distinct SOP class UIDs of its instances. "countSopClassUids"
+    // is the number of instances whose SOP class UID is known. Returns
+    // "false" if the database engine does not index these values.
+    virtual bool LookupStudyAggregates(std::set<std::string>& modalities,
+                                       std::set<std::string>& sopClassUids,
+                                       unsigned int& countSopClassUids,
+                                       int64_t study) = 0;
+
+    // Keyset pagination: Lists at most "limit" resources of the given
+    // level whose internal ID is strictly greater than "after", by
+    // increasing internal ID. Contrarily to the "since" argument of
+    // "GetAllPublicIds()", the cost does not depend on the position
+    // of the page.
+    virtual void GetResourcesAfter(std::vector<int64_t>& internalIds,
+                                   std::vector<std::string>& publicIds,
+                                   ResourceType resourceType,
+                                   int64_t after,
+                                   size_t limit) = 0;
+
+    // Reads the main DICOM tags of several resources at once: The
+    // tags of "ids[i]" are stored into "*target[i]". The maps are
+    // allocated by the caller, and "target" must have the same size
+    // as "ids".
+    virtual void GetMainDicomTags(std::vector<DicomMap*>& target,
+                                  const std::vector<int64_t>& ids) = 0;
+
+    // Set-oriented versions of "GetPublicId()", "GetResourceType()"
+    // and "LookupParent()": "target[i]" corresponds to "ids[i]". They
+    // throw "ErrorCode_UnknownResource" if some resource is missing.
+    virtual void GetPublicIds(std::vector<std::string>& target,
+                              const std::vector<int64_t>& ids) = 0;
+
+    virtual void GetResourceTypes(std::vector<ResourceType>& target,
+                                  const std::vector<int64_t>& ids) = 0;
+
+    // "parents[i]" is set to -1 if "ids[i]" has no parent
+    virtual void LookupParents(std::vector<int64_t>& parents,
+                               const std::vector<int64_t>& ids) = 0;
   };
 }
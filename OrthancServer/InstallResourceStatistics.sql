@@ -0,0 +1,201 @@
+-- New in Orthanc 1.4.2 (no change in the version of the database
+-- schema). This table stores the statistics of each resource,
+-- aggregated over all its descendants (including itself), so that
+-- they can be read without walking through the hierarchy. The row
+-- with "id = 0" contains the statistics of the whole database. The
+-- column "parentId" mirrors "Resources.parentId" (using "0" for the
+-- top-level resources): It must remain available while a resource
+-- and its descendants are being deleted by the cascading triggers,
+-- which explains why this table has no foreign key.
+
+CREATE TABLE ResourceStatistics(
+       id INTEGER PRIMARY KEY,
+       parentId INTEGER,
+       countPatients INTEGER,
+       countStudies INTEGER,
+       countSeries INTEGER,
+       countInstances INTEGER,
+       compressedSize INTEGER,
+       uncompressedSize INTEGER
+       );
+
+CREATE INDEX ResourceStatisticsParentIndex ON ResourceStatistics(parentId);
+
+
+-- Initialization of the statistics of the resources that already
+-- exist in the database, from the bottom to the top of the hierarchy
+-- ("1" to "4" correspond to "ResourceType_Patient" to
+-- "ResourceType_Instance" in C++)
+
+INSERT INTO ResourceStatistics
+  SELECT internalId, IFNULL(parentId, 0),
+         resourceType = 1, resourceType = 2, resourceType = 3, resourceType = 4,
+         IFNULL((SELECT SUM(compressedSize) FROM AttachedFiles WHERE id = internalId), 0),
+         IFNULL((SELECT SUM(uncompressedSize) FROM AttachedFiles WHERE id = internalId), 0)
+  FROM Resources;
+
+UPDATE ResourceStatistics SET
+  countInstances = countInstances + IFNULL((SELECT SUM(c.countInstances) FROM ResourceStatistics AS c WHERE c.parentId = ResourceStatistics.id), 0),
+  compressedSize = compressedSize + IFNULL((SELECT SUM(c.compressedSize) FROM ResourceStatistics AS c WHERE c.parentId = ResourceStatistics.id), 0),
+  uncompressedSize = uncompressedSize + IFNULL((SELECT SUM(c.uncompressedSize) FROM ResourceStatistics AS c WHERE c.parentId = ResourceStatistics.id), 0)
+  WHERE id IN (SELECT internalId FROM Resources WHERE resourceType = 3);
+
+UPDATE ResourceStatistics SET
+  countSeries = countSeries + IFNULL((SELECT SUM(c.countSeries) FROM ResourceStatistics AS c WHERE c.parentId = ResourceStatistics.id), 0),
+  countInstances = countInstances + IFNULL((SELECT SUM(c.countInstances) FROM ResourceStatistics AS c WHERE c.parentId = ResourceStatistics.id), 0),
+  compressedSize = compressedSize + IFNULL((SELECT SUM(c.compressedSize) FROM ResourceStatistics AS c WHERE c.parentId = ResourceStatistics.id), 0),
+  uncompressedSize = uncompressedSize + IFNULL((SELECT SUM(c.uncompressedSize) FROM ResourceStatistics AS c WHERE c.parentId = ResourceStatistics.id), 0)
+  WHERE id IN (SELECT internalId FROM Resources WHERE resourceType = 2);
+
+UPDATE ResourceStatistics SET
+  countStudies = countStudies + IFNULL((SELECT SUM(c.countStudies) FROM ResourceStatistics AS c WHERE c.parentId = ResourceStatistics.id), 0),
+  countSeries = countSeries + IFNULL((SELECT SUM(c.countSeries) FROM ResourceStatistics AS c WHERE c.parentId = ResourceStatistics.id), 0),
+  countInstances = countInstances + IFNULL((SELECT SUM(c.countInstances) FROM ResourceStatistics AS c WHERE c.parentId = ResourceStatistics.id), 0),
+  compressedSize = compressedSize + IFNULL((SELECT SUM(c.compressedSize) FROM ResourceStatistics AS c WHERE c.parentId = ResourceStatistics.id), 0),
+  uncompressedSize = uncompressedSize + IFNULL((SELECT SUM(c.uncompressedSize) FROM ResourceStatistics AS c WHERE c.parentId = ResourceStatistics.id), 0)
+  WHERE id IN (SELECT internalId FROM Resources WHERE resourceType = 1);
+
+INSERT INTO ResourceStatistics
+  SELECT 0, NULL,
+         IFNULL(SUM(countPatients), 0), IFNULL(SUM(countStudies), 0),
+         IFNULL(SUM(countSeries), 0), IFNULL(SUM(countInstances), 0),
+         IFNULL(SUM(compressedSize), 0), IFNULL(SUM(uncompressedSize), 0)
+  FROM ResourceStatistics WHERE parentId = 0;
+
+
+-- In the triggers below, the ancestors of a resource are found by
+-- following "ResourceStatistics.parentId" (at most 4 levels,
+-- including the row "0" of the whole database)
+
+CREATE TRIGGER ResourceStatisticsAdded
+AFTER INSERT ON Resources
+BEGIN
+  INSERT INTO ResourceStatistics VALUES (
+    new.internalId, IFNULL(new.parentId, 0),
+    new.resourceType = 1, new.resourceType = 2, new.resourceType = 3, new.resourceType = 4, 0, 0);
+
+  UPDATE ResourceStatistics SET
+    countPatients = countPatients + (new.resourceType = 1),
+    countStudies = countStudies + (new.resourceType = 2),
+    countSeries = countSeries + (new.resourceType = 3),
+    countInstances = countInstances + (new.resourceType = 4)
+  WHERE id IN (
+    IFNULL(new.parentId, 0),
+    (SELECT parentId FROM ResourceStatistics WHERE id = IFNULL(new.parentId, 0)),
+    (SELECT parentId FROM ResourceStatistics WHERE id =
+      (SELECT parentId FROM ResourceStatistics WHERE id = IFNULL(new.parentId, 0))),
+    (SELECT parentId FROM ResourceStatistics WHERE id =
+      (SELECT parentId FROM ResourceStatistics WHERE id =
+        (SELECT parentId FROM ResourceStatistics WHERE id = IFNULL(new.parentId, 0)))));
+END;
+
+CREATE TRIGGER ResourceStatisticsAttached
+AFTER UPDATE OF parentId ON Resources
+FOR EACH ROW WHEN IFNULL(old.parentId, 0) != IFNULL(new.parentId, 0)
+BEGIN
+  UPDATE ResourceStatistics SET
+    countPatients = countPatients - (SELECT countPatients FROM ResourceStatistics WHERE id = new.internalId),
+    countStudies = countStudies - (SELECT countStudies FROM ResourceStatistics WHERE id = new.internalId),
+    countSeries = countSeries - (SELECT countSeries FROM ResourceStatistics WHERE id = new.internalId),
+    countInstances = countInstances - (SELECT countInstances FROM ResourceStatistics WHERE id = new.internalId),
+    compressedSize = compressedSize - (SELECT compressedSize FROM ResourceStatistics WHERE id = new.internalId),
+    uncompressedSize = uncompressedSize - (SELECT uncompressedSize FROM ResourceStatistics WHERE id = new.internalId)
+  WHERE id IN (
+    IFNULL(old.parentId, 0),
+    (SELECT parentId FROM ResourceStatistics WHERE id = IFNULL(old.parentId, 0)),
+    (SELECT parentId FROM ResourceStatistics WHERE id =
+      (SELECT parentId FROM ResourceStatistics WHERE id = IFNULL(old.parentId, 0))),
+    (SELECT parentId FROM ResourceStatistics WHERE id =
+      (SELECT parentId FROM ResourceStatistics WHERE id =
+        (SELECT parentId FROM ResourceStatistics WHERE id = IFNULL(old.parentId, 0)))));
+
+  UPDATE ResourceStatistics SET
+    countPatients = countPatients + (SELECT countPatients FROM ResourceStatistics WHERE id = new.internalId),
+    countStudies = countStudies + (SELECT countStudies FROM ResourceStatistics WHERE id = new.internalId),
+    countSeries = countSeries + (SELECT countSeries FROM ResourceStatistics WHERE id = new.internalId),
+    countInstances = countInstances + (SELECT countInstances FROM ResourceStatistics WHERE id = new.internalId),
+    compressedSize = compressedSize + (SELECT compressedSize FROM ResourceStatistics WHERE id = new.internalId),
+    uncompressedSize = uncompressedSize + (SELECT uncompressedSize FROM ResourceStatistics WHERE id = new.internalId)
+  WHERE id IN (
+    IFNULL(new.parentId, 0),
+    (SELECT parentId FROM ResourceStatistics WHERE id = IFNULL(new.parentId, 0)),
+    (SELECT parentId FROM ResourceStatistics WHERE id =
+      (SELECT parentId FROM ResourceStatistics WHERE id = IFNULL(new.parentId, 0))),
+    (SELECT parentId FROM ResourceStatistics WHERE id =
+      (SELECT parentId FROM ResourceStatistics WHERE id =
+        (SELECT parentId FROM ResourceStatistics WHERE id = IFNULL(new.parentId, 0)))));
+
+  UPDATE ResourceStatistics SET parentId = IFNULL(new.parentId, 0) WHERE id = new.internalId;
+END;
+
+-- The descendants of a deleted resource are deleted by the foreign
+-- keys before this trigger is invoked on the resource itself: At this
+-- point, the statistics of the resource only contain what has not
+-- been subtracted from its ancestors yet
+CREATE TRIGGER ResourceStatisticsDeleted
+AFTER DELETE ON Resources
+BEGIN
+  UPDATE ResourceStatistics SET
+    countPatients = countPatients - (SELECT countPatients FROM ResourceStatistics WHERE id = old.internalId),
+    countStudies = countStudies - (SELECT countStudies FROM ResourceStatistics WHERE id = old.internalId),
+    countSeries = countSeries - (SELECT countSeries FROM ResourceStatistics WHERE id = old.internalId),
+    countInstances = countInstances - (SELECT countInstances FROM ResourceStatistics WHERE id = old.internalId),
+    compressedSize = compressedSize - (SELECT compressedSize FROM ResourceStatistics WHERE id = old.internalId),
+    uncompressedSize = uncompressedSize - (SELECT uncompressedSize FROM ResourceStatistics WHERE id = old.internalId)
+  WHERE id IN (
+    (SELECT parentId FROM ResourceStatistics WHERE id = old.internalId),
+    (SELECT parentId FROM ResourceStatistics WHERE id =
+      (SELECT parentId FROM ResourceStatistics WHERE id = old.internalId)),
+    (SELECT parentId FROM ResourceStatistics WHERE id =
+      (SELECT parentId FROM ResourceStatistics WHERE id =
+        (SELECT parentId FROM ResourceStatistics WHERE id = old.internalId))),
+    (SELECT parentId FROM ResourceStatistics WHERE id =
+      (SELECT parentId FROM ResourceStatistics WHERE id =
+        (SELECT parentId FROM ResourceStatistics WHERE id =
+          (SELECT parentId FROM ResourceStatistics WHERE id = old.internalId)))));
+
+  DELETE FROM ResourceStatistics WHERE id = old.internalId;
+END;
+
+CREATE TRIGGER ResourceStatisticsFileAdded
+AFTER INSERT ON AttachedFiles
+BEGIN
+  UPDATE ResourceStatistics SET
+    compressedSize = compressedSize + new.compressedSize,
+    uncompressedSize = uncompressedSize + new.uncompressedSize
+  WHERE id IN (
+    new.id,
+    (SELECT parentId FROM ResourceStatistics WHERE id = new.id),
+    (SELECT parentId FROM ResourceStatistics WHERE id =
+      (SELECT parentId FROM ResourceStatistics WHERE id = new.id)),
+    (SELECT parentId FROM ResourceStatistics WHERE id =
+      (SELECT parentId FROM ResourceStatistics WHERE id =
+        (SELECT parentId FROM ResourceStatistics WHERE id = new.id))),
+    (SELECT parentId FROM ResourceStatistics WHERE id =
+      (SELECT parentId FROM ResourceStatistics WHERE id =
+        (SELECT parentId FROM ResourceStatistics WHERE id =
+          (SELECT parentId FROM ResourceStatistics WHERE id = new.id)))));
+END;
+
+-- The attachments that are deleted together with their resource are
+-- already taken into account by "ResourceStatisticsDeleted"
+CREATE TRIGGER ResourceStatisticsFileDeleted
+AFTER DELETE ON AttachedFiles
+FOR EACH ROW WHEN EXISTS (SELECT 1 FROM Resources WHERE internalId = old.id)
+BEGIN
+  UPDATE ResourceStatistics SET
+    compressedSize = compressedSize - old.compressedSize,
+    uncompressedSize = uncompressedSize - old.uncompressedSize
+  WHERE id IN (
+    old.id,
+    (SELECT parentId FROM ResourceStatistics WHERE id = old.id),
+    (SELECT parentId FROM ResourceStatistics WHERE id =
+      (SELECT parentId FROM ResourceStatistics WHERE id = old.id)),
+    (SELECT parentId FROM ResourceStatistics WHERE id =
+      (SELECT parentId FROM ResourceStatistics WHERE id =
+        (SELECT parentId FROM ResourceStatistics WHERE id = old.id))),
+    (SELECT parentId FROM ResourceStatistics WHERE id =
+      (SELECT parentId FROM ResourceStatistics WHERE id =
+        (SELECT parentId FROM ResourceStatistics WHERE id =
+          (SELECT parentId FROM ResourceStatistics WHERE id = old.id)))));
+END;
@@ -0,0 +1,97 @@
+-- New in Orthanc 1.4.2 (no change in the version of the database
+-- schema). This table indexes, for each study, the values that are
+-- aggregated over its children by the C-FIND requests at the study
+-- level, so that "ModalitiesInStudy" (0008,0061) and
+-- "SOPClassesInStudy" (0008,0062) can be answered with one lookup,
+-- without reading the DICOM files. There is one row per contributing
+-- resource:
+--   - "type = 1": "Modality" (0008,0060) of a series,
+--   - "type = 2": "SOPClassUID" metadata of an instance (this
+--      corresponds to "MetadataType_Instance_SopClassUid" in C++).
+-- The column "studyId" is NULL as long as the resource is not
+-- attached to its parent study.
+
+CREATE TABLE StudyAggregates(
+       id INTEGER,
+       type INTEGER,
+       studyId INTEGER,
+       value TEXT,
+       PRIMARY KEY(id, type)
+       );
+
+CREATE INDEX StudyAggregatesIndex ON StudyAggregates(studyId);
+
+
+-- Initialization from the resources that already exist in the
+-- database ("3" and "4" correspond to "ResourceType_Series" and
+-- "ResourceType_Instance" in C++)
+
+INSERT INTO StudyAggregates
+  SELECT m.id, 1, series.parentId, m.value
+  FROM MainDicomTags AS m, Resources AS series
+  WHERE m.tagGroup = 8 AND m.tagElement = 96 AND
+        series.internalId = m.id AND series.resourceType = 3;
+
+INSERT INTO StudyAggregates
+  SELECT m.id, 2, series.parentId, m.value
+  FROM Metadata AS m, Resources AS instance
+  LEFT JOIN Resources AS series ON series.internalId = instance.parentId
+  WHERE m.type = 10 AND
+        instance.internalId = m.id AND instance.resourceType = 4;
+
+
+-- The rows are removed together with the main DICOM tags and the
+-- metadata, including when their resource is deleted (the foreign
+-- keys of these tables fire the "AFTER DELETE" triggers)
+
+CREATE TRIGGER StudyAggregatesModalityAdded
+AFTER INSERT ON MainDicomTags
+FOR EACH ROW WHEN new.tagGroup = 8 AND new.tagElement = 96
+BEGIN
+  INSERT OR REPLACE INTO StudyAggregates
+    SELECT new.id, 1, parentId, new.value FROM Resources
+    WHERE internalId = new.id AND resourceType = 3;
+END;
+
+CREATE TRIGGER StudyAggregatesModalityDeleted
+AFTER DELETE ON MainDicomTags
+FOR EACH ROW WHEN old.tagGroup = 8 AND old.tagElement = 96
+BEGIN
+  DELETE FROM StudyAggregates WHERE id = old.id AND type = 1;
+END;
+
+-- "DatabaseWrapper::SetMetadata()" uses "INSERT OR REPLACE", which
+-- does not fire the "AFTER DELETE" trigger below
+CREATE TRIGGER StudyAggregatesSopClassAdded
+AFTER INSERT ON Metadata
+FOR EACH ROW WHEN new.type = 10
+BEGIN
+  INSERT OR REPLACE INTO StudyAggregates
+    SELECT new.id, 2, (SELECT parentId FROM Resources WHERE internalId = instance.parentId), new.value
+    FROM Resources AS instance
+    WHERE instance.internalId = new.id AND instance.resourceType = 4;
+END;
+
+CREATE TRIGGER StudyAggregatesSopClassDeleted
+AFTER DELETE ON Metadata
+FOR EACH ROW WHEN old.type = 10
+BEGIN
+  DELETE FROM StudyAggregates WHERE id = old.id AND type = 2;
+END;
+
+-- The main DICOM tags and the metadata are stored before the
+-- resources are attached to their parent
+CREATE TRIGGER StudyAggregatesAttached
+AFTER UPDATE OF parentId ON Resources
+FOR EACH ROW WHEN new.resourceType = 3 OR new.resourceType = 4
+BEGIN
+  -- A series is attached to a study
+  UPDATE StudyAggregates SET studyId = new.parentId
+    WHERE type = 1 AND id = new.internalId;
+  UPDATE StudyAggregates SET studyId = new.parentId
+    WHERE type = 2 AND id IN (SELECT internalId FROM Resources WHERE parentId = new.internalId);
+
+  -- An instance is attached to a series
+  UPDATE StudyAggregates SET studyId = (SELECT parentId FROM Resources WHERE internalId = new.parentId)
+    WHERE type = 2 AND id = new.internalId;
+END;
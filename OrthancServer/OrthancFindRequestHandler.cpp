@@ -137,39 +137,55 @@ namespace Orthanc
                                             const DicomTag& tag,
                                             const std::list<std::string>& instances)
   {
-    // WARNING: This function is slow, as it reads the JSON file
-    // summarizing each instance of interest from the hard drive.
-
-    std::string formatted = tag.Format();
+    // WARNING: This function is slow, as it reads the summary of
+    // each instance of interest from the hard drive.
 
     for (std::list<std::string>::const_iterator
            it = instances.begin(); it != instances.end(); ++it)
     {
-      Json::Value dicom;
-      context.ReadDicomAsJson(dicom, *it);
-
-      if (dicom.isMember(formatted))
+      std::string value;
+      if (context.LookupStringValue(value, *it, tag))
       {
-        const Json::Value& source = dicom[formatted];
-
-        if (source.type() == Json::objectValue &&
-            source.isMember("Type") &&
-            source.isMember("Value") &&
-            source["Type"].asString() == "String" &&
-            source["Value"].type() == Json::stringValue)
-        {
-          target.insert(source["Value"].asString());
-        }
+        target.insert(value);
       }
     }
   }
 
 
+  static void StoreCounter(DicomMap& result,
+                           const DicomTag& tag,
+                           unsigned int value)
+  {
+    result.SetValue(tag, boost::lexical_cast<std::string>(value), false);
+  }
+
+
   static void ComputePatientCounters(DicomMap& result,
                                      ServerIndex& index,
                                      const std::string& patient,
                                      const DicomMap& query)
   {
+    unsigned int countStudies, countSeries, countInstances;
+    if (index.LookupChildrenCounters(countStudies, countSeries, countInstances, patient))
+    {
+      if (query.HasTag(DICOM_TAG_NUMBER_OF_PATIENT_RELATED_STUDIES))
+      {
+        StoreCounter(result, DICOM_TAG_NUMBER_OF_PATIENT_RELATED_STUDIES, countStudies);
+      }
+
+      if (query.HasTag(DICOM_TAG_NUMBER_OF_PATIENT_RELATED_SERIES))
+      {
+        StoreCounter(result, DICOM_TAG_NUMBER_OF_PATIENT_RELATED_SERIES, countSeries);
+      }
+
+      if (query.HasTag(DICOM_TAG_NUMBER_OF_PATIENT_RELATED_INSTANCES))
+      {
+        StoreCounter(result, DICOM_TAG_NUMBER_OF_PATIENT_RELATED_INSTANCES, countInstances);
+      }
+
+      return;
+    }
+
     std::list<std::string> studies;
     index.GetChildren(studies, patient);
 
@@ -211,6 +227,57 @@ namespace Orthanc
   }
 
 
+  static bool LookupStudyCounters(DicomMap& result,
+                                  ServerIndex& index,
+                                  const std::string& study,
+                                  const DicomMap& query)
+  {
+    unsigned int countStudies, countSeries, countInstances;
+    if (!index.LookupChildrenCounters(countStudies, countSeries, countInstances, study))
+    {
+      return false;
+    }
+
+    std::set<std::string> modalities, sopClassUids;
+    bool hasAllSopClassUids = true;
+
+    if ((query.HasTag(DICOM_TAG_MODALITIES_IN_STUDY) ||
+         query.HasTag(DICOM_TAG_SOP_CLASSES_IN_STUDY)) &&
+        !index.LookupStudyAggregates(modalities, sopClassUids, hasAllSopClassUids, study))
+    {
+      return false;
+    }
+
+    if (query.HasTag(DICOM_TAG_SOP_CLASSES_IN_STUDY) &&
+        !hasAllSopClassUids)
+    {
+      return false;
+    }
+
+    if (query.HasTag(DICOM_TAG_NUMBER_OF_STUDY_RELATED_SERIES))
+    {
+      StoreCounter(result, DICOM_TAG_NUMBER_OF_STUDY_RELATED_SERIES, countSeries);
+    }
+
+    if (query.HasTag(DICOM_TAG_NUMBER_OF_STUDY_RELATED_INSTANCES))
+    {
+      StoreCounter(result, DICOM_TAG_NUMBER_OF_STUDY_RELATED_INSTANCES, countInstances);
+    }
+
+    if (query.HasTag(DICOM_TAG_MODALITIES_IN_STUDY))
+    {
+      StoreSetOfStrings(result, DICOM_TAG_MODALITIES_IN_STUDY, modalities);
+    }
+
+    if (query.HasTag(DICOM_TAG_SOP_CLASSES_IN_STUDY))
+    {
+      StoreSetOfStrings(result, DICOM_TAG_SOP_CLASSES_IN_STUDY, sopClassUids);
+    }
+
+    return true;
+  }
+
+
   static void ComputeStudyCounters(DicomMap& result,
                                    ServerContext& context,
                                    const std::string& study,
@@ -218,6 +285,12 @@ namespace Orthanc
   {
     ServerIndex& index = context.GetIndex();
 
+    if (LookupStudyCounters(result, index, study, query))
+    {
+      // The counters are maintained by the database engine
+      return;
+    }
+
     std::list<std::string> series;
     index.GetChildren(series, study);
     
@@ -278,6 +351,17 @@ namespace Orthanc
                                     const std::string& series,
                                     const DicomMap& query)
   {
+    unsigned int countStudies, countSeries, countInstances;
+    if (index.LookupChildrenCounters(countStudies, countSeries, countInstances, series))
+    {
+      if (query.HasTag(DICOM_TAG_NUMBER_OF_SERIES_RELATED_INSTANCES))
+      {
+        StoreCounter(result, DICOM_TAG_NUMBER_OF_SERIES_RELATED_INSTANCES, countInstances);
+      }
+
+      return;
+    }
+
     std::list<std::string> instances;
     index.GetChildren(instances, series);
 
@@ -359,6 +443,177 @@ namespace Orthanc
   }
 
 
+  static bool IsIndexedTag(const DicomTag& tag,
+                           ResourceType level)
+  {
+    // The tags that are computed by "ComputeCounters()"
+    switch (level)
+    {
+      case ResourceType_Patient:
+        if (tag == DICOM_TAG_NUMBER_OF_PATIENT_RELATED_STUDIES ||
+            tag == DICOM_TAG_NUMBER_OF_PATIENT_RELATED_SERIES ||
+            tag == DICOM_TAG_NUMBER_OF_PATIENT_RELATED_INSTANCES)
+        {
+          return true;
+        }
+        break;
+
+      case ResourceType_Study:
+        if (tag == DICOM_TAG_NUMBER_OF_STUDY_RELATED_SERIES ||
+            tag == DICOM_TAG_NUMBER_OF_STUDY_RELATED_INSTANCES ||
+            tag == DICOM_TAG_SOP_CLASSES_IN_STUDY ||
+            tag == DICOM_TAG_MODALITIES_IN_STUDY)
+        {
+          return true;
+        }
+        break;
+
+      case ResourceType_Series:
+        if (tag == DICOM_TAG_NUMBER_OF_SERIES_RELATED_INSTANCES)
+        {
+          return true;
+        }
+        break;
+
+      default:
+        break;
+    }
+
+    // The main DICOM tags of the level of the query, and of its ancestors
+    for (;;)
+    {
+      std::set<DicomTag> extra;
+      ServerToolbox::GetExtraMainDicomTags(extra, level);
+
+      if (DicomMap::IsMainDicomTag(tag, level) ||
+          extra.find(tag) != extra.end())
+      {
+        return true;
+      }
+
+      if (level == ResourceType_Patient)
+      {
+        return false;
+      }
+
+      level = GetParentResourceType(level);
+    }
+  }
+
+
+  static bool IsAnswerFromIndex(const DicomArray& query,
+                                ResourceType level)
+  {
+    for (size_t i = 0; i < query.GetSize(); i++)
+    {
+      const DicomTag tag = query.GetElement(i).GetTag();
+
+      if (tag != DICOM_TAG_QUERY_RETRIEVE_LEVEL &&
+          tag != DICOM_TAG_SPECIFIC_CHARACTER_SET &&
+          !IsIndexedTag(tag, level))
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+
+  static void MergeMainDicomTags(DicomMap& target,
+                                 ServerIndex& index,
+                                 const std::string& resource,
+                                 ResourceType expectedType,
+                                 ResourceType levelOfInterest)
+  {
+    DicomMap tags;
+    if (!index.GetMainDicomTags(tags, resource, expectedType, levelOfInterest))
+    {
+      throw OrthancException(ErrorCode_UnknownResource);  // The resource was deleted in between
+    }
+
+    DicomArray tmp(tags);
+    for (size_t i = 0; i < tmp.GetSize(); i++)
+    {
+      target.SetValue(tmp.GetElement(i).GetTag(), tmp.GetElement(i).GetValue());
+    }
+  }
+
+
+  static void ReadMainDicomTagsAsJson(Json::Value& target,
+                                      ServerIndex& index,
+                                      const std::string& resource,
+                                      ResourceType level)
+  {
+    // Gather the main DICOM tags of the resource and of its ancestors,
+    // in the same format as "ServerContext::ReadDicomAsJson()"
+    DicomMap tags;
+    std::string current = resource;
+
+    for (;;)
+    {
+      if (level == ResourceType_Study)
+      {
+        // The main DICOM tags of the patient are stored at the study level
+        MergeMainDicomTags(tags, index, current, ResourceType_Study, ResourceType_Patient);
+        MergeMainDicomTags(tags, index, current, ResourceType_Study, ResourceType_Study);
+        break;
+      }
+
+      MergeMainDicomTags(tags, index, current, level, level);
+
+      if (level == ResourceType_Patient)
+      {
+        break;
+      }
+
+      std::string parent;
+      if (!index.LookupParent(parent, current))
+      {
+        throw OrthancException(ErrorCode_UnknownResource);
+      }
+
+      current = parent;
+      level = GetParentResourceType(level);
+    }
+
+    target = Json::objectValue;
+    FromDcmtkBridge::ToJson(target, tags, false /* full format */);
+  }
+
+
+  static void ExtractAnswerTags(Json::Value& target,
+                                const DicomBinarySummary& summary,
+                                const DicomArray& query,
+                                const std::list<DicomTag>& sequencesToReturn)
+  {
+    if (!sequencesToReturn.empty())
+    {
+      // The content of the sequences is only available in JSON
+      summary.ToJson(target);
+      return;
+    }
+
+    // Only extract the requested tags, in the format of
+    // "ServerContext::ReadDicomAsJson()". "AddAnswer()" gives an
+    // empty value to the tags that are absent or that are not strings.
+    target = Json::objectValue;
+
+    for (size_t i = 0; i < query.GetSize(); i++)
+    {
+      const DicomTag& tag = query.GetElement(i).GetTag();
+
+      std::string value;
+      if (summary.LookupStringValue(value, tag))
+      {
+        Json::Value& item = target[tag.Format()];
+        item["Type"] = "String";
+        item["Value"] = value;
+      }
+    }
+  }
+
+
   static void AddAnswer(DicomFindAnswers& answers,
                         const Json::Value& resource,
                         const DicomArray& query,
@@ -648,14 +903,59 @@ namespace Orthanc
     assert(resources.size() == instances.size());
     bool complete = true;
 
+    // If all the constraints were evaluated by the database, and if
+    // all the requested tags are indexed, the answers are built
+    // without reading the summary of the instances from the storage area
+    const bool isAnswerFromIndex = (!finder.HasUnoptimizedConstraints() &&
+                                    sequencesToReturn.empty() &&
+                                    IsAnswerFromIndex(query, level));
+
+    if (isAnswerFromIndex)
+    {
+      LOG(INFO) << "The C-FIND request is answered using the index only";
+    }
+
     for (size_t i = 0; i < instances.size(); i++)
     {
-      // TODO - Don't read the full JSON from the disk if only "main
-      // DICOM tags" are to be returned
+      if (answers.IsCancelled())
+      {
+        // The remote modality has sent a C-CANCEL request
+        LOG(INFO) << "The C-FIND request was cancelled after " << answers.GetSize() << " answers";
+        break;
+      }
+
       Json::Value dicom;
-      context_.ReadDicomAsJson(dicom, instances[i]);
+      bool isMatch;
+
+      if (isAnswerFromIndex)
+      {
+        ReadMainDicomTagsAsJson(dicom, context_.GetIndex(), resources[i], level);
+        isMatch = true;
+      }
+      else
+      {
+        std::string summary;
+        if (context_.ReadDicomSummary(summary, instances[i]))
+        {
+          // Filter by looking up the tags in place, and only extract
+          // the tags of the matching instances
+          DicomBinarySummary binary(summary);
+          isMatch = finder.IsMatch(binary);
+
+          if (isMatch)
+          {
+            ExtractAnswerTags(dicom, binary, query, sequencesToReturn);
+          }
+        }
+        else
+        {
+          // Instance stored by Orthanc <= 1.4.1, not migrated yet
+          context_.ReadDicomAsJson(dicom, instances[i]);
+          isMatch = finder.IsMatch(dicom);
+        }
+      }
       
-      if (finder.IsMatch(dicom))
+      if (isMatch)
       {
         if (maxResults != 0 &&
             answers.GetSize() >= maxResults)
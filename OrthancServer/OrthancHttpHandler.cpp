@@ -63,6 +63,31 @@ namespace Orthanc
   }
 
 
+  bool OrthancHttpHandler::CreateChunkedRequestReader(std::auto_ptr<IChunkedRequestReader>& target,
+                                                      RequestOrigin origin,
+                                                      const char* remoteIp,
+                                                      const char* username,
+                                                      HttpMethod method,
+                                                      const UriComponents& uri,
+                                                      const Arguments& headers)
+  {
+    for (Handlers::const_iterator it = handlers_.begin(); it != handlers_.end(); ++it) 
+    {
+      if ((*it)->CreateChunkedRequestReader(target, origin, remoteIp, username, method, uri, headers))
+      {
+        if (target.get() == NULL)
+        {
+          throw OrthancException(ErrorCode_InternalError);
+        }
+
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+
   void OrthancHttpHandler::Register(IHttpHandler& handler,
                                     bool isOrthancRestApi)
   {
@@ -61,6 +61,14 @@ namespace Orthanc
                         const char* bodyData,
                         size_t bodySize);
 
+    virtual bool CreateChunkedRequestReader(std::auto_ptr<IChunkedRequestReader>& target,
+                                            RequestOrigin origin,
+                                            const char* remoteIp,
+                                            const char* username,
+                                            HttpMethod method,
+                                            const UriComponents& uri,
+                                            const Arguments& headers);
+
     void Register(IHttpHandler& handler,
                   bool isOrthancRestApi);
 
@@ -795,6 +795,53 @@ namespace Orthanc
   }
 
 
+  void Configuration::GetExtraMainDicomTags(std::set<DicomTag>& target,
+                                            ResourceType level)
+  {
+    boost::recursive_mutex::scoped_lock lock(globalMutex_);
+
+    target.clear();
+
+    static const char* const KEY = "ExtraMainDicomTags";
+
+    if (!configuration_.isMember(KEY))
+    {
+      return;
+    }
+
+    const Json::Value& extra = configuration_[KEY];
+    const char* name = EnumerationToString(level);
+
+    if (extra.type() != Json::objectValue)
+    {
+      LOG(ERROR) << "The configuration option \"" << KEY << "\" must be an object";
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    if (!extra.isMember(name))
+    {
+      return;
+    }
+
+    const Json::Value& tags = extra[name];
+    if (tags.type() != Json::arrayValue)
+    {
+      LOG(ERROR) << "Badly formatted list of extra main DICOM tags for level: " << name;
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    for (Json::Value::ArrayIndex i = 0; i < tags.size(); i++)
+    {
+      if (tags[i].type() != Json::stringValue)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+
+      target.insert(FromDcmtkBridge::ParseTag(tags[i].asString()));
+    }
+  }
+
+
   bool Configuration::IsSameAETitle(const std::string& aet1,
                                     const std::string& aet2)
   {
@@ -1011,7 +1058,13 @@ namespace Orthanc
     {
     }
 
-    return new DatabaseWrapper(indexDirectory.string() + "/index");
+    std::auto_ptr<DatabaseWrapper> database(new DatabaseWrapper(indexDirectory.string() + "/index"));
+
+    // The concurrent read-only connections to SQLite require the
+    // normal locking mode of the primary connection
+    database->SetExclusiveLocking(Configuration::GetGlobalUnsignedIntegerParameter("DatabaseReadConnections", 0) == 0);
+
+    return database.release();
   }
 
 
@@ -1054,6 +1107,42 @@ namespace Orthanc
         }
       }
 
+      virtual void ReadRange(std::string& content,
+                             const std::string& uuid,
+                             FileContentType type,
+                             uint64_t start,
+                             uint64_t end)
+      {
+        if (type != FileContentType_Dicom)
+        {
+          storage_.ReadRange(content, uuid, type, start, end);
+        }
+        else
+        {
+          throw OrthancException(ErrorCode_UnknownResource);
+        }
+      }
+
+      virtual bool HasReadRange() const
+      {
+        return storage_.HasReadRange();
+      }
+
+      virtual void CreateFromFile(const std::string& uuid,
+                                  const std::string& path,
+                                  FileContentType type)
+      {
+        if (type != FileContentType_Dicom)
+        {
+          storage_.CreateFromFile(uuid, path, type);
+        }
+      }
+
+      virtual bool HasCreateFromFile() const
+      {
+        return storage_.HasCreateFromFile();
+      }
+
       virtual void Remove(const std::string& uuid,
                           FileContentType type) 
       {
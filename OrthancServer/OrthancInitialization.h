@@ -95,6 +95,9 @@ namespace Orthanc
     static void GetGlobalListOfStringsParameter(std::list<std::string>& target,
                                                 const std::string& key);
 
+    static void GetExtraMainDicomTags(std::set<DicomTag>& target,
+                                      ResourceType level);
+
     static bool IsKnownAETitle(const std::string& aet,
                                const std::string& ip);
 
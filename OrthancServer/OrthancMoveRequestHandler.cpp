@@ -134,6 +134,7 @@ namespace Orthanc
 
         job_->SetDescription("C-MOVE");
         job_->SetPermissive(true);
+        job_->SetLanesCount(std::max(1u, Configuration::GetGlobalUnsignedIntegerParameter("StoreJobsLanes", 1)));
         job_->SetLocalAet(context.GetDefaultLocalApplicationEntityTitle());
         job_->SetRemoteModality(Configuration::GetModalityUsingAet(targetAet));
 
@@ -34,17 +34,27 @@
 #include "../PrecompiledHeadersServer.h"
 #include "OrthancRestApi.h"
 
+#include "../../Core/ChunkedBuffer.h"
+#include "../../Core/Compression/ZipReader.h"
 #include "../../Core/Logging.h"
+#include "../../Core/MetricsRegistry.h"
+#include "../../Core/SystemToolbox.h"
+#include "../../Core/TemporaryFile.h"
+#include "../OrthancInitialization.h"
 #include "../ServerContext.h"
 
+#include <boost/bind.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/thread.hpp>
+
 namespace Orthanc
 {
-  void OrthancRestApi::AnswerStoredResource(RestApiPostCall& call,
-                                            const std::string& publicId,
-                                            ResourceType resourceType,
-                                            StoreStatus status) const
+  static void FormatStoredResource(Json::Value& result,
+                                   const std::string& publicId,
+                                   ResourceType resourceType,
+                                   StoreStatus status)
   {
-    Json::Value result = Json::objectValue;
+    result = Json::objectValue;
 
     if (status != StoreStatus_Failure)
     {
@@ -53,6 +63,16 @@ namespace Orthanc
     }
 
     result["Status"] = EnumerationToString(status);
+  }
+
+
+  void OrthancRestApi::AnswerStoredResource(RestApiPostCall& call,
+                                            const std::string& publicId,
+                                            ResourceType resourceType,
+                                            StoreStatus status) const
+  {
+    Json::Value result;
+    FormatStoredResource(result, publicId, resourceType, status);
     call.GetOutput().AnswerJson(result);
   }
 
@@ -78,6 +98,233 @@ namespace Orthanc
 
   // Upload of DICOM files through HTTP ---------------------------------------
 
+  namespace
+  {
+    /**
+     * Stores the files of a ZIP archive through a pool of threads, so
+     * that the parsing of the DICOM files and the writes to the
+     * storage area overlap, and so that the concurrent transactions
+     * of "ServerIndex::Store()" can be grouped. The files are pushed
+     * by the thread reading the archive into a bounded queue, which
+     * limits the number of uncompressed files in RAM.
+     **/
+    class ZipUploadWorkers : public boost::noncopyable
+    {
+    private:
+      struct Item
+      {
+        size_t       index_;
+        std::string  filename_;
+        std::string  content_;
+      };
+
+      ServerContext&             context_;
+      DicomInstanceOrigin        origin_;
+      Json::Value&               answer_;
+      boost::mutex               mutex_;
+      boost::condition_variable  itemAvailable_;
+      boost::condition_variable  slotAvailable_;
+      std::list<Item*>           queue_;
+      size_t                     capacity_;
+      bool                       done_;
+      boost::thread_group        threads_;
+
+      void Store(Json::Value& status,
+                 const Item& item)
+      {
+        try
+        {
+          DicomInstanceToStore toStore;
+          toStore.SetOrigin(origin_);
+          toStore.SetBuffer(item.content_);
+
+          std::string publicId;
+          StoreStatus result = context_.Store(publicId, toStore);
+          FormatStoredResource(status, publicId, ResourceType_Instance, result);
+        }
+        catch (OrthancException& e)
+        {
+          FormatStoredResource(status, "", ResourceType_Instance, StoreStatus_Failure);
+          status["Error"] = e.What();
+        }
+        catch (std::bad_alloc&)
+        {
+          FormatStoredResource(status, "", ResourceType_Instance, StoreStatus_Failure);
+          status["Error"] = EnumerationToString(ErrorCode_NotEnoughMemory);
+        }
+      }
+
+      void Worker()
+      {
+        for (;;)
+        {
+          std::auto_ptr<Item> item;
+
+          {
+            boost::mutex::scoped_lock lock(mutex_);
+
+            while (queue_.empty() &&
+                   !done_)
+            {
+              itemAvailable_.wait(lock);
+            }
+
+            if (queue_.empty())
+            {
+              return;  // All the files have been stored
+            }
+
+            item.reset(queue_.front());
+            queue_.pop_front();
+          }
+
+          slotAvailable_.notify_one();
+
+          Json::Value status;
+
+          try
+          {
+            Store(status, *item);
+          }
+          catch (...)
+          {
+            LOG(ERROR) << "Native exception while storing a file from a ZIP archive: " << item->filename_;
+            FormatStoredResource(status, "", ResourceType_Instance, StoreStatus_Failure);
+          }
+
+          SetStatus(item->index_, item->filename_, status);
+        }
+      }
+
+    public:
+      ZipUploadWorkers(ServerContext& context,
+                       const DicomInstanceOrigin& origin,
+                       Json::Value& answer,
+                       size_t threadsCount) :
+        context_(context),
+        origin_(origin),
+        answer_(answer),
+        capacity_(threadsCount),
+        done_(false)
+      {
+        if (threadsCount == 0)
+        {
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
+        }
+
+        for (size_t i = 0; i < threadsCount; i++)
+        {
+          threads_.create_thread(boost::bind(&ZipUploadWorkers::Worker, this));
+        }
+      }
+
+      ~ZipUploadWorkers()
+      {
+        Finish();
+
+        for (std::list<Item*>::iterator it = queue_.begin(); it != queue_.end(); ++it)
+        {
+          delete *it;
+        }
+      }
+
+      void SetStatus(size_t index,
+                     const std::string& filename,
+                     Json::Value& status)
+      {
+        status["Filename"] = filename;
+
+        boost::mutex::scoped_lock lock(mutex_);
+        answer_[static_cast<Json::Value::ArrayIndex>(index)] = status;
+      }
+
+      // The content is swapped with an empty string
+      void Push(size_t index,
+                const std::string& filename,
+                std::string& content)
+      {
+        std::auto_ptr<Item> item(new Item);
+        item->index_ = index;
+        item->filename_ = filename;
+        item->content_.swap(content);
+
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+
+          while (queue_.size() >= capacity_)
+          {
+            slotAvailable_.wait(lock);
+          }
+
+          queue_.push_back(item.release());
+        }
+
+        itemAvailable_.notify_one();
+      }
+
+      void Finish()
+      {
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          done_ = true;
+        }
+
+        itemAvailable_.notify_all();
+        threads_.join_all();
+      }
+    };
+  }
+
+
+  static void StoreZipArchive(Json::Value& answer,
+                              ServerContext& context,
+                              const DicomInstanceOrigin& origin,
+                              ZipReader& zip)
+  {
+    const size_t count = zip.GetFilesCount();
+
+    LOG(INFO) << "Receiving a ZIP archive with " << count << " files through HTTP";
+
+    zip.SetMaximumFileSize(static_cast<uint64_t>(Configuration::GetGlobalUnsignedIntegerParameter(
+                                                   "ZipUploadMaximumFileSize", 1024)) * 1024 * 1024);
+
+    answer = Json::arrayValue;
+    answer.resize(static_cast<Json::Value::ArrayIndex>(count));
+
+    if (count == 0)
+    {
+      return;
+    }
+
+    const size_t threadsCount = std::min(count, static_cast<size_t>(
+      std::max(1u, Configuration::GetGlobalUnsignedIntegerParameter("ZipUploadThreads", 4))));
+
+    ZipUploadWorkers workers(context, origin, answer, threadsCount);
+
+    for (size_t i = 0; i < count; i++)
+    {
+      std::string content;
+
+      try
+      {
+        zip.ReadFile(content, i);
+      }
+      catch (OrthancException& e)
+      {
+        Json::Value status;
+        FormatStoredResource(status, "", ResourceType_Instance, StoreStatus_Failure);
+        status["Error"] = e.What();
+        workers.SetStatus(i, zip.GetFilename(i), status);
+        continue;
+      }
+
+      workers.Push(i, zip.GetFilename(i), content);
+    }
+
+    workers.Finish();
+  }
+
+
   static void UploadDicomFile(RestApiPostCall& call)
   {
     ServerContext& context = OrthancRestApi::GetContext(call);
@@ -87,6 +334,16 @@ namespace Orthanc
       return;
     }
 
+    if (ZipReader::IsZipMemoryBuffer(call.GetBodyData(), call.GetBodySize()))
+    {
+      std::auto_ptr<ZipReader> zip(ZipReader::CreateFromMemory(call.GetBodyData(), call.GetBodySize()));
+
+      Json::Value answer;
+      StoreZipArchive(answer, context, DicomInstanceOrigin::FromRest(call), *zip);
+      call.GetOutput().AnswerJson(answer);
+      return;
+    }
+
     LOG(INFO) << "Receiving a DICOM file of " << call.GetBodySize() << " bytes through HTTP";
 
     // TODO Remove unneccessary memcpy
@@ -103,6 +360,183 @@ namespace Orthanc
   }
 
 
+  namespace
+  {
+    /**
+     * Receives the body of "POST /instances" while it is read from
+     * the network. Small bodies are kept in RAM, larger ones are
+     * spooled to a temporary file, that is parsed with its large
+     * values (e.g. the pixel data) left on the disk, then copied into
+     * the storage area: A large upload is never fully loaded in
+     * memory. ZIP archives are read from the temporary file one file
+     * at a time.
+     **/
+    class DicomUploadReader : public IHttpHandler::IChunkedRequestReader
+    {
+    private:
+      static const size_t  MEMORY_THRESHOLD = 16 * 1024 * 1024;
+
+      ServerContext&                           context_;
+      DicomInstanceOrigin                      origin_;
+      ChunkedBuffer                            memory_;
+      std::auto_ptr<TemporaryFile>             file_;
+      std::auto_ptr<boost::filesystem::ofstream>  stream_;
+      uint64_t                                 size_;
+      bool                                     isZip_;
+
+      void WriteToFile(const void* data,
+                       size_t size)
+      {
+        if (size > 0)
+        {
+          stream_->write(reinterpret_cast<const char*>(data), size);
+          if (!stream_->good())
+          {
+            throw OrthancException(ErrorCode_CannotWriteFile);
+          }
+        }
+      }
+
+    public:
+      DicomUploadReader(ServerContext& context,
+                        const DicomInstanceOrigin& origin,
+                        bool isZip) :
+        context_(context),
+        origin_(origin),
+        size_(0),
+        isZip_(isZip)
+      {
+      }
+
+      virtual void AddBodyChunk(const void* data,
+                                size_t size)
+      {
+        if (size_ == 0)
+        {
+          // Sniff the first bytes, as ZIP archives are often posted
+          // without the "application/zip" content type
+          isZip_ = isZip_ || ZipReader::IsZipMemoryBuffer(data, size);
+        }
+
+        if (file_.get() == NULL &&
+            memory_.GetNumBytes() + size > MEMORY_THRESHOLD)
+        {
+          // Switch from RAM to a temporary file
+          file_.reset(new TemporaryFile);
+          stream_.reset(new boost::filesystem::ofstream(file_->GetPath(), std::ios::binary));
+
+          std::string flushed;
+          memory_.Flatten(flushed);
+          WriteToFile(flushed.c_str(), flushed.size());
+        }
+
+        if (file_.get() == NULL)
+        {
+          memory_.AddChunk(data, size);
+        }
+        else
+        {
+          WriteToFile(data, size);
+        }
+
+        size_ += size;
+      }
+
+      virtual void Execute(HttpOutput& output)
+      {
+        MetricsRegistry::Timer timer(context_.GetMetricsRegistry(), "orthanc_rest_api_duration_seconds",
+                                     MetricsRegistry::FormatLabel("method", "POST") + "," +
+                                     MetricsRegistry::FormatLabel("route", "/instances"));
+
+        if (size_ == 0)
+        {
+          output.SendStatus(HttpStatus_400_BadRequest);
+          return;
+        }
+
+        Json::Value result;
+
+        if (isZip_)
+        {
+          std::auto_ptr<ZipReader> zip;
+
+          if (file_.get() == NULL)
+          {
+            std::string body;
+            memory_.Flatten(body);
+            zip.reset(ZipReader::CreateFromMemory(body));
+          }
+          else
+          {
+            stream_->close();
+            zip.reset(ZipReader::CreateFromFile(file_->GetPath()));
+          }
+
+          StoreZipArchive(result, context_, origin_, *zip);
+        }
+        else
+        {
+          LOG(INFO) << "Receiving a DICOM file of " << size_ << " bytes through HTTP";
+
+          std::string body;
+
+          DicomInstanceToStore toStore;
+          toStore.SetOrigin(origin_);
+
+          if (file_.get() == NULL)
+          {
+            memory_.Flatten(body);
+            toStore.SetBuffer(body);
+          }
+          else
+          {
+            stream_->close();
+            toStore.SetFile(file_->GetPath());
+          }
+
+          std::string publicId;
+          StoreStatus status = context_.Store(publicId, toStore);
+          FormatStoredResource(result, publicId, ResourceType_Instance, status);
+        }
+
+        RestApiOutput restOutput(output, HttpMethod_Post);
+        restOutput.AnswerJson(result);
+      }
+    };
+  }
+
+
+  bool OrthancRestApi::CreateChunkedRequestReader(std::auto_ptr<IChunkedRequestReader>& target,
+                                                  RequestOrigin origin,
+                                                  const char* remoteIp,
+                                                  const char* username,
+                                                  HttpMethod method,
+                                                  const UriComponents& uri,
+                                                  const Arguments& headers)
+  {
+    if (method == HttpMethod_Post &&
+        uri.size() == 1 &&
+        uri[0] == "instances")
+    {
+      bool isZip = false;
+
+      Arguments::const_iterator contentType = headers.find("content-type");
+      if (contentType != headers.end())
+      {
+        std::string mime = Toolbox::StripSpaces(contentType->second.substr(0, contentType->second.find(';')));
+        Toolbox::ToLowerCase(mime);
+        isZip = (mime == "application/zip");
+      }
+
+      target.reset(new DicomUploadReader(context_, DicomInstanceOrigin::FromHttp(remoteIp, username), isZip));
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
 
   // Registration of the various REST handlers --------------------------------
 
@@ -111,6 +545,8 @@ namespace Orthanc
     leaveBarrier_(false),
     resetRequestReceived_(false)
   {
+    SetMetricsRegistry(context.GetMetricsRegistry());
+
     RegisterSystem();
 
     RegisterChanges();
@@ -96,5 +96,13 @@ namespace Orthanc
                               const std::string& publicId,
                               ResourceType resourceType,
                               StoreStatus status) const;
+
+    virtual bool CreateChunkedRequestReader(std::auto_ptr<IChunkedRequestReader>& target,
+                                            RequestOrigin origin,
+                                            const char* remoteIp,
+                                            const char* username,
+                                            HttpMethod method,
+                                            const UriComponents& uri,
+                                            const Arguments& headers);
   };
 }
@@ -35,11 +35,169 @@
 #include "OrthancRestApi.h"
 
 #include "../../Core/HttpServer/FilesystemHttpSender.h"
+#include "../../Core/HttpServer/IHttpStreamAnswer.h"
+#include "../../Core/Logging.h"
+#include "../OrthancInitialization.h"
 #include "../ServerJobs/ArchiveJob.h"
 
 namespace Orthanc
 {
-  static bool AddResourcesOfInterest(ArchiveJob& job,
+  namespace
+  {
+    // Collects the bytes of the ZIP archive that are ready to be sent
+    class PendingOutputStream : public ZipWriter::IOutputStream
+    {
+    private:
+      std::string&  pending_;
+
+    public:
+      PendingOutputStream(std::string& pending) :
+        pending_(pending)
+      {
+      }
+
+      virtual void Write(const std::string& chunk)
+      {
+        pending_.append(chunk);
+      }
+
+      virtual void Close()
+      {
+      }
+    };
+
+
+    /**
+     * Streams an archive to the HTTP client while it is being
+     * created, using the chunked transfer encoding: The steps of the
+     * archive job are executed synchronously in the HTTP thread each
+     * time the HTTP server asks for a new chunk. This avoids writing
+     * the archive into a temporary file, and the download starts as
+     * soon as the first instance is compressed.
+     **/
+    class ArchiveStreamAnswer : public IHttpStreamAnswer
+    {
+    private:
+      std::string                pending_;   // Must be declared before "job_"
+      std::string                chunk_;
+      std::auto_ptr<ArchiveJob>  job_;
+      std::string                filename_;
+      bool                       started_;
+      bool                       done_;
+
+    public:
+      ArchiveStreamAnswer(ServerContext& context,
+                          bool isMedia,
+                          bool enableExtendedSopClass,
+                          const std::string& filename) :
+        job_(new ArchiveJob(new PendingOutputStream(pending_), context,
+                            isMedia, enableExtendedSopClass)),
+        filename_(filename),
+        started_(false),
+        done_(false)
+      {
+      }
+
+      ArchiveJob& GetJob()
+      {
+        return *job_;
+      }
+
+      // To be called once the resources are added, before the HTTP
+      // header is sent, so that errors are reported to the client
+      void Start()
+      {
+        if (started_)
+        {
+          throw OrthancException(ErrorCode_BadSequenceOfCalls);
+        }
+
+        job_->Start();
+        started_ = true;
+      }
+
+      virtual HttpCompression SetupHttpCompression(bool /*gzipAllowed*/,
+                                                   bool /*deflateAllowed*/)
+      {
+        return HttpCompression_None;   // ZIP archives are already compressed
+      }
+
+      virtual bool HasContentFilename(std::string& filename)
+      {
+        filename = filename_;
+        return true;
+      }
+
+      virtual std::string GetContentType()
+      {
+        return "application/zip";
+      }
+
+      virtual bool HasContentLength()
+      {
+        return false;
+      }
+
+      virtual uint64_t GetContentLength()
+      {
+        throw OrthancException(ErrorCode_BadSequenceOfCalls);
+      }
+
+      virtual bool SetRange(uint64_t /*start*/,
+                            uint64_t /*end*/)
+      {
+        return false;
+      }
+
+      virtual bool ReadNextChunk()
+      {
+        if (!started_)
+        {
+          throw OrthancException(ErrorCode_BadSequenceOfCalls);
+        }
+
+        while (pending_.empty() &&
+               !done_)
+        {
+          JobStepResult result = job_->ExecuteStep();
+
+          switch (result.GetCode())
+          {
+            case JobStepCode_Continue:
+              break;
+
+            case JobStepCode_Success:
+              done_ = true;   // The central directory is now in "pending_"
+              break;
+
+            case JobStepCode_Failure:
+              throw OrthancException(result.GetFailureCode());
+
+            default:
+              throw OrthancException(ErrorCode_InternalError);
+          }
+        }
+
+        chunk_.swap(pending_);
+        pending_.clear();
+
+        return !chunk_.empty();
+      }
+
+      virtual const char* GetChunkContent()
+      {
+        return chunk_.c_str();
+      }
+
+      virtual size_t GetChunkSize()
+      {
+        return chunk_.size();
+      }
+    };
+  }
+
+
+  static bool GetResourcesOfInterest(std::list<std::string>& target,
                                      RestApiPostCall& call)
   {
     Json::Value resources;
@@ -53,7 +211,7 @@ namespace Orthanc
           return false;   // Bad request
         }
 
-        job.AddResource(resources[i].asString());
+        target.push_back(resources[i].asString());
       }
 
       return true;
@@ -94,17 +252,50 @@ namespace Orthanc
     }      
   }
 
-  
-  static void CreateBatchArchive(RestApiPostCall& call)
+
+  static void SendArchive(RestApiCall& call,
+                          const std::list<std::string>& resources,
+                          bool isMedia,
+                          bool enableExtendedSopClass,
+                          const std::string& filename)
   {
     ServerContext& context = OrthancRestApi::GetContext(call);
 
-    boost::shared_ptr<TemporaryFile> tmp(new TemporaryFile);
-    std::auto_ptr<ArchiveJob> job(new ArchiveJob(tmp, context, false, false));
+    if (Configuration::GetGlobalBoolParameter("SynchronousZipStream", false))
+    {
+      ArchiveStreamAnswer answer(context, isMedia, enableExtendedSopClass, filename);
 
-    if (AddResourcesOfInterest(*job, call))
+      for (std::list<std::string>::const_iterator
+             it = resources.begin(); it != resources.end(); ++it)
+      {
+        answer.GetJob().AddResource(*it);
+      }
+
+      answer.Start();
+      call.GetOutput().AnswerStream(answer);
+    }
+    else
     {
-      SubmitJob(call, tmp, context, job, "Archive.zip");
+      boost::shared_ptr<TemporaryFile> tmp(new TemporaryFile);
+      std::auto_ptr<ArchiveJob> job(new ArchiveJob(tmp, context, isMedia, enableExtendedSopClass));
+
+      for (std::list<std::string>::const_iterator
+             it = resources.begin(); it != resources.end(); ++it)
+      {
+        job->AddResource(*it);
+      }
+
+      SubmitJob(call, tmp, context, job, filename);
+    }
+  }
+
+  
+  static void CreateBatchArchive(RestApiPostCall& call)
+  {
+    std::list<std::string> resources;
+    if (GetResourcesOfInterest(resources, call))
+    {
+      SendArchive(call, resources, false, false, "Archive.zip");
     }
   }  
 
@@ -112,43 +303,33 @@ namespace Orthanc
   template <bool Extended>
   static void CreateBatchMedia(RestApiPostCall& call)
   {
-    ServerContext& context = OrthancRestApi::GetContext(call);
-
-    boost::shared_ptr<TemporaryFile> tmp(new TemporaryFile);
-    std::auto_ptr<ArchiveJob> job(new ArchiveJob(tmp, context, true, Extended));
-
-    if (AddResourcesOfInterest(*job, call))
+    std::list<std::string> resources;
+    if (GetResourcesOfInterest(resources, call))
     {
-      SubmitJob(call, tmp, context, job, "Archive.zip");
+      SendArchive(call, resources, true, Extended, "Archive.zip");
     }
   }
   
 
   static void CreateArchive(RestApiGetCall& call)
   {
-    ServerContext& context = OrthancRestApi::GetContext(call);
-
     std::string id = call.GetUriComponent("id", "");
 
-    boost::shared_ptr<TemporaryFile> tmp(new TemporaryFile);
-    std::auto_ptr<ArchiveJob> job(new ArchiveJob(tmp, context, false, false));
-    job->AddResource(id);
+    std::list<std::string> resources;
+    resources.push_back(id);
 
-    SubmitJob(call, tmp, context, job, id + ".zip");
+    SendArchive(call, resources, false, false, id + ".zip");
   }
 
 
   static void CreateMedia(RestApiGetCall& call)
   {
-    ServerContext& context = OrthancRestApi::GetContext(call);
-
     std::string id = call.GetUriComponent("id", "");
 
-    boost::shared_ptr<TemporaryFile> tmp(new TemporaryFile);
-    std::auto_ptr<ArchiveJob> job(new ArchiveJob(tmp, context, true, call.HasArgument("extended")));
-    job->AddResource(id);
+    std::list<std::string> resources;
+    resources.push_back(id);
 
-    SubmitJob(call, tmp, context, job, id + ".zip");
+    SendArchive(call, resources, true, call.HasArgument("extended"), id + ".zip");
   }
 
 
@@ -705,8 +705,16 @@ namespace Orthanc
     bool permissive = Toolbox::GetJsonBooleanField(request, "Permissive", false);
     bool asynchronous = Toolbox::GetJsonBooleanField(request, "Asynchronous", false);
     int priority = Toolbox::GetJsonIntegerField(request, "Priority", 0);
+    unsigned int lanes = Toolbox::GetJsonUnsignedIntegerField
+      (request, "Lanes", Configuration::GetGlobalUnsignedIntegerParameter("StoreJobsLanes", 1));
+
+    if (lanes == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
 
     job->SetPermissive(permissive);
+    job->SetLanesCount(lanes);
     
     if (asynchronous)
     {
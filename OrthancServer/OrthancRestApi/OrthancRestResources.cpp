@@ -38,9 +38,14 @@
 #include "../../Core/DicomParsing/FromDcmtkBridge.h"
 #include "../../Core/DicomParsing/Internals/DicomImageDecoder.h"
 #include "../../Core/HttpServer/HttpContentNegociation.h"
+#include "../../Core/HttpServer/IHttpStreamAnswer.h"
+#include "../../Core/Images/Image.h"
+#include "../../Core/Images/ImageProcessing.h"
 #include "../../Core/Logging.h"
+#include "../FramesBatch.h"
 #include "../OrthancInitialization.h"
 #include "../Search/LookupResource.h"
+#include "../ServerJobs/DicomSummaryMigrationJob.h"
 #include "../ServerContext.h"
 #include "../ServerToolbox.h"
 #include "../SliceOrdering.h"
@@ -118,18 +123,14 @@ namespace Orthanc
   {
     Json::Value answer = Json::arrayValue;
 
-    for (std::list<std::string>::const_iterator
-           resource = resources.begin(); resource != resources.end(); ++resource)
+    if (expand)
     {
-      if (expand)
-      {
-        Json::Value item;
-        if (index.LookupResource(item, *resource, level))
-        {
-          answer.append(item);
-        }
-      }
-      else
+      index.ExpandResources(answer, resources, level);
+    }
+    else
+    {
+      for (std::list<std::string>::const_iterator
+             resource = resources.begin(); resource != resources.end(); ++resource)
       {
         answer.append(*resource);
       }
@@ -146,8 +147,35 @@ namespace Orthanc
 
     std::list<std::string> result;
 
-    if (call.HasArgument("limit") ||
-        call.HasArgument("since"))
+    if (call.HasArgument("after"))
+    {
+      // Keyset pagination: The page starts after the given cursor
+      // (as returned by the previous page), or after the resource
+      // whose identifier is given, which is not slowed down by the
+      // offset
+      if (call.HasArgument("since"))
+      {
+        LOG(ERROR) << "The \"since\" and \"after\" arguments cannot be combined in GET request against: "
+                   << call.FlattenUri();
+        throw OrthancException(ErrorCode_BadRequest);
+      }
+
+      if (!call.HasArgument("limit"))
+      {
+        LOG(ERROR) << "Missing \"limit\" argument for GET request against: " << call.FlattenUri();
+        throw OrthancException(ErrorCode_BadRequest);
+      }
+
+      size_t limit = boost::lexical_cast<size_t>(call.GetArgument("limit", ""));
+
+      // The cursor of the next page is returned as an HTTP header, in
+      // order to keep the format of the answer unchanged
+      std::string cursor;
+      index.GetAllUuidsAfter(result, cursor, resourceType, call.GetArgument("after", ""), limit);
+      call.GetOutput().AddHeader("X-Orthanc-Next-After", cursor);
+    }
+    else if (call.HasArgument("limit") ||
+             call.HasArgument("since"))
     {
       if (!call.HasArgument("limit"))
       {
@@ -334,160 +362,171 @@ namespace Orthanc
 
   namespace
   {
-    class ImageToEncode
+    class SelectImageFormat : public HttpContentNegociation::IHandler
     {
     private:
-      std::auto_ptr<ImageAccessor>&  image_;
-      ImageExtractionMode            mode_;
-      bool                           invert_;
-      std::string                    format_;
-      std::string                    answer_;
+      std::string&  mime_;
 
     public:
-      ImageToEncode(std::auto_ptr<ImageAccessor>& image,
-                    ImageExtractionMode mode,
-                    bool invert) :
-        image_(image),
-        mode_(mode),
-        invert_(invert)
+      SelectImageFormat(std::string& mime) : mime_(mime)
       {
       }
 
-      void Answer(RestApiOutput& output)
+      virtual void Handle(const std::string& type,
+                          const std::string& subtype)
       {
-        output.AnswerBuffer(answer_, format_);
+        mime_ = type + "/" + subtype;
       }
+    };
 
-      void EncodeUsingPng()
-      {
-        format_ = "image/png";
-        DicomImageDecoder::ExtractPngImage(answer_, image_, mode_, invert_);
-      }
 
-      void EncodeUsingPam()
+    // Rendering of one decoded frame before its encoding
+    class IFrameRenderer : public boost::noncopyable
+    {
+    public:
+      virtual ~IFrameRenderer()
       {
-        /**
-         * "No Internet Media Type (aka MIME type, content type) for
-         * PBM has been registered with IANA, but the unofficial value
-         * image/x-portable-arbitrarymap is assigned by this
-         * specification, to be consistent with conventional values
-         * for the older Netpbm formats."
-         * http://netpbm.sourceforge.net/doc/pam.html
-         **/
-        format_ = "image/x-portable-arbitrarymap";
-        DicomImageDecoder::ExtractPamImage(answer_, image_, mode_, invert_);
       }
 
-      void EncodeUsingJpeg(uint8_t quality)
-      {
-        format_ = "image/jpeg";
-        DicomImageDecoder::ExtractJpegImage(answer_, image_, mode_, invert_, quality);
-      }
-    };
+      // Identifies the rendering in the cache of the rendered frames
+      virtual std::string GetCacheParameters() const = 0;
 
-    class EncodePng : public HttpContentNegociation::IHandler
-    {
-    private:
-      ImageToEncode&  image_;
+      // Whether the rendering can be stored on the disk by the cache
+      virtual bool IsPersistent() const = 0;
 
-    public:
-      EncodePng(ImageToEncode& image) : image_(image)
-      {
-      }
+      // Whether "Render()" uses the DICOM tags of the instance
+      virtual bool IsUsingDicomTags() const = 0;
 
-      virtual void Handle(const std::string& type,
-                          const std::string& subtype)
-      {
-        assert(type == "image");
-        assert(subtype == "png");
-        image_.EncodeUsingPng();
-      }
+      virtual void Render(std::auto_ptr<ImageAccessor>& image,
+                          ImageExtractionMode& mode,
+                          bool& invert,
+                          const DicomMap& tags) = 0;
     };
+  }
 
-    class EncodePam : public HttpContentNegociation::IHandler
-    {
-    private:
-      ImageToEncode&  image_;
 
-    public:
-      EncodePam(ImageToEncode& image) : image_(image)
-      {
-      }
+  // Returns "false" if the client accepts none of the supported formats
+  static bool NegotiateImageFormat(std::string& mime,
+                                   const RestApiGetCall& call)
+  {
+    SelectImageFormat handler(mime);
 
-      virtual void Handle(const std::string& type,
-                          const std::string& subtype)
+    /**
+     * "No Internet Media Type (aka MIME type, content type) for
+     * PBM has been registered with IANA, but the unofficial value
+     * image/x-portable-arbitrarymap is assigned by this
+     * specification, to be consistent with conventional values
+     * for the older Netpbm formats."
+     * http://netpbm.sourceforge.net/doc/pam.html
+     **/
+
+    HttpContentNegociation negociation;
+    negociation.Register("image/png", handler);
+    negociation.Register("image/jpeg", handler);
+    negociation.Register("image/x-portable-arbitrarymap", handler);
+
+    return negociation.Apply(call.GetHttpHeaders());
+  }
+
+
+  static uint8_t GetJpegQuality(const RestApiGetCall& call)
+  {
+    std::string v = call.GetArgument("quality", "90" /* default JPEG quality */);
+
+    try
+    {
+      unsigned int quality = boost::lexical_cast<unsigned int>(v);
+      if (quality >= 1 && quality <= 100)
       {
-        assert(type == "image");
-        assert(subtype == "x-portable-arbitrarymap");
-        image_.EncodeUsingPam();
+        return static_cast<uint8_t>(quality);
       }
-    };
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+    }
 
-    class EncodeJpeg : public HttpContentNegociation::IHandler
+    LOG(ERROR) << "Bad quality for a JPEG encoding (must be a number between 0 and 100): " << v;
+    throw OrthancException(ErrorCode_BadRequest);
+  }
+
+
+  static void EncodeImage(std::string& target,
+                          std::auto_ptr<ImageAccessor>& image,
+                          ImageExtractionMode mode,
+                          bool invert,
+                          const std::string& mime,
+                          uint8_t quality)
+  {
+    if (mime == "image/png")
     {
-    private:
-      ImageToEncode&  image_;
-      unsigned int    quality_;
+      DicomImageDecoder::ExtractPngImage(target, image, mode, invert);
+    }
+    else if (mime == "image/jpeg")
+    {
+      DicomImageDecoder::ExtractJpegImage(target, image, mode, invert, quality);
+    }
+    else
+    {
+      assert(mime == "image/x-portable-arbitrarymap");
+      DicomImageDecoder::ExtractPamImage(target, image, mode, invert);
+    }
+  }
 
-    public:
-      EncodeJpeg(ImageToEncode& image,
-                 const RestApiGetCall& call) :
-        image_(image)
-      {
-        std::string v = call.GetArgument("quality", "90" /* default JPEG quality */);
-        bool ok = false;
 
-        try
-        {
-          quality_ = boost::lexical_cast<unsigned int>(v);
-          ok = (quality_ >= 1 && quality_ <= 100);
-        }
-        catch (boost::bad_lexical_cast&)
-        {
-        }
+  static void ExtractRenderingTags(DicomMap& target,
+                                   ParsedDicomFile& dicom)
+  {
+    static const DicomTag TAGS[] = {
+      DICOM_TAG_PHOTOMETRIC_INTERPRETATION,
+      DICOM_TAG_RESCALE_INTERCEPT,
+      DICOM_TAG_RESCALE_SLOPE,
+      DICOM_TAG_WINDOW_CENTER,
+      DICOM_TAG_WINDOW_WIDTH
+    };
 
-        if (!ok)
+    for (size_t i = 0; i < sizeof(TAGS) / sizeof(DicomTag); i++)
+    {
+      std::string value;
+      if (dicom.GetTagValue(value, TAGS[i]))
+      {
+        // Only keep the first value of multi-valued tags (such as
+        // several windows)
+        size_t separator = value.find('\\');
+        if (separator != std::string::npos)
         {
-          LOG(ERROR) << "Bad quality for a JPEG encoding (must be a number between 0 and 100): " << v;
-          throw OrthancException(ErrorCode_BadRequest);
+          value.resize(separator);
         }
-      }
 
-      virtual void Handle(const std::string& type,
-                          const std::string& subtype)
-      {
-        assert(type == "image");
-        assert(subtype == "jpeg");
-        image_.EncodeUsingJpeg(quality_);
+        target.SetValue(TAGS[i], value, false);
       }
-    };
+    }
   }
 
 
-  template <enum ImageExtractionMode mode>
-  static void GetImage(RestApiGetCall& call)
+  static bool IsMonochrome1(const DicomMap& tags)
   {
-    ServerContext& context = OrthancRestApi::GetContext(call);
-
-    std::string frameId = call.GetUriComponent("frame", "0");
+    const DicomValue* value = tags.TestAndGetValue(DICOM_TAG_PHOTOMETRIC_INTERPRETATION);
+    return (value != NULL &&
+            !value->IsNull() &&
+            !value->IsBinary() &&
+            Toolbox::StripSpaces(value->GetContent()) == "MONOCHROME1");
+  }
 
-    unsigned int frame;
-    try
-    {
-      frame = boost::lexical_cast<unsigned int>(frameId);
-    }
-    catch (boost::bad_lexical_cast)
-    {
-      return;
-    }
 
-    bool invert = false;
-    std::auto_ptr<ImageAccessor> decoded;
+  // Decodes one frame of a DICOM instance. If "tags" is not NULL, it
+  // receives the DICOM tags that drive the rendering of the frame. If
+  // the frame cannot be decoded, "decoded" is left empty. Returns
+  // "false" iff the client was redirected to the "unsupported" image.
+  static bool DecodeFrame(std::auto_ptr<ImageAccessor>& decoded,
+                          DicomMap* tags,
+                          RestApiGetCall& call,
+                          const std::string& publicId,
+                          unsigned int frame)
+  {
+    ServerContext& context = OrthancRestApi::GetContext(call);
 
     try
     {
-      std::string publicId = call.GetUriComponent("id", "");
-
 #if ORTHANC_ENABLE_PLUGINS == 1
       if (context.GetPlugins().HasCustomImageDecoder())
       {
@@ -503,19 +542,14 @@ namespace Orthanc
          * the cache below.
          **/
 
-        if (mode == ImageExtractionMode_Preview &&
+        if (tags != NULL &&
             decoded.get() != NULL)
         {
           // TODO Optimize this lookup for photometric interpretation:
           // It should be implemented by the plugin to avoid parsing
           // twice the DICOM file
           ParsedDicomFile parsed(dicomContent);
-          
-          PhotometricInterpretation photometric;
-          if (parsed.LookupPhotometricInterpretation(photometric))
-          {
-            invert = (photometric == PhotometricInterpretation_Monochrome1);
-          }
+          ExtractRenderingTags(*tags, parsed);
         }
       }
 #endif
@@ -527,11 +561,9 @@ namespace Orthanc
         ServerContext::DicomCacheLocker locker(context, publicId);        
         decoded.reset(DicomImageDecoder::Decode(locker.GetDicom(), frame));
 
-        PhotometricInterpretation photometric;
-        if (mode == ImageExtractionMode_Preview &&
-            locker.GetDicom().LookupPhotometricInterpretation(photometric))
+        if (tags != NULL)
         {
-          invert = (photometric == PhotometricInterpretation_Monochrome1);
+          ExtractRenderingTags(*tags, locker.GetDicom());
         }
       }
     }
@@ -551,25 +583,356 @@ namespace Orthanc
         }
 
         call.GetOutput().Redirect(root + "app/images/unsupported.png");
+        return false;
       }
     }
 
-    ImageToEncode image(decoded, mode, invert);
+    return true;
+  }
 
-    HttpContentNegociation negociation;
-    EncodePng png(image);
-    negociation.Register("image/png", png);
 
-    EncodeJpeg jpeg(image, call);
-    negociation.Register("image/jpeg", jpeg);
+  static void AnswerRenderedFrame(RestApiGetCall& call,
+                                  IFrameRenderer& renderer)
+  {
+    ServerContext& context = OrthancRestApi::GetContext(call);
 
-    EncodePam pam(image);
-    negociation.Register("image/x-portable-arbitrarymap", pam);
+    std::string frameId = call.GetUriComponent("frame", "0");
 
-    if (negociation.Apply(call.GetHttpHeaders()))
+    unsigned int frame;
+    try
     {
-      image.Answer(call.GetOutput());
+      frame = boost::lexical_cast<unsigned int>(frameId);
     }
+    catch (boost::bad_lexical_cast)
+    {
+      return;
+    }
+
+    std::string mime;
+    if (!NegotiateImageFormat(mime, call))
+    {
+      return;
+    }
+
+    const uint8_t quality = GetJpegQuality(call);
+
+    std::string parameters = (frameId + "|" + renderer.GetCacheParameters() + "|" + mime);
+    if (mime == "image/jpeg")
+    {
+      parameters += "|" + boost::lexical_cast<std::string>(static_cast<int>(quality));
+    }
+
+    std::string publicId = call.GetUriComponent("id", "");
+    std::string answer, cacheKey;
+
+    if (context.LookupRenderedFrame(answer, cacheKey, publicId, parameters, renderer.IsPersistent()))
+    {
+      call.GetOutput().AnswerBuffer(answer, mime);
+      return;
+    }
+
+    std::auto_ptr<ImageAccessor> image;
+    DicomMap tags;
+    if (!DecodeFrame(image, (renderer.IsUsingDicomTags() ? &tags : NULL), call, publicId, frame))
+    {
+      return;
+    }
+
+    ImageExtractionMode mode = ImageExtractionMode_Preview;
+    bool invert = false;
+
+    if (image.get() != NULL)
+    {
+      renderer.Render(image, mode, invert, tags);
+    }
+
+    // This throws an exception if the frame cannot be decoded
+    EncodeImage(answer, image, mode, invert, mime, quality);
+
+    context.StoreRenderedFrame(cacheKey, publicId, answer, renderer.IsPersistent());
+    call.GetOutput().AnswerBuffer(answer, mime);
+  }
+
+
+  namespace
+  {
+    class ExtractionModeRenderer : public IFrameRenderer
+    {
+    private:
+      ImageExtractionMode  mode_;
+
+    public:
+      ExtractionModeRenderer(ImageExtractionMode mode) :
+        mode_(mode)
+      {
+      }
+
+      virtual std::string GetCacheParameters() const
+      {
+        switch (mode_)
+        {
+          case ImageExtractionMode_Preview:
+            return "preview";
+
+          case ImageExtractionMode_UInt8:
+            return "uint8";
+
+          case ImageExtractionMode_UInt16:
+            return "uint16";
+
+          case ImageExtractionMode_Int16:
+            return "int16";
+
+          default:
+            throw OrthancException(ErrorCode_ParameterOutOfRange);
+        }
+      }
+
+      virtual bool IsPersistent() const
+      {
+        return false;
+      }
+
+      virtual bool IsUsingDicomTags() const
+      {
+        // The photometric interpretation is only used by previews
+        return mode_ == ImageExtractionMode_Preview;
+      }
+
+      virtual void Render(std::auto_ptr<ImageAccessor>& image,
+                          ImageExtractionMode& mode,
+                          bool& invert,
+                          const DicomMap& tags)
+      {
+        // The extraction mode is applied during the encoding
+        mode = mode_;
+        invert = (mode_ == ImageExtractionMode_Preview && IsMonochrome1(tags));
+      }
+    };
+  }
+
+
+  template <enum ImageExtractionMode mode>
+  static void GetImage(RestApiGetCall& call)
+  {
+    ExtractionModeRenderer renderer(mode);
+    AnswerRenderedFrame(call, renderer);
+  }
+
+
+  static unsigned int GetRenderedSize(const RestApiGetCall& call,
+                                      const char* argument)
+  {
+    std::string value = call.GetArgument(argument, "");
+    if (value.empty())
+    {
+      return 0;  // Not specified
+    }
+
+    try
+    {
+      int size = boost::lexical_cast<int>(value);
+      if (size > 0)
+      {
+        return static_cast<unsigned int>(size);
+      }
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+    }
+
+    LOG(ERROR) << "Bad value for argument \"" << argument << "\" (must be a positive integer): " << value;
+    throw OrthancException(ErrorCode_BadRequest);
+  }
+
+
+  static bool LookupRenderedWindowing(float& target,
+                                      const RestApiGetCall& call,
+                                      const char* argument)
+  {
+    std::string value = call.GetArgument(argument, "");
+    if (value.empty())
+    {
+      return false;
+    }
+
+    try
+    {
+      target = boost::lexical_cast<float>(value);
+      return true;
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+      LOG(ERROR) << "Bad value for argument \"" << argument << "\" (must be a number): " << value;
+      throw OrthancException(ErrorCode_BadRequest);
+    }
+  }
+
+
+  namespace
+  {
+    /**
+     * Renders a frame as a 8bpp image, by applying the rescale
+     * slope/intercept and the windowing, and by downscaling it so
+     * that it fits within the box "width" x "height" (keeping the
+     * aspect ratio), in one single pass over the pixels. Contrarily
+     * to "/preview", the window defaults to the one that is specified
+     * in the DICOM tags. The pixels are never upscaled.
+     **/
+    class WindowingRenderer : public IFrameRenderer
+    {
+    private:
+      unsigned int  maxWidth_;
+      unsigned int  maxHeight_;
+      bool          hasCenter_;
+      float         center_;
+      bool          hasWidth_;
+      float         width_;
+
+    public:
+      WindowingRenderer(const RestApiGetCall& call) :
+        maxWidth_(GetRenderedSize(call, "width")),
+        maxHeight_(GetRenderedSize(call, "height")),
+        center_(0),
+        width_(0)
+      {
+        hasCenter_ = LookupRenderedWindowing(center_, call, "window-center");
+        hasWidth_ = LookupRenderedWindowing(width_, call, "window-width");
+
+        if (hasWidth_ &&
+            width_ < 1.0f)
+        {
+          LOG(ERROR) << "The width of the window must be at least 1: " << width_;
+          throw OrthancException(ErrorCode_BadRequest);
+        }
+      }
+
+      virtual std::string GetCacheParameters() const
+      {
+        return ("rendered|" +
+                boost::lexical_cast<std::string>(maxWidth_) + "|" +
+                boost::lexical_cast<std::string>(maxHeight_) + "|" +
+                (hasCenter_ ? boost::lexical_cast<std::string>(center_) : "") + "|" +
+                (hasWidth_ ? boost::lexical_cast<std::string>(width_) : ""));
+      }
+
+      virtual bool IsPersistent() const
+      {
+        // Only the thumbnails are stored on the disk
+        return (maxWidth_ != 0 ||
+                maxHeight_ != 0);
+      }
+
+      virtual bool IsUsingDicomTags() const
+      {
+        return true;
+      }
+
+      virtual void Render(std::auto_ptr<ImageAccessor>& image,
+                          ImageExtractionMode& mode,
+                          bool& invert,
+                          const DicomMap& tags)
+      {
+        unsigned int width = image->GetWidth();
+        unsigned int height = image->GetHeight();
+
+        float scaling = 1.0f;
+
+        if (maxWidth_ != 0 &&
+            maxWidth_ < width)
+        {
+          scaling = static_cast<float>(maxWidth_) / static_cast<float>(width);
+        }
+
+        if (maxHeight_ != 0 &&
+            maxHeight_ < height)
+        {
+          scaling = std::min(scaling, static_cast<float>(maxHeight_) / static_cast<float>(height));
+        }
+
+        if (scaling < 1.0f)
+        {
+          width = std::max(1, boost::math::iround(scaling * static_cast<float>(width)));
+          height = std::max(1, boost::math::iround(scaling * static_cast<float>(height)));
+        }
+
+        if (image->GetFormat() == PixelFormat_RGB48)
+        {
+          std::auto_ptr<ImageAccessor> converted
+            (new Image(PixelFormat_RGB24, image->GetWidth(), image->GetHeight(), false));
+          ImageProcessing::Convert(*converted, *image);
+          image = converted;
+        }
+
+        std::auto_ptr<ImageAccessor> rendered;
+
+        if (image->GetFormat() == PixelFormat_RGB24)
+        {
+          // No windowing on color images
+          rendered.reset(new Image(PixelFormat_RGB24, width, height, false));
+          ImageProcessing::Resize(*rendered, *image);
+
+          // The "preview" mode leaves RGB24 images unchanged
+          mode = ImageExtractionMode_Preview;
+        }
+        else
+        {
+          float slope, intercept;
+          if (!tags.ParseFloat(slope, DICOM_TAG_RESCALE_SLOPE))
+          {
+            slope = 1.0f;
+          }
+
+          if (!tags.ParseFloat(intercept, DICOM_TAG_RESCALE_INTERCEPT))
+          {
+            intercept = 0.0f;
+          }
+
+          float center, windowWidth;
+          if (!tags.ParseFloat(center, DICOM_TAG_WINDOW_CENTER) ||
+              !tags.ParseFloat(windowWidth, DICOM_TAG_WINDOW_WIDTH) ||
+              windowWidth < 1.0f)
+          {
+            // No valid window in the DICOM tags: Stretch the range of
+            // the pixels, as in "/preview"
+            int64_t a, b;
+            ImageProcessing::GetMinMaxIntegerValue(a, b, *image);
+
+            const float x = static_cast<float>(a) * slope + intercept;
+            const float y = static_cast<float>(b) * slope + intercept;
+            center = (x + y) / 2.0f + 0.5f;
+            windowWidth = std::abs(y - x) + 1.0f;
+          }
+
+          if (hasCenter_)
+          {
+            center = center_;
+          }
+
+          if (hasWidth_)
+          {
+            windowWidth = width_;
+          }
+
+          rendered.reset(new Image(PixelFormat_Grayscale8, width, height, false));
+          ImageProcessing::ApplyWindowing(*rendered, *image, center, windowWidth,
+                                          slope, intercept, IsMonochrome1(tags));
+
+          // The "uint8" mode leaves Grayscale8 images unchanged
+          mode = ImageExtractionMode_UInt8;
+        }
+
+        image = rendered;
+        invert = false;
+      }
+    };
+  }
+
+
+  static void GetRenderedFrame(RestApiGetCall& call)
+  {
+    WindowingRenderer renderer(call);
+    AnswerRenderedFrame(call, renderer);
   }
 
 
@@ -645,6 +1008,422 @@ namespace Orthanc
   }
 
 
+  namespace
+  {
+    /**
+     * Streams a batch of frames of one instance as a multipart answer,
+     * using the chunked transfer encoding. The frames are read from
+     * the DICOM file of the cache (hence from its "DicomFrameIndex")
+     * by a background thread, that prepares the next frame (possibly
+     * decoding and encoding it) while the current frame is sent to the
+     * HTTP client. The entry of the cache is only locked while a frame
+     * is copied out of it, not while waiting for a slow client.
+     **/
+    class FramesBatchAnswer : public IHttpStreamAnswer
+    {
+    private:
+      ServerContext&                  context_;
+      std::string                     publicId_;
+      FramesBatch                     batch_;
+      std::auto_ptr<IFrameRenderer>   renderer_;   // NULL for raw frames
+      std::string                     mime_;
+      uint8_t                         quality_;
+      std::string                     boundary_;
+
+      boost::mutex                    mutex_;
+      boost::condition_variable       produced_;
+      boost::condition_variable       consumed_;
+      std::string                     contentType_;
+      std::string                     next_;
+      bool                            hasNext_;
+      bool                            done_;
+      bool                            stopped_;
+      bool                            hasError_;
+      ErrorCode                       error_;
+      boost::thread                   thread_;
+
+      std::string                     chunk_;
+      bool                            closed_;
+
+      void RenderFrame(std::string& target,
+                       ParsedDicomFile& dicom,
+                       std::string& dicomContent,
+                       const DicomMap& tags,
+                       unsigned int frame)
+      {
+        std::auto_ptr<ImageAccessor> image;
+
+#if ORTHANC_ENABLE_PLUGINS == 1
+        if (context_.GetPlugins().HasCustomImageDecoder())
+        {
+          if (dicomContent.empty())
+          {
+            context_.ReadDicom(dicomContent, publicId_);
+          }
+
+          image.reset(context_.GetPlugins().DecodeUnsafe(dicomContent.c_str(), dicomContent.size(), frame));
+        }
+#endif
+
+        if (image.get() == NULL)
+        {
+          image.reset(DicomImageDecoder::Decode(dicom, frame));
+        }
+
+        ImageExtractionMode mode = ImageExtractionMode_Preview;
+        bool invert = false;
+        renderer_->Render(image, mode, invert, tags);
+
+        EncodeImage(target, image, mode, invert, mime_, quality_);
+      }
+
+      void Produce()
+      {
+        std::vector<unsigned int> frames;
+        DicomMap tags;
+
+        {
+          ServerContext::DicomCacheLocker locker(context_, publicId_);
+          ParsedDicomFile& dicom = locker.GetDicom();
+
+          batch_.GetFrames(frames, dicom.GetFramesCount());
+
+          if (renderer_.get() != NULL &&
+              renderer_->IsUsingDicomTags())
+          {
+            ExtractRenderingTags(tags, dicom);
+          }
+        }
+
+        std::string dicomContent;  // Only read if a decoder plugin is installed
+
+        for (size_t i = 0; i < frames.size(); i++)
+        {
+          const unsigned int frame = frames[i];
+          std::string content, mime;
+
+          {
+            // The cache entry is released before waiting for the
+            // previous frame to be consumed by the HTTP client
+            ServerContext::DicomCacheLocker locker(context_, publicId_);
+
+            if (renderer_.get() == NULL)
+            {
+              locker.GetDicom().GetRawFrame(content, mime, frame);
+            }
+            else
+            {
+              RenderFrame(content, locker.GetDicom(), dicomContent, tags, frame);
+              mime = mime_;
+            }
+          }
+
+          std::string part;
+          FramesBatch::FormatPart(part, boundary_, mime, "instances/" + publicId_ + "/frames/" +
+                                  boost::lexical_cast<std::string>(frame), content);
+          content.clear();
+
+          boost::mutex::scoped_lock lock(mutex_);
+
+          while (hasNext_ &&
+                 !stopped_)
+          {
+            consumed_.wait(lock);
+          }
+
+          if (stopped_)
+          {
+            return;
+          }
+
+          if (i == 0)
+          {
+            contentType_ = mime;
+          }
+
+          next_.swap(part);
+          hasNext_ = true;
+          produced_.notify_one();
+        }
+      }
+
+      static void Worker(FramesBatchAnswer* that)
+      {
+        try
+        {
+          that->Produce();
+        }
+        catch (OrthancException& e)
+        {
+          boost::mutex::scoped_lock lock(that->mutex_);
+          that->hasError_ = true;
+          that->error_ = e.GetErrorCode();
+        }
+        catch (std::bad_alloc&)
+        {
+          boost::mutex::scoped_lock lock(that->mutex_);
+          that->hasError_ = true;
+          that->error_ = ErrorCode_NotEnoughMemory;
+        }
+        catch (...)
+        {
+          // No exception must escape from the thread, which would
+          // terminate Orthanc
+          LOG(ERROR) << "Native exception while preparing a batch of frames";
+          boost::mutex::scoped_lock lock(that->mutex_);
+          that->hasError_ = true;
+          that->error_ = ErrorCode_InternalError;
+        }
+
+        boost::mutex::scoped_lock lock(that->mutex_);
+        that->done_ = true;
+        that->produced_.notify_one();
+      }
+
+    public:
+      // Takes the ownership of "renderer", if any
+      FramesBatchAnswer(ServerContext& context,
+                        const std::string& publicId,
+                        const FramesBatch& batch,
+                        IFrameRenderer* renderer,
+                        const std::string& mime,
+                        uint8_t quality) :
+        context_(context),
+        publicId_(publicId),
+        batch_(batch),
+        renderer_(renderer),
+        mime_(mime),
+        quality_(quality),
+        boundary_(Toolbox::GenerateUuid()),
+        hasNext_(false),
+        done_(false),
+        stopped_(false),
+        hasError_(false),
+        error_(ErrorCode_Success),
+        closed_(false)
+      {
+      }
+
+      virtual ~FramesBatchAnswer()
+      {
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          stopped_ = true;
+          consumed_.notify_one();
+        }
+
+        if (thread_.joinable())
+        {
+          thread_.join();
+        }
+      }
+
+      // Waits for the first frame, before the HTTP header is sent, so
+      // that errors are reported to the client. Returns "false" if
+      // the batch contains no frame.
+      bool Start()
+      {
+        thread_ = boost::thread(Worker, this);
+
+        boost::mutex::scoped_lock lock(mutex_);
+
+        while (!hasNext_ &&
+               !done_)
+        {
+          produced_.wait(lock);
+        }
+
+        if (hasNext_)
+        {
+          return true;
+        }
+        else if (hasError_)
+        {
+          throw OrthancException(error_);
+        }
+        else
+        {
+          return false;
+        }
+      }
+
+      virtual HttpCompression SetupHttpCompression(bool /*gzipAllowed*/,
+                                                   bool /*deflateAllowed*/)
+      {
+        return HttpCompression_None;
+      }
+
+      virtual bool HasContentFilename(std::string& /*filename*/)
+      {
+        return false;
+      }
+
+      virtual std::string GetContentType()
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        return ("multipart/related; type=" + contentType_ + "; boundary=" + boundary_);
+      }
+
+      virtual bool HasContentLength()
+      {
+        return false;
+      }
+
+      virtual uint64_t GetContentLength()
+      {
+        throw OrthancException(ErrorCode_BadSequenceOfCalls);
+      }
+
+      virtual bool SetRange(uint64_t /*start*/,
+                            uint64_t /*end*/)
+      {
+        return false;
+      }
+
+      virtual bool ReadNextChunk()
+      {
+        if (closed_)
+        {
+          return false;
+        }
+
+        boost::mutex::scoped_lock lock(mutex_);
+
+        while (!hasNext_ &&
+               !done_)
+        {
+          produced_.wait(lock);
+        }
+
+        if (hasNext_)
+        {
+          chunk_.swap(next_);
+          next_.clear();
+          hasNext_ = false;
+          consumed_.notify_one();
+        }
+        else if (hasError_)
+        {
+          // The HTTP header is already sent: The connection is closed
+          LOG(ERROR) << "Error while sending a batch of frames: " << EnumerationToString(error_);
+          throw OrthancException(error_);
+        }
+        else
+        {
+          FramesBatch::FormatClosingBoundary(chunk_, boundary_);
+          closed_ = true;
+        }
+
+        return true;
+      }
+
+      virtual const char* GetChunkContent()
+      {
+        return chunk_.c_str();
+      }
+
+      virtual size_t GetChunkSize()
+      {
+        return chunk_.size();
+      }
+    };
+  }
+
+
+  static unsigned int GetFramesBatchArgument(const RestApiGetCall& call,
+                                             const char* argument)
+  {
+    std::string value = call.GetArgument(argument, "");
+    if (value.empty())
+    {
+      return 0;
+    }
+
+    try
+    {
+      return boost::lexical_cast<unsigned int>(value);
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+      LOG(ERROR) << "Bad value for argument \"" << argument << "\" (must be a positive integer): " << value;
+      throw OrthancException(ErrorCode_BadRequest);
+    }
+  }
+
+
+  // If "renderer" is NULL, the raw frames are sent
+  static void AnswerFramesBatch(RestApiGetCall& call,
+                                std::auto_ptr<IFrameRenderer>& renderer)
+  {
+    // By default, all the frames are sent. The argument "frames" is a
+    // list of ranges of frames (e.g. "0-9,20,30-"). Alternatively, the
+    // argument "count" is the maximum number of frames that are sent,
+    // starting from the frame whose index is given by "first".
+    FramesBatch batch;
+
+    if (call.HasArgument("frames"))
+    {
+      if (call.HasArgument("first") ||
+          call.HasArgument("count"))
+      {
+        LOG(ERROR) << "The argument \"frames\" cannot be combined with \"first\" and \"count\"";
+        throw OrthancException(ErrorCode_BadRequest);
+      }
+
+      batch.ParseRanges(call.GetArgument("frames", ""));
+    }
+    else if (call.HasArgument("first") ||
+             call.HasArgument("count"))
+    {
+      batch.AddFirstAndCount(GetFramesBatchArgument(call, "first"),
+                             GetFramesBatchArgument(call, "count"));
+    }
+
+    std::string mime;
+    uint8_t quality = 0;
+
+    if (renderer.get() != NULL)
+    {
+      if (!NegotiateImageFormat(mime, call))
+      {
+        return;
+      }
+
+      quality = GetJpegQuality(call);
+    }
+
+    FramesBatchAnswer answer(OrthancRestApi::GetContext(call), call.GetUriComponent("id", ""),
+                             batch, renderer.release(), mime, quality);
+
+    if (answer.Start())
+    {
+      call.GetOutput().AnswerStream(answer);
+    }
+  }
+
+
+  static void GetRawFramesBatch(RestApiGetCall& call)
+  {
+    std::auto_ptr<IFrameRenderer> renderer;  // NULL
+    AnswerFramesBatch(call, renderer);
+  }
+
+
+  template <enum ImageExtractionMode mode>
+  static void GetImagesBatch(RestApiGetCall& call)
+  {
+    std::auto_ptr<IFrameRenderer> renderer(new ExtractionModeRenderer(mode));
+    AnswerFramesBatch(call, renderer);
+  }
+
+
+  static void GetRenderedFramesBatch(RestApiGetCall& call)
+  {
+    std::auto_ptr<IFrameRenderer> renderer(new WindowingRenderer(call));
+    AnswerFramesBatch(call, renderer);
+  }
+
+
 
   static void GetResourceStatistics(RestApiGetCall& call)
   {
@@ -801,8 +1580,32 @@ namespace Orthanc
   }
 
 
+  static bool IsGeneratedDicomAsJson(RestApiCall& call)
+  {
+    // Since Orthanc 1.4.2, the "DICOM-as-JSON" attachment of the new
+    // instances is replaced by their binary summary, from which it
+    // is generated on demand
+    std::string publicId = call.GetUriComponent("id", "");
+    FileInfo info;
+
+    return (call.GetUriComponent("resourceType", "") == "instances" &&
+            StringToContentType(call.GetUriComponent("name", "")) == FileContentType_DicomAsJson &&
+            !OrthancRestApi::GetIndex(call).LookupAttachment(info, publicId, FileContentType_DicomAsJson) &&
+            OrthancRestApi::GetIndex(call).LookupAttachment(info, publicId, FileContentType_DicomSummary));
+  }
+
+
   static void GetAttachmentOperations(RestApiGetCall& call)
   {
+    if (IsGeneratedDicomAsJson(call))
+    {
+      Json::Value operations = Json::arrayValue;
+      operations.append("compressed-data");
+      operations.append("data");
+      call.GetOutput().AnswerJson(operations);
+      return;
+    }
+
     FileInfo info;
     if (GetAttachmentInfo(info, call))
     {
@@ -849,7 +1652,13 @@ namespace Orthanc
     std::string publicId = call.GetUriComponent("id", "");
     FileContentType type = StringToContentType(call.GetUriComponent("name", ""));
 
-    if (uncompress)
+    if (IsGeneratedDicomAsJson(call))
+    {
+      std::string json;
+      context.ReadDicomAsJson(json, publicId);
+      call.GetOutput().AnswerBuffer(json, "application/json");
+    }
+    else if (uncompress)
     {
       context.AnswerAttachment(call.GetOutput(), publicId, type);
     }
@@ -994,7 +1803,8 @@ namespace Orthanc
       allowed = true;
     }
     else if (Configuration::GetGlobalBoolParameter("StoreDicom", true) &&
-             contentType == FileContentType_DicomAsJson)
+             (contentType == FileContentType_DicomAsJson ||
+              contentType == FileContentType_DicomSummary))
     {
       allowed = true;
     }
@@ -1533,6 +2343,7 @@ namespace Orthanc
              instance = instances.begin(); instance != instances.end(); ++instance)
       {
         index.DeleteAttachment(*instance, FileContentType_DicomAsJson);
+        index.DeleteAttachment(*instance, FileContentType_DicomSummary);
       }
     }
 
@@ -1540,6 +2351,51 @@ namespace Orthanc
   }
 
 
+  static void MigrateDicomAsJson(RestApiPostCall& call)
+  {
+    // curl http://localhost:8042/tools/migrate-dicom-as-json -X POST -d '{"Priority":-10}'
+    ServerContext& context = OrthancRestApi::GetContext(call);
+
+    Json::Value request = Json::objectValue;
+    if (call.GetBodySize() != 0 &&
+        (!call.ParseJsonRequest(request) ||
+         request.type() != Json::objectValue))
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    int priority = Toolbox::GetJsonIntegerField(request, "Priority", 0);
+    unsigned int lanes = Toolbox::GetJsonUnsignedIntegerField(request, "Lanes", 1);
+
+    if (lanes == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    std::list<std::string> instances;
+    context.GetIndex().GetAllUuids(instances, ResourceType_Instance);
+
+    std::auto_ptr<DicomSummaryMigrationJob> job(new DicomSummaryMigrationJob(context));
+    job->SetDescription("REST API");
+    job->SetPermissive(true);
+    job->SetLanesCount(lanes);
+    job->Reserve(instances.size());
+
+    for (std::list<std::string>::const_iterator
+           it = instances.begin(); it != instances.end(); ++it)
+    {
+      job->AddInstance(*it);
+    }
+
+    std::string id;
+    context.GetJobsEngine().GetRegistry().Submit(id, job.release(), priority);
+
+    Json::Value v;
+    v["ID"] = id;
+    call.GetOutput().AnswerJson(v);
+  }
+
+
   template <enum ResourceType type>
   static void ReconstructResource(RestApiPostCall& call)
   {
@@ -1587,14 +2443,22 @@ namespace Orthanc
     Register("/instances/{id}/frames", ListFrames);
 
     Register("/instances/{id}/frames/{frame}/preview", GetImage<ImageExtractionMode_Preview>);
+    Register("/instances/{id}/frames/{frame}/rendered", GetRenderedFrame);
     Register("/instances/{id}/frames/{frame}/image-uint8", GetImage<ImageExtractionMode_UInt8>);
     Register("/instances/{id}/frames/{frame}/image-uint16", GetImage<ImageExtractionMode_UInt16>);
     Register("/instances/{id}/frames/{frame}/image-int16", GetImage<ImageExtractionMode_Int16>);
     Register("/instances/{id}/frames/{frame}/matlab", GetMatlabImage);
     Register("/instances/{id}/frames/{frame}/raw", GetRawFrame<false>);
     Register("/instances/{id}/frames/{frame}/raw.gz", GetRawFrame<true>);
+    Register("/instances/{id}/frames-batch/preview", GetImagesBatch<ImageExtractionMode_Preview>);
+    Register("/instances/{id}/frames-batch/rendered", GetRenderedFramesBatch);
+    Register("/instances/{id}/frames-batch/image-uint8", GetImagesBatch<ImageExtractionMode_UInt8>);
+    Register("/instances/{id}/frames-batch/image-uint16", GetImagesBatch<ImageExtractionMode_UInt16>);
+    Register("/instances/{id}/frames-batch/image-int16", GetImagesBatch<ImageExtractionMode_Int16>);
+    Register("/instances/{id}/frames-batch/raw", GetRawFramesBatch);
     Register("/instances/{id}/pdf", ExtractPdf);
     Register("/instances/{id}/preview", GetImage<ImageExtractionMode_Preview>);
+    Register("/instances/{id}/rendered", GetRenderedFrame);
     Register("/instances/{id}/image-uint8", GetImage<ImageExtractionMode_UInt8>);
     Register("/instances/{id}/image-uint16", GetImage<ImageExtractionMode_UInt16>);
     Register("/instances/{id}/image-int16", GetImage<ImageExtractionMode_Int16>);
@@ -1625,6 +2489,7 @@ namespace Orthanc
     Register("/{resourceType}/{id}/attachments/{name}/verify-md5", VerifyAttachment);
 
     Register("/tools/invalidate-tags", InvalidateTags);
+    Register("/tools/migrate-dicom-as-json", MigrateDicomAsJson);
     Register("/tools/lookup", Lookup);
     Register("/tools/find", Find);
 
@@ -91,9 +91,25 @@ namespace Orthanc
   {
     Json::Value result = Json::objectValue;
     OrthancRestApi::GetIndex(call).ComputeStatistics(result);
+    OrthancRestApi::GetContext(call).GetDicomCacheStatistics(result["DicomCache"]);
+    OrthancRestApi::GetContext(call).GetRenderedCacheStatistics(result["RenderedCache"]);
+
+    Json::Value dicomServer;
+    if (OrthancRestApi::GetContext(call).GetDicomServerStatistics(dicomServer))
+    {
+      result["DicomServer"] = dicomServer;
+    }
     call.GetOutput().AnswerJson(result);
   }
 
+  static void GetMetrics(RestApiGetCall& call)
+  {
+    // Text format of Prometheus
+    std::string metrics;
+    OrthancRestApi::GetContext(call).ExportMetrics(metrics);
+    call.GetOutput().AnswerBuffer(metrics, "text/plain; version=0.0.4");
+  }
+
   static void GenerateUid(RestApiGetCall& call)
   {
     std::string level = call.GetArgument("level", "");
@@ -367,6 +383,7 @@ namespace Orthanc
     Register("/", ServeRoot);
     Register("/system", GetSystemInformation);
     Register("/statistics", GetStatistics);
+    Register("/tools/metrics", GetMetrics);
     Register("/tools/generate-uid", GenerateUid);
     Register("/tools/execute-script", ExecuteScript);
     Register("/tools/now", GetNowIsoString<true>);
@@ -63,6 +63,26 @@ namespace Orthanc
         mainTags_.insert(tags[i]);
       }
     }    
+
+    // The extra main DICOM tags of the patients are also stored at
+    // the study level by "ServerToolbox::StoreMainDicomTags()"
+    std::set<DicomTag> extra;
+    ServerToolbox::GetExtraMainDicomTags(extra, level);
+
+    if (level == ResourceType_Study)
+    {
+      std::set<DicomTag> patient;
+      ServerToolbox::GetExtraMainDicomTags(patient, ResourceType_Patient);
+      extra.insert(patient.begin(), patient.end());
+    }
+
+    for (std::set<DicomTag>::const_iterator it = extra.begin(); it != extra.end(); ++it)
+    {
+      if (identifiers_.find(*it) == identifiers_.end())
+      {
+        mainTags_.insert(*it);
+      }
+    }
   }
 
   LookupResource::Level::~Level()
@@ -307,6 +327,23 @@ namespace Orthanc
   }
 
 
+  bool LookupResource::IsMatch(const DicomBinarySummary& summary) const
+  {
+    for (Constraints::const_iterator it = unoptimizedConstraints_.begin(); 
+         it != unoptimizedConstraints_.end(); ++it)
+    {
+      std::string value;
+      if (!summary.LookupStringValue(value, it->first) ||
+          !it->second->Match(value))
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+
   void LookupResource::ApplyLevel(SetOfResources& candidates,
                                   ResourceType level,
                                   IDatabaseWrapper& database) const
@@ -329,6 +366,24 @@ namespace Orthanc
       for (std::list<int64_t>::const_iterator
              study = allStudies.begin(); study != allStudies.end(); ++study)
       {
+        std::set<std::string> modalities, sopClassUids;
+        unsigned int countSopClassUids;
+        if (database.LookupStudyAggregates(modalities, sopClassUids, countSopClassUids, *study))
+        {
+          // The modalities of the study are indexed by the database engine
+          for (std::set<std::string>::const_iterator
+                 it = modalities.begin(); it != modalities.end(); ++it)
+          {
+            if (modalitiesInStudy_->Match(*it))
+            {
+              matchingStudies.push_back(*study);
+              break;
+            }
+          }
+
+          continue;
+        }
+
         std::list<int64_t> childrenSeries;
         database.GetChildrenInternalId(childrenSeries, *study);
 
@@ -35,6 +35,7 @@
 
 #include "ListConstraint.h"
 #include "SetOfResources.h"
+#include "../../Core/DicomFormat/DicomBinarySummary.h"
 
 #include <memory>
 
@@ -104,5 +105,14 @@ namespace Orthanc
                         IDatabaseWrapper& database) const;
 
     bool IsMatch(const Json::Value& dicomAsJson) const;
+
+    bool IsMatch(const DicomBinarySummary& summary) const;
+
+    // If "false", the candidates returned by "FindCandidates()" need
+    // not to be filtered by "IsMatch()"
+    bool HasUnoptimizedConstraints() const
+    {
+      return !unoptimizedConstraints_.empty();
+    }
   };
 }
@@ -34,6 +34,8 @@
 #include "PrecompiledHeadersServer.h"
 #include "ServerContext.h"
 
+#include "../Core/DicomFormat/DicomBinarySummary.h"
+#include "../Core/DicomNetworking/DicomServer.h"
 #include "../Core/DicomParsing/FromDcmtkBridge.h"
 #include "../Core/FileStorage/StorageAccessor.h"
 #include "../Core/HttpServer/FilesystemHttpSender.h"
@@ -51,9 +53,9 @@
 
 
 
-#define ENABLE_DICOM_CACHE  1
-
-static const size_t DICOM_CACHE_SIZE = 2;
+// The parsed DICOM files are distributed over several shards of the
+// cache, so that different instances can be accessed concurrently
+static const unsigned int DICOM_CACHE_SHARDS = 16;
 
 /**
  * IMPORTANT: We make the assumption that the same instance of
@@ -224,18 +226,25 @@ namespace Orthanc
     compressionEnabled_(false),
     storeMD5_(true),
     provider_(*this),
-    dicomCache_(provider_, DICOM_CACHE_SIZE),
+    dicomCache_(provider_,
+                static_cast<size_t>(Configuration::GetGlobalUnsignedIntegerParameter("DicomCacheSize", 128)) * 1024 * 1024,
+                DICOM_CACHE_SHARDS),
+    renderedCache_(static_cast<size_t>(Configuration::GetGlobalUnsignedIntegerParameter("RenderedCacheSize", 32)) * 1024 * 1024),
+    renderedCacheOnDisk_(Configuration::GetGlobalBoolParameter("RenderedCacheOnDisk", false)),
     mainLua_(*this),
     filterLua_(*this),
     luaListener_(*this),
 #if ORTHANC_ENABLE_PLUGINS == 1
     plugins_(NULL),
 #endif
+    dicomServer_(NULL),
     done_(false),
     haveJobsChanged_(false),
     queryRetrieveArchive_(Configuration::GetGlobalUnsignedIntegerParameter("QueryRetrieveSize", 10)),
     defaultLocalAet_(Configuration::GetGlobalStringParameter("DicomAet", "ORTHANC"))
   {
+    metrics_.SetEnabled(Configuration::GetGlobalBoolParameter("MetricsEnabled", true));
+
     listeners_.push_back(ServerListener(luaListener_, "Lua"));
 
     SetupJobsEngine(unitTesting, loadJobsFromDatabase);
@@ -310,13 +319,12 @@ namespace Orthanc
   {
     try
     {
-      StorageAccessor accessor(area_);
+      StorageAccessor accessor(area_, metrics_);
 
       DicomInstanceHasher hasher(dicom.GetSummary());
       resultPublicId = hasher.HashInstance();
 
-      Json::Value simplifiedTags;
-      ServerToolbox::SimplifyTags(simplifiedTags, dicom.GetJson(), DicomToJsonFormat_Human);
+      const Json::Value& simplifiedTags = dicom.GetSimplifiedJson();
 
       // Test if the instance must be filtered out
       bool accepted = true;
@@ -353,14 +361,31 @@ namespace Orthanc
       // TODO Should we use "gzip" instead?
       CompressionType compression = (compressionEnabled_ ? CompressionType_ZlibWithSize : CompressionType_None);
 
-      FileInfo dicomInfo = accessor.Write(dicom.GetBufferData(), dicom.GetBufferSize(), 
-                                          FileContentType_Dicom, compression, storeMD5_);
-      FileInfo jsonInfo = accessor.Write(dicom.GetJson().toStyledString(), 
-                                         FileContentType_DicomAsJson, compression, storeMD5_);
+      FileInfo dicomInfo;
+
+      if (dicom.HasFile())
+      {
+        // Large uploads are copied from their temporary file, without
+        // a full copy in memory (unless compression is enabled)
+        dicomInfo = accessor.WriteFromFile(dicom.GetFile(), FileContentType_Dicom, compression, storeMD5_);
+      }
+      else
+      {
+        dicomInfo = accessor.Write(dicom.GetBufferData(), dicom.GetBufferSize(), 
+                                   FileContentType_Dicom, compression, storeMD5_);
+      }
+
+      // The tags are stored as a binary summary that replaces the
+      // former "DICOM-as-JSON" attachment. It is never compressed, so
+      // that it can be read in place.
+      std::string summary;
+      DicomBinarySummary::Encode(summary, dicom.GetJson());
+      FileInfo summaryInfo = accessor.Write(summary, FileContentType_DicomSummary,
+                                            CompressionType_None, storeMD5_);
 
       ServerIndex::Attachments attachments;
       attachments.push_back(dicomInfo);
-      attachments.push_back(jsonInfo);
+      attachments.push_back(summaryInfo);
 
       typedef std::map<MetadataType, std::string>  InstanceMetadata;
       InstanceMetadata  instanceMetadata;
@@ -379,7 +404,7 @@ namespace Orthanc
       if (status != StoreStatus_Success)
       {
         accessor.Remove(dicomInfo);
-        accessor.Remove(jsonInfo);
+        accessor.Remove(summaryInfo);
       }
 
       switch (status)
@@ -445,7 +470,7 @@ namespace Orthanc
       throw OrthancException(ErrorCode_UnknownResource);
     }
 
-    StorageAccessor accessor(area_);
+    StorageAccessor accessor(area_, metrics_);
     accessor.AnswerFile(output, attachment, GetFileContentMime(content));
   }
 
@@ -473,7 +498,7 @@ namespace Orthanc
 
     std::string content;
 
-    StorageAccessor accessor(area_);
+    StorageAccessor accessor(area_, metrics_);
     accessor.Read(content, attachment);
 
     FileInfo modified = accessor.Write(content.empty() ? NULL : content.c_str(),
@@ -496,35 +521,102 @@ namespace Orthanc
   }
 
 
-  void ServerContext::ReadDicomAsJsonInternal(std::string& result,
+  bool ServerContext::ReadDicomSummary(std::string& summary,
+                                       const std::string& instancePublicId)
+  {
+    FileInfo attachment;
+    if (index_.LookupAttachment(attachment, instancePublicId, FileContentType_DicomSummary))
+    {
+      ReadAttachment(summary, attachment);
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+
+  bool ServerContext::LookupStringValue(std::string& value,
+                                        const std::string& instancePublicId,
+                                        const DicomTag& tag)
+  {
+    std::string summary;
+    if (ReadDicomSummary(summary, instancePublicId))
+    {
+      return DicomBinarySummary(summary).LookupStringValue(value, tag);
+    }
+
+    Json::Value dicom;
+    ReadDicomAsJson(dicom, instancePublicId);
+
+    const std::string formatted = tag.Format();
+
+    if (dicom.isMember(formatted))
+    {
+      const Json::Value& source = dicom[formatted];
+
+      if (source.type() == Json::objectValue &&
+          source.isMember("Type") &&
+          source.isMember("Value") &&
+          source["Type"].asString() == "String" &&
+          source["Value"].type() == Json::stringValue)
+      {
+        value = source["Value"].asString();
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+
+  void ServerContext::ReadDicomAsJsonInternal(Json::Value& result,
                                               const std::string& instancePublicId)
   {
+    {
+      std::string summary;
+      if (ReadDicomSummary(summary, instancePublicId))
+      {
+        DicomBinarySummary(summary).ToJson(result);
+        return;
+      }
+    }
+
     FileInfo attachment;
     if (index_.LookupAttachment(attachment, instancePublicId, FileContentType_DicomAsJson))
     {
-      ReadAttachment(result, attachment);
+      // Instance stored by a version of Orthanc <= 1.4.1, that has
+      // not been migrated to the binary summary yet
+      std::string content;
+      ReadAttachment(content, attachment);
+
+      Json::Reader reader;
+      if (!reader.parse(content, result))
+      {
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
     }
     else
     {
-      // The "DICOM as JSON" summary is not available from the Orthanc
+      // The summary of the tags is not available from the Orthanc
       // store (most probably deleted), reconstruct it from the DICOM file
       std::string dicom;
       ReadDicom(dicom, instancePublicId);
 
-      LOG(INFO) << "Reconstructing the missing DICOM-as-JSON summary for instance: "
+      LOG(INFO) << "Reconstructing the missing summary of the DICOM tags for instance: "
                 << instancePublicId;
     
       ParsedDicomFile parsed(dicom);
+      parsed.DatasetToJson(result);
 
-      Json::Value summary;
-      parsed.DatasetToJson(summary);
-
-      result = summary.toStyledString();
+      std::string summary;
+      DicomBinarySummary::Encode(summary, result);
 
-      if (!AddAttachment(instancePublicId, FileContentType_DicomAsJson,
-                         result.c_str(), result.size()))
+      if (!AddAttachment(instancePublicId, FileContentType_DicomSummary,
+                         summary.c_str(), summary.size()))
       {
-        LOG(WARNING) << "Cannot associate the DICOM-as-JSON summary to instance: " << instancePublicId;
+        LOG(WARNING) << "Cannot associate the summary of the DICOM tags to instance: " << instancePublicId;
         throw OrthancException(ErrorCode_InternalError);
       }
     }
@@ -535,14 +627,16 @@ namespace Orthanc
                                       const std::string& instancePublicId,
                                       const std::set<DicomTag>& ignoreTagLength)
   {
+    Json::Value tmp;
+    ReadDicomAsJson(tmp, instancePublicId, ignoreTagLength);
+
     if (ignoreTagLength.empty())
     {
-      ReadDicomAsJsonInternal(result, instancePublicId);
+      Json::FastWriter writer;
+      result = writer.write(tmp);
     }
     else
     {
-      Json::Value tmp;
-      ReadDicomAsJson(tmp, instancePublicId, ignoreTagLength);
       result = tmp.toStyledString();
     }
   }
@@ -554,19 +648,12 @@ namespace Orthanc
   {
     if (ignoreTagLength.empty())
     {
-      std::string tmp;
-      ReadDicomAsJsonInternal(tmp, instancePublicId);
-
-      Json::Reader reader;
-      if (!reader.parse(tmp, result))
-      {
-        throw OrthancException(ErrorCode_CorruptedFile);
-      }
+      ReadDicomAsJsonInternal(result, instancePublicId);
     }
     else
     {
-      // The "DicomAsJson" attachment might have stored some tags as
-      // "too long". We are forced to re-parse the DICOM file.
+      // The summary of the tags might have stored some tags as "too
+      // long". We are forced to re-parse the DICOM file.
       std::string dicom;
       ReadDicom(dicom, instancePublicId);
 
@@ -576,6 +663,43 @@ namespace Orthanc
   }
 
 
+  bool ServerContext::MigrateToDicomSummary(const std::string& instancePublicId)
+  {
+    FileInfo attachment;
+    if (index_.LookupAttachment(attachment, instancePublicId, FileContentType_DicomSummary) ||
+        !index_.LookupAttachment(attachment, instancePublicId, FileContentType_DicomAsJson))
+    {
+      // Nothing to migrate
+      return false;
+    }
+
+    Json::Value json;
+
+    {
+      std::string content;
+      ReadAttachment(content, attachment);
+
+      Json::Reader reader;
+      if (!reader.parse(content, json))
+      {
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
+    }
+
+    std::string summary;
+    DicomBinarySummary::Encode(summary, json);
+
+    if (!AddAttachment(instancePublicId, FileContentType_DicomSummary,
+                       summary.c_str(), summary.size()))
+    {
+      throw OrthancException(ErrorCode_InternalError);
+    }
+
+    index_.DeleteAttachment(instancePublicId, FileContentType_DicomAsJson);
+    return true;
+  }
+
+
   void ServerContext::ReadAttachment(std::string& result,
                                      const std::string& instancePublicId,
                                      FileContentType content,
@@ -605,31 +729,34 @@ namespace Orthanc
                                      const FileInfo& attachment)
   {
     // This will decompress the attachment
-    StorageAccessor accessor(area_);
+    StorageAccessor accessor(area_, metrics_);
     accessor.Read(result, attachment);
   }
 
 
-  IDynamicObject* ServerContext::DicomCacheProvider::Provide(const std::string& instancePublicId)
+  IDynamicObject* ServerContext::DicomCacheProvider::Provide(size_t& memorySize,
+                                                             const std::string& instancePublicId)
   {
     std::string content;
     context_.ReadDicom(content, instancePublicId);
+
+    // The memory that is consumed by DCMTK is roughly the size of the file
+    memorySize = content.size();
+
     return new ParsedDicomFile(content);
   }
 
 
   ServerContext::DicomCacheLocker::DicomCacheLocker(ServerContext& that,
                                                     const std::string& instancePublicId) : 
-    that_(that),
-    lock_(that_.dicomCacheMutex_)
+    timer_(that.metrics_, "orthanc_dicom_cache_wait_seconds"),
+    accessor_(that.dicomCache_, instancePublicId)
   {
-#if ENABLE_DICOM_CACHE == 0
-    static std::auto_ptr<IDynamicObject> p;
-    p.reset(provider_.Provide(instancePublicId));
-    dicom_ = dynamic_cast<ParsedDicomFile*>(p.get());
-#else
-    dicom_ = &dynamic_cast<ParsedDicomFile&>(that_.dicomCache_.Access(instancePublicId));
-#endif
+    dicom_ = &dynamic_cast<ParsedDicomFile&>(accessor_.GetContent());
+
+    // The waiting time includes the parsing of the DICOM file on a
+    // cache miss. The entry is locked until the destruction.
+    timer_.Restart("orthanc_dicom_cache_hold_seconds");
   }
 
 
@@ -638,6 +765,392 @@ namespace Orthanc
   }
 
 
+  bool ServerContext::GetDicomServerStatistics(Json::Value& target)
+  {
+    if (dicomServer_ == NULL)
+    {
+      return false;
+    }
+    else
+    {
+      dicomServer_->GetStatistics(target);
+      return true;
+    }
+  }
+
+
+  void ServerContext::GetDicomCacheStatistics(Json::Value& target)
+  {
+    uint64_t hits, misses, evictions;
+    size_t count, memory;
+    dicomCache_.GetStatistics(hits, misses, evictions, count, memory);
+
+    target = Json::objectValue;
+    target["CountEntries"] = static_cast<unsigned int>(count);
+    target["MemorySize"] = boost::lexical_cast<std::string>(memory);
+    target["MemorySizeMB"] = static_cast<unsigned int>(memory / (1024 * 1024));
+    target["Hits"] = boost::lexical_cast<std::string>(hits);
+    target["Misses"] = boost::lexical_cast<std::string>(misses);
+    target["Evictions"] = boost::lexical_cast<std::string>(evictions);
+  }
+
+
+  // Maximum number of renderings of one instance that are kept in the
+  // storage area, if "RenderedCacheOnDisk" is enabled
+  static const size_t MAX_PERSISTENT_RENDERINGS = 8;
+
+  // Pairs made of a cache key and of the corresponding rendering
+  typedef std::list< std::pair<std::string, std::string> >  PersistentRenderings;
+
+
+  // The attachment is a sequence of renderings, each of which is made
+  // of its cache key, of its size, and of its content:
+  // "<key>\n<size>\n<content>"
+  static void WritePersistentRenderings(std::string& target,
+                                        const PersistentRenderings& renderings)
+  {
+    target.clear();
+
+    for (PersistentRenderings::const_iterator it = renderings.begin();
+         it != renderings.end(); ++it)
+    {
+      target.append(it->first);
+      target.push_back('\n');
+      target.append(boost::lexical_cast<std::string>(it->second.size()));
+      target.push_back('\n');
+      target.append(it->second);
+    }
+  }
+
+
+  static bool ParsePersistentRenderings(PersistentRenderings& target,
+                                        const std::string& content)
+  {
+    target.clear();
+
+    size_t pos = 0;
+    while (pos < content.size())
+    {
+      size_t endKey = content.find('\n', pos);
+      if (endKey == std::string::npos)
+      {
+        return false;
+      }
+
+      size_t endSize = content.find('\n', endKey + 1);
+      if (endSize == std::string::npos)
+      {
+        return false;
+      }
+
+      size_t size;
+      try
+      {
+        size = boost::lexical_cast<size_t>(content.substr(endKey + 1, endSize - endKey - 1));
+      }
+      catch (boost::bad_lexical_cast&)
+      {
+        return false;
+      }
+
+      if (size > content.size() - endSize - 1)
+      {
+        return false;
+      }
+
+      target.push_back(std::make_pair(content.substr(pos, endKey - pos),
+                                      content.substr(endSize + 1, size)));
+      pos = endSize + 1 + size;
+    }
+
+    return true;
+  }
+
+
+  bool ServerContext::ReadPersistentRenderings(PersistentRenderings& target,
+                                               const std::string& instancePublicId)
+  {
+    target.clear();
+
+    FileInfo attachment;
+    if (!index_.LookupAttachment(attachment, instancePublicId, FileContentType_RenderedFrame))
+    {
+      return false;
+    }
+
+    std::string content;
+
+    try
+    {
+      ReadAttachment(content, attachment);
+    }
+    catch (OrthancException& e)
+    {
+      LOG(WARNING) << "Cannot read the rendered frames of instance " << instancePublicId
+                   << " from the storage area: " << e.What();
+      return false;
+    }
+
+    if (ParsePersistentRenderings(target, content))
+    {
+      return true;
+    }
+    else
+    {
+      // For instance, the single rendering of a previous version
+      LOG(WARNING) << "Ignoring the badly formatted rendered frames of instance " << instancePublicId;
+      target.clear();
+      return false;
+    }
+  }
+
+
+  bool ServerContext::LookupRenderedFrame(std::string& rendered,
+                                          std::string& cacheKey,
+                                          const std::string& instancePublicId,
+                                          const std::string& parameters,
+                                          bool persistent)
+  {
+    cacheKey.clear();
+
+    /**
+     * The key contains the UUID of the DICOM file, which ensures that
+     * the cache never answers the rendering of a previous version of
+     * the instance. This also checks that the instance still exists,
+     * as the entries of the instances that are deleted together with
+     * their parent resource are only removed by the LRU policy.
+     **/
+    FileInfo dicom;
+    if (!index_.LookupAttachment(dicom, instancePublicId, FileContentType_Dicom))
+    {
+      return false;
+    }
+
+    const std::string key = instancePublicId + "|" + dicom.GetUuid() + "|" + parameters;
+
+    if (renderedCache_.Fetch(rendered, key))
+    {
+      return true;
+    }
+
+    cacheKey = key;
+
+    PersistentRenderings renderings;
+    if (persistent &&
+        renderedCacheOnDisk_ &&
+        ReadPersistentRenderings(renderings, instancePublicId))
+    {
+      for (PersistentRenderings::const_iterator it = renderings.begin();
+           it != renderings.end(); ++it)
+      {
+        if (it->first == key)
+        {
+          rendered = it->second;
+          renderedCache_.Add(key, rendered);
+          return true;
+        }
+      }
+    }
+
+    return false;
+  }
+
+
+  void ServerContext::StoreRenderedFrame(const std::string& cacheKey,
+                                         const std::string& instancePublicId,
+                                         const std::string& rendered,
+                                         bool persistent)
+  {
+    if (cacheKey.empty())
+    {
+      return;
+    }
+
+    renderedCache_.Add(cacheKey, rendered);
+
+    if (persistent &&
+        renderedCacheOnDisk_)
+    {
+      /**
+       * As each resource has at most one attachment of a given type,
+       * all the persistent renderings of the instance (e.g. the
+       * thumbnails of different sizes) are kept together in the same
+       * attachment, that is rewritten. The renderings of a previous
+       * version of the DICOM file (whose key has another prefix) are
+       * dropped, as well as the oldest ones beyond the limit. Two
+       * concurrent writes might lose one rendering, which is only a
+       * cache miss.
+       **/
+      // The prefix "<instance>|<UUID of the DICOM file>|" of the key
+      const std::string prefix = cacheKey.substr(0, cacheKey.find('|', cacheKey.find('|') + 1) + 1);
+
+      PersistentRenderings previous, renderings;
+      ReadPersistentRenderings(previous, instancePublicId);
+
+      for (PersistentRenderings::const_iterator it = previous.begin();
+           it != previous.end(); ++it)
+      {
+        if (it->first != cacheKey &&
+            it->first.compare(0, prefix.size(), prefix) == 0)
+        {
+          renderings.push_back(*it);
+        }
+      }
+
+      renderings.push_back(std::make_pair(cacheKey, rendered));
+
+      while (renderings.size() > MAX_PERSISTENT_RENDERINGS)
+      {
+        renderings.pop_front();
+      }
+
+      std::string content;
+      WritePersistentRenderings(content, renderings);
+
+      // The rendering is written to the index without going through
+      // "AddAttachment()", as caching a thumbnail must neither recycle
+      // patients, nor be reported as a change of the instance
+      CompressionType compression = (compressionEnabled_ ? CompressionType_ZlibWithSize : CompressionType_None);
+
+      StorageAccessor accessor(area_, metrics_);
+      FileInfo attachment = accessor.Write(content, FileContentType_RenderedFrame, compression, storeMD5_);
+
+      if (index_.AddCacheAttachment(attachment, instancePublicId) != StoreStatus_Success)
+      {
+        accessor.Remove(attachment);
+      }
+    }
+  }
+
+
+  void ServerContext::GetRenderedCacheStatistics(Json::Value& target)
+  {
+    uint64_t hits, misses, evictions;
+    size_t count, memory;
+    renderedCache_.GetStatistics(hits, misses, evictions, count, memory);
+
+    target = Json::objectValue;
+    target["CountEntries"] = static_cast<unsigned int>(count);
+    target["MemorySize"] = boost::lexical_cast<std::string>(memory);
+    target["MemorySizeMB"] = static_cast<unsigned int>(memory / (1024 * 1024));
+    target["Hits"] = boost::lexical_cast<std::string>(hits);
+    target["Misses"] = boost::lexical_cast<std::string>(misses);
+    target["Evictions"] = boost::lexical_cast<std::string>(evictions);
+  }
+
+
+  static void SetCacheMetrics(MetricsRegistry& metrics,
+                              const std::string& cache,
+                              uint64_t hits,
+                              uint64_t misses,
+                              uint64_t evictions,
+                              size_t count,
+                              size_t memory)
+  {
+    const std::string label = MetricsRegistry::FormatLabel("cache", cache);
+
+    metrics.SetCounter("orthanc_cache_hits_total", label, hits);
+    metrics.SetCounter("orthanc_cache_misses_total", label, misses);
+    metrics.SetCounter("orthanc_cache_evictions_total", label, evictions);
+    metrics.SetGauge("orthanc_cache_entries", label, static_cast<double>(count));
+    metrics.SetGauge("orthanc_cache_memory_bytes", label, static_cast<double>(memory));
+    metrics.SetGauge("orthanc_cache_hit_ratio", label, (hits + misses == 0 ? 0.0 :
+                                                         static_cast<double>(hits) / static_cast<double>(hits + misses)));
+  }
+
+
+  static double GetStatisticsValue(const Json::Value& statistics,
+                                   const char* key)
+  {
+    // Large counters are stored as strings in the JSON statistics
+    const Json::Value& value = statistics[key];
+
+    if (value.type() == Json::stringValue)
+    {
+      return boost::lexical_cast<double>(value.asString());
+    }
+    else
+    {
+      return value.asDouble();
+    }
+  }
+
+
+  static uint64_t GetStatisticsCounter(const Json::Value& statistics,
+                                       const char* key)
+  {
+    const Json::Value& value = statistics[key];
+
+    if (value.type() == Json::stringValue)
+    {
+      return boost::lexical_cast<uint64_t>(value.asString());
+    }
+    else
+    {
+      return value.asUInt64();
+    }
+  }
+
+
+  void ServerContext::ExportMetrics(std::string& target)
+  {
+    uint64_t hits, misses, evictions;
+    size_t count, memory;
+
+    dicomCache_.GetStatistics(hits, misses, evictions, count, memory);
+    SetCacheMetrics(metrics_, "dicom", hits, misses, evictions, count, memory);
+
+    renderedCache_.GetStatistics(hits, misses, evictions, count, memory);
+    SetCacheMetrics(metrics_, "rendered", hits, misses, evictions, count, memory);
+
+    {
+      std::map<JobState, unsigned int> jobs;
+      jobsEngine_.GetRegistry().GetStatistics(jobs);
+
+      static const JobState STATES[] = {
+        JobState_Pending,
+        JobState_Running,
+        JobState_Success,
+        JobState_Failure,
+        JobState_Paused,
+        JobState_Retry
+      };
+
+      for (size_t i = 0; i < sizeof(STATES) / sizeof(JobState); i++)
+      {
+        std::map<JobState, unsigned int>::const_iterator found = jobs.find(STATES[i]);
+        metrics_.SetGauge("orthanc_jobs", MetricsRegistry::FormatLabel("state", EnumerationToString(STATES[i])),
+                          (found == jobs.end() ? 0 : found->second));
+      }
+    }
+
+    Json::Value dicom;
+    if (GetDicomServerStatistics(dicom))
+    {
+      metrics_.SetGauge("orthanc_dicom_associations_active", GetStatisticsValue(dicom, "ActiveAssociations"));
+      metrics_.SetGauge("orthanc_dicom_associations_peak", GetStatisticsValue(dicom, "PeakAssociations"));
+      metrics_.SetGauge("orthanc_dicom_associations_maximum", GetStatisticsValue(dicom, "MaximumAssociations"));
+      metrics_.SetCounter("orthanc_dicom_associations_total", GetStatisticsCounter(dicom, "TotalAssociations"));
+      metrics_.SetCounter("orthanc_dicom_associations_rejected_total", GetStatisticsCounter(dicom, "RejectedAssociations"));
+
+      const Json::Value& modalities = dicom["Modalities"];
+      Json::Value::Members aets = modalities.getMemberNames();
+
+      for (size_t i = 0; i < aets.size(); i++)
+      {
+        const Json::Value& modality = modalities[aets[i]];
+        const std::string label = MetricsRegistry::FormatLabel("aet", aets[i]);
+
+        metrics_.SetCounter("orthanc_dicom_modality_associations_total", label, GetStatisticsCounter(modality, "Associations"));
+        metrics_.SetCounter("orthanc_dicom_modality_instances_total", label, GetStatisticsCounter(modality, "Instances"));
+        metrics_.SetCounter("orthanc_dicom_modality_received_bytes_total", label, GetStatisticsCounter(modality, "ReceivedSize"));
+      }
+    }
+
+    metrics_.ExportPrometheusText(target);
+  }
+
+
   void ServerContext::SetStoreMD5ForAttachments(bool storeMD5)
   {
     LOG(INFO) << "Storing MD5 for attachments: " << (storeMD5 ? "yes" : "no");
@@ -655,7 +1168,13 @@ namespace Orthanc
     // TODO Should we use "gzip" instead?
     CompressionType compression = (compressionEnabled_ ? CompressionType_ZlibWithSize : CompressionType_None);
 
-    StorageAccessor accessor(area_);
+    if (attachmentType == FileContentType_DicomSummary)
+    {
+      // The binary summary of the tags is read in place
+      compression = CompressionType_None;
+    }
+
+    StorageAccessor accessor(area_, metrics_);
     FileInfo attachment = accessor.Write(data, size, attachmentType, compression, storeMD5_);
 
     StoreStatus status = index_.AddAttachment(attachment, resourceId);
@@ -678,8 +1197,8 @@ namespace Orthanc
     if (expectedType == ResourceType_Instance)
     {
       // remove the file from the DicomCache
-      boost::mutex::scoped_lock lock(dicomCacheMutex_);
       dicomCache_.Invalidate(uuid);
+      renderedCache_.InvalidatePrefix(uuid + "|");
     }
 
     return index_.DeleteResource(target, uuid, expectedType);
@@ -767,13 +1286,32 @@ namespace Orthanc
 
     assert(resources.size() == instances.size());
 
+    // If all the constraints were evaluated by the database, don't
+    // read the DICOM-as-JSON summary of the candidates from the disk
+    const bool isFiltered = lookup.HasUnoptimizedConstraints();
+
     size_t skipped = 0;
     for (size_t i = 0; i < instances.size(); i++)
     {
-      Json::Value dicom;
-      ReadDicomAsJson(dicom, instances[i]);
+      bool isMatch = true;
+
+      if (isFiltered)
+      {
+        // Look up the tags in place in the binary summary, if available
+        std::string summary;
+        if (ReadDicomSummary(summary, instances[i]))
+        {
+          isMatch = lookup.IsMatch(DicomBinarySummary(summary));
+        }
+        else
+        {
+          Json::Value dicom;
+          ReadDicomAsJson(dicom, instances[i]);
+          isMatch = lookup.IsMatch(dicom);
+        }
+      }
       
-      if (lookup.IsMatch(dicom))
+      if (isMatch)
       {
         if (skipped < since)
         {
@@ -39,12 +39,14 @@
 #include "OrthancHttpHandler.h"
 #include "ServerIndex.h"
 
-#include "../Core/Cache/MemoryCache.h"
+#include "../Core/Cache/MemoryStringCache.h"
+#include "../Core/Cache/ShardedMemoryCache.h"
 #include "../Core/Cache/SharedArchive.h"
 #include "../Core/DicomParsing/ParsedDicomFile.h"
 #include "../Core/FileStorage/IStorageArea.h"
 #include "../Core/JobsEngine/JobsEngine.h"
 #include "../Core/JobsEngine/SetOfInstancesJob.h"
+#include "../Core/MetricsRegistry.h"
 #include "../Core/MultiThreading/SharedMessageQueue.h"
 #include "../Core/RestApi/RestApiOutput.h"
 #include "../Plugins/Engine/OrthancPlugins.h"
@@ -55,6 +57,8 @@
 
 namespace Orthanc
 {
+  class DicomServer;
+
   /**
    * This class is responsible for maintaining the storage area on the
    * filesystem (including compression), as well as the index of the
@@ -93,7 +97,7 @@ namespace Orthanc
       }
     };
     
-    class DicomCacheProvider : public ICachePageProvider
+    class DicomCacheProvider : public ShardedMemoryCache::IProvider
     {
     private:
       ServerContext& context_;
@@ -103,7 +107,8 @@ namespace Orthanc
       {
       }
       
-      virtual IDynamicObject* Provide(const std::string& id);
+      virtual IDynamicObject* Provide(size_t& memorySize,
+                                      const std::string& id);
     };
 
     class ServerListener
@@ -140,9 +145,12 @@ namespace Orthanc
     static void SaveJobsThread(ServerContext* that,
                                unsigned int sleepDelay);
 
-    void ReadDicomAsJsonInternal(std::string& result,
+    void ReadDicomAsJsonInternal(Json::Value& result,
                                  const std::string& instancePublicId);
 
+    bool ReadPersistentRenderings(std::list< std::pair<std::string, std::string> >& target,
+                                  const std::string& instancePublicId);
+
     void SetupJobsEngine(bool unitTesting,
                          bool loadJobsFromDatabase);
 
@@ -154,6 +162,7 @@ namespace Orthanc
 
     virtual void SignalJobFailure(const std::string& jobId);
 
+    MetricsRegistry metrics_;  // Must be declared before "index_"
     ServerIndex index_;
     IStorageArea& area_;
 
@@ -161,8 +170,9 @@ namespace Orthanc
     bool storeMD5_;
     
     DicomCacheProvider provider_;
-    boost::mutex dicomCacheMutex_;
-    MemoryCache dicomCache_;
+    ShardedMemoryCache dicomCache_;
+    MemoryStringCache renderedCache_;
+    bool renderedCacheOnDisk_;
     JobsEngine jobsEngine_;
 
     LuaScripting mainLua_;
@@ -173,6 +183,8 @@ namespace Orthanc
     OrthancPlugins* plugins_;
 #endif
 
+    const DicomServer* dicomServer_;
+
     ServerListeners listeners_;
     boost::recursive_mutex listenersMutex_;
 
@@ -190,9 +202,9 @@ namespace Orthanc
     class DicomCacheLocker : public boost::noncopyable
     {
     private:
-      ServerContext& that_;
-      ParsedDicomFile *dicom_;
-      boost::mutex::scoped_lock lock_;
+      MetricsRegistry::Timer        timer_;   // Must be declared before "accessor_"
+      ShardedMemoryCache::Accessor  accessor_;
+      ParsedDicomFile*              dicom_;
 
     public:
       DicomCacheLocker(ServerContext& that,
@@ -218,6 +230,11 @@ namespace Orthanc
       return index_;
     }
 
+    MetricsRegistry& GetMetricsRegistry()
+    {
+      return metrics_;
+    }
+
     void SetCompressionEnabled(bool enabled);
 
     bool IsCompressionEnabled() const
@@ -266,6 +283,24 @@ namespace Orthanc
       ReadDicomAsJson(result, instancePublicId, ignoreTagLength);
     }
 
+    // Reads the binary summary of the DICOM tags of an instance, whose
+    // tags can be looked up in place with "DicomBinarySummary".
+    // Returns "false" if the instance was stored by Orthanc <= 1.4.1
+    // and was not migrated yet.
+    bool ReadDicomSummary(std::string& summary,
+                          const std::string& instancePublicId);
+
+    // Looks up the string value of a top-level tag of an instance,
+    // without converting its summary to JSON if possible
+    bool LookupStringValue(std::string& value,
+                           const std::string& instancePublicId,
+                           const DicomTag& tag);
+
+    // Replaces the "DICOM-as-JSON" attachment of an instance stored
+    // by Orthanc <= 1.4.1 by its binary summary. Returns "false" if
+    // there is nothing to migrate.
+    bool MigrateToDicomSummary(const std::string& instancePublicId);
+
     void ReadDicom(std::string& dicom,
                    const std::string& instancePublicId)
     {
@@ -288,6 +323,42 @@ namespace Orthanc
       return storeMD5_;
     }
 
+    void GetDicomCacheStatistics(Json::Value& target);
+
+    // Cache of the rendered frames. The "parameters" identify the
+    // rendering of the frame. On a miss, "cacheKey" receives the key
+    // to be given to "StoreRenderedFrame()", or is empty if the
+    // instance does not exist. The "persistent" renderings are also
+    // stored as an attachment, if "RenderedCacheOnDisk" is enabled:
+    // This attachment keeps the latest renderings of each instance,
+    // indexed by their parameters (e.g. the size of the thumbnails).
+    bool LookupRenderedFrame(std::string& rendered,
+                             std::string& cacheKey,
+                             const std::string& instancePublicId,
+                             const std::string& parameters,
+                             bool persistent);
+
+    void StoreRenderedFrame(const std::string& cacheKey,
+                            const std::string& instancePublicId,
+                            const std::string& rendered,
+                            bool persistent);
+
+    void GetRenderedCacheStatistics(Json::Value& target);
+
+    // The DICOM server is owned by the main function, and must be
+    // reset to NULL before being stopped
+    void SetDicomServer(const DicomServer* server)
+    {
+      dicomServer_ = server;
+    }
+
+    // Returns "false" if the DICOM server is not running
+    bool GetDicomServerStatistics(Json::Value& target);
+
+    // Exports the metrics using the text format of Prometheus, after
+    // having refreshed the gauges (caches, jobs and DICOM server)
+    void ExportMetrics(std::string& target);
+
     JobsEngine& GetJobsEngine()
     {
       return jobsEngine_;
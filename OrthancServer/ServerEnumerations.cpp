@@ -73,6 +73,8 @@ namespace Orthanc
 
     dictContentType_.Add(FileContentType_Dicom, "dicom");
     dictContentType_.Add(FileContentType_DicomAsJson, "dicom-as-json");
+    dictContentType_.Add(FileContentType_DicomSummary, "dicom-summary");
+    dictContentType_.Add(FileContentType_RenderedFrame, "rendered-frame");
   }
 
   void RegisterUserMetadata(int metadata,
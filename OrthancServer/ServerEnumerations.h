@@ -79,6 +79,7 @@ namespace Orthanc
     GlobalProperty_JobsRegistry = 5,
     GlobalProperty_TotalCompressedSize = 6,     // Reserved for Orthanc > 1.4.1
     GlobalProperty_TotalUncompressedSize = 7,   // Reserved for Orthanc > 1.4.1
+    GlobalProperty_ExtraMainDicomTags = 8,      // New in Orthanc 1.4.2
 
     // Reserved values for internal use by the database plugins
     GlobalProperty_DatabasePatchLevel = 4,
@@ -92,11 +92,13 @@ namespace Orthanc
     std::list<FileToRemove> pendingFilesToRemove_;
     std::list<ServerIndexChange> pendingChanges_;
     uint64_t sizeOfFilesToRemove_;
+    uint64_t sizeOfAddedFiles_;
     bool insideTransaction_;
 
     void Reset()
     {
       sizeOfFilesToRemove_ = 0;
+      sizeOfAddedFiles_ = 0;
       hasRemainingLevel_ = false;
       pendingFilesToRemove_.clear();
       pendingChanges_.clear();
@@ -128,6 +130,16 @@ namespace Orthanc
       return sizeOfFilesToRemove_;
     }
 
+    void SignalAttachmentsAdded(uint64_t size)
+    {
+      sizeOfAddedFiles_ += size;
+    }
+
+    uint64_t GetSizeOfAddedFiles() const
+    {
+      return sizeOfAddedFiles_;
+    }
+
     void CommitFilesToRemove()
     {
       for (std::list<FileToRemove>::const_iterator 
@@ -229,6 +241,7 @@ namespace Orthanc
       assert(index_.currentStorageSize_ == index_.db_.GetTotalCompressedSize());
 
       index_.listener_->StartTransaction();
+      index_.pendingUnstableResources_.clear();
     }
 
     ~Transaction()
@@ -238,6 +251,9 @@ namespace Orthanc
       if (!isCommitted_)
       {
         transaction_->Rollback();
+
+        // The resources of a rolled back transaction might not exist
+        index_.pendingUnstableResources_.clear();
       }
     }
 
@@ -260,12 +276,104 @@ namespace Orthanc
         // Send all the pending changes to the Orthanc plugins
         index_.listener_->CommitChanges();
 
+        index_.CommitUnstableResources();
+
         isCommitted_ = true;
       }
     }
   };
 
 
+  // Locks "mutex_", recording the time spent waiting for the mutex
+  // and holding it
+  class ServerIndex::MutexLock : public MetricsRegistry::TimedLock
+  {
+  public:
+    explicit MutexLock(ServerIndex& index) :
+      TimedLock(index.metrics_, index.mutex_,
+                "orthanc_index_mutex_wait_seconds",
+                "orthanc_index_mutex_hold_seconds")
+    {
+    }
+  };
+
+
+  class ServerIndex::ReadOnlyAccessor : public boost::noncopyable
+  {
+  private:
+    ServerIndex&                              index_;
+    IDatabaseWrapper*                         reader_;
+    std::auto_ptr<MutexLock>                  lock_;
+    std::auto_ptr<SQLite::ITransaction>       transaction_;
+
+    void ReleaseReader()
+    {
+      boost::mutex::scoped_lock lock(index_.readersMutex_);
+      index_.availableReaders_.push(reader_);
+      index_.readersCondition_.notify_one();
+    }
+
+  public:
+    explicit ReadOnlyAccessor(ServerIndex& index) :
+      index_(index),
+      reader_(NULL)
+    {
+      {
+        boost::mutex::scoped_lock lock(index_.readersMutex_);
+
+        if (!index_.readers_.empty())
+        {
+          while (index_.availableReaders_.empty())
+          {
+            index_.readersCondition_.wait(lock);
+          }
+
+          reader_ = index_.availableReaders_.top();
+          index_.availableReaders_.pop();
+        }
+      }
+
+      if (reader_ == NULL)
+      {
+        // No read-only connection was configured: Share the primary
+        // connection with the writers
+        lock_.reset(new MutexLock(index_));
+      }
+      else
+      {
+        try
+        {
+          // The transaction provides a consistent snapshot of the
+          // database during the whole lifetime of the accessor
+          transaction_.reset(reader_->StartTransaction());
+          transaction_->Begin();
+        }
+        catch (...)
+        {
+          transaction_.reset(NULL);
+          ReleaseReader();
+          throw;
+        }
+      }
+    }
+
+    ~ReadOnlyAccessor()
+    {
+      if (reader_ != NULL)
+      {
+        // Nothing was written, the rollback simply ends the snapshot
+        transaction_.reset(NULL);
+        ReleaseReader();
+      }
+    }
+
+    IDatabaseWrapper& GetDatabase()
+    {
+      return (reader_ == NULL ? index_.db_ : *reader_);
+    }
+  };
+
+
   class ServerIndex::UnstableResourcePayload
   {
   private:
@@ -303,11 +411,74 @@ namespace Orthanc
   };
 
 
+  class ServerIndex::StoreRequest : public boost::noncopyable
+  {
+  private:
+    std::map<MetadataType, std::string>&  instanceMetadata_;
+    DicomInstanceHasher&                  hasher_;
+    DicomInstanceToStore&                 instance_;
+    const Attachments&                    attachments_;
+    bool                                  done_;
+    StoreStatus                           status_;
+
+  public:
+    StoreRequest(std::map<MetadataType, std::string>& instanceMetadata,
+                 DicomInstanceHasher& hasher,
+                 DicomInstanceToStore& instance,
+                 const Attachments& attachments) :
+      instanceMetadata_(instanceMetadata),
+      hasher_(hasher),
+      instance_(instance),
+      attachments_(attachments),
+      done_(false),
+      status_(StoreStatus_Failure)
+    {
+    }
+
+    std::map<MetadataType, std::string>& GetInstanceMetadata()
+    {
+      return instanceMetadata_;
+    }
+
+    DicomInstanceHasher& GetHasher()
+    {
+      return hasher_;
+    }
+
+    DicomInstanceToStore& GetInstance()
+    {
+      return instance_;
+    }
+
+    const Attachments& GetAttachments() const
+    {
+      return attachments_;
+    }
+
+    bool IsDone() const
+    {
+      return done_;
+    }
+
+    StoreStatus GetStatus() const
+    {
+      assert(done_);
+      return status_;
+    }
+
+    void SetStatus(StoreStatus status)
+    {
+      done_ = true;
+      status_ = status;
+    }
+  };
+
+
   bool ServerIndex::DeleteResource(Json::Value& target,
                                    const std::string& uuid,
                                    ResourceType expectedType)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    MutexLock lock(*this);
 
     Transaction t(*this);
 
@@ -350,7 +521,7 @@ namespace Orthanc
 
     try
     {
-      boost::mutex::scoped_lock lock(that->mutex_);
+      MutexLock lock(*that);
       std::string sleepString;
 
       if (that->db_.LookupGlobalProperty(sleepString, GlobalProperty_FlushSleep) &&
@@ -378,7 +549,7 @@ namespace Orthanc
 
       Logging::Flush();
 
-      boost::mutex::scoped_lock lock(that->mutex_);
+      MutexLock lock(*that);
       that->db_.FlushToDisk();
       count = 0;
     }
@@ -433,11 +604,12 @@ namespace Orthanc
 
 
   bool ServerIndex::GetMetadataAsInteger(int64_t& result,
+                                         IDatabaseWrapper& db,
                                          int64_t id,
                                          MetadataType type)
   {
     std::string s;
-    if (!db_.LookupMetadata(s, id, type))
+    if (!db.LookupMetadata(s, id, type))
     {
       return false;
     }
@@ -542,9 +714,13 @@ namespace Orthanc
                            IDatabaseWrapper& db,
                            unsigned int threadSleep) : 
     done_(false),
+    metrics_(context.GetMetricsRegistry()),
     db_(db),
     maximumStorageSize_(0),
-    maximumPatients_(0)
+    maximumPatients_(0),
+    hasStoreBatchLeader_(false),
+    storeBatchSize_(1),
+    storeBatchLatency_(0)
   {
     listener_.reset(new Listener(context));
     db_.SetListener(*listener_);
@@ -573,6 +749,13 @@ namespace Orthanc
       LOG(ERROR) << "INTERNAL ERROR: ServerIndex::Stop() should be invoked manually to avoid mess in the destruction order!";
       Stop();
     }
+
+    for (size_t i = 0; i < readers_.size(); i++)
+    {
+      assert(readers_[i] != NULL);
+      readers_[i]->Close();
+      delete readers_[i];
+    }
   }
 
 
@@ -609,262 +792,432 @@ namespace Orthanc
 
 
 
-  StoreStatus ServerIndex::Store(std::map<MetadataType, std::string>& instanceMetadata,
-                                 DicomInstanceToStore& instanceToStore,
-                                 const Attachments& attachments)
+  StoreStatus ServerIndex::StoreInternal(std::map<MetadataType, std::string>& instanceMetadata,
+                                         DicomInstanceHasher& hasher,
+                                         DicomInstanceToStore& instanceToStore,
+                                         const Attachments& attachments)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    // WARNING: Before calling this method, "mutex_" must be locked,
+    // and a transaction must be active.
 
     const DicomMap& dicomSummary = instanceToStore.GetSummary();
     const ServerIndex::MetadataMap& metadata = instanceToStore.GetMetadata();
 
     instanceMetadata.clear();
 
-    DicomInstanceHasher hasher(instanceToStore.GetSummary());
+    // Do nothing if the instance already exists
+    {
+      ResourceType type;
+      int64_t tmp;
+      if (db_.LookupResource(tmp, type, hasher.HashInstance()))
+      {
+        assert(type == ResourceType_Instance);
+        db_.GetAllMetadata(instanceMetadata, tmp);
+        return StoreStatus_AlreadyStored;
+      }
+    }
 
-    try
+    // Ensure there is enough room in the storage for the new instance
+    uint64_t instanceSize = 0;
+    for (Attachments::const_iterator it = attachments.begin();
+         it != attachments.end(); ++it)
     {
-      Transaction t(*this);
+      instanceSize += it->GetCompressedSize();
+    }
+
+    Recycle(instanceSize, hasher.HashPatient());
+
+    // Create the instance
+    int64_t instance = CreateResource(hasher.HashInstance(), ResourceType_Instance);
+    ServerToolbox::StoreMainDicomTags(db_, instance, ResourceType_Instance, dicomSummary);
+
+    // Detect up to which level the patient/study/series/instance
+    // hierarchy must be created
+    int64_t patient = -1, study = -1, series = -1;
+    bool isNewPatient = false;
+    bool isNewStudy = false;
+    bool isNewSeries = false;
+
+    {
+      ResourceType dummy;
 
-      // Do nothing if the instance already exists
+      if (db_.LookupResource(series, dummy, hasher.HashSeries()))
       {
-        ResourceType type;
-        int64_t tmp;
-        if (db_.LookupResource(tmp, type, hasher.HashInstance()))
-        {
-          assert(type == ResourceType_Instance);
-          db_.GetAllMetadata(instanceMetadata, tmp);
-          return StoreStatus_AlreadyStored;
-        }
+        assert(dummy == ResourceType_Series);
+        // The patient, the study and the series already exist
+
+        bool ok = (db_.LookupResource(patient, dummy, hasher.HashPatient()) &&
+                   db_.LookupResource(study, dummy, hasher.HashStudy()));
+        assert(ok);
       }
+      else if (db_.LookupResource(study, dummy, hasher.HashStudy()))
+      {
+        assert(dummy == ResourceType_Study);
+
+        // New series: The patient and the study already exist
+        isNewSeries = true;
 
-      // Ensure there is enough room in the storage for the new instance
-      uint64_t instanceSize = 0;
-      for (Attachments::const_iterator it = attachments.begin();
-           it != attachments.end(); ++it)
+        bool ok = db_.LookupResource(patient, dummy, hasher.HashPatient());
+        assert(ok);
+      }
+      else if (db_.LookupResource(patient, dummy, hasher.HashPatient()))
       {
-        instanceSize += it->GetCompressedSize();
+        assert(dummy == ResourceType_Patient);
+
+        // New study and series: The patient already exist
+        isNewStudy = true;
+        isNewSeries = true;
+      }
+      else
+      {
+        // New patient, study and series: Nothing exists
+        isNewPatient = true;
+        isNewStudy = true;
+        isNewSeries = true;
       }
+    }
 
-      Recycle(instanceSize, hasher.HashPatient());
+    // Create the series if needed
+    if (isNewSeries)
+    {
+      series = CreateResource(hasher.HashSeries(), ResourceType_Series);
+      ServerToolbox::StoreMainDicomTags(db_, series, ResourceType_Series, dicomSummary);
+    }
 
-      // Create the instance
-      int64_t instance = CreateResource(hasher.HashInstance(), ResourceType_Instance);
-      ServerToolbox::StoreMainDicomTags(db_, instance, ResourceType_Instance, dicomSummary);
+    // Create the study if needed
+    if (isNewStudy)
+    {
+      study = CreateResource(hasher.HashStudy(), ResourceType_Study);
+      ServerToolbox::StoreMainDicomTags(db_, study, ResourceType_Study, dicomSummary);
+    }
 
-      // Detect up to which level the patient/study/series/instance
-      // hierarchy must be created
-      int64_t patient = -1, study = -1, series = -1;
-      bool isNewPatient = false;
-      bool isNewStudy = false;
-      bool isNewSeries = false;
+    // Create the patient if needed
+    if (isNewPatient)
+    {
+      patient = CreateResource(hasher.HashPatient(), ResourceType_Patient);
+      ServerToolbox::StoreMainDicomTags(db_, patient, ResourceType_Patient, dicomSummary);
+    }
 
-      {
-        ResourceType dummy;
+    // Create the parent-to-child links
+    db_.AttachChild(series, instance);
 
-        if (db_.LookupResource(series, dummy, hasher.HashSeries()))
-        {
-          assert(dummy == ResourceType_Series);
-          // The patient, the study and the series already exist
+    if (isNewSeries)
+    {
+      db_.AttachChild(study, series);
+    }
 
-          bool ok = (db_.LookupResource(patient, dummy, hasher.HashPatient()) &&
-                     db_.LookupResource(study, dummy, hasher.HashStudy()));
-          assert(ok);
-        }
-        else if (db_.LookupResource(study, dummy, hasher.HashStudy()))
-        {
-          assert(dummy == ResourceType_Study);
+    if (isNewStudy)
+    {
+      db_.AttachChild(patient, study);
+    }
 
-          // New series: The patient and the study already exist
-          isNewSeries = true;
+    // Sanity checks
+    assert(patient != -1);
+    assert(study != -1);
+    assert(series != -1);
+    assert(instance != -1);
 
-          bool ok = db_.LookupResource(patient, dummy, hasher.HashPatient());
-          assert(ok);
-        }
-        else if (db_.LookupResource(patient, dummy, hasher.HashPatient()))
-        {
-          assert(dummy == ResourceType_Patient);
+    // Attach the files to the newly created instance
+    for (Attachments::const_iterator it = attachments.begin();
+         it != attachments.end(); ++it)
+    {
+      db_.AddAttachment(instance, *it);
+    }
 
-          // New study and series: The patient already exist
-          isNewStudy = true;
-          isNewSeries = true;
-        }
-        else
-        {
-          // New patient, study and series: Nothing exists
-          isNewPatient = true;
-          isNewStudy = true;
-          isNewSeries = true;
-        }
-      }
+    listener_->SignalAttachmentsAdded(instanceSize);
 
-      // Create the series if needed
-      if (isNewSeries)
+    // Attach the user-specified metadata
+    for (MetadataMap::const_iterator 
+           it = metadata.begin(); it != metadata.end(); ++it)
+    {
+      switch (it->first.first)
       {
-        series = CreateResource(hasher.HashSeries(), ResourceType_Series);
-        ServerToolbox::StoreMainDicomTags(db_, series, ResourceType_Series, dicomSummary);
+        case ResourceType_Patient:
+          db_.SetMetadata(patient, it->first.second, it->second);
+          break;
+
+        case ResourceType_Study:
+          db_.SetMetadata(study, it->first.second, it->second);
+          break;
+
+        case ResourceType_Series:
+          db_.SetMetadata(series, it->first.second, it->second);
+          break;
+
+        case ResourceType_Instance:
+          SetInstanceMetadata(instanceMetadata, instance, it->first.second, it->second);
+          break;
+
+        default:
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
       }
+    }
+
+    // Attach the auto-computed metadata for the patient/study/series levels
+    std::string now = SystemToolbox::GetNowIsoString(true /* use UTC time (not local time) */);
+    db_.SetMetadata(series, MetadataType_LastUpdate, now);
+    db_.SetMetadata(study, MetadataType_LastUpdate, now);
+    db_.SetMetadata(patient, MetadataType_LastUpdate, now);
+
+    // Attach the auto-computed metadata for the instance level,
+    // reflecting these additions into the input metadata map
+    SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_ReceptionDate, now);
+    SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_RemoteAet,
+                        instanceToStore.GetOrigin().GetRemoteAetC());
+    SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_Origin, 
+                        EnumerationToString(instanceToStore.GetOrigin().GetRequestOrigin()));
+
+    {
+      std::string s;
 
-      // Create the study if needed
-      if (isNewStudy)
+      if (instanceToStore.LookupTransferSyntax(s))
       {
-        study = CreateResource(hasher.HashStudy(), ResourceType_Study);
-        ServerToolbox::StoreMainDicomTags(db_, study, ResourceType_Study, dicomSummary);
+        // New in Orthanc 1.2.0
+        SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_TransferSyntax, s);
       }
 
-      // Create the patient if needed
-      if (isNewPatient)
+      if (instanceToStore.GetOrigin().LookupRemoteIp(s))
       {
-        patient = CreateResource(hasher.HashPatient(), ResourceType_Patient);
-        ServerToolbox::StoreMainDicomTags(db_, patient, ResourceType_Patient, dicomSummary);
+        // New in Orthanc 1.4.0
+        SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_RemoteIp, s);
       }
 
-      // Create the parent-to-child links
-      db_.AttachChild(series, instance);
-
-      if (isNewSeries)
+      if (instanceToStore.GetOrigin().LookupCalledAet(s))
       {
-        db_.AttachChild(study, series);
+        // New in Orthanc 1.4.0
+        SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_CalledAet, s);
       }
 
-      if (isNewStudy)
+      if (instanceToStore.GetOrigin().LookupHttpUsername(s))
       {
-        db_.AttachChild(patient, study);
+        // New in Orthanc 1.4.0
+        SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_HttpUsername, s);
       }
+    }
 
-      // Sanity checks
-      assert(patient != -1);
-      assert(study != -1);
-      assert(series != -1);
-      assert(instance != -1);
+    const DicomValue* value;
+    if ((value = dicomSummary.TestAndGetValue(DICOM_TAG_SOP_CLASS_UID)) != NULL &&
+        !value->IsNull() &&
+        !value->IsBinary())
+    {
+      SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_SopClassUid, value->GetContent());
+    }
 
-      // Attach the files to the newly created instance
-      for (Attachments::const_iterator it = attachments.begin();
-           it != attachments.end(); ++it)
+    if ((value = dicomSummary.TestAndGetValue(DICOM_TAG_INSTANCE_NUMBER)) != NULL ||
+        (value = dicomSummary.TestAndGetValue(DICOM_TAG_IMAGE_INDEX)) != NULL)
+    {
+      if (!value->IsNull() && 
+          !value->IsBinary())
       {
-        db_.AddAttachment(instance, *it);
+        SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_IndexInSeries, value->GetContent());
       }
+    }
 
-      // Attach the user-specified metadata
-      for (MetadataMap::const_iterator 
-             it = metadata.begin(); it != metadata.end(); ++it)
-      {
-        switch (it->first.first)
-        {
-          case ResourceType_Patient:
-            db_.SetMetadata(patient, it->first.second, it->second);
-            break;
+    // Check whether the series of this new instance is now completed
+    if (isNewSeries)
+    {
+      ComputeExpectedNumberOfInstances(db_, series, dicomSummary);
+    }
 
-          case ResourceType_Study:
-            db_.SetMetadata(study, it->first.second, it->second);
-            break;
+    SeriesStatus seriesStatus = GetSeriesStatus(db_, series);
+    if (seriesStatus == SeriesStatus_Complete)
+    {
+      LogChange(series, ChangeType_CompletedSeries, ResourceType_Series, hasher.HashSeries());
+    }
 
-          case ResourceType_Series:
-            db_.SetMetadata(series, it->first.second, it->second);
-            break;
+    // Mark the parent resources of this instance as unstable
+    MarkAsUnstable(series, ResourceType_Series, hasher.HashSeries());
+    MarkAsUnstable(study, ResourceType_Study, hasher.HashStudy());
+    MarkAsUnstable(patient, ResourceType_Patient, hasher.HashPatient());
 
-          case ResourceType_Instance:
-            SetInstanceMetadata(instanceMetadata, instance, it->first.second, it->second);
-            break;
+    return StoreStatus_Success;
+  }
 
-          default:
-            throw OrthancException(ErrorCode_ParameterOutOfRange);
-        }
-      }
 
-      // Attach the auto-computed metadata for the patient/study/series levels
-      std::string now = SystemToolbox::GetNowIsoString(true /* use UTC time (not local time) */);
-      db_.SetMetadata(series, MetadataType_LastUpdate, now);
-      db_.SetMetadata(study, MetadataType_LastUpdate, now);
-      db_.SetMetadata(patient, MetadataType_LastUpdate, now);
+  StoreStatus ServerIndex::StoreInTransaction(std::map<MetadataType, std::string>& instanceMetadata,
+                                              DicomInstanceHasher& hasher,
+                                              DicomInstanceToStore& instanceToStore,
+                                              const Attachments& attachments)
+  {
+    // WARNING: Before calling this method, "mutex_" must be locked.
 
-      // Attach the auto-computed metadata for the instance level,
-      // reflecting these additions into the input metadata map
-      SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_ReceptionDate, now);
-      SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_RemoteAet,
-                          instanceToStore.GetOrigin().GetRemoteAetC());
-      SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_Origin, 
-                          EnumerationToString(instanceToStore.GetOrigin().GetRequestOrigin()));
+    try
+    {
+      Transaction t(*this);
+
+      StoreStatus status = StoreInternal(instanceMetadata, hasher, instanceToStore, attachments);
 
+      if (status == StoreStatus_Success)
       {
-        std::string s;
+        t.Commit(listener_->GetSizeOfAddedFiles());
+      }
 
-        if (instanceToStore.LookupTransferSyntax(s))
-        {
-          // New in Orthanc 1.2.0
-          SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_TransferSyntax, s);
-        }
+      return status;
+    }
+    catch (OrthancException& e)
+    {
+      LOG(ERROR) << "EXCEPTION [" << e.What() << "]";
+    }
 
-        if (instanceToStore.GetOrigin().LookupRemoteIp(s))
-        {
-          // New in Orthanc 1.4.0
-          SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_RemoteIp, s);
-        }
+    return StoreStatus_Failure;
+  }
 
-        if (instanceToStore.GetOrigin().LookupCalledAet(s))
-        {
-          // New in Orthanc 1.4.0
-          SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_CalledAet, s);
-        }
 
-        if (instanceToStore.GetOrigin().LookupHttpUsername(s))
-        {
-          // New in Orthanc 1.4.0
-          SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_HttpUsername, s);
-        }
+  void ServerIndex::StoreBatch(std::vector<StoreStatus>& status,
+                               const std::vector<StoreRequest*>& batch)
+  {
+    status.resize(batch.size());
+
+    MutexLock lock(*this);
+
+    try
+    {
+      // Optimistic path: All the instances of the batch are
+      // committed at once, in one single transaction
+      Transaction t(*this);
+
+      for (size_t i = 0; i < batch.size(); i++)
+      {
+        status[i] = StoreInternal(batch[i]->GetInstanceMetadata(),
+                                  batch[i]->GetHasher(),
+                                  batch[i]->GetInstance(),
+                                  batch[i]->GetAttachments());
       }
 
-      const DicomValue* value;
-      if ((value = dicomSummary.TestAndGetValue(DICOM_TAG_SOP_CLASS_UID)) != NULL &&
-          !value->IsNull() &&
-          !value->IsBinary())
+      t.Commit(listener_->GetSizeOfAddedFiles());
+
+      return;
+    }
+    catch (OrthancException& e)
+    {
+      LOG(WARNING) << "Cannot store a batch of " << batch.size() << " instances at once, "
+                   << "falling back to one transaction per instance: " << e.What();
+    }
+
+    // The transaction of the batch has been rolled back: Store the
+    // instances one by one, so that each instance gets its own status
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+      status[i] = StoreInTransaction(batch[i]->GetInstanceMetadata(),
+                                     batch[i]->GetHasher(),
+                                     batch[i]->GetInstance(),
+                                     batch[i]->GetAttachments());
+    }
+  }
+
+
+  StoreStatus ServerIndex::Store(std::map<MetadataType, std::string>& instanceMetadata,
+                                 DicomInstanceToStore& instanceToStore,
+                                 const Attachments& attachments)
+  {
+    // This throws an exception if some DICOM identifier is missing
+    DicomInstanceHasher hasher(instanceToStore.GetSummary());
+
+    {
+      boost::mutex::scoped_lock lock(storeBatchMutex_);
+
+      if (storeBatchSize_ <= 1)
       {
-        SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_SopClassUid, value->GetContent());
+        // Group commit is disabled (default behavior)
+        lock.unlock();
+
+        MutexLock lock2(*this);
+        return StoreInTransaction(instanceMetadata, hasher, instanceToStore, attachments);
       }
+    }
+
+    /**
+     * Group commit: The concurrent calls to "Store()" are queued. The
+     * first thread that finds no active "leader" becomes the leader:
+     * It waits for at most "storeBatchLatency_" milliseconds for
+     * other instances to arrive, then commits the whole batch in one
+     * single transaction on behalf of the other threads, which are
+     * sleeping until their own request is done. This amortizes the
+     * cost of one SQLite commit (and of its fsync) over the batch.
+     **/
+
+    StoreRequest request(instanceMetadata, hasher, instanceToStore, attachments);
+
+    boost::mutex::scoped_lock lock(storeBatchMutex_);
+    storeBatchQueue_.push_back(&request);
+    storeBatchCondition_.notify_all();
+
+    while (!request.IsDone() &&
+           hasStoreBatchLeader_)
+    {
+      storeBatchCondition_.wait(lock);
+    }
+
+    if (request.IsDone())
+    {
+      // Another thread has stored this instance
+      return request.GetStatus();
+    }
+
+    // This thread is now the leader
+    hasStoreBatchLeader_ = true;
 
-      if ((value = dicomSummary.TestAndGetValue(DICOM_TAG_INSTANCE_NUMBER)) != NULL ||
-          (value = dicomSummary.TestAndGetValue(DICOM_TAG_IMAGE_INDEX)) != NULL)
+    while (!request.IsDone())
+    {
+      if (storeBatchQueue_.size() < storeBatchSize_ &&
+          storeBatchLatency_ > 0)
       {
-        if (!value->IsNull() && 
-            !value->IsBinary())
+        // Wait for more instances to arrive
+        const boost::system_time timeout = (boost::get_system_time() +
+                                            boost::posix_time::milliseconds(storeBatchLatency_));
+
+        while (storeBatchQueue_.size() < storeBatchSize_ &&
+               storeBatchCondition_.timed_wait(lock, timeout))
         {
-          SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_IndexInSeries, value->GetContent());
         }
       }
 
-      // Check whether the series of this new instance is now completed
-      if (isNewSeries)
+      std::vector<StoreRequest*> batch;
+      batch.reserve(std::min(storeBatchQueue_.size(), static_cast<size_t>(storeBatchSize_)));
+
+      while (!storeBatchQueue_.empty() &&
+             batch.size() < storeBatchSize_)
       {
-        ComputeExpectedNumberOfInstances(db_, series, dicomSummary);
+        batch.push_back(storeBatchQueue_.front());
+        storeBatchQueue_.pop_front();
       }
 
-      SeriesStatus seriesStatus = GetSeriesStatus(series);
-      if (seriesStatus == SeriesStatus_Complete)
+      std::vector<StoreStatus> status;
+
+      lock.unlock();
+
+      try
       {
-        LogChange(series, ChangeType_CompletedSeries, ResourceType_Series, hasher.HashSeries());
+        StoreBatch(status, batch);
+      }
+      catch (...)
+      {
+        LOG(ERROR) << "Unexpected error while storing a batch of " << batch.size() << " instances";
+        status.clear();
       }
 
-      // Mark the parent resources of this instance as unstable
-      MarkAsUnstable(series, ResourceType_Series, hasher.HashSeries());
-      MarkAsUnstable(study, ResourceType_Study, hasher.HashStudy());
-      MarkAsUnstable(patient, ResourceType_Patient, hasher.HashPatient());
+      lock.lock();
 
-      t.Commit(instanceSize);
+      for (size_t i = 0; i < batch.size(); i++)
+      {
+        batch[i]->SetStatus(i < status.size() ? status[i] : StoreStatus_Failure);
+      }
 
-      return StoreStatus_Success;
-    }
-    catch (OrthancException& e)
-    {
-      LOG(ERROR) << "EXCEPTION [" << e.What() << "]";
+      // Wake up the threads whose instance has been stored
+      storeBatchCondition_.notify_all();
     }
 
-    return StoreStatus_Failure;
+    // Hand over the leadership to one of the waiting threads, if any
+    hasStoreBatchLeader_ = false;
+    storeBatchCondition_.notify_all();
+
+    return request.GetStatus();
   }
 
 
   void ServerIndex::ComputeStatistics(Json::Value& target)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    MutexLock lock(*this);
     target = Json::objectValue;
 
     uint64_t cs = currentStorageSize_;
@@ -883,18 +1236,19 @@ namespace Orthanc
 
 
 
-  SeriesStatus ServerIndex::GetSeriesStatus(int64_t id)
+  SeriesStatus ServerIndex::GetSeriesStatus(IDatabaseWrapper& db,
+                                            int64_t id)
   {
     // Get the expected number of instances in this series (from the metadata)
     int64_t expected;
-    if (!GetMetadataAsInteger(expected, id, MetadataType_Series_ExpectedNumberOfInstances))
+    if (!GetMetadataAsInteger(expected, db, id, MetadataType_Series_ExpectedNumberOfInstances))
     {
       return SeriesStatus_Unknown;
     }
 
     // Loop over the instances of this series
     std::list<int64_t> children;
-    db_.GetChildrenInternalId(children, id);
+    db.GetChildrenInternalId(children, id);
 
     std::set<int64_t> instances;
     for (std::list<int64_t>::const_iterator 
@@ -902,7 +1256,7 @@ namespace Orthanc
     {
       // Get the index of this instance in the series
       int64_t index;
-      if (!GetMetadataAsInteger(index, *it, MetadataType_Instance_IndexInSeries))
+      if (!GetMetadataAsInteger(index, db, *it, MetadataType_Instance_IndexInSeries))
       {
         return SeriesStatus_Unknown;
       }
@@ -934,17 +1288,16 @@ namespace Orthanc
 
 
   void ServerIndex::MainDicomTagsToJson(Json::Value& target,
-                                        int64_t resourceId,
+                                        const DicomMap& tags,
                                         ResourceType resourceType)
   {
-    DicomMap tags;
-    db_.GetMainDicomTags(tags, resourceId);
-
     if (resourceType == ResourceType_Study)
     {
       DicomMap t1, t2;
       tags.ExtractStudyInformation(t1);
       tags.ExtractPatientInformation(t2);
+      ServerToolbox::ExtractExtraMainDicomTags(t1, tags, ResourceType_Study);
+      ServerToolbox::ExtractExtraMainDicomTags(t2, tags, ResourceType_Patient);
 
       target["MainDicomTags"] = Json::objectValue;
       FromDcmtkBridge::ToJson(target["MainDicomTags"], t1, true);
@@ -959,34 +1312,19 @@ namespace Orthanc
     }
   }
 
-  bool ServerIndex::LookupResource(Json::Value& result,
+  void ServerIndex::ExpandResource(Json::Value& result,
+                                   IDatabaseWrapper& db,
+                                   int64_t id,
                                    const std::string& publicId,
-                                   ResourceType expectedType)
+                                   ResourceType type,
+                                   const DicomMap& mainDicomTags,
+                                   const std::string& parent)
   {
-    result = Json::objectValue;
-
-    boost::mutex::scoped_lock lock(mutex_);
-
-    // Lookup for the requested resource
-    int64_t id;
-    ResourceType type;
-    if (!db_.LookupResource(id, type, publicId) ||
-        type != expectedType)
-    {
-      return false;
-    }
+    result = Json::objectValue;
 
-    // Find the parent resource (if it exists)
+    // Record the parent resource (if it exists)
     if (type != ResourceType_Patient)
     {
-      int64_t parentId;
-      if (!db_.LookupParent(parentId, id))
-      {
-        throw OrthancException(ErrorCode_InternalError);
-      }
-
-      std::string parent = db_.GetPublicId(parentId);
-
       switch (type)
       {
         case ResourceType_Study:
@@ -1008,7 +1346,7 @@ namespace Orthanc
 
     // List the children resources
     std::list<std::string> children;
-    db_.GetChildrenPublicId(children, id);
+    db.GetChildrenPublicId(children, id);
 
     if (type != ResourceType_Instance)
     {
@@ -1053,10 +1391,10 @@ namespace Orthanc
       case ResourceType_Series:
       {
         result["Type"] = "Series";
-        result["Status"] = EnumerationToString(GetSeriesStatus(id));
+        result["Status"] = EnumerationToString(GetSeriesStatus(db, id));
 
         int64_t i;
-        if (GetMetadataAsInteger(i, id, MetadataType_Series_ExpectedNumberOfInstances))
+        if (GetMetadataAsInteger(i, db, id, MetadataType_Series_ExpectedNumberOfInstances))
           result["ExpectedNumberOfInstances"] = static_cast<int>(i);
         else
           result["ExpectedNumberOfInstances"] = Json::nullValue;
@@ -1069,7 +1407,7 @@ namespace Orthanc
         result["Type"] = "Instance";
 
         FileInfo attachment;
-        if (!db_.LookupAttachment(attachment, id, FileContentType_Dicom))
+        if (!db.LookupAttachment(attachment, id, FileContentType_Dicom))
         {
           throw OrthancException(ErrorCode_InternalError);
         }
@@ -1078,7 +1416,7 @@ namespace Orthanc
         result["FileUuid"] = attachment.GetUuid();
 
         int64_t i;
-        if (GetMetadataAsInteger(i, id, MetadataType_Instance_IndexInSeries))
+        if (GetMetadataAsInteger(i, db, id, MetadataType_Instance_IndexInSeries))
           result["IndexInSeries"] = static_cast<int>(i);
         else
           result["IndexInSeries"] = Json::nullValue;
@@ -1092,16 +1430,16 @@ namespace Orthanc
 
     // Record the remaining information
     result["ID"] = publicId;
-    MainDicomTagsToJson(result, id, type);
+    MainDicomTagsToJson(result, mainDicomTags, type);
 
     std::string tmp;
 
-    if (db_.LookupMetadata(tmp, id, MetadataType_AnonymizedFrom))
+    if (db.LookupMetadata(tmp, id, MetadataType_AnonymizedFrom))
     {
       result["AnonymizedFrom"] = tmp;
     }
 
-    if (db_.LookupMetadata(tmp, id, MetadataType_ModifiedFrom))
+    if (db.LookupMetadata(tmp, id, MetadataType_ModifiedFrom))
     {
       result["ModifiedFrom"] = tmp;
     }
@@ -1110,32 +1448,159 @@ namespace Orthanc
         type == ResourceType_Study ||
         type == ResourceType_Series)
     {
-      result["IsStable"] = !unstableResources_.Contains(id);
+      {
+        boost::mutex::scoped_lock lock(unstableResourcesMutex_);
+        result["IsStable"] = !unstableResources_.Contains(id);
+      }
 
-      if (db_.LookupMetadata(tmp, id, MetadataType_LastUpdate))
+      if (db.LookupMetadata(tmp, id, MetadataType_LastUpdate))
       {
         result["LastUpdate"] = tmp;
       }
     }
+  }
+
+
+  bool ServerIndex::LookupResource(Json::Value& result,
+                                   const std::string& publicId,
+                                   ResourceType expectedType)
+  {
+    result = Json::objectValue;
+
+    ReadOnlyAccessor accessor(*this);
+    IDatabaseWrapper& db = accessor.GetDatabase();
+
+    // Lookup for the requested resource
+    int64_t id;
+    ResourceType type;
+    if (!db.LookupResource(id, type, publicId) ||
+        type != expectedType)
+    {
+      return false;
+    }
+
+    std::string parent;
+    if (type != ResourceType_Patient)
+    {
+      int64_t parentId;
+      if (!db.LookupParent(parentId, id))
+      {
+        throw OrthancException(ErrorCode_InternalError);
+      }
+
+      parent = db.GetPublicId(parentId);
+    }
+
+    DicomMap tags;
+    db.GetMainDicomTags(tags, id);
 
+    ExpandResource(result, db, id, publicId, type, tags, parent);
     return true;
   }
 
 
+  void ServerIndex::ExpandResources(Json::Value& target,
+                                    const std::list<std::string>& publicIds,
+                                    ResourceType expectedType)
+  {
+    target = Json::arrayValue;
+
+    if (publicIds.empty())
+    {
+      return;
+    }
+
+    // The whole page is read with one database connection, and the
+    // parents and the main DICOM tags are read by set-oriented queries
+    ReadOnlyAccessor accessor(*this);
+    IDatabaseWrapper& db = accessor.GetDatabase();
+
+    std::vector<int64_t> ids;
+    std::vector<std::string> found;
+    ids.reserve(publicIds.size());
+    found.reserve(publicIds.size());
+
+    for (std::list<std::string>::const_iterator
+           it = publicIds.begin(); it != publicIds.end(); ++it)
+    {
+      int64_t id;
+      ResourceType type;
+      if (db.LookupResource(id, type, *it) &&
+          type == expectedType)
+      {
+        ids.push_back(id);
+        found.push_back(*it);
+      }
+    }
+
+    std::vector<std::string> parents(ids.size());
+
+    if (expectedType != ResourceType_Patient)
+    {
+      std::vector<int64_t> parentIds;
+      db.LookupParents(parentIds, ids);
+
+      for (size_t i = 0; i < parentIds.size(); i++)
+      {
+        if (parentIds[i] == -1)
+        {
+          throw OrthancException(ErrorCode_InternalError);
+        }
+      }
+
+      db.GetPublicIds(parents, parentIds);
+    }
+
+    std::vector<DicomMap*> tags(ids.size(), NULL);
+
+    try
+    {
+      for (size_t i = 0; i < tags.size(); i++)
+      {
+        tags[i] = new DicomMap;
+      }
+
+      db.GetMainDicomTags(tags, ids);
+
+      for (size_t i = 0; i < ids.size(); i++)
+      {
+        Json::Value item;
+        ExpandResource(item, db, ids[i], found[i], expectedType, *tags[i], parents[i]);
+        target.append(item);
+      }
+    }
+    catch (...)
+    {
+      for (size_t i = 0; i < tags.size(); i++)
+      {
+        delete tags[i];
+      }
+
+      throw;
+    }
+
+    for (size_t i = 0; i < tags.size(); i++)
+    {
+      delete tags[i];
+    }
+  }
+
+
   bool ServerIndex::LookupAttachment(FileInfo& attachment,
                                      const std::string& instanceUuid,
                                      FileContentType contentType)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyAccessor accessor(*this);
+    IDatabaseWrapper& db = accessor.GetDatabase();
 
     int64_t id;
     ResourceType type;
-    if (!db_.LookupResource(id, type, instanceUuid))
+    if (!db.LookupResource(id, type, instanceUuid))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
 
-    if (db_.LookupAttachment(attachment, id, contentType))
+    if (db.LookupAttachment(attachment, id, contentType))
     {
       assert(attachment.GetContentType() == contentType);
       return true;
@@ -1151,8 +1616,9 @@ namespace Orthanc
   void ServerIndex::GetAllUuids(std::list<std::string>& target,
                                 ResourceType resourceType)
   {
-    boost::mutex::scoped_lock lock(mutex_);
-    db_.GetAllPublicIds(target, resourceType);
+    ReadOnlyAccessor accessor(*this);
+    IDatabaseWrapper& db = accessor.GetDatabase();
+    db.GetAllPublicIds(target, resourceType);
   }
 
 
@@ -1167,8 +1633,94 @@ namespace Orthanc
       return;
     }
 
-    boost::mutex::scoped_lock lock(mutex_);
-    db_.GetAllPublicIds(target, resourceType, since, limit);
+    ReadOnlyAccessor accessor(*this);
+    IDatabaseWrapper& db = accessor.GetDatabase();
+    db.GetAllPublicIds(target, resourceType, since, limit);
+  }
+
+
+  // The cursors of the keyset pagination wrap the internal ID of the
+  // last resource of the page. They cannot be mistaken for a public
+  // identifier, that only contains hexadecimal digits and dashes.
+  static const std::string PAGINATION_CURSOR_PREFIX = "cursor-";
+
+
+  static bool ParsePaginationCursor(int64_t& internalId,
+                                    const std::string& cursor)
+  {
+    if (cursor.size() <= PAGINATION_CURSOR_PREFIX.size() ||
+        cursor.compare(0, PAGINATION_CURSOR_PREFIX.size(), PAGINATION_CURSOR_PREFIX) != 0)
+    {
+      return false;
+    }
+
+    try
+    {
+      internalId = boost::lexical_cast<int64_t>(cursor.substr(PAGINATION_CURSOR_PREFIX.size()));
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+      LOG(ERROR) << "Badly formatted pagination cursor: " << cursor;
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    if (internalId < 0)
+    {
+      LOG(ERROR) << "Badly formatted pagination cursor: " << cursor;
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    return true;
+  }
+
+
+  void ServerIndex::GetAllUuidsAfter(std::list<std::string>& target,
+                                     std::string& cursor,
+                                     ResourceType resourceType,
+                                     const std::string& after,
+                                     size_t limit)
+  {
+    target.clear();
+
+    ReadOnlyAccessor accessor(*this);
+    IDatabaseWrapper& db = accessor.GetDatabase();
+
+    int64_t start = 0;
+
+    if (!after.empty() &&
+        !ParsePaginationCursor(start, after))
+    {
+      ResourceType type;
+      if (!db.LookupResource(start, type, after) ||
+          type != resourceType)
+      {
+        // The position of a deleted resource is unknown: The client
+        // should paginate with the cursors to be robust to deletions
+        LOG(ERROR) << "Unknown resource, use the pagination cursor instead: " << after;
+        throw OrthancException(ErrorCode_UnknownResource);
+      }
+    }
+
+    if (limit != 0)
+    {
+      std::vector<int64_t> internalIds;
+      std::vector<std::string> publicIds;
+      db.GetResourcesAfter(internalIds, publicIds, resourceType, start, limit);
+
+      for (size_t i = 0; i < publicIds.size(); i++)
+      {
+        target.push_back(publicIds[i]);
+      }
+
+      if (!internalIds.empty())
+      {
+        start = internalIds.back();
+      }
+    }
+
+    // If the page is empty, the cursor does not move, so that the
+    // client can later poll for the resources that are created
+    cursor = PAGINATION_CURSOR_PREFIX + boost::lexical_cast<std::string>(start);
   }
 
 
@@ -1205,7 +1757,7 @@ namespace Orthanc
     bool done;
 
     {
-      boost::mutex::scoped_lock lock(mutex_);
+      MutexLock lock(*this);
 
       // Fix wrt. Orthanc <= 1.3.2: A transaction was missing, as
       // "GetLastChange()" involves calls to "GetPublicId()"
@@ -1223,7 +1775,7 @@ namespace Orthanc
     std::list<ServerIndexChange> changes;
 
     {
-      boost::mutex::scoped_lock lock(mutex_);
+      MutexLock lock(*this);
 
       // Fix wrt. Orthanc <= 1.3.2: A transaction was missing, as
       // "GetLastChange()" involves calls to "GetPublicId()"
@@ -1239,7 +1791,7 @@ namespace Orthanc
   void ServerIndex::LogExportedResource(const std::string& publicId,
                                         const std::string& remoteModality)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    MutexLock lock(*this);
     Transaction transaction(*this);
 
     int64_t id;
@@ -1334,7 +1886,7 @@ namespace Orthanc
     bool done;
 
     {
-      boost::mutex::scoped_lock lock(mutex_);
+      MutexLock lock(*this);
       db_.GetExportedResources(exported, done, since, maxResults);
     }
 
@@ -1347,7 +1899,7 @@ namespace Orthanc
     std::list<ExportedResource> exported;
 
     {
-      boost::mutex::scoped_lock lock(mutex_);
+      MutexLock lock(*this);
       db_.GetLastExportedResource(exported);
     }
 
@@ -1359,7 +1911,11 @@ namespace Orthanc
   {
     if (maximumStorageSize_ != 0)
     {
-      uint64_t currentSize = currentStorageSize_ - listener_->GetSizeOfFilesToRemove();
+      // The files that were added by the current transaction must be
+      // taken into consideration, in the case of group commit
+      uint64_t currentSize = (currentStorageSize_ +
+                              listener_->GetSizeOfAddedFiles() -
+                              listener_->GetSizeOfFilesToRemove());
       assert(db_.GetTotalCompressedSize() == currentSize);
 
       if (currentSize + instanceSize > maximumStorageSize_)
@@ -1429,7 +1985,7 @@ namespace Orthanc
 
   void ServerIndex::SetMaximumPatientCount(unsigned int count) 
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    MutexLock lock(*this);
     maximumPatients_ = count;
 
     if (count == 0)
@@ -1446,7 +2002,7 @@ namespace Orthanc
 
   void ServerIndex::SetMaximumStorageSize(uint64_t size) 
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    MutexLock lock(*this);
     maximumStorageSize_ = size;
 
     if (size == 0)
@@ -1461,6 +2017,40 @@ namespace Orthanc
     StandaloneRecycling();
   }
 
+  void ServerIndex::SetStoreBatch(unsigned int size,
+                                  unsigned int latency)
+  {
+    boost::mutex::scoped_lock lock(storeBatchMutex_);
+
+    if (size <= 1)
+    {
+      storeBatchSize_ = 1;
+      LOG(INFO) << "Group commit of the incoming instances is disabled";
+    }
+    else
+    {
+      storeBatchSize_ = size;
+      storeBatchLatency_ = latency;
+      LOG(WARNING) << "Group commit of the incoming instances is enabled: At most "
+                   << size << " instances per transaction, max latency of "
+                   << latency << "ms";
+    }
+  }
+
+  void ServerIndex::AddReadOnlyConnection(IDatabaseWrapper* database)
+  {
+    if (database == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+
+    boost::mutex::scoped_lock lock(readersMutex_);
+    readers_.push_back(database);
+    availableReaders_.push(database);
+    readersCondition_.notify_one();
+  }
+
+
   void ServerIndex::StandaloneRecycling()
   {
     // WARNING: No mutex here, do not include this as a public method
@@ -1472,25 +2062,26 @@ namespace Orthanc
 
   bool ServerIndex::IsProtectedPatient(const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyAccessor accessor(*this);
+    IDatabaseWrapper& db = accessor.GetDatabase();
 
     // Lookup for the requested resource
     int64_t id;
     ResourceType type;
-    if (!db_.LookupResource(id, type, publicId) ||
+    if (!db.LookupResource(id, type, publicId) ||
         type != ResourceType_Patient)
     {
       throw OrthancException(ErrorCode_ParameterOutOfRange);
     }
 
-    return db_.IsProtectedPatient(id);
+    return db.IsProtectedPatient(id);
   }
      
 
   void ServerIndex::SetProtectedPatient(const std::string& publicId,
                                         bool isProtected)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    MutexLock lock(*this);
     Transaction transaction(*this);
 
     // Lookup for the requested resource
@@ -1517,11 +2108,12 @@ namespace Orthanc
   {
     result.clear();
 
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyAccessor accessor(*this);
+    IDatabaseWrapper& db = accessor.GetDatabase();
 
     ResourceType type;
     int64_t resource;
-    if (!db_.LookupResource(resource, type, publicId))
+    if (!db.LookupResource(resource, type, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
@@ -1533,12 +2125,12 @@ namespace Orthanc
     }
 
     std::list<int64_t> tmp;
-    db_.GetChildrenInternalId(tmp, resource);
+    db.GetChildrenInternalId(tmp, resource);
 
     for (std::list<int64_t>::const_iterator 
            it = tmp.begin(); it != tmp.end(); ++it)
     {
-      result.push_back(db_.GetPublicId(*it));
+      result.push_back(db.GetPublicId(*it));
     }
   }
 
@@ -1548,11 +2140,12 @@ namespace Orthanc
   {
     result.clear();
 
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyAccessor accessor(*this);
+    IDatabaseWrapper& db = accessor.GetDatabase();
 
     ResourceType type;
     int64_t top;
-    if (!db_.LookupResource(top, type, publicId))
+    if (!db.LookupResource(top, type, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
@@ -1575,14 +2168,14 @@ namespace Orthanc
       int64_t resource = toExplore.top();
       toExplore.pop();
 
-      if (db_.GetResourceType(resource) == ResourceType_Instance)
+      if (db.GetResourceType(resource) == ResourceType_Instance)
       {
-        result.push_back(db_.GetPublicId(resource));
+        result.push_back(db.GetPublicId(resource));
       }
       else
       {
         // Tag all the children of this resource as to be explored
-        db_.GetChildrenInternalId(tmp, resource);
+        db.GetChildrenInternalId(tmp, resource);
         for (std::list<int64_t>::const_iterator 
                it = tmp.begin(); it != tmp.end(); ++it)
         {
@@ -1597,7 +2190,7 @@ namespace Orthanc
                                 MetadataType type,
                                 const std::string& value)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    MutexLock lock(*this);
     Transaction t(*this);
 
     ResourceType rtype;
@@ -1621,7 +2214,7 @@ namespace Orthanc
   void ServerIndex::DeleteMetadata(const std::string& publicId,
                                    MetadataType type)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    MutexLock lock(*this);
     Transaction t(*this);
 
     ResourceType rtype;
@@ -1646,32 +2239,34 @@ namespace Orthanc
                                    const std::string& publicId,
                                    MetadataType type)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyAccessor accessor(*this);
+    IDatabaseWrapper& db = accessor.GetDatabase();
 
     ResourceType rtype;
     int64_t id;
-    if (!db_.LookupResource(id, rtype, publicId))
+    if (!db.LookupResource(id, rtype, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
 
-    return db_.LookupMetadata(target, id, type);
+    return db.LookupMetadata(target, id, type);
   }
 
 
   void ServerIndex::ListAvailableMetadata(std::list<MetadataType>& target,
                                           const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyAccessor accessor(*this);
+    IDatabaseWrapper& db = accessor.GetDatabase();
 
     ResourceType rtype;
     int64_t id;
-    if (!db_.LookupResource(id, rtype, publicId))
+    if (!db.LookupResource(id, rtype, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
 
-    db_.ListAvailableMetadata(target, id);
+    db.ListAvailableMetadata(target, id);
   }
 
 
@@ -1679,36 +2274,38 @@ namespace Orthanc
                                              const std::string& publicId,
                                              ResourceType expectedType)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyAccessor accessor(*this);
+    IDatabaseWrapper& db = accessor.GetDatabase();
 
     ResourceType type;
     int64_t id;
-    if (!db_.LookupResource(id, type, publicId) ||
+    if (!db.LookupResource(id, type, publicId) ||
         expectedType != type)
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
 
-    db_.ListAvailableAttachments(target, id);
+    db.ListAvailableAttachments(target, id);
   }
 
 
   bool ServerIndex::LookupParent(std::string& target,
                                  const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyAccessor accessor(*this);
+    IDatabaseWrapper& db = accessor.GetDatabase();
 
     ResourceType type;
     int64_t id;
-    if (!db_.LookupResource(id, type, publicId))
+    if (!db.LookupResource(id, type, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
 
     int64_t parentId;
-    if (db_.LookupParent(parentId, id))
+    if (db.LookupParent(parentId, id))
     {
-      target = db_.GetPublicId(parentId);
+      target = db.GetPublicId(parentId);
       return true;
     }
     else
@@ -1720,7 +2317,7 @@ namespace Orthanc
 
   uint64_t ServerIndex::IncrementGlobalSequence(GlobalProperty sequence)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    MutexLock lock(*this);
     Transaction transaction(*this);
 
     uint64_t seq = IncrementGlobalSequenceInternal(sequence);
@@ -1734,7 +2331,7 @@ namespace Orthanc
   void ServerIndex::LogChange(ChangeType changeType,
                               const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    MutexLock lock(*this);
     Transaction transaction(*this);
 
     int64_t id;
@@ -1751,13 +2348,13 @@ namespace Orthanc
 
   void ServerIndex::DeleteChanges()
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    MutexLock lock(*this);
     db_.ClearChanges();
   }
 
   void ServerIndex::DeleteExportedResources()
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    MutexLock lock(*this);
     db_.ClearExportedResources();
   }
 
@@ -1770,64 +2367,70 @@ namespace Orthanc
                                           /* in  */ int64_t id,
                                           /* in  */ ResourceType type)
   {
-    std::stack<int64_t> toExplore;
-    toExplore.push(id);
-
     countInstances = 0;
     countSeries = 0;
     countStudies = 0;
     compressedSize = 0;
     uncompressedSize = 0;
 
-    while (!toExplore.empty())
+    if (!db_.LookupResourceStatistics(compressedSize, uncompressedSize, countStudies,
+                                      countSeries, countInstances, id))
     {
-      // Get the internal ID of the current resource
-      int64_t resource = toExplore.top();
-      toExplore.pop();
+      // The database engine does not maintain the statistics of the
+      // resources: Walk through the hierarchy
+      std::stack<int64_t> toExplore;
+      toExplore.push(id);
 
-      ResourceType thisType = db_.GetResourceType(resource);
+      while (!toExplore.empty())
+      {
+        // Get the internal ID of the current resource
+        int64_t resource = toExplore.top();
+        toExplore.pop();
 
-      std::list<FileContentType> f;
-      db_.ListAvailableAttachments(f, resource);
+        ResourceType thisType = db_.GetResourceType(resource);
 
-      for (std::list<FileContentType>::const_iterator
-             it = f.begin(); it != f.end(); ++it)
-      {
-        FileInfo attachment;
-        if (db_.LookupAttachment(attachment, resource, *it))
+        std::list<FileContentType> f;
+        db_.ListAvailableAttachments(f, resource);
+
+        for (std::list<FileContentType>::const_iterator
+               it = f.begin(); it != f.end(); ++it)
         {
-          compressedSize += attachment.GetCompressedSize();
-          uncompressedSize += attachment.GetUncompressedSize();
+          FileInfo attachment;
+          if (db_.LookupAttachment(attachment, resource, *it))
+          {
+            compressedSize += attachment.GetCompressedSize();
+            uncompressedSize += attachment.GetUncompressedSize();
+          }
         }
-      }
 
-      if (thisType == ResourceType_Instance)
-      {
-        countInstances++;
-      }
-      else
-      {
-        switch (thisType)
+        if (thisType == ResourceType_Instance)
+        {
+          countInstances++;
+        }
+        else
         {
-          case ResourceType_Study:
-            countStudies++;
-            break;
+          switch (thisType)
+          {
+            case ResourceType_Study:
+              countStudies++;
+              break;
 
-          case ResourceType_Series:
-            countSeries++;
-            break;
+            case ResourceType_Series:
+              countSeries++;
+              break;
 
-          default:
-            break;
-        }
+            default:
+              break;
+          }
 
-        // Tag all the children of this resource as to be explored
-        std::list<int64_t> tmp;
-        db_.GetChildrenInternalId(tmp, resource);
-        for (std::list<int64_t>::const_iterator 
-               it = tmp.begin(); it != tmp.end(); ++it)
-        {
-          toExplore.push(*it);
+          // Tag all the children of this resource as to be explored
+          std::list<int64_t> tmp;
+          db_.GetChildrenInternalId(tmp, resource);
+          for (std::list<int64_t>::const_iterator 
+                 it = tmp.begin(); it != tmp.end(); ++it)
+          {
+            toExplore.push(*it);
+          }
         }
       }
     }
@@ -1848,7 +2451,7 @@ namespace Orthanc
   void ServerIndex::GetStatistics(Json::Value& target,
                                   const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    MutexLock lock(*this);
 
     ResourceType type;
     int64_t top;
@@ -1897,7 +2500,7 @@ namespace Orthanc
                                   /* out */ unsigned int& countInstances, 
                                   const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    MutexLock lock(*this);
 
     ResourceType type;
     int64_t top;
@@ -1911,6 +2514,59 @@ namespace Orthanc
   }
 
 
+  bool ServerIndex::LookupChildrenCounters(unsigned int& countStudies, 
+                                           unsigned int& countSeries, 
+                                           unsigned int& countInstances, 
+                                           const std::string& publicId)
+  {
+    ReadOnlyAccessor accessor(*this);
+    IDatabaseWrapper& db = accessor.GetDatabase();
+
+    ResourceType type;
+    int64_t id;
+    if (!db.LookupResource(id, type, publicId))
+    {
+      throw OrthancException(ErrorCode_UnknownResource);
+    }
+
+    uint64_t compressedSize, uncompressedSize;
+    return db.LookupResourceStatistics(compressedSize, uncompressedSize, countStudies,
+                                       countSeries, countInstances, id);
+  }
+
+
+  bool ServerIndex::LookupStudyAggregates(std::set<std::string>& modalities,
+                                          std::set<std::string>& sopClassUids,
+                                          bool& hasAllSopClassUids,
+                                          const std::string& studyPublicId)
+  {
+    ReadOnlyAccessor accessor(*this);
+    IDatabaseWrapper& db = accessor.GetDatabase();
+
+    ResourceType type;
+    int64_t id;
+    if (!db.LookupResource(id, type, studyPublicId) ||
+        type != ResourceType_Study)
+    {
+      throw OrthancException(ErrorCode_UnknownResource);
+    }
+
+    uint64_t compressedSize, uncompressedSize;
+    unsigned int countStudies, countSeries, countInstances, countSopClassUids;
+    if (!db.LookupResourceStatistics(compressedSize, uncompressedSize, countStudies,
+                                     countSeries, countInstances, id) ||
+        !db.LookupStudyAggregates(modalities, sopClassUids, countSopClassUids, id))
+    {
+      return false;
+    }
+
+    // The SOP class UID is not stored as a metadata for the instances
+    // that were received by Orthanc <= 1.1.0
+    hasAllSopClassUids = (countSopClassUids == countInstances);
+    return true;
+  }
+
+
   void ServerIndex::UnstableResourcesMonitorThread(ServerIndex* that,
                                                    unsigned int threadSleep)
   {
@@ -1927,7 +2583,8 @@ namespace Orthanc
       // Check for stable resources each few seconds
       boost::this_thread::sleep(boost::posix_time::milliseconds(threadSleep));
 
-      boost::mutex::scoped_lock lock(that->mutex_);
+      MutexLock lock(*that);
+      boost::mutex::scoped_lock lock2(that->unstableResourcesMutex_);
 
       while (!that->unstableResources_.IsEmpty() &&
              that->unstableResources_.GetOldestPayload().GetAge() > static_cast<unsigned int>(stableAge))
@@ -1978,14 +2635,38 @@ namespace Orthanc
            type == Orthanc::ResourceType_Study ||
            type == Orthanc::ResourceType_Series);
 
-    UnstableResourcePayload payload(type, publicId);
-    unstableResources_.AddOrMakeMostRecent(id, payload);
+    {
+      // Registered by "CommitUnstableResources()" once the
+      // transaction is committed
+      PendingUnstableResource pending;
+      pending.id_ = id;
+      pending.type_ = type;
+      pending.publicId_ = publicId;
+      pendingUnstableResources_.push_back(pending);
+    }
     //LOG(INFO) << "Unstable resource: " << EnumerationToString(type) << " " << id;
 
     LogChange(id, ChangeType_NewChildInstance, type, publicId);
   }
 
 
+  void ServerIndex::CommitUnstableResources()
+  {
+    // WARNING: Before calling this method, "mutex_" must be locked.
+
+    boost::mutex::scoped_lock lock(unstableResourcesMutex_);
+
+    for (std::list<PendingUnstableResource>::const_iterator
+           it = pendingUnstableResources_.begin(); it != pendingUnstableResources_.end(); ++it)
+    {
+      UnstableResourcePayload payload(it->type_, it->publicId_);
+      unstableResources_.AddOrMakeMostRecent(it->id_, payload);
+    }
+
+    pendingUnstableResources_.clear();
+  }
+
+
 
   void ServerIndex::LookupIdentifierExact(std::list<std::string>& result,
                                           ResourceType level,
@@ -2000,18 +2681,19 @@ namespace Orthanc
     
     result.clear();
 
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyAccessor accessor(*this);
+    IDatabaseWrapper& db = accessor.GetDatabase();
 
     LookupIdentifierQuery query(level);
     query.AddConstraint(tag, IdentifierConstraintType_Equal, value);
-    query.Apply(result, db_);
+    query.Apply(result, db);
   }
 
 
   StoreStatus ServerIndex::AddAttachment(const FileInfo& attachment,
                                          const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    MutexLock lock(*this);
 
     Transaction t(*this);
 
@@ -2059,10 +2741,35 @@ namespace Orthanc
   }
 
 
+  StoreStatus ServerIndex::AddCacheAttachment(const FileInfo& attachment,
+                                              const std::string& publicId)
+  {
+    MutexLock lock(*this);
+
+    Transaction t(*this);
+
+    ResourceType resourceType;
+    int64_t resourceId;
+    if (!db_.LookupResource(resourceId, resourceType, publicId))
+    {
+      return StoreStatus_Failure;  // Inexistent resource
+    }
+
+    // The previous version of the attachment is removed from the
+    // storage area once the transaction is committed
+    db_.DeleteAttachment(resourceId, attachment.GetContentType());
+    db_.AddAttachment(resourceId, attachment);
+
+    t.Commit(attachment.GetCompressedSize());
+
+    return StoreStatus_Success;
+  }
+
+
   void ServerIndex::DeleteAttachment(const std::string& publicId,
                                      FileContentType type)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    MutexLock lock(*this);
     Transaction t(*this);
 
     ResourceType rtype;
@@ -2086,19 +2793,20 @@ namespace Orthanc
   bool ServerIndex::GetMetadata(Json::Value& target,
                                 const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyAccessor accessor(*this);
+    IDatabaseWrapper& db = accessor.GetDatabase();
 
     target = Json::objectValue;
 
     ResourceType type;
     int64_t id;
-    if (!db_.LookupResource(id, type, publicId))
+    if (!db.LookupResource(id, type, publicId))
     {
       return false;
     }
 
     std::list<MetadataType> metadata;
-    db_.ListAvailableMetadata(metadata, id);
+    db.ListAvailableMetadata(metadata, id);
 
     for (std::list<MetadataType>::const_iterator
            it = metadata.begin(); it != metadata.end(); ++it)
@@ -2106,7 +2814,7 @@ namespace Orthanc
       std::string key = EnumerationToString(*it);
 
       std::string value;
-      if (!db_.LookupMetadata(value, id, *it))
+      if (!db.LookupMetadata(value, id, *it))
       {
         value.clear();
       }
@@ -2121,7 +2829,7 @@ namespace Orthanc
   void ServerIndex::SetGlobalProperty(GlobalProperty property,
                                       const std::string& value)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    MutexLock lock(*this);
     db_.SetGlobalProperty(property, value);
   }
 
@@ -2129,7 +2837,7 @@ namespace Orthanc
   bool ServerIndex::LookupGlobalProperty(std::string& value,
                                          GlobalProperty property)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    MutexLock lock(*this);
     return db_.LookupGlobalProperty(value, property);
   }
   
@@ -2167,12 +2875,13 @@ namespace Orthanc
 
     result.Clear();
 
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyAccessor accessor(*this);
+    IDatabaseWrapper& db = accessor.GetDatabase();
 
     // Lookup for the requested resource
     int64_t id;
     ResourceType type;
-    if (!db_.LookupResource(id, type, publicId) ||
+    if (!db.LookupResource(id, type, publicId) ||
         type != expectedType)
     {
       return false;
@@ -2181,16 +2890,18 @@ namespace Orthanc
     if (type == ResourceType_Study)
     {
       DicomMap tmp;
-      db_.GetMainDicomTags(tmp, id);
+      db.GetMainDicomTags(tmp, id);
 
       switch (levelOfInterest)
       {
         case ResourceType_Patient:
           tmp.ExtractPatientInformation(result);
+          ServerToolbox::ExtractExtraMainDicomTags(result, tmp, ResourceType_Patient);
           return true;
 
         case ResourceType_Study:
           tmp.ExtractStudyInformation(result);
+          ServerToolbox::ExtractExtraMainDicomTags(result, tmp, ResourceType_Study);
           return true;
 
         default:
@@ -2199,7 +2910,7 @@ namespace Orthanc
     }
     else
     {
-      db_.GetMainDicomTags(result, id);
+      db.GetMainDicomTags(result, id);
       return true;
     }    
   }
@@ -2208,16 +2919,17 @@ namespace Orthanc
   bool ServerIndex::LookupResourceType(ResourceType& type,
                                        const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyAccessor accessor(*this);
+    IDatabaseWrapper& db = accessor.GetDatabase();
 
     int64_t id;
-    return db_.LookupResource(id, type, publicId);
+    return db.LookupResource(id, type, publicId);
   }
 
 
   unsigned int ServerIndex::GetDatabaseVersion()
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    MutexLock lock(*this);
     return db_.GetDatabaseVersion();
   }
 
@@ -2226,29 +2938,39 @@ namespace Orthanc
                                    std::vector<std::string>& instances,
                                    const ::Orthanc::LookupResource& lookup)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyAccessor accessor(*this);
+    IDatabaseWrapper& db = accessor.GetDatabase();
    
     std::list<int64_t> tmp;
-    lookup.FindCandidates(tmp, db_);
+    lookup.FindCandidates(tmp, db);
 
-    resources.resize(tmp.size());
-    instances.resize(tmp.size());
+    std::vector<int64_t> candidates(tmp.begin(), tmp.end());
+    std::vector<int64_t> children(candidates.size());
 
-    size_t pos = 0;
-    for (std::list<int64_t>::const_iterator
-           it = tmp.begin(); it != tmp.end(); ++it, pos++)
+#ifndef NDEBUG
     {
-      assert(db_.GetResourceType(*it) == lookup.GetLevel());
-      
-      int64_t instance;
-      if (!ServerToolbox::FindOneChildInstance(instance, db_, *it, lookup.GetLevel()))
+      std::vector<ResourceType> types;
+      db.GetResourceTypes(types, candidates);
+
+      for (size_t i = 0; i < types.size(); i++)
       {
-        throw OrthancException(ErrorCode_InternalError);
+        assert(types[i] == lookup.GetLevel());
       }
+    }
+#endif
 
-      resources[pos] = db_.GetPublicId(*it);
-      instances[pos] = db_.GetPublicId(instance);
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+      if (!ServerToolbox::FindOneChildInstance(children[i], db, candidates[i], lookup.GetLevel()))
+      {
+        throw OrthancException(ErrorCode_InternalError);
+      }
     }
+
+    // The public IDs are read by set-oriented queries, instead of one
+    // round trip to the database per candidate
+    db.GetPublicIds(resources, candidates);
+    db.GetPublicIds(instances, children);
   }
 
 
@@ -2256,11 +2978,12 @@ namespace Orthanc
                                  const std::string& publicId,
                                  ResourceType parentType)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyAccessor accessor(*this);
+    IDatabaseWrapper& db = accessor.GetDatabase();
 
     ResourceType type;
     int64_t id;
-    if (!db_.LookupResource(id, type, publicId))
+    if (!db.LookupResource(id, type, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
@@ -2270,7 +2993,7 @@ namespace Orthanc
       int64_t parentId;
 
       if (type == ResourceType_Patient ||    // Cannot further go up in hierarchy
-          !db_.LookupParent(parentId, id))
+          !db.LookupParent(parentId, id))
       {
         return false;
       }
@@ -2279,7 +3002,7 @@ namespace Orthanc
       type = GetParentResourceType(type);
     }
 
-    target = db_.GetPublicId(id);
+    target = db.GetPublicId(id);
     return true;
   }
 
@@ -2291,7 +3014,7 @@ namespace Orthanc
 
     DicomInstanceHasher hasher(summary);
 
-    boost::mutex::scoped_lock lock(mutex_);
+    MutexLock lock(*this);
 
     try
     {
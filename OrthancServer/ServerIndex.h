@@ -35,7 +35,9 @@
 
 #include <boost/thread.hpp>
 #include <boost/noncopyable.hpp>
+#include <stack>
 #include "../Core/Cache/LeastRecentlyUsedIndex.h"
+#include "../Core/MetricsRegistry.h"
 #include "../Core/SQLite/Connection.h"
 #include "../Core/DicomFormat/DicomMap.h"
 #include "../Core/DicomFormat/DicomInstanceHasher.h"
@@ -60,31 +62,73 @@ namespace Orthanc
     class Listener;
     class Transaction;
     class UnstableResourcePayload;
+    class StoreRequest;
+    class ReadOnlyAccessor;
+    class MutexLock;
 
     bool done_;
     boost::mutex mutex_;
+    MetricsRegistry& metrics_;
     boost::thread flushThread_;
     boost::thread unstableResourcesMonitorThread_;
 
     std::auto_ptr<Listener> listener_;
     IDatabaseWrapper& db_;
+    boost::mutex unstableResourcesMutex_;  // Always locked after "mutex_"
     LeastRecentlyUsedIndex<int64_t, UnstableResourcePayload>  unstableResources_;
 
+    // The resources that are marked as unstable by the current
+    // transaction are only registered in "unstableResources_" once it
+    // is committed. Protected by "mutex_".
+    struct PendingUnstableResource
+    {
+      int64_t       id_;
+      ResourceType  type_;
+      std::string   publicId_;
+    };
+
+    std::list<PendingUnstableResource>  pendingUnstableResources_;
+
     uint64_t currentStorageSize_;
     uint64_t maximumStorageSize_;
     unsigned int maximumPatients_;
 
+    // Group commit of the incoming instances (new in Orthanc 1.4.2)
+    boost::mutex storeBatchMutex_;
+    boost::condition_variable storeBatchCondition_;
+    std::list<StoreRequest*> storeBatchQueue_;
+    bool hasStoreBatchLeader_;
+    unsigned int storeBatchSize_;
+    unsigned int storeBatchLatency_;
+
+    // Pool of read-only connections to the database, that are used
+    // instead of "db_" so that read-only requests are not serialized
+    // with the writers (new in Orthanc 1.4.2)
+    boost::mutex readersMutex_;
+    boost::condition_variable readersCondition_;
+    std::vector<IDatabaseWrapper*> readers_;   // Owned by this object
+    std::stack<IDatabaseWrapper*> availableReaders_;
+
     static void FlushThread(ServerIndex* that,
                             unsigned int threadSleep);
 
     static void UnstableResourcesMonitorThread(ServerIndex* that,
                                                unsigned int threadSleep);
 
-    void MainDicomTagsToJson(Json::Value& result,
-                             int64_t resourceId,
-                             ResourceType resourceType);
+    static void MainDicomTagsToJson(Json::Value& result,
+                                    const DicomMap& tags,
+                                    ResourceType resourceType);
 
-    SeriesStatus GetSeriesStatus(int64_t id);
+    void ExpandResource(Json::Value& result,
+                        IDatabaseWrapper& db,
+                        int64_t id,
+                        const std::string& publicId,
+                        ResourceType type,
+                        const DicomMap& mainDicomTags,
+                        const std::string& parent);
+
+    SeriesStatus GetSeriesStatus(IDatabaseWrapper& db,
+                                 int64_t id);
 
     bool IsRecyclingNeeded(uint64_t instanceSize);
 
@@ -97,6 +141,8 @@ namespace Orthanc
                         Orthanc::ResourceType type,
                         const std::string& publicId);
 
+    void CommitUnstableResources();
+
     void GetStatisticsInternal(/* out */ uint64_t& compressedSize, 
                                /* out */ uint64_t& uncompressedSize, 
                                /* out */ unsigned int& countStudies, 
@@ -106,6 +152,7 @@ namespace Orthanc
                                /* in  */ ResourceType type);
 
     bool GetMetadataAsInteger(int64_t& result,
+                              IDatabaseWrapper& db,
                               int64_t id,
                               MetadataType type);
 
@@ -124,6 +171,19 @@ namespace Orthanc
                              MetadataType metadata,
                              const std::string& value);
 
+    StoreStatus StoreInternal(std::map<MetadataType, std::string>& instanceMetadata,
+                              DicomInstanceHasher& hasher,
+                              DicomInstanceToStore& instance,
+                              const Attachments& attachments);
+
+    StoreStatus StoreInTransaction(std::map<MetadataType, std::string>& instanceMetadata,
+                                   DicomInstanceHasher& hasher,
+                                   DicomInstanceToStore& instance,
+                                   const Attachments& attachments);
+
+    void StoreBatch(std::vector<StoreStatus>& status,
+                    const std::vector<StoreRequest*>& batch);
+
   public:
     ServerIndex(ServerContext& context,
                 IDatabaseWrapper& database,
@@ -149,6 +209,15 @@ namespace Orthanc
     // "count == 0" means no limit on the number of patients
     void SetMaximumPatientCount(unsigned int count);
 
+    // "size <= 1" disables the group commit of the incoming
+    // instances. The latency is expressed in milliseconds.
+    void SetStoreBatch(unsigned int size,
+                       unsigned int latency);
+
+    // Takes the ownership of the connection, that must only be used
+    // for read-only queries
+    void AddReadOnlyConnection(IDatabaseWrapper* database);
+
     StoreStatus Store(std::map<MetadataType, std::string>& instanceMetadata,
                       DicomInstanceToStore& instance,
                       const Attachments& attachments);
@@ -159,6 +228,13 @@ namespace Orthanc
                         const std::string& publicId,
                         ResourceType expectedType);
 
+    // Same as "LookupResource()" for a full page of resources, whose
+    // descriptions are stored in the JSON array "target". The
+    // resources that do not exist (anymore) are skipped.
+    void ExpandResources(Json::Value& target,
+                         const std::list<std::string>& publicIds,
+                         ResourceType expectedType);
+
     bool LookupAttachment(FileInfo& attachment,
                           const std::string& instanceUuid,
                           FileContentType contentType);
@@ -171,6 +247,17 @@ namespace Orthanc
                      size_t since,
                      size_t limit);
 
+    // Keyset pagination: Lists the resources that were created after
+    // "after" (or from the beginning if "after" is empty), which is
+    // either a public identifier, or the cursor that was returned by
+    // the previous page. Contrarily to a public identifier, a cursor
+    // remains valid once its resource has been deleted.
+    void GetAllUuidsAfter(std::list<std::string>& target,
+                          std::string& cursor /* out */,
+                          ResourceType resourceType,
+                          const std::string& after,
+                          size_t limit);
+
     bool DeleteResource(Json::Value& target /* out */,
                         const std::string& uuid,
                         ResourceType expectedType);
@@ -244,6 +331,20 @@ namespace Orthanc
                        /* out */ unsigned int& countInstances, 
                        const std::string& publicId);
 
+    // The two methods below read the counters and the aggregated
+    // values of C-FIND in constant time, if the database engine
+    // maintains them. Otherwise, they return "false" and the caller
+    // must walk through the hierarchy.
+    bool LookupChildrenCounters(/* out */ unsigned int& countStudies, 
+                                /* out */ unsigned int& countSeries, 
+                                /* out */ unsigned int& countInstances, 
+                                const std::string& publicId);
+
+    bool LookupStudyAggregates(/* out */ std::set<std::string>& modalities,
+                               /* out */ std::set<std::string>& sopClassUids,
+                               /* out */ bool& hasAllSopClassUids,
+                               const std::string& studyPublicId);
+
     void LookupIdentifierExact(std::list<std::string>& result,
                                ResourceType level,
                                const DicomTag& tag,
@@ -252,6 +353,12 @@ namespace Orthanc
     StoreStatus AddAttachment(const FileInfo& attachment,
                               const std::string& publicId);
 
+    // Replaces an attachment that only caches data that is derived
+    // from the resource: Contrarily to "AddAttachment()", this never
+    // triggers the recycling mechanism, and is not logged as a change
+    StoreStatus AddCacheAttachment(const FileInfo& attachment,
+                                   const std::string& publicId);
+
     void DeleteAttachment(const std::string& publicId,
                           FileContentType type);
 
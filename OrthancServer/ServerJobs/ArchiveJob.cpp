@@ -687,7 +687,6 @@ namespace Orthanc
   class ArchiveJob::ZipWriterIterator : public boost::noncopyable
   {
   private:
-    TemporaryFile&                        target_;
     ServerContext&                        context_;
     ZipCommands                           commands_;
     std::auto_ptr<HierarchicalZipWriter>  zip_;
@@ -695,15 +694,24 @@ namespace Orthanc
     bool                                  isMedia_;
 
   public:
-    ZipWriterIterator(TemporaryFile& target,
+    // Exactly one of "target" and "stream" must be non-NULL. The
+    // ownership of "stream" is transferred to the iterator.
+    ZipWriterIterator(TemporaryFile* target,
+                      ZipWriter::IOutputStream* stream,
                       ServerContext& context,
                       ArchiveIndex& archive,
                       bool isMedia,
                       bool enableExtendedSopClass) :
-      target_(target),
       context_(context),
       isMedia_(isMedia)
     {
+      std::auto_ptr<ZipWriter::IOutputStream> protection(stream);
+
+      if ((target == NULL) == (stream == NULL))
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+
       if (isMedia)
       {
         MediaIndexVisitor visitor(commands_, context);
@@ -723,8 +731,17 @@ namespace Orthanc
         archive.Apply(visitor);
       }
 
-      zip_.reset(new HierarchicalZipWriter(target.GetPath().c_str()));
-      zip_->SetZip64(commands_.IsZip64());
+      if (target != NULL)
+      {
+        zip_.reset(new HierarchicalZipWriter(target->GetPath().c_str()));
+        zip_->SetZip64(commands_.IsZip64());
+      }
+      else
+      {
+        // No temporary file: The archive is directly pushed to the
+        // stream, one instance after the other
+        zip_.reset(new HierarchicalZipWriter(protection.release(), commands_.IsZip64()));
+      }
     }
       
     size_t GetStepsCount() const
@@ -775,6 +792,11 @@ namespace Orthanc
     {
       return commands_.GetUncompressedSize();
     }
+
+    void Close()
+    {
+      zip_->Close();
+    }
   };
 
 
@@ -798,6 +820,26 @@ namespace Orthanc
   }
 
 
+  ArchiveJob::ArchiveJob(ZipWriter::IOutputStream* stream,
+                         ServerContext& context,
+                         bool isMedia,
+                         bool enableExtendedSopClass) :
+    outputStream_(stream),
+    context_(context),
+    archive_(new ArchiveIndex(ResourceType_Patient)),  // root
+    isMedia_(isMedia),
+    enableExtendedSopClass_(enableExtendedSopClass),
+    currentStep_(0),
+    instancesCount_(0),
+    uncompressedSize_(0)
+  {
+    if (stream == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+  }
+
+
   void ArchiveJob::AddResource(const std::string& publicId)
   {
     if (writer_.get() != NULL)   // Already started
@@ -824,8 +866,8 @@ namespace Orthanc
       throw OrthancException(ErrorCode_BadSequenceOfCalls);
     }
 
-    writer_.reset(new ZipWriterIterator(*target_, context_, *archive_,
-                                        isMedia_, enableExtendedSopClass_));
+    writer_.reset(new ZipWriterIterator(target_.get(), outputStream_.release(), context_,
+                                        *archive_, isMedia_, enableExtendedSopClass_));
 
     instancesCount_ = writer_->GetInstancesCount();
     uncompressedSize_ = writer_->GetUncompressedSize();
@@ -836,7 +878,8 @@ namespace Orthanc
   {
     assert(writer_.get() != NULL);
 
-    if (target_.unique())
+    if (target_.get() != NULL &&
+        target_.unique())
     {
       LOG(WARNING) << "A client has disconnected while creating an archive";
       return JobStepResult::Failure(ErrorCode_NetworkProtocol);          
@@ -844,7 +887,8 @@ namespace Orthanc
         
     if (writer_->GetStepsCount() == 0)
     {
-      writer_.reset();  // Flush all the results
+      writer_->Close();  // Flush all the results, reporting errors
+      writer_.reset();
       return JobStepResult::Success();
     }
     else
@@ -855,7 +899,8 @@ namespace Orthanc
 
       if (currentStep_ == writer_->GetStepsCount())
       {
-        writer_.reset();  // Flush all the results
+        writer_->Close();  // Flush all the results, reporting errors
+        writer_.reset();
         return JobStepResult::Success();
       }
       else
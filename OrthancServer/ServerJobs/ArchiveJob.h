@@ -33,6 +33,7 @@
 
 #pragma once
 
+#include "../../Core/Compression/ZipWriter.h"
 #include "../../Core/JobsEngine/IJob.h"
 #include "../../Core/TemporaryFile.h"
 #include "../ServerContext.h"
@@ -51,6 +52,7 @@ namespace Orthanc
     class ZipWriterIterator;
     
     boost::shared_ptr<TemporaryFile>      target_;
+    std::auto_ptr<ZipWriter::IOutputStream>  outputStream_;
     ServerContext&                        context_;
     boost::shared_ptr<ArchiveIndex>       archive_;
     bool                                  isMedia_;
@@ -68,6 +70,14 @@ namespace Orthanc
                bool isMedia,
                bool enableExtendedSopClass);
 
+    // Streaming mode: The archive is written to "stream" (whose
+    // ownership is taken) while the steps are executed, without
+    // any temporary file
+    ArchiveJob(ZipWriter::IOutputStream* stream,
+               ServerContext& context,
+               bool isMedia,
+               bool enableExtendedSopClass);
+
     void SetDescription(const std::string& description)
     {
       description_ = description;
@@ -36,24 +36,37 @@
 
 #include "../../Core/Logging.h"
 #include "../../Core/SerializationToolbox.h"
+#include "../OrthancInitialization.h"
 
 namespace Orthanc
 {
-  void DicomModalityStoreJob::OpenConnection()
+  DicomUserConnection& DicomModalityStoreJob::OpenConnection(size_t lane)
   {
-    if (connection_.get() == NULL)
+    boost::mutex::scoped_lock lock(connectionsMutex_);
+
+    if (lane >= connections_.size())
     {
-      connection_.reset(new DicomUserConnection);
-      connection_->SetLocalApplicationEntityTitle(localAet_);
-      connection_->SetRemoteModality(remote_);
+      connections_.resize(lane + 1);
     }
+
+    if (connections_[lane].get() == NULL)
+    {
+      connections_[lane].reset(new DicomUserConnection);
+      connections_[lane]->SetLocalApplicationEntityTitle(localAet_);
+      connections_[lane]->SetRemoteModality(remote_);
+      connections_[lane]->SetMaximumPendingStores
+        (std::max(1u, Configuration::GetGlobalUnsignedIntegerParameter("DicomScuPendingStores", 1)));
+    }
+
+    return *connections_[lane];
   }
 
 
-  bool DicomModalityStoreJob::HandleInstance(const std::string& instance)
+  bool DicomModalityStoreJob::HandleInstanceInLane(size_t lane,
+                                                   const std::string& instance)
   {
     assert(IsStarted());
-    OpenConnection();
+    DicomUserConnection& connection = OpenConnection(lane);
 
     LOG(INFO) << "Sending instance " << instance << " to modality \"" 
               << remote_.GetApplicationEntityTitle() << "\"";
@@ -70,20 +83,102 @@ namespace Orthanc
       return false;
     }
 
-    if (HasMoveOriginator())
+    try
     {
-      connection_->Store(dicom, moveOriginatorAet_, moveOriginatorId_);
+      if (HasMoveOriginator())
+      {
+        connection.Store(dicom, moveOriginatorAet_, moveOriginatorId_);
+      }
+      else
+      {
+        connection.Store(dicom);
+      }
     }
-    else
+    catch (OrthancException&)
     {
-      connection_->Store(dicom);
+      // The current instance has not been sent, but the instances
+      // that were pending on the association might have failed too
+      SignalFailedStores(connection);
+      throw;
     }
 
     //boost::this_thread::sleep(boost::posix_time::milliseconds(500));
 
+    SignalFailedStores(connection);
+
     return true;
   }
-    
+
+
+  void DicomModalityStoreJob::SignalFailedStores(DicomUserConnection& connection)
+  {
+    // With pipelining, the rejection of an instance is only known
+    // after other instances have been sent: Map the SOP instance UIDs
+    // back to the Orthanc identifiers of the instances
+    std::list<std::string> failed;
+    connection.DrainFailedStores(failed);
+
+    for (std::list<std::string>::const_iterator
+           it = failed.begin(); it != failed.end(); ++it)
+    {
+      std::list<std::string> instances;
+      context_.GetIndex().LookupIdentifierExact(instances, ResourceType_Instance,
+                                                DICOM_TAG_SOP_INSTANCE_UID, *it);
+
+      if (instances.empty())
+      {
+        LOG(ERROR) << "Unknown instance failed to be sent to modality \""
+                   << remote_.GetApplicationEntityTitle() << "\": " << *it;
+      }
+
+      for (std::list<std::string>::const_iterator
+             instance = instances.begin(); instance != instances.end(); ++instance)
+      {
+        SignalFailedInstance(*instance);
+      }
+    }
+  }
+
+
+  void DicomModalityStoreJob::CollectPendingStores()
+  {
+    // Collect the responses to the C-STORE requests that are still
+    // pending on each association (if pipelining is enabled)
+    Connections connections;
+
+    {
+      boost::mutex::scoped_lock lock(connectionsMutex_);
+      connections = connections_;
+    }
+
+    for (Connections::iterator it = connections.begin(); it != connections.end(); ++it)
+    {
+      if (it->get() != NULL)
+      {
+        try
+        {
+          (*it)->WaitPendingStores();
+        }
+        catch (OrthancException&)
+        {
+          // The association is broken, the pending requests are
+          // reported as failed by "DrainFailedStores()"
+        }
+
+        SignalFailedStores(**it);
+      }
+    }
+  }
+
+
+  bool DicomModalityStoreJob::HandleTrailingStep()
+  {
+    // The failures are reported per instance, and are taken into
+    // account by "SetOfInstancesJob" once this step is over
+    CollectPendingStores();
+    return true;
+  }
+
 
   DicomModalityStoreJob::DicomModalityStoreJob(ServerContext& context) :
     context_(context),
@@ -166,7 +261,13 @@ namespace Orthanc
 
   void DicomModalityStoreJob::ReleaseResources()   // For pausing jobs
   {
-    connection_.reset(NULL);
+    StopLanes();
+
+    // Don't lose the failures of the pipelined C-STORE requests
+    CollectPendingStores();
+
+    boost::mutex::scoped_lock lock(connectionsMutex_);
+    connections_.clear();
   }
 
 
@@ -38,22 +38,50 @@
 
 #include "../ServerContext.h"
 
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
 namespace Orthanc
 {
   class DicomModalityStoreJob : public SetOfInstancesJob
   {
   private:
+    typedef std::vector< boost::shared_ptr<DicomUserConnection> >  Connections;
+
     ServerContext&                      context_;
     std::string                         localAet_;
     RemoteModalityParameters            remote_;
     std::string                         moveOriginatorAet_;
     uint16_t                            moveOriginatorId_;
-    std::auto_ptr<DicomUserConnection>  connection_;
+    boost::mutex                        connectionsMutex_;
+    Connections                         connections_;  // One association per lane
+
+    DicomUserConnection& OpenConnection(size_t lane);
 
-    void OpenConnection();
+    void SignalFailedStores(DicomUserConnection& connection);
+
+    void CollectPendingStores();
 
   protected:
-    virtual bool HandleInstance(const std::string& instance);
+    virtual bool HandleInstance(const std::string& instance)
+    {
+      return HandleInstanceInLane(0, instance);
+    }
+
+    virtual bool IsParallelizable() const
+    {
+      return true;
+    }
+
+    virtual bool HandleInstanceInLane(size_t lane,
+                                      const std::string& instance);
+
+    virtual bool HasTrailingStep() const
+    {
+      return true;
+    }
+
+    virtual bool HandleTrailingStep();
     
   public:
     DicomModalityStoreJob(ServerContext& context);
@@ -61,6 +89,11 @@ namespace Orthanc
     DicomModalityStoreJob(ServerContext& context,
                           const Json::Value& serialized);
 
+    virtual ~DicomModalityStoreJob()
+    {
+      StopLanes();
+    }
+
     const std::string& GetLocalAet() const
     {
       return localAet_;
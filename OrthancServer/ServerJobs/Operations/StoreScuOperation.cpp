@@ -39,6 +39,7 @@
 #include "../../../Core/Logging.h"
 #include "../../../Core/OrthancException.h"
 #include "../../../Core/SerializationToolbox.h"
+#include "../../OrthancInitialization.h"
 
 namespace Orthanc
 {
@@ -70,6 +71,12 @@ namespace Orthanc
     {
       std::string dicom;
       instance.ReadDicom(dicom);
+
+      // The pending C-STORE requests are collected before any other
+      // DIMSE command, or when the connection manager closes the
+      // association after its timeout
+      resource->GetConnection().SetMaximumPendingStores
+        (std::max(1u, Configuration::GetGlobalUnsignedIntegerParameter("DicomScuPendingStores", 1)));
       resource->GetConnection().Store(dicom);
     }
     catch (OrthancException& e)
@@ -78,6 +85,17 @@ namespace Orthanc
                  << modality_.GetApplicationEntityTitle() << "\": " << e.What();
     }
 
+    // With pipelining, the rejection of a previous instance is only
+    // known now: Report it for the instance it concerns
+    std::list<std::string> failed;
+    resource->GetConnection().DrainFailedStores(failed);
+
+    for (std::list<std::string>::const_iterator it = failed.begin(); it != failed.end(); ++it)
+    {
+      LOG(ERROR) << "Lua: Unable to send instance with SOP instance UID " << *it
+                 << " to modality \"" << modality_.GetApplicationEntityTitle() << "\"";
+    }
+
     outputs.Append(input.Clone());
   }
 
@@ -46,6 +46,7 @@
 #include "Operations/SystemCallOperation.h"
 
 #include "DicomModalityStoreJob.h"
+#include "DicomSummaryMigrationJob.h"
 #include "OrthancPeerStoreJob.h"
 #include "ResourceModificationJob.h"
 
@@ -67,6 +68,10 @@ namespace Orthanc
     {
       return new ResourceModificationJob(context_, source);
     }
+    else if (type == "DicomSummaryMigration")
+    {
+      return new DicomSummaryMigrationJob(context_, source);
+    }
     else
     {
       return GenericJobUnserializer::UnserializeJob(source);
@@ -39,22 +39,38 @@
 
 namespace Orthanc
 {
-  bool OrthancPeerStoreJob::HandleInstance(const std::string& instance)
+  HttpClient& OrthancPeerStoreJob::GetClient(size_t lane)
   {
-    //boost::this_thread::sleep(boost::posix_time::milliseconds(500));
+    boost::mutex::scoped_lock lock(clientsMutex_);
+
+    if (lane >= clients_.size())
+    {
+      clients_.resize(lane + 1);
+    }
 
-    if (client_.get() == NULL)
+    if (clients_[lane].get() == NULL)
     {
-      client_.reset(new HttpClient(peer_, "instances"));
-      client_->SetMethod(HttpMethod_Post);
+      clients_[lane].reset(new HttpClient(peer_, "instances"));
+      clients_[lane]->SetMethod(HttpMethod_Post);
     }
+
+    return *clients_[lane];
+  }
+
+
+  bool OrthancPeerStoreJob::HandleInstanceInLane(size_t lane,
+                                                 const std::string& instance)
+  {
+    //boost::this_thread::sleep(boost::posix_time::milliseconds(500));
+
+    HttpClient& client = GetClient(lane);
       
     LOG(INFO) << "Sending instance " << instance << " to peer \"" 
               << peer_.GetUrl() << "\"";
 
     try
     {
-      context_.ReadDicom(client_->GetBody(), instance);
+      context_.ReadDicom(client.GetBody(), instance);
     }
     catch (OrthancException& e)
     {
@@ -63,7 +79,7 @@ namespace Orthanc
     }
 
     std::string answer;
-    if (client_->Apply(answer))
+    if (client.Apply(answer))
     {
       return true;
     }
@@ -89,7 +105,10 @@ namespace Orthanc
 
   void OrthancPeerStoreJob::ReleaseResources()   // For pausing jobs
   {
-    client_.reset(NULL);
+    StopLanes();
+
+    boost::mutex::scoped_lock lock(clientsMutex_);
+    clients_.clear();
   }
 
 
@@ -38,18 +38,37 @@
 
 #include "../ServerContext.h"
 
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
 
 namespace Orthanc
 {
   class OrthancPeerStoreJob : public SetOfInstancesJob
   {
   private:
+    typedef std::vector< boost::shared_ptr<HttpClient> >  Clients;
+
     ServerContext&             context_;
     WebServiceParameters       peer_;
-    std::auto_ptr<HttpClient>  client_;
+    boost::mutex               clientsMutex_;
+    Clients                    clients_;   // One HTTP client per lane
+
+    HttpClient& GetClient(size_t lane);
 
   protected:
-    virtual bool HandleInstance(const std::string& instance);
+    virtual bool HandleInstance(const std::string& instance)
+    {
+      return HandleInstanceInLane(0, instance);
+    }
+
+    virtual bool IsParallelizable() const
+    {
+      return true;
+    }
+
+    virtual bool HandleInstanceInLane(size_t lane,
+                                      const std::string& instance);
     
   public:
     OrthancPeerStoreJob(ServerContext& context) :
@@ -60,6 +79,11 @@ namespace Orthanc
     OrthancPeerStoreJob(ServerContext& context,
                         const Json::Value& serialize);
 
+    virtual ~OrthancPeerStoreJob()
+    {
+      StopLanes();
+    }
+
     void SetPeer(const WebServiceParameters& peer);
 
     const WebServiceParameters& GetPeer() const
@@ -35,6 +35,7 @@
 #include "ServerToolbox.h"
 
 #include "../Core/DicomFormat/DicomArray.h"
+#include "../Core/DicomFormat/DicomBinarySummary.h"
 #include "../Core/FileStorage/StorageAccessor.h"
 #include "../Core/Logging.h"
 #include "../Core/OrthancException.h"
@@ -73,6 +74,37 @@ namespace Orthanc
       DICOM_TAG_SOP_INSTANCE_UID
     };
 
+    // The additional tags that are stored in the "MainDicomTags"
+    // table, as specified by the "ExtraMainDicomTags" configuration
+    // option. These sets are only modified during the startup of
+    // Orthanc, hence no mutex.
+    static std::set<DicomTag> extraPatientTags_;
+    static std::set<DicomTag> extraStudyTags_;
+    static std::set<DicomTag> extraSeriesTags_;
+    static std::set<DicomTag> extraInstanceTags_;
+
+
+    static std::set<DicomTag>& GetExtraTagsInternal(ResourceType level)
+    {
+      switch (level)
+      {
+        case ResourceType_Patient:
+          return extraPatientTags_;
+
+        case ResourceType_Study:
+          return extraStudyTags_;
+
+        case ResourceType_Series:
+          return extraSeriesTags_;
+
+        case ResourceType_Instance:
+          return extraInstanceTags_;
+
+        default:
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+    }
+
 
     void SimplifyTags(Json::Value& target,
                       const Json::Value& source,
@@ -199,6 +231,7 @@ namespace Orthanc
         case ResourceType_Study:
           // Duplicate the patient tags at the study level (new in Orthanc 0.9.5 - db v6)
           dicomSummary.ExtractPatientInformation(tags);
+          ExtractExtraMainDicomTags(tags, dicomSummary, ResourceType_Patient);
           StoreMainDicomTagsInternal(database, resource, tags);
 
           dicomSummary.ExtractStudyInformation(tags);
@@ -216,10 +249,82 @@ namespace Orthanc
           throw OrthancException(ErrorCode_InternalError);
       }
 
+      ExtractExtraMainDicomTags(tags, dicomSummary, level);
       StoreMainDicomTagsInternal(database, resource, tags);
     }
 
 
+    void SetExtraMainDicomTags(ResourceType level,
+                               const std::set<DicomTag>& tags)
+    {
+      std::set<DicomTag>& target = GetExtraTagsInternal(level);
+      target.clear();
+
+      for (std::set<DicomTag>::const_iterator it = tags.begin(); it != tags.end(); ++it)
+      {
+        if (DicomMap::IsMainDicomTag(*it, level))
+        {
+          LOG(INFO) << "Tag " << it->Format() << " is already a main DICOM tag at the "
+                    << EnumerationToString(level) << " level";
+        }
+        else
+        {
+          target.insert(*it);
+        }
+      }
+    }
+
+
+    void GetExtraMainDicomTags(std::set<DicomTag>& target,
+                               ResourceType level)
+    {
+      target = GetExtraTagsInternal(level);
+    }
+
+
+    void ExtractExtraMainDicomTags(DicomMap& target,
+                                   const DicomMap& source,
+                                   ResourceType level)
+    {
+      const std::set<DicomTag>& tags = GetExtraTagsInternal(level);
+
+      for (std::set<DicomTag>::const_iterator it = tags.begin(); it != tags.end(); ++it)
+      {
+        target.CopyTagIfExists(source, *it);
+      }
+    }
+
+
+    std::string GetExtraMainDicomTagsSignature()
+    {
+      static const ResourceType levels[] = {
+        ResourceType_Patient,
+        ResourceType_Study,
+        ResourceType_Series,
+        ResourceType_Instance
+      };
+
+      std::string signature;
+
+      for (size_t i = 0; i < sizeof(levels) / sizeof(ResourceType); i++)
+      {
+        const std::set<DicomTag>& tags = GetExtraTagsInternal(levels[i]);
+
+        for (std::set<DicomTag>::const_iterator it = tags.begin(); it != tags.end(); ++it)
+        {
+          if (!signature.empty())
+          {
+            signature += ";";
+          }
+
+          signature += std::string(EnumerationToString(levels[i])) + ":" + it->Format();
+        }
+      }
+
+      return signature;
+    }
+
+
     bool FindOneChildInstance(int64_t& result,
                               IDatabaseWrapper& database,
                               int64_t resource,
@@ -433,8 +538,10 @@ namespace Orthanc
         Json::Value dicomAsJson;
         locker.GetDicom().DatasetToJson(dicomAsJson);
 
-        std::string s = dicomAsJson.toStyledString();
-        context.AddAttachment(*it, FileContentType_DicomAsJson, s.c_str(), s.size());
+        std::string s;
+        DicomBinarySummary::Encode(s, dicomAsJson);
+        context.AddAttachment(*it, FileContentType_DicomSummary, s.c_str(), s.size());
+        context.GetIndex().DeleteAttachment(*it, FileContentType_DicomAsJson);
 
         context.GetIndex().ReconstructInstance(locker.GetDicom());
       }
@@ -70,5 +70,21 @@ namespace Orthanc
 
     void ReconstructResource(ServerContext& context,
                              const std::string& resource);
+
+    // The "extra main DICOM tags" are additional tags that are
+    // indexed in the database, so that they can be used by C-FIND and
+    // "/tools/find" without reading the DICOM files from the storage
+    // area (new in Orthanc 1.4.2)
+    void SetExtraMainDicomTags(ResourceType level,
+                               const std::set<DicomTag>& tags);
+
+    void GetExtraMainDicomTags(std::set<DicomTag>& target,
+                               ResourceType level);
+
+    void ExtractExtraMainDicomTags(DicomMap& target,
+                                   const DicomMap& source,
+                                   ResourceType level);
+
+    std::string GetExtraMainDicomTagsSignature();
   }
 }
@@ -68,6 +68,7 @@ public:
   virtual void Handle(const std::string& dicomFile,
                       const DicomMap& dicomSummary,
                       const Json::Value& dicomJson,
+                      const Json::Value& simplifiedTags,
                       const std::string& remoteIp,
                       const std::string& remoteAet,
                       const std::string& calledAet) 
@@ -80,6 +81,7 @@ public:
       toStore.SetBuffer(dicomFile);
       toStore.SetSummary(dicomSummary);
       toStore.SetJson(dicomJson);
+      toStore.SetSimplifiedJson(simplifiedTags);
 
       std::string id;
       server_.Store(id, toStore);
@@ -811,6 +813,27 @@ static bool StartDicomServer(ServerContext& context,
   dicomServer.SetMoveRequestHandlerFactory(serverFactory);
   dicomServer.SetFindRequestHandlerFactory(serverFactory);
   dicomServer.SetAssociationTimeout(Configuration::GetGlobalUnsignedIntegerParameter("DicomScpTimeout", 30));
+  dicomServer.SetThreadsCount(Configuration::GetGlobalUnsignedIntegerParameter("DicomThreadsCount", 4));
+  dicomServer.SetMaximumAssociations(Configuration::GetGlobalUnsignedIntegerParameter("DicomMaximumAssociations", 0));
+  dicomServer.SetStreamingFindAnswers(Configuration::GetGlobalBoolParameter("DicomStreamingFind", true));
+
+  {
+    std::string overflow = Configuration::GetGlobalStringParameter("DicomAssociationsOverflow", "Wait");
+    if (overflow == "Wait")
+    {
+      dicomServer.SetRejectAssociationsOverflow(false);
+    }
+    else if (overflow == "Reject")
+    {
+      dicomServer.SetRejectAssociationsOverflow(true);
+    }
+    else
+    {
+      LOG(ERROR) << "Configuration option \"DicomAssociationsOverflow\" must be either "
+                 << "\"Wait\" or \"Reject\", found: " << overflow;
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
 
 
 #if ORTHANC_ENABLE_PLUGINS == 1
@@ -851,6 +874,8 @@ static bool StartDicomServer(ServerContext& context,
   bool restart = false;
   ErrorCode error = ErrorCode_Success;
 
+  context.SetDicomServer(&dicomServer);
+
   try
   {
     restart = StartHttpServer(context, restApi, plugins);
@@ -860,6 +885,7 @@ static bool StartDicomServer(ServerContext& context,
     error = e.GetErrorCode();
   }
 
+  context.SetDicomServer(NULL);
   dicomServer.Stop();
   LOG(WARNING) << "    DICOM server has stopped";
 
@@ -970,6 +996,8 @@ static bool ConfigureServerContext(IDatabaseWrapper& database,
   HttpClient::SetDefaultVerbose(Configuration::GetGlobalBoolParameter("HttpVerbose", false));
   HttpClient::SetDefaultTimeout(Configuration::GetGlobalUnsignedIntegerParameter("HttpTimeout", 0));
   HttpClient::SetDefaultProxy(Configuration::GetGlobalStringParameter("HttpProxy", ""));
+  HttpClient::SetConnectionPoolSize(Configuration::GetGlobalUnsignedIntegerParameter("HttpClientPoolSize", 4));
+  HttpClient::SetHttp2Enabled(Configuration::GetGlobalBoolParameter("HttpClientHttp2", false));
 
   DicomUserConnection::SetDefaultTimeout(Configuration::GetGlobalUnsignedIntegerParameter("DicomScuTimeout", 10));
 
@@ -996,6 +1024,33 @@ static bool ConfigureServerContext(IDatabaseWrapper& database,
     context.GetIndex().SetMaximumStorageSize(0);
   }
 
+  context.GetIndex().SetStoreBatch
+    (Configuration::GetGlobalUnsignedIntegerParameter("StoreBatchSize", 1),
+     Configuration::GetGlobalUnsignedIntegerParameter("StoreBatchLatency", 10));
+
+  {
+    unsigned int count = Configuration::GetGlobalUnsignedIntegerParameter("DatabaseReadConnections", 0);
+    unsigned int opened = 0;
+
+    while (opened < count)
+    {
+      IDatabaseWrapper* reader = database.OpenReadOnlyConnection();
+      if (reader == NULL)
+      {
+        LOG(WARNING) << "The database back-end does not support concurrent read-only connections";
+        break;
+      }
+
+      context.GetIndex().AddReadOnlyConnection(reader);
+      opened++;
+    }
+
+    if (opened > 0)
+    {
+      LOG(WARNING) << "Number of read-only connections to the database: " << opened;
+    }
+  }
+
   context.GetJobsEngine().GetRegistry().SetMaxCompletedJobs
     (Configuration::GetGlobalUnsignedIntegerParameter("JobsHistorySize", 10));
 
@@ -1038,6 +1093,53 @@ static bool ConfigureServerContext(IDatabaseWrapper& database,
 }
 
 
+static void ConfigureExtraMainDicomTags(IDatabaseWrapper& database,
+                                        IStorageArea& storageArea)
+{
+  static const ResourceType levels[] = {
+    ResourceType_Patient,
+    ResourceType_Study,
+    ResourceType_Series,
+    ResourceType_Instance
+  };
+
+  for (size_t i = 0; i < sizeof(levels) / sizeof(ResourceType); i++)
+  {
+    std::set<DicomTag> tags;
+    Configuration::GetExtraMainDicomTags(tags, levels[i]);
+    ServerToolbox::SetExtraMainDicomTags(levels[i], tags);
+  }
+
+  std::string signature = ServerToolbox::GetExtraMainDicomTagsSignature();
+
+  std::string previous;
+  if (!database.LookupGlobalProperty(previous, GlobalProperty_ExtraMainDicomTags))
+  {
+    previous.clear();
+  }
+
+  if (signature != previous)
+  {
+    // The main DICOM tags of the resources that are already stored
+    // must be updated, otherwise they would not match the lookups
+    LOG(WARNING) << "The set of extra main DICOM tags has changed, reconstructing the index";
+
+    std::auto_ptr<SQLite::ITransaction> transaction(database.StartTransaction());
+    transaction->Begin();
+
+    for (size_t i = 0; i < sizeof(levels) / sizeof(ResourceType); i++)
+    {
+      ServerToolbox::ReconstructMainDicomTags(database, storageArea, levels[i]);
+    }
+
+    database.SetGlobalProperty(GlobalProperty_ExtraMainDicomTags, signature);
+    transaction->Commit();
+
+    LOG(WARNING) << "The extra main DICOM tags have been successfully indexed";
+  }
+}
+
+
 static bool ConfigureDatabase(IDatabaseWrapper& database,
                               IStorageArea& storageArea,
                               OrthancPlugins *plugins,
@@ -1061,6 +1163,8 @@ static bool ConfigureDatabase(IDatabaseWrapper& database,
     throw OrthancException(ErrorCode_IncompatibleDatabaseVersion);
   }
 
+  ConfigureExtraMainDicomTags(database, storageArea);
+
   bool success = ConfigureServerContext
     (database, storageArea, plugins, loadJobsFromDatabase);
 
@@ -43,6 +43,7 @@
 #include "../../Core/Logging.h"
 #include "PluginsEnumerations.h"
 
+#include <algorithm>
 #include <cassert>
 
 namespace Orthanc
@@ -74,6 +75,7 @@ namespace Orthanc
     type_ = _OrthancPluginDatabaseAnswerType_None;
 
     answerDicomMap_ = NULL;
+    answerDicomMaps_ = NULL;
     answerChanges_ = NULL;
     answerExportedResources_ = NULL;
     answerDone_ = NULL;
@@ -173,6 +175,7 @@ namespace Orthanc
     payload_(payload),
     listener_(NULL),
     answerDicomMap_(NULL),
+    answerDicomMaps_(NULL),
     answerChanges_(NULL),
     answerExportedResources_(NULL),
     answerDone_(NULL)
@@ -345,6 +348,46 @@ namespace Orthanc
   }
 
 
+  void OrthancPluginDatabase::GetResourcesAfter(std::vector<int64_t>& internalIds,
+                                                std::vector<std::string>& publicIds,
+                                                ResourceType resourceType,
+                                                int64_t after,
+                                                size_t limit)
+  {
+    // Fallback implementation, as the database SDK has no primitive
+    // to seek into the list of resources
+    internalIds.clear();
+    publicIds.clear();
+
+    if (limit == 0)
+    {
+      return;
+    }
+
+    std::list<int64_t> tmp;
+    GetAllInternalIds(tmp, resourceType);
+
+    std::vector<int64_t> sorted;
+    sorted.reserve(tmp.size());
+
+    for (std::list<int64_t>::const_iterator it = tmp.begin(); it != tmp.end(); ++it)
+    {
+      if (*it > after)
+      {
+        sorted.push_back(*it);
+      }
+    }
+
+    std::sort(sorted.begin(), sorted.end());
+
+    for (size_t i = 0; i < sorted.size() && i < limit; i++)
+    {
+      internalIds.push_back(sorted[i]);
+      publicIds.push_back(GetPublicId(sorted[i]));
+    }
+  }
+
+
 
   void OrthancPluginDatabase::GetChanges(std::list<ServerIndexChange>& target /*out*/,
                                          bool& done /*out*/,
@@ -426,6 +469,147 @@ namespace Orthanc
   }
 
 
+  void OrthancPluginDatabase::GetMainDicomTags(std::vector<DicomMap*>& target,
+                                               const std::vector<int64_t>& ids)
+  {
+    if (target.size() != ids.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+      if (target[i] == NULL)
+      {
+        throw OrthancException(ErrorCode_NullPointer);
+      }
+    }
+
+    if (extensions_.getMainDicomTagsOfResources == NULL)
+    {
+      // Fallback implementation, one call per resource
+      for (size_t i = 0; i < ids.size(); i++)
+      {
+        GetMainDicomTags(*target[i], ids[i]);
+      }
+    }
+    else if (!ids.empty())
+    {
+      // The same resource might be requested several times
+      std::multimap<int64_t, DicomMap*> maps;
+      for (size_t i = 0; i < ids.size(); i++)
+      {
+        target[i]->Clear();
+        maps.insert(std::make_pair(ids[i], target[i]));
+      }
+
+      ResetAnswers();
+      answerDicomMaps_ = &maps;
+
+      CheckSuccess(extensions_.getMainDicomTagsOfResources
+                   (GetContext(), payload_, &ids[0], static_cast<uint32_t>(ids.size())));
+    }
+  }
+
+
+  void OrthancPluginDatabase::GetPublicIds(std::vector<std::string>& target,
+                                           const std::vector<int64_t>& ids)
+  {
+    target.resize(ids.size());
+
+    if (extensions_.getPublicIds == NULL)
+    {
+      // Fallback implementation, one call per resource
+      for (size_t i = 0; i < ids.size(); i++)
+      {
+        target[i] = GetPublicId(ids[i]);
+      }
+    }
+    else if (!ids.empty())
+    {
+      ResetAnswers();
+      CheckSuccess(extensions_.getPublicIds
+                   (GetContext(), payload_, &ids[0], static_cast<uint32_t>(ids.size())));
+
+      if (type_ != _OrthancPluginDatabaseAnswerType_String ||
+          answerStrings_.size() != ids.size())
+      {
+        throw OrthancException(ErrorCode_DatabasePlugin);
+      }
+
+      std::copy(answerStrings_.begin(), answerStrings_.end(), target.begin());
+    }
+  }
+
+
+  void OrthancPluginDatabase::GetResourceTypes(std::vector<ResourceType>& target,
+                                               const std::vector<int64_t>& ids)
+  {
+    target.resize(ids.size());
+
+    if (extensions_.getResourceTypes == NULL)
+    {
+      // Fallback implementation, one call per resource
+      for (size_t i = 0; i < ids.size(); i++)
+      {
+        target[i] = GetResourceType(ids[i]);
+      }
+    }
+    else if (!ids.empty())
+    {
+      ResetAnswers();
+      CheckSuccess(extensions_.getResourceTypes
+                   (GetContext(), payload_, &ids[0], static_cast<uint32_t>(ids.size())));
+
+      if (type_ != _OrthancPluginDatabaseAnswerType_Int32 ||
+          answerInt32_.size() != ids.size())
+      {
+        throw OrthancException(ErrorCode_DatabasePlugin);
+      }
+
+      size_t pos = 0;
+      for (std::list<int32_t>::const_iterator
+             it = answerInt32_.begin(); it != answerInt32_.end(); ++it, pos++)
+      {
+        target[pos] = Plugins::Convert(static_cast<OrthancPluginResourceType>(*it));
+      }
+    }
+  }
+
+
+  void OrthancPluginDatabase::LookupParents(std::vector<int64_t>& parents,
+                                            const std::vector<int64_t>& ids)
+  {
+    parents.resize(ids.size());
+
+    if (extensions_.lookupParents == NULL)
+    {
+      // Fallback implementation, one call per resource
+      for (size_t i = 0; i < ids.size(); i++)
+      {
+        if (!LookupParent(parents[i], ids[i]))
+        {
+          parents[i] = -1;
+        }
+      }
+    }
+    else if (!ids.empty())
+    {
+      ResetAnswers();
+      CheckSuccess(extensions_.lookupParents
+                   (GetContext(), payload_, &ids[0], static_cast<uint32_t>(ids.size())));
+
+      if (type_ != _OrthancPluginDatabaseAnswerType_Int64 ||
+          answerInt64_.size() != ids.size())
+      {
+        throw OrthancException(ErrorCode_DatabasePlugin);
+      }
+
+      std::copy(answerInt64_.begin(), answerInt64_.end(), parents.begin());
+    }
+  }
+
+
   std::string OrthancPluginDatabase::GetPublicId(int64_t resourceId)
   {
     ResetAnswers();
@@ -960,6 +1144,13 @@ namespace Orthanc
           answerDicomMap_->Clear();
           break;
 
+        case _OrthancPluginDatabaseAnswerType_ResourceDicomTag:
+          if (answerDicomMaps_ == NULL)
+          {
+            throw OrthancException(ErrorCode_DatabasePlugin);
+          }
+          break;
+
         case _OrthancPluginDatabaseAnswerType_Change:
           assert(answerChanges_ != NULL);
           answerChanges_->clear();
@@ -1019,6 +1210,27 @@ namespace Orthanc
         break;
       }
 
+      case _OrthancPluginDatabaseAnswerType_ResourceDicomTag:
+      {
+        const OrthancPluginDicomTag& tag = *reinterpret_cast<const OrthancPluginDicomTag*>(answer.valueGeneric);
+        assert(answerDicomMaps_ != NULL);
+
+        typedef std::multimap<int64_t, DicomMap*>::const_iterator  Iterator;
+        std::pair<Iterator, Iterator> range = answerDicomMaps_->equal_range(answer.valueInt64);
+
+        if (range.first == range.second)
+        {
+          LOG(ERROR) << "The database plugin has answered tags for a resource that was not requested";
+          throw OrthancException(ErrorCode_DatabasePlugin);
+        }
+
+        for (Iterator it = range.first; it != range.second; ++it)
+        {
+          it->second->SetValue(tag.group, tag.element, std::string(tag.value), false);
+        }
+        break;
+      }
+
       case _OrthancPluginDatabaseAnswerType_String:
       {
         if (answer.valueString == NULL)
@@ -64,6 +64,7 @@ namespace Orthanc
     std::list<FileInfo>            answerAttachments_;
 
     DicomMap*                      answerDicomMap_;
+    std::multimap<int64_t, DicomMap*>*  answerDicomMaps_;
     std::list<ServerIndexChange>*  answerChanges_;
     std::list<ExportedResource>*   answerExportedResources_;
     bool*                          answerDone_;
@@ -267,6 +268,50 @@ namespace Orthanc
     virtual void Upgrade(unsigned int targetVersion,
                          IStorageArea& storageArea);
 
+    virtual IDatabaseWrapper* OpenReadOnlyConnection()
+    {
+      // The database plugins are in charge of their own concurrency
+      return NULL;
+    }
+
+    virtual bool LookupResourceStatistics(uint64_t& compressedSize,
+                                          uint64_t& uncompressedSize,
+                                          unsigned int& countStudies,
+                                          unsigned int& countSeries,
+                                          unsigned int& countInstances,
+                                          int64_t id)
+    {
+      // Not available in the database SDK
+      return false;
+    }
+
+    virtual bool LookupStudyAggregates(std::set<std::string>& modalities,
+                                       std::set<std::string>& sopClassUids,
+                                       unsigned int& countSopClassUids,
+                                       int64_t study)
+    {
+      // Not available in the database SDK
+      return false;
+    }
+
+    virtual void GetResourcesAfter(std::vector<int64_t>& internalIds,
+                                   std::vector<std::string>& publicIds,
+                                   ResourceType resourceType,
+                                   int64_t after,
+                                   size_t limit);
+
+    virtual void GetMainDicomTags(std::vector<DicomMap*>& target,
+                                  const std::vector<int64_t>& ids);
+
+    virtual void GetPublicIds(std::vector<std::string>& target,
+                              const std::vector<int64_t>& ids);
+
+    virtual void GetResourceTypes(std::vector<ResourceType>& target,
+                                  const std::vector<int64_t>& ids);
+
+    virtual void LookupParents(std::vector<int64_t>& parents,
+                               const std::vector<int64_t>& ids);
+
     void AnswerReceived(const _OrthancPluginDatabaseAnswer& answer);
   };
 }
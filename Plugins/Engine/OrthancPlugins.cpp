@@ -206,6 +206,50 @@ namespace Orthanc
       }
 
 
+      virtual void ReadRange(std::string& content,
+                             const std::string& uuid,
+                             FileContentType type,
+                             uint64_t start,
+                             uint64_t end)
+      {
+        // The storage area plugins can only read whole attachments
+        std::string whole;
+        Read(whole, uuid, type);
+
+        if (start > end ||
+            end > whole.size())
+        {
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
+        }
+
+        content.assign(whole, static_cast<size_t>(start),
+                       static_cast<size_t>(end - start));
+      }
+
+
+      virtual bool HasReadRange() const
+      {
+        return false;
+      }
+
+
+      virtual void CreateFromFile(const std::string& uuid,
+                                  const std::string& path,
+                                  FileContentType type)
+      {
+        // The storage area plugins can only write whole attachments
+        std::string content;
+        SystemToolbox::ReadFile(content, path);
+        Create(uuid, content.empty() ? NULL : content.c_str(), content.size(), type);
+      }
+
+
+      virtual bool HasCreateFromFile() const
+      {
+        return false;
+      }
+
+
       virtual void Remove(const std::string& uuid,
                           FileContentType type) 
       {
@@ -949,6 +993,94 @@ namespace Orthanc
   }
 
 
+  namespace
+  {
+    // The callbacks of the plugins receive the full body of the
+    // request, which is accumulated in RAM before calling them
+    class BufferedRequestReader : public IHttpHandler::IChunkedRequestReader
+    {
+    private:
+      OrthancPlugins&           plugins_;
+      RequestOrigin             origin_;
+      std::string               remoteIp_;
+      std::string               username_;
+      HttpMethod                method_;
+      UriComponents             uri_;
+      IHttpHandler::Arguments   headers_;
+      ChunkedBuffer             body_;
+
+    public:
+      BufferedRequestReader(OrthancPlugins& plugins,
+                            RequestOrigin origin,
+                            const char* remoteIp,
+                            const char* username,
+                            HttpMethod method,
+                            const UriComponents& uri,
+                            const IHttpHandler::Arguments& headers) :
+        plugins_(plugins),
+        origin_(origin),
+        remoteIp_(remoteIp),
+        username_(username),
+        method_(method),
+        uri_(uri),
+        headers_(headers)
+      {
+      }
+
+      virtual void AddBodyChunk(const void* data,
+                                size_t size)
+      {
+        body_.AddChunk(data, size);
+      }
+
+      virtual void Execute(HttpOutput& output)
+      {
+        std::string body;
+        body_.Flatten(body);
+
+        IHttpHandler::GetArguments getArguments;  // Only available for GET requests
+        if (!plugins_.Handle(output, origin_, remoteIp_.c_str(), username_.c_str(), method_, uri_,
+                             headers_, getArguments, body.c_str(), body.size()))
+        {
+          throw OrthancException(ErrorCode_UnknownResource);
+        }
+      }
+    };
+  }
+
+
+  bool OrthancPlugins::CreateChunkedRequestReader(std::auto_ptr<IChunkedRequestReader>& target,
+                                                  RequestOrigin origin,
+                                                  const char* remoteIp,
+                                                  const char* username,
+                                                  HttpMethod method,
+                                                  const UriComponents& uri,
+                                                  const Arguments& headers)
+  {
+    /**
+     * The plugins never process the body by chunks. However, if some
+     * plugin has registered a REST callback for this URI, the
+     * subsequent handlers (notably the REST API of Orthanc) must not
+     * take over the request, as the callbacks of the plugins have
+     * precedence in "Handle()".
+     **/
+    std::string flatUri = Toolbox::FlattenUri(uri);
+
+    for (PImpl::RestCallbacks::const_iterator it = pimpl_->restCallbacks_.begin(); 
+         it != pimpl_->restCallbacks_.end(); ++it)
+    {
+      boost::cmatch what;
+      if (boost::regex_match(flatUri.c_str(), what, (*it)->GetRegularExpression()))
+      {
+        target.reset(new BufferedRequestReader(*this, origin, remoteIp, username, method, uri, headers));
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+
   void OrthancPlugins::SignalStoredInstance(const std::string& instanceId,
                                             DicomInstanceToStore& instance,
                                             const Json::Value& simplifiedTags)
@@ -1575,9 +1707,7 @@ namespace Orthanc
         }
         else
         {
-          Json::Value simplified;
-          ServerToolbox::SimplifyTags(simplified, instance.GetJson(), DicomToJsonFormat_Human);
-          s = writer.write(simplified);
+          s = writer.write(instance.GetSimplifiedJson());
         }
 
         *p.resultStringToFree = CopyString(s);
@@ -213,6 +213,14 @@ namespace Orthanc
                         const char* bodyData,
                         size_t bodySize);
 
+    virtual bool CreateChunkedRequestReader(std::auto_ptr<IChunkedRequestReader>& target,
+                                            RequestOrigin origin,
+                                            const char* remoteIp,
+                                            const char* username,
+                                            HttpMethod method,
+                                            const UriComponents& uri,
+                                            const Arguments& headers);
+
     virtual bool InvokeService(SharedLibrary& plugin,
                                _OrthancPluginService service,
                                const void* parameters);
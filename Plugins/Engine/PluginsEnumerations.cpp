@@ -225,6 +225,12 @@ namespace Orthanc
         case FileContentType_DicomAsJson:
           return OrthancPluginContentType_DicomAsJson;
 
+        case FileContentType_DicomSummary:
+          return OrthancPluginContentType_DicomSummary;
+
+        case FileContentType_RenderedFrame:
+          return OrthancPluginContentType_RenderedFrame;
+
         default:
           return OrthancPluginContentType_Unknown;
       }
@@ -241,6 +247,12 @@ namespace Orthanc
         case OrthancPluginContentType_DicomAsJson:
           return FileContentType_DicomAsJson;
 
+        case OrthancPluginContentType_DicomSummary:
+          return FileContentType_DicomSummary;
+
+        case OrthancPluginContentType_RenderedFrame:
+          return FileContentType_RenderedFrame;
+
         default:
           return FileContentType_Unknown;
       }
@@ -75,6 +75,7 @@ extern "C"
     _OrthancPluginDatabaseAnswerType_Int64 = 15,
     _OrthancPluginDatabaseAnswerType_Resource = 16,
     _OrthancPluginDatabaseAnswerType_String = 17,
+    _OrthancPluginDatabaseAnswerType_ResourceDicomTag = 18,  /* New in Orthanc 1.4.2 */
 
     _OrthancPluginDatabaseAnswerType_INTERNAL = 0x7fffffff
   } _OrthancPluginDatabaseAnswerType;
@@ -244,6 +245,31 @@ extern "C"
     context->InvokeService(context, _OrthancPluginService_DatabaseAnswer, &params);
   }
 
+  /**
+   * Answers one main DICOM tag of one of the resources that were
+   * given to the "getMainDicomTagsOfResources()" extension.
+   *
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param database The database context, as received by the extension.
+   * @param id The internal ID of the resource to which the tag belongs.
+   * @param tag The main DICOM tag.
+   * @ingroup Callbacks
+   **/
+  ORTHANC_PLUGIN_INLINE void OrthancPluginDatabaseAnswerResourceDicomTag(
+    OrthancPluginContext*          context,
+    OrthancPluginDatabaseContext*  database,
+    int64_t                        id,
+    const OrthancPluginDicomTag*   tag)
+  {
+    _OrthancPluginDatabaseAnswer params;
+    memset(&params, 0, sizeof(params));
+    params.database = database;
+    params.type = _OrthancPluginDatabaseAnswerType_ResourceDicomTag;
+    params.valueInt64 = id;
+    params.valueGeneric = tag;
+    context->InvokeService(context, _OrthancPluginService_DatabaseAnswer, &params);
+  }
+
   ORTHANC_PLUGIN_INLINE void OrthancPluginDatabaseAnswerAttachment(
     OrthancPluginContext*          context,
     OrthancPluginDatabaseContext*  database,
@@ -694,6 +720,54 @@ extern "C"
       uint16_t element,
       const char* start,
       const char* end);
+
+    /**
+     * The following set-oriented primitives are new in Orthanc
+     * 1.4.2. They read the information about "idsCount" resources
+     * with one single query, which avoids one round trip to the
+     * database engine per resource.
+     **/
+
+    /* Output: Use OrthancPluginDatabaseAnswerResourceDicomTag() */
+    OrthancPluginErrorCode  (*getMainDicomTagsOfResources) (
+      /* outputs */
+      OrthancPluginDatabaseContext* context,
+      /* inputs */
+      void* payload,
+      const int64_t* ids,
+      uint32_t idsCount);
+
+    /* Output: Use OrthancPluginDatabaseAnswerString(), with exactly
+       one answer per resource, in the order of "ids" */
+    OrthancPluginErrorCode  (*getPublicIds) (
+      /* outputs */
+      OrthancPluginDatabaseContext* context,
+      /* inputs */
+      void* payload,
+      const int64_t* ids,
+      uint32_t idsCount);
+
+    /* Output: Use OrthancPluginDatabaseAnswerInt32() with the
+       "OrthancPluginResourceType", with exactly one answer per
+       resource, in the order of "ids" */
+    OrthancPluginErrorCode  (*getResourceTypes) (
+      /* outputs */
+      OrthancPluginDatabaseContext* context,
+      /* inputs */
+      void* payload,
+      const int64_t* ids,
+      uint32_t idsCount);
+
+    /* Output: Use OrthancPluginDatabaseAnswerInt64() with the
+       internal ID of the parent (or -1 if none), with exactly one
+       answer per resource, in the order of "ids" */
+    OrthancPluginErrorCode  (*lookupParents) (
+      /* outputs */
+      OrthancPluginDatabaseContext* context,
+      /* inputs */
+      void* payload,
+      const int64_t* ids,
+      uint32_t idsCount);
    } OrthancPluginDatabaseExtensions;
 
 /*<! @endcond */
@@ -635,6 +635,8 @@ extern "C"
     OrthancPluginContentType_Unknown = 0,      /*!< Unknown content type */
     OrthancPluginContentType_Dicom = 1,        /*!< DICOM */
     OrthancPluginContentType_DicomAsJson = 2,  /*!< JSON summary of a DICOM file */
+    OrthancPluginContentType_DicomSummary = 3, /*!< Binary summary of a DICOM file (new in Orthanc 1.4.2) */
+    OrthancPluginContentType_RenderedFrame = 4, /*!< Cached rendering of a frame (new in Orthanc 1.4.2) */
 
     _OrthancPluginContentType_INTERNAL = 0x7fffffff
   } OrthancPluginContentType;
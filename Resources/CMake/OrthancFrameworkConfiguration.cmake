@@ -145,11 +145,18 @@ if (ENABLE_MODULE_IMAGES)
     ${ORTHANC_ROOT}/Core/Images/PamReader.cpp
     ${ORTHANC_ROOT}/Core/Images/PamWriter.cpp
     )
+
+  if (ENABLE_SIMD AND NOT ORTHANC_SANDBOXED)
+    add_definitions(-DORTHANC_ENABLE_SIMD=1)
+  else()
+    add_definitions(-DORTHANC_ENABLE_SIMD=0)
+  endif()
 endif()
 
 if (ENABLE_MODULE_DICOM)
   list(APPEND ORTHANC_CORE_SOURCES_INTERNAL
     ${ORTHANC_ROOT}/Core/DicomFormat/DicomArray.cpp
+    ${ORTHANC_ROOT}/Core/DicomFormat/DicomBinarySummary.cpp
     ${ORTHANC_ROOT}/Core/DicomFormat/DicomImageInformation.cpp
     ${ORTHANC_ROOT}/Core/DicomFormat/DicomInstanceHasher.cpp
     ${ORTHANC_ROOT}/Core/DicomFormat/DicomIntegerPixelAccessor.cpp
@@ -320,6 +327,7 @@ if (ENABLE_ZLIB)
   if (NOT ORTHANC_SANDBOXED)
     list(APPEND ORTHANC_CORE_SOURCES_INTERNAL
       ${ORTHANC_ROOT}/Core/Compression/HierarchicalZipWriter.cpp
+      ${ORTHANC_ROOT}/Core/Compression/ZipReader.cpp
       ${ORTHANC_ROOT}/Core/Compression/ZipWriter.cpp
       ${ORTHANC_ROOT}/Core/FileStorage/StorageAccessor.cpp
       )
@@ -528,8 +536,11 @@ else()
     )
 
   list(APPEND ORTHANC_CORE_SOURCES_INTERNAL
+    ${ORTHANC_ROOT}/Core/Cache/MemoryStringCache.cpp
     ${ORTHANC_ROOT}/Core/Cache/SharedArchive.cpp
+    ${ORTHANC_ROOT}/Core/Cache/ShardedMemoryCache.cpp
     ${ORTHANC_ROOT}/Core/FileStorage/FilesystemStorage.cpp
+    ${ORTHANC_ROOT}/Core/MetricsRegistry.cpp
     ${ORTHANC_ROOT}/Core/MultiThreading/RunnableWorkersPool.cpp
     ${ORTHANC_ROOT}/Core/MultiThreading/Semaphore.cpp
     ${ORTHANC_ROOT}/Core/MultiThreading/SharedMessageQueue.cpp
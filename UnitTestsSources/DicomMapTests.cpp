@@ -35,6 +35,7 @@
 #include "gtest/gtest.h"
 
 #include "../Core/OrthancException.h"
+#include "../Core/DicomFormat/DicomBinarySummary.h"
 #include "../Core/DicomFormat/DicomMap.h"
 #include "../Core/DicomParsing/FromDcmtkBridge.h"
 
@@ -368,3 +369,117 @@ TEST(DicomMap, Parse)
   ASSERT_DOUBLE_EQ(-2147483649.0, d); 
   ASSERT_EQ(-2147483649ll, j);
 }
+
+
+static void AddSummaryLeaf(Json::Value& target,
+                           const std::string& tag,
+                           const std::string& name,
+                           const std::string& type,
+                           const Json::Value& value)
+{
+  target[tag] = Json::objectValue;
+  target[tag]["Name"] = name;
+  target[tag]["Type"] = type;
+  target[tag]["Value"] = value;
+}
+
+
+TEST(DicomBinarySummary, Basic)
+{
+  Json::Value item1 = Json::objectValue;
+  AddSummaryLeaf(item1, "0008,1150", "ReferencedSOPClassUID", "String", "1.2.3");
+  AddSummaryLeaf(item1, "0008,1155", "ReferencedSOPInstanceUID", "String", "4.5.6");
+
+  Json::Value item2 = Json::objectValue;   // Empty item
+
+  Json::Value json = Json::objectValue;
+  AddSummaryLeaf(json, "0010,0010", "PatientName", "String", "Hello^World");
+  AddSummaryLeaf(json, "0008,0020", "StudyDate", "String", "");
+  AddSummaryLeaf(json, "0010,0030", "PatientBirthDate", "Null", Json::nullValue);
+  AddSummaryLeaf(json, "0008,1030", "StudyDescription", "TooLong", Json::nullValue);
+  AddSummaryLeaf(json, "0009,1001", "Unknown Tag & Data", "Binary", "data:application/octet-stream;base64,AA==");
+  json["0009,1001"]["PrivateCreator"] = "Creator";
+  json["0008,1110"] = Json::objectValue;
+  json["0008,1110"]["Name"] = "ReferencedStudySequence";
+  json["0008,1110"]["Type"] = "Sequence";
+  json["0008,1110"]["Value"] = Json::arrayValue;
+  json["0008,1110"]["Value"].append(item1);
+  json["0008,1110"]["Value"].append(item2);
+
+  std::string encoded;
+  DicomBinarySummary::Encode(encoded, json);
+  ASSERT_TRUE(DicomBinarySummary::IsBinarySummary(encoded.c_str(), encoded.size()));
+  ASSERT_FALSE(DicomBinarySummary::IsBinarySummary("{}", 2));
+
+  DicomBinarySummary summary(encoded);
+  ASSERT_EQ(6u, summary.GetTagsCount());
+  ASSERT_EQ(DicomTag(0x0008, 0x0020), summary.GetTag(0));
+  ASSERT_EQ(DicomTag(0x0008, 0x1030), summary.GetTag(1));
+  ASSERT_EQ(DicomTag(0x0008, 0x1110), summary.GetTag(2));
+  ASSERT_EQ(DicomTag(0x0009, 0x1001), summary.GetTag(3));
+  ASSERT_EQ(DicomTag(0x0010, 0x0010), summary.GetTag(4));
+  ASSERT_EQ(DicomTag(0x0010, 0x0030), summary.GetTag(5));
+  ASSERT_THROW(summary.GetTag(6), OrthancException);
+
+  std::string s;
+  ASSERT_TRUE(summary.LookupStringValue(s, DICOM_TAG_PATIENT_NAME));
+  ASSERT_EQ("Hello^World", s);
+  ASSERT_TRUE(summary.LookupStringValue(s, DicomTag(0x0008, 0x0020)));
+  ASSERT_TRUE(s.empty());
+  ASSERT_FALSE(summary.LookupStringValue(s, DicomTag(0x0010, 0x0030)));
+  ASSERT_FALSE(summary.LookupStringValue(s, DicomTag(0x0008, 0x1030)));
+  ASSERT_FALSE(summary.LookupStringValue(s, DICOM_TAG_PATIENT_ID));
+
+  DicomBinarySummary::TagType type;
+  ASSERT_TRUE(summary.LookupTagType(type, DicomTag(0x0008, 0x1110)));
+  ASSERT_EQ(DicomBinarySummary::TagType_Sequence, type);
+  ASSERT_TRUE(summary.LookupTagType(type, DicomTag(0x0008, 0x1030)));
+  ASSERT_EQ(DicomBinarySummary::TagType_TooLong, type);
+  ASSERT_FALSE(summary.LookupTagType(type, DICOM_TAG_PATIENT_ID));
+
+  Json::Value decoded;
+  summary.ToJson(decoded);
+  ASSERT_EQ(0, json.compare(decoded));
+
+  // Empty dataset
+  DicomBinarySummary::Encode(encoded, Json::objectValue);
+
+  {
+    DicomBinarySummary empty(encoded);
+    ASSERT_EQ(0u, empty.GetTagsCount());
+    ASSERT_FALSE(empty.LookupStringValue(s, DICOM_TAG_PATIENT_NAME));
+    empty.ToJson(decoded);
+    ASSERT_EQ(Json::objectValue, decoded.type());
+    ASSERT_EQ(0u, decoded.size());
+  }
+
+  ASSERT_THROW(DicomBinarySummary::Encode(encoded, Json::arrayValue), OrthancException);
+  ASSERT_THROW(DicomBinarySummary::Encode(encoded, Json::Value("nope")), OrthancException);
+}
+
+
+TEST(DicomBinarySummary, Corrupted)
+{
+  Json::Value json = Json::objectValue;
+  AddSummaryLeaf(json, "0010,0010", "PatientName", "String", "Hello");
+
+  std::string encoded;
+  DicomBinarySummary::Encode(encoded, json);
+
+  std::string s = encoded.substr(0, encoded.size() - 1);
+  ASSERT_THROW(DicomBinarySummary summary(s), OrthancException);
+
+  s.clear();
+  ASSERT_THROW(DicomBinarySummary summary(s), OrthancException);
+
+  s = "{}";
+  ASSERT_THROW(DicomBinarySummary summary(s), OrthancException);
+
+  s = encoded;
+  s[4] = 2;  // Unsupported version
+  ASSERT_THROW(DicomBinarySummary summary(s), OrthancException);
+
+  s = encoded;
+  s[8] = 0x7f;  // Bad offset of the top-level dataset
+  ASSERT_THROW(DicomBinarySummary summary(s), OrthancException);
+}
@@ -42,6 +42,7 @@
 #include "../Core/HttpServer/FilesystemHttpSender.h"
 #include "../Core/Logging.h"
 #include "../Core/OrthancException.h"
+#include "../Core/SystemToolbox.h"
 #include "../Core/Toolbox.h"
 #include "../OrthancServer/ServerIndex.h"
 
@@ -86,6 +87,27 @@ TEST(FilesystemStorage, Basic2)
   ASSERT_EQ(s.GetSize(uid), data.size());
 }
 
+TEST(FilesystemStorage, ReadRange)
+{
+  FilesystemStorage s("UnitTestsStorage");
+  ASSERT_TRUE(s.HasReadRange());
+
+  std::string data = "Hello world";
+  std::string uid = Toolbox::GenerateUuid();
+  s.Create(uid.c_str(), &data[0], data.size(), FileContentType_Unknown);
+
+  std::string d;
+  s.ReadRange(d, uid, FileContentType_Unknown, 0, 5);
+  ASSERT_EQ("Hello", d);
+  s.ReadRange(d, uid, FileContentType_Unknown, 6, 11);
+  ASSERT_EQ("world", d);
+  s.ReadRange(d, uid, FileContentType_Unknown, 3, 3);
+  ASSERT_TRUE(d.empty());
+
+  ASSERT_THROW(s.ReadRange(d, uid, FileContentType_Unknown, 6, 12), OrthancException);
+  ASSERT_THROW(s.ReadRange(d, uid, FileContentType_Unknown, 6, 5), OrthancException);
+}
+
 TEST(FilesystemStorage, EndToEnd)
 {
   FilesystemStorage s("UnitTestsStorage");
@@ -143,6 +165,42 @@ TEST(StorageAccessor, NoCompression)
 }
 
 
+TEST(StorageAccessor, WriteFromFile)
+{
+  FilesystemStorage s("UnitTestsStorage");
+  ASSERT_TRUE(s.HasCreateFromFile());
+
+  StorageAccessor accessor(s);
+
+  const std::string path = "UnitTestsResults/StorageAccessorFromFile";
+  SystemToolbox::WriteFile("Hello world", path);
+
+  FileInfo info = accessor.WriteFromFile(path, FileContentType_Dicom, CompressionType_None, true);
+
+  std::string r;
+  accessor.Read(r, info);
+
+  ASSERT_EQ("Hello world", r);
+  ASSERT_EQ(CompressionType_None, info.GetCompressionType());
+  ASSERT_EQ(11u, info.GetUncompressedSize());
+  ASSERT_EQ(11u, info.GetCompressedSize());
+  ASSERT_EQ("3e25960a79dbc69b674cd4ec67a72c62", info.GetUncompressedMD5());
+  ASSERT_EQ(info.GetUncompressedMD5(), info.GetCompressedMD5());
+
+  // The source file is copied, not moved
+  ASSERT_TRUE(SystemToolbox::IsRegularFile(path));
+
+  // Fallback to the in-memory path if compression is requested
+  info = accessor.WriteFromFile(path, FileContentType_Dicom, CompressionType_ZlibWithSize, false);
+  accessor.Read(r, info);
+  ASSERT_EQ("Hello world", r);
+  ASSERT_EQ(CompressionType_ZlibWithSize, info.GetCompressionType());
+
+  ASSERT_THROW(accessor.WriteFromFile("UnitTestsResults/Nope", FileContentType_Dicom,
+                                      CompressionType_None, false), OrthancException);
+}
+
+
 TEST(StorageAccessor, Compression)
 {
   FilesystemStorage s("UnitTestsStorage");
@@ -47,6 +47,7 @@
 #include "../Core/Endianness.h"
 #include "../Resources/EncodingTests.h"
 #include "../Core/DicomNetworking/DicomFindAnswers.h"
+#include "../Core/DicomNetworking/DicomServer.h"
 #include "../Core/DicomParsing/Internals/DicomImageDecoder.h"
 #include "../Plugins/Engine/PluginsEnumerations.h"
 
@@ -580,6 +581,57 @@ TEST(ParsedDicomFile, InsertReplaceJson)
 }
 
 
+TEST(FromDcmtkBridge, SummaryAndJsonSinglePass)
+{
+  ParsedDicomFile f(true);
+
+  Json::Value a;
+  CreateSampleJson(a);
+  f.Insert(REFERENCED_STUDY_SEQUENCE, a, true);
+  f.ReplacePlainString(DICOM_TAG_PATIENT_NAME, std::string(ORTHANC_MAXIMUM_TAG_LENGTH + 1, 'a'));
+  f.ReplacePlainString(DICOM_TAG_STUDY_DESCRIPTION, "Hello");
+
+  DcmDataset& dataset = *f.GetDcmtkObject().getDataset();
+  std::set<DicomTag> ignoreTagLength;
+
+  DicomMap summary1, summary2;
+  Json::Value json1, json2, simplified1, simplified2;
+
+  FromDcmtkBridge::ExtractDicomSummary(summary1, dataset);
+  FromDcmtkBridge::ExtractDicomAsJson(json1, dataset, ignoreTagLength);
+  ServerToolbox::SimplifyTags(simplified1, json1, DicomToJsonFormat_Human);
+
+  FromDcmtkBridge::ExtractDicomSummaryAndJson(summary2, json2, simplified2, dataset, ignoreTagLength);
+
+  ASSERT_EQ(0, json1.compare(json2));
+  ASSERT_EQ(0, simplified1.compare(simplified2));
+  ASSERT_EQ("TooLong", json2["0010,0010"]["Type"].asString());
+  ASSERT_EQ(Json::nullValue, simplified2["PatientName"].type());
+  ASSERT_EQ("Hello", simplified2["StudyDescription"].asString());
+  ASSERT_EQ(Json::arrayValue, simplified2["ReferencedStudySequence"].type());
+
+  std::set<DicomTag> tags1, tags2;
+  summary1.GetTags(tags1);
+  summary2.GetTags(tags2);
+  ASSERT_TRUE(tags1 == tags2);
+
+  for (std::set<DicomTag>::const_iterator it = tags1.begin(); it != tags1.end(); ++it)
+  {
+    const DicomValue& v1 = summary1.GetValue(*it);
+    const DicomValue& v2 = summary2.GetValue(*it);
+    ASSERT_EQ(v1.IsNull(), v2.IsNull());
+    ASSERT_EQ(v1.IsBinary(), v2.IsBinary());
+    if (!v1.IsNull())
+    {
+      ASSERT_EQ(v1.GetContent(), v2.GetContent());
+    }
+  }
+
+  ASSERT_TRUE(summary2.GetValue(DICOM_TAG_PATIENT_NAME).IsNull());
+  ASSERT_FALSE(summary2.HasTag(REFERENCED_STUDY_SEQUENCE));
+}
+
+
 TEST(ParsedDicomFile, JsonEncoding)
 {
   ParsedDicomFile f(true);
@@ -748,6 +800,111 @@ TEST(DicomFindAnswers, Basic)
 }
 
 
+namespace
+{
+  class StreamedAnswers : public DicomFindAnswers::IStream
+  {
+  private:
+    std::vector<std::string>  patients_;
+    size_t                    maxAnswers_;
+    bool                      cancelled_;
+
+  public:
+    StreamedAnswers(size_t maxAnswers) :
+      maxAnswers_(maxAnswers),
+      cancelled_(false)
+    {
+    }
+
+    void Cancel()
+    {
+      cancelled_ = true;
+    }
+
+    virtual bool IsCancelled() const
+    {
+      return cancelled_;
+    }
+
+    virtual bool Push(ParsedDicomFile* answer)
+    {
+      std::auto_ptr<ParsedDicomFile> protection(answer);
+
+      if (cancelled_ ||
+          patients_.size() >= maxAnswers_)
+      {
+        return false;  // Simulates a C-CANCEL
+      }
+      else
+      {
+        std::string s;
+        protection->GetTagValue(s, DICOM_TAG_PATIENT_ID);
+        patients_.push_back(s);
+        return true;
+      }
+    }
+
+    const std::vector<std::string>& GetPatients() const
+    {
+      return patients_;
+    }
+  };
+}
+
+
+TEST(DicomFindAnswers, Streaming)
+{
+  StreamedAnswers stream(2);
+
+  DicomFindAnswers a(false);
+  ASSERT_FALSE(a.IsStreaming());
+  a.SetStream(stream);
+  ASSERT_TRUE(a.IsStreaming());
+  ASSERT_FALSE(a.IsCancelled());
+
+  const char* patients[] = { "a", "b", "c", "d" };
+
+  for (size_t i = 0; i < 4; i++)
+  {
+    DicomMap m;
+    m.SetValue(DICOM_TAG_PATIENT_ID, patients[i], false);
+    a.Add(m);
+
+    ASSERT_EQ(i >= 2, a.IsCancelled());
+  }
+
+  ASSERT_EQ(2u, a.GetSize());
+  ASSERT_EQ(2u, stream.GetPatients().size());
+  ASSERT_EQ("a", stream.GetPatients() [0]);
+  ASSERT_EQ("b", stream.GetPatients() [1]);
+
+  {
+    DicomFindAnswers b(false);
+    DicomMap m;
+    m.SetValue(DICOM_TAG_PATIENT_ID, "hello", false);
+    b.Add(m);
+    ASSERT_THROW(b.SetStream(stream), OrthancException);
+  }
+
+  {
+    // The cancellation is visible before the next answer is pushed
+    StreamedAnswers stream2(10);
+    DicomFindAnswers c(false);
+    c.SetStream(stream2);
+    ASSERT_FALSE(c.IsCancelled());
+
+    stream2.Cancel();
+    ASSERT_TRUE(c.IsCancelled());
+
+    DicomMap m;
+    m.SetValue(DICOM_TAG_PATIENT_ID, "hello", false);
+    c.Add(m);
+    ASSERT_EQ(0u, c.GetSize());
+    ASSERT_EQ(0u, stream2.GetPatients().size());
+  }
+}
+
+
 TEST(ParsedDicomFile, FromJson)
 {
   FromDcmtkBridge::RegisterDictionaryTag(DicomTag(0x7057, 0x1000), ValueRepresentation_OtherByte, "MyPrivateTag2", 1, 1, "ORTHANC");
@@ -1303,3 +1460,35 @@ TEST(ParsedDicomFile, InvalidCharacterSets)
     ASSERT_EQ(Encoding_Latin3, d.GetEncoding());
   }
 }
+
+
+TEST(DicomServer, Associations)
+{
+  DicomServer server;
+  ASSERT_EQ(4u, server.GetThreadsCount());
+  ASSERT_EQ(0u, server.GetMaximumAssociations());
+  ASSERT_FALSE(server.IsRejectAssociationsOverflow());
+  ASSERT_THROW(server.SetThreadsCount(0), OrthancException);
+
+  server.SetMaximumAssociations(2);
+  ASSERT_TRUE(server.ReserveAssociation());
+  ASSERT_TRUE(server.ReserveAssociation());
+  ASSERT_FALSE(server.ReserveAssociation());
+  server.SignalRejectedAssociation();
+
+  server.SignalStoredInstance("MODALITY", 100);
+  server.SignalStoredInstance("MODALITY", 50);
+  server.ReleaseAssociation("MODALITY", 10);
+  ASSERT_TRUE(server.ReserveAssociation());
+
+  Json::Value s;
+  server.GetStatistics(s);
+  ASSERT_EQ(2u, s["ActiveAssociations"].asUInt());
+  ASSERT_EQ(2u, s["PeakAssociations"].asUInt());
+  ASSERT_EQ("3", s["TotalAssociations"].asString());
+  ASSERT_EQ("1", s["RejectedAssociations"].asString());
+  ASSERT_EQ("1", s["Modalities"]["MODALITY"]["Associations"].asString());
+  ASSERT_EQ("2", s["Modalities"]["MODALITY"]["Instances"].asString());
+  ASSERT_EQ("150", s["Modalities"]["MODALITY"]["ReceivedSize"].asString());
+  ASSERT_EQ("10", s["Modalities"]["MODALITY"]["DurationMs"].asString());
+}
@@ -198,3 +198,244 @@ TYPED_TEST(TestIntegerImageTraits, SetZeroFloat)
     }
   }
 }
+
+
+namespace
+{
+  // Deterministic pseudo-random content (linear congruential generator)
+  static void FillPseudoRandom(ImageAccessor& image,
+                               uint32_t seed)
+  {
+    for (unsigned int y = 0; y < image.GetHeight(); y++)
+    {
+      uint8_t* p = reinterpret_cast<uint8_t*>(image.GetRow(y));
+
+      for (unsigned int x = 0; x < image.GetWidth() * image.GetBytesPerPixel(); x++, p++)
+      {
+        seed = seed * 1664525u + 1013904223u;
+        *p = static_cast<uint8_t>(seed >> 24);
+      }
+    }
+  }
+
+  static bool IsSameImage(const ImageAccessor& a,
+                          const ImageAccessor& b)
+  {
+    if (a.GetFormat() != b.GetFormat() ||
+        a.GetWidth() != b.GetWidth() ||
+        a.GetHeight() != b.GetHeight())
+    {
+      return false;
+    }
+
+    for (unsigned int y = 0; y < a.GetHeight(); y++)
+    {
+      if (memcmp(a.GetConstRow(y), b.GetConstRow(y), a.GetWidth() * a.GetBytesPerPixel()) != 0)
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  // The width is not a multiple of the SIMD registers, so that the
+  // scalar loops also process the end of the rows
+  static const unsigned int SIMD_WIDTH = 77;
+  static const unsigned int SIMD_HEIGHT = 5;
+
+  static const PixelFormat SIMD_FORMATS[] = {
+    PixelFormat_Grayscale8,
+    PixelFormat_Grayscale16,
+    PixelFormat_SignedGrayscale16
+  };
+}
+
+
+TEST(ImageProcessing, SimdMinMax)
+{
+  for (size_t i = 0; i < sizeof(SIMD_FORMATS) / sizeof(PixelFormat); i++)
+  {
+    Image image(SIMD_FORMATS[i], SIMD_WIDTH, SIMD_HEIGHT, false);
+
+    for (uint32_t seed = 0; seed < 10; seed++)
+    {
+      FillPseudoRandom(image, seed);
+
+      int64_t a, b, c, d;
+      ImageProcessing::SetSimdEnabled(false);
+      ImageProcessing::GetMinMaxIntegerValue(a, b, image);
+      ImageProcessing::SetSimdEnabled(true);
+      ImageProcessing::GetMinMaxIntegerValue(c, d, image);
+
+      ASSERT_EQ(a, c);
+      ASSERT_EQ(b, d);
+      ASSERT_LE(a, b);
+    }
+  }
+}
+
+
+TEST(ImageProcessing, SimdShiftScale)
+{
+  // The offset 0.5 and the scaling 0.5 produce halfway cases for the rounding
+  static const float OFFSETS[] = { 0.0f, 0.5f, -100.0f, 1000.0f, -32768.0f };
+  static const float SCALINGS[] = { 1.0f, 0.5f, -0.5f, 0.37f, 3.3f, 100.0f };
+
+  for (size_t i = 0; i < sizeof(SIMD_FORMATS) / sizeof(PixelFormat); i++)
+  {
+    Image source(SIMD_FORMATS[i], SIMD_WIDTH, SIMD_HEIGHT, false);
+    FillPseudoRandom(source, static_cast<uint32_t>(i));
+
+    for (size_t j = 0; j < sizeof(OFFSETS) / sizeof(float); j++)
+    {
+      for (size_t k = 0; k < sizeof(SCALINGS) / sizeof(float); k++)
+      {
+        for (int useRound = 0; useRound < 2; useRound++)
+        {
+          Image a(SIMD_FORMATS[i], SIMD_WIDTH, SIMD_HEIGHT, false);
+          Image b(SIMD_FORMATS[i], SIMD_WIDTH, SIMD_HEIGHT, false);
+          ImageProcessing::Copy(a, source);
+          ImageProcessing::Copy(b, source);
+
+          ImageProcessing::SetSimdEnabled(false);
+          ImageProcessing::ShiftScale(a, OFFSETS[j], SCALINGS[k], useRound != 0);
+          ImageProcessing::SetSimdEnabled(true);
+          ImageProcessing::ShiftScale(b, OFFSETS[j], SCALINGS[k], useRound != 0);
+
+          ASSERT_TRUE(IsSameImage(a, b));
+        }
+      }
+    }
+  }
+}
+
+
+TEST(ImageProcessing, SimdConvert)
+{
+  for (size_t i = 0; i < sizeof(SIMD_FORMATS) / sizeof(PixelFormat); i++)
+  {
+    Image source(SIMD_FORMATS[i], SIMD_WIDTH, SIMD_HEIGHT, false);
+    FillPseudoRandom(source, static_cast<uint32_t>(i));
+
+    for (size_t j = 0; j < sizeof(SIMD_FORMATS) / sizeof(PixelFormat); j++)
+    {
+      if (i != j)
+      {
+        Image a(SIMD_FORMATS[j], SIMD_WIDTH, SIMD_HEIGHT, false);
+        Image b(SIMD_FORMATS[j], SIMD_WIDTH, SIMD_HEIGHT, false);
+
+        ImageProcessing::SetSimdEnabled(false);
+        ImageProcessing::Convert(a, source);
+        ImageProcessing::SetSimdEnabled(true);
+        ImageProcessing::Convert(b, source);
+
+        ASSERT_TRUE(IsSameImage(a, b));
+      }
+    }
+  }
+}
+
+
+TEST(ImageProcessing, SimdInvert)
+{
+  Image a(PixelFormat_Grayscale8, SIMD_WIDTH, SIMD_HEIGHT, false);
+  Image b(PixelFormat_Grayscale8, SIMD_WIDTH, SIMD_HEIGHT, false);
+  FillPseudoRandom(a, 42);
+  ImageProcessing::Copy(b, a);
+
+  ImageProcessing::SetSimdEnabled(false);
+  ImageProcessing::Invert(a);
+  ImageProcessing::SetSimdEnabled(true);
+  ImageProcessing::Invert(b);
+
+  ASSERT_TRUE(IsSameImage(a, b));
+}
+
+
+TEST(ImageProcessing, Resize)
+{
+  Image source(PixelFormat_Grayscale8, 4, 2, false);
+  uint8_t* row0 = reinterpret_cast<uint8_t*>(source.GetRow(0));
+  uint8_t* row1 = reinterpret_cast<uint8_t*>(source.GetRow(1));
+  row0[0] = 0;   row0[1] = 10;  row0[2] = 100; row0[3] = 200;
+  row1[0] = 20;  row1[1] = 30;  row1[2] = 0;   row1[3] = 1;
+
+  Image half(PixelFormat_Grayscale8, 2, 1, false);
+  ImageProcessing::Resize(half, source);
+  ASSERT_EQ(15, reinterpret_cast<const uint8_t*>(half.GetConstRow(0)) [0]);
+  ASSERT_EQ(75, reinterpret_cast<const uint8_t*>(half.GetConstRow(0)) [1]);  // 75.25
+
+  Image same(PixelFormat_Grayscale8, 4, 2, false);
+  ImageProcessing::Resize(same, source);
+  ASSERT_TRUE(IsSameImage(same, source));
+
+  // Upscaling uses the nearest neighbor
+  Image twice(PixelFormat_Grayscale8, 8, 4, false);
+  ImageProcessing::Resize(twice, source);
+  ASSERT_EQ(200, reinterpret_cast<const uint8_t*>(twice.GetConstRow(1)) [7]);
+  ASSERT_EQ(1, reinterpret_cast<const uint8_t*>(twice.GetConstRow(2)) [6]);
+
+  Image color(PixelFormat_RGB24, 2, 1, false);
+  uint8_t* p = reinterpret_cast<uint8_t*>(color.GetRow(0));
+  p[0] = 0;  p[1] = 100;  p[2] = 255;
+  p[3] = 10; p[4] = 200;  p[5] = 255;
+
+  Image pixel(PixelFormat_RGB24, 1, 1, false);
+  ImageProcessing::Resize(pixel, color);
+  p = reinterpret_cast<uint8_t*>(pixel.GetRow(0));
+  ASSERT_EQ(5, p[0]);
+  ASSERT_EQ(150, p[1]);
+  ASSERT_EQ(255, p[2]);
+
+  ASSERT_THROW(ImageProcessing::Resize(half, color), OrthancException);
+}
+
+
+TEST(ImageProcessing, ApplyWindowing)
+{
+  Image source(PixelFormat_SignedGrayscale16, 4, 1, false);
+  int16_t* s = reinterpret_cast<int16_t*>(source.GetRow(0));
+  s[0] = -1000;
+  s[1] = 0;
+  s[2] = 40;
+  s[3] = 1000;
+
+  // Window of CT images for soft tissues, on top of the rescale
+  // intercept of CT images
+  Image target(PixelFormat_Grayscale8, 4, 1, false);
+  ImageProcessing::ApplyWindowing(target, source, 40, 400, 1, -1024, false);
+  const uint8_t* t = reinterpret_cast<const uint8_t*>(target.GetConstRow(0));
+  ASSERT_EQ(0, t[0]);
+  ASSERT_EQ(0, t[1]);
+  ASSERT_EQ(0, t[2]);
+  ASSERT_EQ(87, t[3]);  // ((-24 - 39.5) / 399 + 0.5) * 255 = 86.9
+
+  ImageProcessing::ApplyWindowing(target, source, 40, 400, 1, 0, false);
+  ASSERT_EQ(0, t[0]);
+  ASSERT_EQ(102, t[1]);  // ((0 - 39.5) / 399 + 0.5) * 255 = 102.2
+  ASSERT_EQ(128, t[2]);
+  ASSERT_EQ(255, t[3]);
+
+  ImageProcessing::ApplyWindowing(target, source, 40, 400, 1, 0, true);
+  ASSERT_EQ(255, t[0]);
+  ASSERT_EQ(153, t[1]);
+  ASSERT_EQ(127, t[2]);
+  ASSERT_EQ(0, t[3]);
+
+  // The rescale slope is applied before the windowing
+  ImageProcessing::ApplyWindowing(target, source, 80, 800, 2, 0, false);
+  ASSERT_EQ(0, t[0]);
+  ASSERT_EQ(102, t[1]);
+  ASSERT_EQ(128, t[2]);
+  ASSERT_EQ(255, t[3]);
+
+  // Windowing and downscaling in the same pass
+  Image thumbnail(PixelFormat_Grayscale8, 2, 1, false);
+  ImageProcessing::ApplyWindowing(thumbnail, source, 40, 400, 1, 0, false);
+  ASSERT_EQ(51, reinterpret_cast<const uint8_t*>(thumbnail.GetConstRow(0)) [0]);
+  ASSERT_EQ(192, reinterpret_cast<const uint8_t*>(thumbnail.GetConstRow(0)) [1]);  // 191.5
+
+  ASSERT_THROW(ImageProcessing::ApplyWindowing(target, source, 40, 0.5f, 1, 0, false), OrthancException);
+  ASSERT_THROW(ImageProcessing::ApplyWindowing(source, source, 40, 400, 1, 0, false), OrthancException);
+}
@@ -39,7 +39,9 @@
 #include <boost/lexical_cast.hpp>
 
 #include "../Core/Cache/MemoryCache.h"
+#include "../Core/Cache/MemoryStringCache.h"
 #include "../Core/Cache/SharedArchive.h"
+#include "../Core/Cache/ShardedMemoryCache.h"
 #include "../Core/IDynamicObject.h"
 #include "../Core/Logging.h"
 
@@ -282,3 +284,246 @@ TEST(LRU, SharedArchive)
 
   ASSERT_EQ(2u, count);
 }
+
+
+
+namespace
+{
+  class SizedIntegerProvider : public Orthanc::ShardedMemoryCache::IProvider
+  {
+  public:
+    std::string log_;
+
+    virtual Orthanc::IDynamicObject* Provide(size_t& memorySize,
+                                             const std::string& s)
+    {
+      int value = boost::lexical_cast<int>(s);
+      if (value < 0)
+      {
+        throw Orthanc::OrthancException(Orthanc::ErrorCode_InexistentItem);
+      }
+
+      memorySize = 10;
+      return new Integer(log_, value);
+    }
+  };
+}
+
+
+TEST(ShardedMemoryCache, Basic)
+{
+  SizedIntegerProvider provider;
+
+  {
+    // A single shard that can hold 3 entries of 10 bytes
+    Orthanc::ShardedMemoryCache cache(provider, 35, 1);
+
+    { Orthanc::ShardedMemoryCache::Accessor a(cache, "42"); }
+    { Orthanc::ShardedMemoryCache::Accessor a(cache, "43"); }
+    { Orthanc::ShardedMemoryCache::Accessor a(cache, "45"); }
+    { Orthanc::ShardedMemoryCache::Accessor a(cache, "42"); }  // 42, 45, 43
+
+    {
+      // 43 is in use, and cannot be evicted
+      Orthanc::ShardedMemoryCache::Accessor a(cache, "43");
+      { Orthanc::ShardedMemoryCache::Accessor b(cache, "47"); }  // 45 is removed
+      { Orthanc::ShardedMemoryCache::Accessor b(cache, "44"); }  // 42 is removed
+      ASSERT_EQ("45 42 ", provider.log_);
+
+      cache.Invalidate("43");   // Postponed until the accessor is released
+      ASSERT_EQ("45 42 ", provider.log_);
+    }
+
+    ASSERT_EQ("45 42 43 ", provider.log_);
+
+    ASSERT_THROW(Orthanc::ShardedMemoryCache::Accessor(cache, "-1"), Orthanc::OrthancException);
+
+    uint64_t hits, misses, evictions;
+    size_t count, memory;
+    cache.GetStatistics(hits, misses, evictions, count, memory);
+    ASSERT_EQ(2u, hits);
+    ASSERT_EQ(5u, misses);
+    ASSERT_EQ(2u, evictions);
+    ASSERT_EQ(2u, count);     // 47 and 44
+    ASSERT_EQ(20u, memory);
+  }
+
+  // The remaining entries are destroyed together with the cache
+  ASSERT_EQ("45 42 43 44 47 ", provider.log_);
+}
+
+
+namespace
+{
+  class ShardedCacheThread
+  {
+  private:
+    Orthanc::ShardedMemoryCache& cache_;
+    int thread_;
+
+  public:
+    ShardedCacheThread(Orthanc::ShardedMemoryCache& cache,
+                       int thread) :
+      cache_(cache),
+      thread_(thread)
+    {
+    }
+
+    void operator() ()
+    {
+      for (int i = 0; i < 100; i++)
+      {
+        std::string id = boost::lexical_cast<std::string>((i * (thread_ + 1)) % 17);
+        Orthanc::ShardedMemoryCache::Accessor accessor(cache_, id);
+        accessor.GetContent();
+      }
+    }
+  };
+}
+
+
+TEST(ShardedMemoryCache, Concurrency)
+{
+  SizedIntegerProvider provider;
+
+  {
+    Orthanc::ShardedMemoryCache cache(provider, 100, 4);
+
+    boost::thread_group threads;
+    for (int i = 0; i < 4; i++)
+    {
+      threads.create_thread(ShardedCacheThread(cache, i));
+    }
+
+    threads.join_all();
+
+    uint64_t hits, misses, evictions;
+    size_t count, memory;
+    cache.GetStatistics(hits, misses, evictions, count, memory);
+    ASSERT_EQ(400u, hits + misses);
+    ASSERT_EQ(misses, evictions + count);
+    ASSERT_LE(memory, 100u);
+  }
+}
+
+
+TEST(ShardedMemoryCache, GlobalBudget)
+{
+  SizedIntegerProvider provider;
+
+  {
+    // The budget is shared by the shards, whose count exceeds the
+    // number of entries that fit in the cache
+    Orthanc::ShardedMemoryCache cache(provider, 35, 16);
+
+    for (int i = 0; i < 10; i++)
+    {
+      Orthanc::ShardedMemoryCache::Accessor a(cache, boost::lexical_cast<std::string>(i));
+    }
+
+    uint64_t hits, misses, evictions;
+    size_t count, memory;
+    cache.GetStatistics(hits, misses, evictions, count, memory);
+    ASSERT_EQ(0u, hits);
+    ASSERT_EQ(10u, misses);
+    ASSERT_EQ(7u, evictions);
+    ASSERT_EQ(3u, count);
+    ASSERT_EQ(30u, memory);
+
+    // The least recently used entries are evicted first, whatever their shard
+    ASSERT_EQ("0 1 2 3 4 5 6 ", provider.log_);
+  }
+
+  provider.log_.clear();
+
+  {
+    // The most recently released entry is kept, even if it is larger
+    // than the whole budget
+    Orthanc::ShardedMemoryCache cache(provider, 5, 4);
+
+    { Orthanc::ShardedMemoryCache::Accessor a(cache, "1"); }
+    { Orthanc::ShardedMemoryCache::Accessor a(cache, "1"); }
+    ASSERT_TRUE(provider.log_.empty());
+
+    { Orthanc::ShardedMemoryCache::Accessor a(cache, "2"); }
+    ASSERT_EQ("1 ", provider.log_);
+
+    uint64_t hits, misses, evictions;
+    size_t count, memory;
+    cache.GetStatistics(hits, misses, evictions, count, memory);
+    ASSERT_EQ(1u, hits);
+    ASSERT_EQ(1u, count);
+    ASSERT_EQ(10u, memory);
+  }
+
+  provider.log_.clear();
+
+  {
+    // A budget of zero disables the cache, except while an entry is in use
+    Orthanc::ShardedMemoryCache cache(provider, 0, 4);
+
+    { Orthanc::ShardedMemoryCache::Accessor a(cache, "1"); }
+    ASSERT_EQ("1 ", provider.log_);
+
+    { Orthanc::ShardedMemoryCache::Accessor a(cache, "1"); }
+    ASSERT_EQ("1 1 ", provider.log_);
+
+    uint64_t hits, misses, evictions;
+    size_t count, memory;
+    cache.GetStatistics(hits, misses, evictions, count, memory);
+    ASSERT_EQ(0u, hits);
+    ASSERT_EQ(2u, misses);
+    ASSERT_EQ(0u, count);
+    ASSERT_EQ(0u, memory);
+  }
+}
+
+
+TEST(MemoryStringCache, Basic)
+{
+  Orthanc::MemoryStringCache cache(10);
+  std::string s;
+
+  cache.Add("a|1", "aaa");
+  cache.Add("a|2", "bbb");
+  cache.Add("b|1", "cc");
+  ASSERT_FALSE(cache.Fetch(s, "nope"));
+  ASSERT_TRUE(cache.Fetch(s, "a|1"));  ASSERT_EQ("aaa", s);
+  ASSERT_TRUE(cache.Fetch(s, "a|2"));  ASSERT_EQ("bbb", s);
+  ASSERT_TRUE(cache.Fetch(s, "b|1"));  ASSERT_EQ("cc", s);
+
+  // "a|1" is the least recently used entry, and must be evicted
+  cache.Add("c|1", "dddd");
+  ASSERT_FALSE(cache.Fetch(s, "a|1"));
+  ASSERT_TRUE(cache.Fetch(s, "c|1"));  ASSERT_EQ("dddd", s);
+
+  // Replacing one value
+  cache.Add("b|1", "e");
+  ASSERT_TRUE(cache.Fetch(s, "b|1"));  ASSERT_EQ("e", s);
+
+  // Too large to be cached
+  cache.Add("f|1", "01234567890");
+  ASSERT_FALSE(cache.Fetch(s, "f|1"));
+
+  uint64_t hits, misses, evictions;
+  size_t count, memory;
+  cache.GetStatistics(hits, misses, evictions, count, memory);
+  ASSERT_EQ(5u, hits);
+  ASSERT_EQ(3u, misses);
+  ASSERT_EQ(1u, evictions);
+  ASSERT_EQ(3u, count);
+  ASSERT_EQ(8u, memory);
+
+  cache.Add("a|3", "f");
+  cache.InvalidatePrefix("a|");
+  ASSERT_FALSE(cache.Fetch(s, "a|2"));
+  ASSERT_FALSE(cache.Fetch(s, "a|3"));
+  ASSERT_TRUE(cache.Fetch(s, "b|1"));
+
+  cache.Invalidate("b|1");
+  ASSERT_FALSE(cache.Fetch(s, "b|1"));
+
+  cache.GetStatistics(hits, misses, evictions, count, memory);
+  ASSERT_EQ(1u, count);
+  ASSERT_EQ(4u, memory);
+}
@@ -37,6 +37,7 @@
 #include "../Core/FileStorage/MemoryStorageArea.h"
 #include "../Core/JobsEngine/JobsEngine.h"
 #include "../Core/Logging.h"
+#include "../Core/MetricsRegistry.h"
 #include "../Core/MultiThreading/SharedMessageQueue.h"
 #include "../Core/OrthancException.h"
 #include "../Core/SerializationToolbox.h"
@@ -61,6 +62,7 @@
 
 #include "../OrthancServer/ServerJobs/ArchiveJob.h"
 #include "../OrthancServer/ServerJobs/DicomModalityStoreJob.h"
+#include "../OrthancServer/ServerJobs/DicomSummaryMigrationJob.h"
 #include "../OrthancServer/ServerJobs/OrthancPeerStoreJob.h"
 #include "../OrthancServer/ServerJobs/ResourceModificationJob.h"
 
@@ -173,6 +175,123 @@ namespace
   };
 
 
+  class DummyParallelInstancesJob : public SetOfInstancesJob
+  {
+  private:
+    boost::mutex           mutex_;
+    std::set<size_t>       lanes_;
+
+  protected:
+    virtual bool HandleInstance(const std::string& instance)
+    {
+      return HandleInstanceInLane(0, instance);
+    }
+
+    virtual bool IsParallelizable() const
+    {
+      return true;
+    }
+
+    virtual bool HandleInstanceInLane(size_t lane,
+                                      const std::string& instance)
+    {
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        lanes_.insert(lane);
+      }
+
+      if (instance == "error")
+      {
+        throw OrthancException(ErrorCode_NetworkProtocol);
+      }
+
+      return (instance != "nope");
+    }
+
+  public:
+    virtual ~DummyParallelInstancesJob()
+    {
+      StopLanes();
+    }
+
+    const std::set<size_t>& GetUsedLanes() const
+    {
+      return lanes_;
+    }
+    
+    virtual void ReleaseResources()
+    {
+      StopLanes();
+    }
+
+    virtual void GetJobType(std::string& s)
+    {
+      s = "DummyParallelInstancesJob";
+    }
+  };
+
+
+  class DummyTrailingInstancesJob : public DummyInstancesJob
+  {
+  private:
+    unsigned int  trailingCount_;
+
+  protected:
+    virtual bool HasTrailingStep() const
+    {
+      return true;
+    }
+
+    virtual bool HandleTrailingStep()
+    {
+      trailingCount_++;
+      return true;
+    }
+
+  public:
+    DummyTrailingInstancesJob() :
+      trailingCount_(0)
+    {
+    }
+
+    unsigned int GetTrailingCount() const
+    {
+      return trailingCount_;
+    }
+  };
+
+
+  class DummyDeferredFailuresJob : public SetOfInstancesJob
+  {
+  private:
+    std::string  previous_;
+
+  protected:
+    virtual bool HandleInstance(const std::string& instance)
+    {
+      // The failure of an instance is only known once the next
+      // instance is handled, as with pipelined C-STORE
+      if (previous_ == "nope")
+      {
+        SignalFailedInstance(previous_);
+      }
+
+      previous_ = instance;
+      return true;
+    }
+
+  public:
+    virtual void ReleaseResources()
+    {
+    }
+
+    virtual void GetJobType(std::string& s)
+    {
+      s = "DummyDeferredFailuresJob";
+    }
+  };
+
+
   class DummyUnserializer : public GenericJobUnserializer
   {
   public:
@@ -254,6 +373,65 @@ TEST(MultiThreading, SharedMessageQueueClean)
 }
 
 
+static void IncrementMetrics(MetricsRegistry* registry)
+{
+  for (unsigned int i = 0; i < 1000; i++)
+  {
+    registry->IncrementCounter("orthanc_test_total", 1);
+    registry->ObserveDuration("orthanc_test_seconds", MetricsRegistry::FormatLabel("route", "/a"),
+                              boost::posix_time::microseconds(i < 500 ? 20 : 2000));
+  }
+}
+
+
+TEST(MultiThreading, MetricsRegistry)
+{
+  MetricsRegistry registry;
+
+  std::vector<boost::thread*> threads;
+  for (size_t i = 0; i < 4; i++)
+  {
+    threads.push_back(new boost::thread(IncrementMetrics, &registry));
+  }
+
+  for (size_t i = 0; i < threads.size(); i++)
+  {
+    threads[i]->join();
+    delete threads[i];
+  }
+
+  registry.SetGauge("orthanc_test_gauge", MetricsRegistry::FormatLabel("name", "a\"b"), 42);
+  registry.SetCounter("orthanc_external_total", MetricsRegistry::FormatLabel("cache", "a"), 12);
+  registry.SetCounter("orthanc_external_total", MetricsRegistry::FormatLabel("cache", "b"), 5);
+  registry.SetCounter("orthanc_external_total", MetricsRegistry::FormatLabel("cache", "a"), 13);
+
+  {
+    MetricsRegistry::Timer timer(registry, "orthanc_timer_seconds");
+  }
+
+  std::string s;
+  registry.ExportPrometheusText(s);
+
+  ASSERT_NE(std::string::npos, s.find("# TYPE orthanc_test_total counter\northanc_test_total 4000\n"));
+  ASSERT_NE(std::string::npos, s.find("# TYPE orthanc_external_total counter\n"
+                                      "orthanc_external_total{cache=\"a\"} 13\n"
+                                      "orthanc_external_total{cache=\"b\"} 5\n"));
+  ASSERT_NE(std::string::npos, s.find("# TYPE orthanc_test_gauge gauge\northanc_test_gauge{name=\"a\\\"b\"} 42\n"));
+  ASSERT_NE(std::string::npos, s.find("# TYPE orthanc_test_seconds histogram\n"));
+  ASSERT_NE(std::string::npos, s.find("orthanc_test_seconds_bucket{route=\"/a\",le=\"5e-05\"} 2000\n"));
+  ASSERT_NE(std::string::npos, s.find("orthanc_test_seconds_bucket{route=\"/a\",le=\"0.001\"} 2000\n"));
+  ASSERT_NE(std::string::npos, s.find("orthanc_test_seconds_bucket{route=\"/a\",le=\"0.005\"} 4000\n"));
+  ASSERT_NE(std::string::npos, s.find("orthanc_test_seconds_bucket{route=\"/a\",le=\"+Inf\"} 4000\n"));
+  ASSERT_NE(std::string::npos, s.find("orthanc_test_seconds_count{route=\"/a\"} 4000\n"));
+  ASSERT_NE(std::string::npos, s.find("orthanc_timer_seconds_count 1\n"));
+
+  registry.SetEnabled(false);
+  registry.IncrementCounter("orthanc_test_total", 1);
+  registry.ExportPrometheusText(s);
+  ASSERT_NE(std::string::npos, s.find("orthanc_test_total 4000\n"));
+}
+
+
 
 
 static bool CheckState(JobsRegistry& registry,
@@ -949,6 +1127,139 @@ TEST(JobsSerialization, GenericOperations)
 }
 
 
+static JobStepResult ExecuteUntilDone(SetOfInstancesJob& job)
+{
+  for (;;)
+  {
+    JobStepResult result = job.ExecuteStep();
+    if (result.GetCode() != JobStepCode_Continue)
+    {
+      return result;
+    }
+  }
+}
+
+
+TEST(SetOfInstancesJob, Lanes)
+{
+  {
+    DummyParallelInstancesJob job;
+    for (size_t i = 0; i < 7; i++)
+    {
+      job.AddInstance(i == 3 ? "nope" : "hello");
+    }
+
+    job.SetPermissive(true);
+    job.SetLanesCount(3);
+    job.Start();
+    ASSERT_THROW(job.SetLanesCount(2), OrthancException);
+
+    ASSERT_EQ(JobStepCode_Success, ExecuteUntilDone(job).GetCode());
+    ASSERT_EQ(7u, job.GetPosition());
+    ASSERT_FLOAT_EQ(1.0f, job.GetProgress());
+
+    ASSERT_EQ(3u, job.GetUsedLanes().size());
+    ASSERT_EQ(1u, job.GetFailedInstances().size());
+    ASSERT_TRUE(job.IsFailedInstance("nope"));
+
+    // Resubmitting restarts the lanes from the first instance
+    job.SignalResubmit();
+    ASSERT_EQ(0u, job.GetPosition());
+    ASSERT_EQ(JobStepCode_Success, ExecuteUntilDone(job).GetCode());
+    ASSERT_EQ(7u, job.GetPosition());
+    ASSERT_EQ(1u, job.GetFailedInstances().size());
+  }
+
+  {
+    // Non-permissive: The position stops at the first failing
+    // instance, and the failure is reported for this instance only
+    DummyParallelInstancesJob job;
+    job.AddInstance("a");
+    job.AddInstance("b");
+    job.AddInstance("nope");
+    job.AddInstance("c");
+    job.SetLanesCount(4);
+    job.Start();
+
+    JobStepResult result = ExecuteUntilDone(job);
+    ASSERT_EQ(JobStepCode_Failure, result.GetCode());
+    ASSERT_EQ(ErrorCode_InternalError, result.GetFailureCode());
+    ASSERT_GE(2u, job.GetPosition());
+    ASSERT_TRUE(job.GetFailedInstances().empty());
+  }
+
+  {
+    DummyParallelInstancesJob job;
+    job.AddInstance("a");
+    job.AddInstance("error");
+    job.AddInstance("b");
+    job.SetLanesCount(3);
+    job.Start();
+
+    JobStepResult result = ExecuteUntilDone(job);
+    ASSERT_EQ(JobStepCode_Failure, result.GetCode());
+    ASSERT_EQ(ErrorCode_NetworkProtocol, result.GetFailureCode());
+    ASSERT_GE(1u, job.GetPosition());
+  }
+
+  {
+    // Pausing the job stops the lanes, that resume from the
+    // instances that are not handled yet
+    DummyParallelInstancesJob job;
+    for (size_t i = 0; i < 100; i++)
+    {
+      job.AddInstance("hello");
+    }
+
+    job.SetLanesCount(4);
+    job.Start();
+    JobStepCode code = job.ExecuteStep().GetCode();
+    job.ReleaseResources();
+
+    if (code == JobStepCode_Continue)
+    {
+      code = ExecuteUntilDone(job).GetCode();
+    }
+
+    ASSERT_EQ(JobStepCode_Success, code);
+    ASSERT_EQ(100u, job.GetPosition());
+  }
+}
+
+
+TEST(SetOfInstancesJob, SignaledFailures)
+{
+  {
+    DummyDeferredFailuresJob job;
+    job.AddInstance("a");
+    job.AddInstance("nope");
+    job.AddInstance("b");
+    job.AddInstance("c");
+    job.SetPermissive(true);
+    job.Start();
+
+    ASSERT_EQ(JobStepCode_Success, ExecuteUntilDone(job).GetCode());
+    ASSERT_EQ(1u, job.GetFailedInstances().size());
+    ASSERT_TRUE(job.IsFailedInstance("nope"));
+  }
+
+  {
+    DummyDeferredFailuresJob job;
+    job.AddInstance("a");
+    job.AddInstance("nope");
+    job.AddInstance("b");
+    job.AddInstance("c");
+    job.Start();
+
+    ASSERT_EQ(JobStepCode_Continue, job.ExecuteStep().GetCode());
+    ASSERT_EQ(JobStepCode_Continue, job.ExecuteStep().GetCode());
+    ASSERT_EQ(JobStepCode_Failure, job.ExecuteStep().GetCode());
+    ASSERT_TRUE(job.IsFailedInstance("nope"));
+    ASSERT_FALSE(job.IsFailedInstance("b"));
+  }
+}
+
+
 TEST(JobsSerialization, GenericJobs)
 {   
   Json::Value s;
@@ -996,6 +1307,20 @@ TEST(JobsSerialization, GenericJobs)
     ASSERT_TRUE(tmp.IsFailedInstance("nope"));
   }
 
+  // SetOfInstancesJob with lanes (the "LanesCount" field is optional
+  // for compatibility with jobs serialized by Orthanc <= 1.4.1)
+
+  {
+    DummyInstancesJob job;
+    job.AddInstance("hello");
+    ASSERT_THROW(job.SetLanesCount(0), OrthancException);
+    job.SetLanesCount(4);
+    ASSERT_TRUE(job.Serialize(s));
+    ASSERT_EQ(4u, DummyInstancesJob(s).GetLanesCount());
+    s.removeMember("LanesCount");
+    ASSERT_EQ(1u, DummyInstancesJob(s).GetLanesCount());
+  }
+
   // SequenceOfOperationsJob
 
   {
@@ -1491,6 +1816,51 @@ TEST_F(OrthancJobsSerialization, Jobs)
 }
 
 
+TEST_F(OrthancJobsSerialization, DicomSummaryMigration)
+{
+  ServerIndex& index = GetContext().GetIndex();
+
+  std::vector<std::string> ids;
+  for (size_t i = 0; i < 5; i++)
+  {
+    std::string id;
+    ASSERT_TRUE(CreateInstance(id));
+    ids.push_back(id);
+
+    // Replace the binary summary by a "DICOM-as-JSON" attachment, as
+    // created by Orthanc <= 1.4.1
+    std::string json;
+    GetContext().ReadDicomAsJson(json, id);
+    index.DeleteAttachment(id, FileContentType_DicomSummary);
+    ASSERT_TRUE(GetContext().AddAttachment(id, FileContentType_DicomAsJson, json.c_str(), json.size()));
+  }
+
+  DicomSummaryMigrationJob job(GetContext());
+  for (size_t i = 0; i < ids.size(); i++)
+  {
+    job.AddInstance(ids[i]);
+  }
+
+  job.AddInstance("nope");   // Removed after the job was issued
+  job.SetLanesCount(2);
+  job.Start();
+
+  ASSERT_EQ(JobStepCode_Success, ExecuteUntilDone(job).GetCode());
+  ASSERT_EQ(6u, job.GetPosition());
+  ASSERT_TRUE(job.GetFailedInstances().empty());
+
+  for (size_t i = 0; i < ids.size(); i++)
+  {
+    FileInfo attachment;
+    ASSERT_TRUE(index.LookupAttachment(attachment, ids[i], FileContentType_DicomSummary));
+    ASSERT_FALSE(index.LookupAttachment(attachment, ids[i], FileContentType_DicomAsJson));
+
+    std::string summary;
+    ASSERT_TRUE(GetContext().ReadDicomSummary(summary, ids[i]));
+  }
+}
+
+
 TEST(JobsSerialization, Registry)
 {   
   Json::Value s;
@@ -47,6 +47,7 @@
 #include "../Core/Compression/ZlibCompressor.h"
 #include "../Core/RestApi/RestApiHierarchy.h"
 #include "../Core/HttpServer/HttpContentNegociation.h"
+#include "../OrthancServer/FramesBatch.h"
 
 using namespace Orthanc;
 
@@ -81,6 +82,77 @@ TEST(HttpClient, Basic)
 }
 
 
+TEST(HttpClient, ConnectionPool)
+{
+  SystemToolbox::WriteFile("", "UnitTestsResults/pool.cert");
+
+  WebServiceParameters a;
+  a.SetUrl("http://localhost:8042/");
+
+  // The pool key depends on the URL, the user and the certificate,
+  // but not on the password
+  WebServiceParameters b(a);
+  b.SetPassword("password");
+  ASSERT_EQ(HttpClient::GetConnectionPoolKey(a), HttpClient::GetConnectionPoolKey(b));
+
+  b.SetUrl("http://localhost:8043/");
+  ASSERT_NE(HttpClient::GetConnectionPoolKey(a), HttpClient::GetConnectionPoolKey(b));
+
+  b = a;
+  b.SetUsername("user");
+  ASSERT_NE(HttpClient::GetConnectionPoolKey(a), HttpClient::GetConnectionPoolKey(b));
+
+  b = a;
+  b.SetClientCertificate("UnitTestsResults/pool.cert", "", "");
+  ASSERT_NE(HttpClient::GetConnectionPoolKey(a), HttpClient::GetConnectionPoolKey(b));
+
+  b = a;
+  b.SetUrl("http://localhost:8043/");
+
+  const std::string key = HttpClient::GetConnectionPoolKey(a);
+  ASSERT_EQ(0u, HttpClient::GetPooledConnectionsCount(key));
+
+  HttpClient::SetConnectionPoolSize(2);
+
+  {
+    // The handles of the clients without Web service are not pooled
+    HttpClient c;
+  }
+
+  {
+    HttpClient c(a, "/system");
+  }
+
+  ASSERT_EQ(1u, HttpClient::GetPooledConnectionsCount(key));
+
+  {
+    // The pooled handle is reused, and a new one is created for the
+    // second client
+    HttpClient c1(a, "/system");
+    ASSERT_EQ(0u, HttpClient::GetPooledConnectionsCount(key));
+
+    HttpClient c2(a, "/system");
+    HttpClient c3(a, "/system");
+
+    HttpClient other(b, "/system");
+  }
+
+  // At most 2 handles are kept for each Web service
+  ASSERT_EQ(2u, HttpClient::GetPooledConnectionsCount(key));
+  ASSERT_EQ(1u, HttpClient::GetPooledConnectionsCount(HttpClient::GetConnectionPoolKey(b)));
+
+  HttpClient::SetConnectionPoolSize(0);
+  ASSERT_EQ(0u, HttpClient::GetPooledConnectionsCount(key));
+
+  {
+    HttpClient c(a, "/system");
+  }
+
+  ASSERT_EQ(0u, HttpClient::GetPooledConnectionsCount(key));
+  HttpClient::SetConnectionPoolSize(4);
+}
+
+
 #if UNIT_TESTS_WITH_HTTP_CONNEXIONS == 1 && ORTHANC_ENABLE_SSL == 1
 
 /**
@@ -185,6 +257,49 @@ TEST(RestApi, ParseCookies)
   ASSERT_EQ("v", cookies["n"]);
 }
 
+TEST(RestApi, ParseRange)
+{
+  bool ok;
+  uint64_t start, end;
+
+  ASSERT_TRUE(HttpToolbox::ParseRange(ok, start, end, "bytes=0-499", 1000));
+  ASSERT_TRUE(ok);  ASSERT_EQ(0u, start);  ASSERT_EQ(500u, end);
+
+  ASSERT_TRUE(HttpToolbox::ParseRange(ok, start, end, " bytes=500-999 ", 1000));
+  ASSERT_TRUE(ok);  ASSERT_EQ(500u, start);  ASSERT_EQ(1000u, end);
+
+  ASSERT_TRUE(HttpToolbox::ParseRange(ok, start, end, "bytes=500-5000", 1000));
+  ASSERT_TRUE(ok);  ASSERT_EQ(500u, start);  ASSERT_EQ(1000u, end);
+
+  ASSERT_TRUE(HttpToolbox::ParseRange(ok, start, end, "bytes=900-", 1000));
+  ASSERT_TRUE(ok);  ASSERT_EQ(900u, start);  ASSERT_EQ(1000u, end);
+
+  ASSERT_TRUE(HttpToolbox::ParseRange(ok, start, end, "bytes=-100", 1000));
+  ASSERT_TRUE(ok);  ASSERT_EQ(900u, start);  ASSERT_EQ(1000u, end);
+
+  ASSERT_TRUE(HttpToolbox::ParseRange(ok, start, end, "bytes=-5000", 1000));
+  ASSERT_TRUE(ok);  ASSERT_EQ(0u, start);  ASSERT_EQ(1000u, end);
+
+  ASSERT_TRUE(HttpToolbox::ParseRange(ok, start, end, "bytes=1000-", 1000));
+  ASSERT_FALSE(ok);
+
+  ASSERT_TRUE(HttpToolbox::ParseRange(ok, start, end, "bytes=-0", 1000));
+  ASSERT_FALSE(ok);
+
+  ASSERT_TRUE(HttpToolbox::ParseRange(ok, start, end, "bytes=0-", 0));
+  ASSERT_FALSE(ok);
+
+  // Ignored headers
+  ASSERT_FALSE(HttpToolbox::ParseRange(ok, start, end, "", 1000));
+  ASSERT_FALSE(HttpToolbox::ParseRange(ok, start, end, "bytes=", 1000));
+  ASSERT_FALSE(HttpToolbox::ParseRange(ok, start, end, "bytes=-", 1000));
+  ASSERT_FALSE(HttpToolbox::ParseRange(ok, start, end, "bytes=10", 1000));
+  ASSERT_FALSE(HttpToolbox::ParseRange(ok, start, end, "bytes=10-5", 1000));
+  ASSERT_FALSE(HttpToolbox::ParseRange(ok, start, end, "bytes=a-5", 1000));
+  ASSERT_FALSE(HttpToolbox::ParseRange(ok, start, end, "bytes=0-1,5-6", 1000));
+  ASSERT_FALSE(HttpToolbox::ParseRange(ok, start, end, "items=0-1", 1000));
+}
+
 TEST(RestApi, RestApiPath)
 {
   IHttpHandler::Arguments args;
@@ -420,7 +535,7 @@ TEST(RestApi, HttpContentNegociation)
   // text/x-dvi entity, and if that does not exist, send the
   // text/plain entity.""
   const std::string T1 = "text/plain; q=0.5, text/html, text/x-dvi; q=0.8, text/x-c";
-  
+
   {
     Orthanc::HttpContentNegociation d;
     d.Register("text/plain", h);
@@ -430,7 +545,7 @@ TEST(RestApi, HttpContentNegociation)
     ASSERT_EQ("text", h.GetType());
     ASSERT_EQ("html", h.GetSubType());
   }
-  
+
   {
     Orthanc::HttpContentNegociation d;
     d.Register("text/plain", h);
@@ -440,7 +555,7 @@ TEST(RestApi, HttpContentNegociation)
     ASSERT_EQ("text", h.GetType());
     ASSERT_EQ("x-c", h.GetSubType());
   }
-  
+
   {
     Orthanc::HttpContentNegociation d;
     d.Register("text/plain", h);
@@ -451,7 +566,7 @@ TEST(RestApi, HttpContentNegociation)
     ASSERT_EQ("text", h.GetType());
     ASSERT_TRUE(h.GetSubType() == "x-c" || h.GetSubType() == "html");
   }
-  
+
   {
     Orthanc::HttpContentNegociation d;
     d.Register("text/plain", h);
@@ -460,7 +575,7 @@ TEST(RestApi, HttpContentNegociation)
     ASSERT_EQ("text", h.GetType());
     ASSERT_EQ("x-dvi", h.GetSubType());
   }
-  
+
   {
     Orthanc::HttpContentNegociation d;
     d.Register("text/plain", h);
@@ -469,3 +584,126 @@ TEST(RestApi, HttpContentNegociation)
     ASSERT_EQ("plain", h.GetSubType());
   }
 }
+
+
+TEST(FramesBatch, Ranges)
+{
+  std::vector<unsigned int> frames;
+
+  {
+    FramesBatch b;
+    ASSERT_TRUE(b.IsAllFrames());
+    b.GetFrames(frames, 3);
+    ASSERT_EQ(3u, frames.size());
+    ASSERT_EQ(0u, frames[0]);
+    ASSERT_EQ(2u, frames[2]);
+    b.GetFrames(frames, 0);
+    ASSERT_TRUE(frames.empty());
+  }
+
+  {
+    // Overlapping and duplicate ranges, given in any order
+    FramesBatch b;
+    b.ParseRanges(" 8-9 ,2, 0-3,2,3-4,9");
+    ASSERT_FALSE(b.IsAllFrames());
+    b.GetFrames(frames, 10);
+    ASSERT_EQ(7u, frames.size());
+    ASSERT_EQ(0u, frames[0]);
+    ASSERT_EQ(1u, frames[1]);
+    ASSERT_EQ(2u, frames[2]);
+    ASSERT_EQ(3u, frames[3]);
+    ASSERT_EQ(4u, frames[4]);
+    ASSERT_EQ(8u, frames[5]);
+    ASSERT_EQ(9u, frames[6]);
+  }
+
+  {
+    // Open and truncated ranges
+    FramesBatch b;
+    b.ParseRanges("5-,1-2,3-100");
+    b.GetFrames(frames, 7);
+    ASSERT_EQ(6u, frames.size());
+    ASSERT_EQ(1u, frames[0]);
+    ASSERT_EQ(6u, frames[5]);
+  }
+
+  {
+    // Out-of-range frames
+    FramesBatch b;
+    b.ParseRanges("0-2,7");
+    ASSERT_THROW(b.GetFrames(frames, 7), OrthancException);
+    b.GetFrames(frames, 8);
+    ASSERT_EQ(4u, frames.size());
+    ASSERT_EQ(7u, frames[3]);
+  }
+
+  {
+    FramesBatch b;
+    ASSERT_THROW(b.ParseRanges("3-2"), OrthancException);  // Reversed
+    ASSERT_THROW(b.ParseRanges(""), OrthancException);
+    ASSERT_THROW(b.ParseRanges("1,"), OrthancException);
+    ASSERT_THROW(b.ParseRanges("-3"), OrthancException);
+    ASSERT_THROW(b.ParseRanges("1-2-3"), OrthancException);
+    ASSERT_THROW(b.ParseRanges("a"), OrthancException);
+    ASSERT_THROW(b.ParseRanges("+1"), OrthancException);
+    ASSERT_THROW(b.ParseRanges("99999999999"), OrthancException);
+    ASSERT_THROW(b.AddRange(3, 2), OrthancException);
+  }
+
+  {
+    FramesBatch b;
+    b.AddFirstAndCount(2, 3);
+    b.GetFrames(frames, 10);
+    ASSERT_EQ(3u, frames.size());
+    ASSERT_EQ(2u, frames[0]);
+    ASSERT_EQ(4u, frames[2]);
+
+    b.GetFrames(frames, 4);  // Truncated
+    ASSERT_EQ(2u, frames.size());
+    ASSERT_EQ(3u, frames[1]);
+
+    ASSERT_THROW(b.GetFrames(frames, 2), OrthancException);
+  }
+
+  {
+    // "count == 0" and overflowing counts mean "up to the last frame"
+    FramesBatch b;
+    b.AddFirstAndCount(1, 0);
+    b.AddFirstAndCount(FramesBatch::LAST_FRAME - 1, FramesBatch::LAST_FRAME);
+    ASSERT_THROW(b.GetFrames(frames, 3), OrthancException);
+
+    FramesBatch c;
+    c.AddFirstAndCount(1, 0);
+    c.AddFirstAndCount(2, FramesBatch::LAST_FRAME);
+    c.GetFrames(frames, 3);
+    ASSERT_EQ(2u, frames.size());
+    ASSERT_EQ(1u, frames[0]);
+    ASSERT_EQ(2u, frames[1]);
+  }
+}
+
+
+TEST(FramesBatch, Multipart)
+{
+  std::string s;
+  FramesBatch::FormatPart(s, "b", "image/png", "instances/id/frames/2", std::string("a\0c", 3));
+  ASSERT_EQ(std::string("--b\r\n"
+                        "Content-Type: image/png\r\n"
+                        "Content-Length: 3\r\n"
+                        "Content-Location: instances/id/frames/2\r\n"
+                        "MIME-Version: 1.0\r\n"
+                        "\r\n"
+                        "a\0c\r\n", 116), s);
+
+  FramesBatch::FormatPart(s, "b", "application/octet-stream", "x", "");
+  ASSERT_EQ("--b\r\n"
+            "Content-Type: application/octet-stream\r\n"
+            "Content-Length: 0\r\n"
+            "Content-Location: x\r\n"
+            "MIME-Version: 1.0\r\n"
+            "\r\n"
+            "\r\n", s);
+
+  FramesBatch::FormatClosingBoundary(s, "b");
+  ASSERT_EQ("--b--\r\n", s);
+}
@@ -39,10 +39,13 @@
 #include "../OrthancServer/DatabaseWrapper.h"
 #include "../OrthancServer/ServerContext.h"
 #include "../OrthancServer/ServerIndex.h"
+#include "../OrthancServer/ServerToolbox.h"
+#include "../OrthancServer/Search/LookupResource.h"
 #include "../OrthancServer/Search/LookupIdentifierQuery.h"
 
 #include <ctype.h>
 #include <algorithm>
+#include <boost/lexical_cast.hpp>
 
 using namespace Orthanc;
 
@@ -523,6 +526,303 @@ TEST_P(DatabaseWrapperTest, Upward)
 }
 
 
+TEST_P(DatabaseWrapperTest, ResourceStatistics)
+{
+  int64_t a[] = {
+    index_->CreateResource("a", ResourceType_Patient),   // 0
+    index_->CreateResource("b", ResourceType_Study),     // 1
+    index_->CreateResource("c", ResourceType_Series),    // 2
+    index_->CreateResource("d", ResourceType_Instance),  // 3
+    index_->CreateResource("e", ResourceType_Instance),  // 4
+    index_->CreateResource("f", ResourceType_Series)     // 5
+  };
+
+  // The instances are attached before their series is attached to its study
+  index_->AttachChild(a[2], a[3]);
+  index_->AttachChild(a[2], a[4]);
+  index_->AttachChild(a[0], a[1]);
+  index_->AttachChild(a[1], a[2]);
+  index_->AttachChild(a[1], a[5]);
+
+  index_->AddAttachment(a[3], FileInfo("d1", FileContentType_Dicom, 10, "md5", CompressionType_ZlibWithSize, 5, "md5"));
+  index_->AddAttachment(a[3], FileInfo("d2", FileContentType_DicomAsJson, 20, "md5"));
+  index_->AddAttachment(a[4], FileInfo("e1", FileContentType_Dicom, 100, "md5"));
+  index_->AddAttachment(a[1], FileInfo("b1", FileContentType_StartUser, 1000, "md5"));
+
+  uint64_t compressed, uncompressed;
+  unsigned int countStudies, countSeries, countInstances;
+
+  ASSERT_TRUE(index_->LookupResourceStatistics(compressed, uncompressed, countStudies,
+                                               countSeries, countInstances, a[0]));
+  ASSERT_EQ(1125u, compressed);
+  ASSERT_EQ(1130u, uncompressed);
+  ASSERT_EQ(1u, countStudies);
+  ASSERT_EQ(2u, countSeries);
+  ASSERT_EQ(2u, countInstances);
+
+  ASSERT_TRUE(index_->LookupResourceStatistics(compressed, uncompressed, countStudies,
+                                               countSeries, countInstances, a[2]));
+  ASSERT_EQ(125u, compressed);
+  ASSERT_EQ(130u, uncompressed);
+  ASSERT_EQ(0u, countStudies);
+  ASSERT_EQ(1u, countSeries);
+  ASSERT_EQ(2u, countInstances);
+
+  ASSERT_EQ(1125u, index_->GetTotalCompressedSize());
+  ASSERT_EQ(1130u, index_->GetTotalUncompressedSize());
+  ASSERT_EQ(1u, index_->GetResourceCount(ResourceType_Patient));
+  ASSERT_EQ(2u, index_->GetResourceCount(ResourceType_Series));
+  ASSERT_EQ(2u, index_->GetResourceCount(ResourceType_Instance));
+
+  index_->DeleteAttachment(a[3], FileContentType_DicomAsJson);
+  ASSERT_TRUE(index_->LookupResourceStatistics(compressed, uncompressed, countStudies,
+                                               countSeries, countInstances, a[1]));
+  ASSERT_EQ(1105u, compressed);
+  ASSERT_EQ(1110u, uncompressed);
+
+  index_->DeleteResource(a[3]);
+  ASSERT_TRUE(index_->LookupResourceStatistics(compressed, uncompressed, countStudies,
+                                               countSeries, countInstances, a[1]));
+  ASSERT_EQ(1100u, compressed);
+  ASSERT_EQ(1100u, uncompressed);
+  ASSERT_EQ(2u, countSeries);
+  ASSERT_EQ(1u, countInstances);
+  ASSERT_EQ(1u, index_->GetResourceCount(ResourceType_Instance));
+
+  // Deleting the last instance also deletes the series "c"
+  index_->DeleteResource(a[4]);
+  ASSERT_TRUE(index_->LookupResourceStatistics(compressed, uncompressed, countStudies,
+                                               countSeries, countInstances, a[0]));
+  ASSERT_EQ(1000u, compressed);
+  ASSERT_EQ(1u, countSeries);
+  ASSERT_EQ(0u, countInstances);
+  ASSERT_EQ(1u, index_->GetResourceCount(ResourceType_Series));
+
+  index_->DeleteResource(a[0]);
+  ASSERT_EQ(0u, index_->GetTotalCompressedSize());
+  ASSERT_EQ(0u, index_->GetTotalUncompressedSize());
+  ASSERT_EQ(0u, index_->GetResourceCount(ResourceType_Patient));
+  ASSERT_EQ(0u, index_->GetResourceCount(ResourceType_Study));
+  ASSERT_EQ(0u, index_->GetResourceCount(ResourceType_Series));
+  ASSERT_EQ(0u, index_->GetResourceCount(ResourceType_Instance));
+}
+
+
+TEST_P(DatabaseWrapperTest, StudyAggregates)
+{
+  int64_t a[] = {
+    index_->CreateResource("a", ResourceType_Patient),   // 0
+    index_->CreateResource("b", ResourceType_Study),     // 1
+    index_->CreateResource("c", ResourceType_Series),    // 2
+    index_->CreateResource("d", ResourceType_Instance),  // 3
+    index_->CreateResource("e", ResourceType_Instance),  // 4
+    index_->CreateResource("f", ResourceType_Series),    // 5
+    index_->CreateResource("g", ResourceType_Instance)   // 6
+  };
+
+  // Same order as in "ServerIndex::Store()": The main DICOM tags and
+  // the metadata are stored before the resources are attached
+  index_->SetMainDicomTag(a[2], DICOM_TAG_MODALITY, "CT");
+  index_->SetMainDicomTag(a[5], DICOM_TAG_MODALITY, "MR");
+  index_->SetMetadata(a[3], MetadataType_Instance_SopClassUid, "1.2");
+  index_->AttachChild(a[2], a[3]);
+  index_->AttachChild(a[2], a[4]);
+  index_->AttachChild(a[5], a[6]);
+  index_->AttachChild(a[0], a[1]);
+  index_->AttachChild(a[1], a[2]);
+  index_->AttachChild(a[1], a[5]);
+  index_->SetMetadata(a[6], MetadataType_Instance_SopClassUid, "1.3");
+  index_->SetMetadata(a[6], MetadataType_Instance_SopClassUid, "1.3");
+
+  std::set<std::string> modalities, sopClassUids;
+  unsigned int countSopClassUids;
+
+  ASSERT_TRUE(index_->LookupStudyAggregates(modalities, sopClassUids, countSopClassUids, a[1]));
+  ASSERT_EQ(2u, modalities.size());
+  ASSERT_TRUE(modalities.find("CT") != modalities.end());
+  ASSERT_TRUE(modalities.find("MR") != modalities.end());
+  ASSERT_EQ(2u, sopClassUids.size());
+  ASSERT_EQ(2u, countSopClassUids);  // The instance "e" has no SOP class UID
+
+  index_->SetMetadata(a[4], MetadataType_Instance_SopClassUid, "1.2");
+  ASSERT_TRUE(index_->LookupStudyAggregates(modalities, sopClassUids, countSopClassUids, a[1]));
+  ASSERT_EQ(2u, sopClassUids.size());
+  ASSERT_EQ(3u, countSopClassUids);
+
+  // Deleting the last instance also deletes the series "f"
+  index_->DeleteResource(a[6]);
+  ASSERT_TRUE(index_->LookupStudyAggregates(modalities, sopClassUids, countSopClassUids, a[1]));
+  ASSERT_EQ(1u, modalities.size());
+  ASSERT_EQ("CT", *modalities.begin());
+  ASSERT_EQ(1u, sopClassUids.size());
+  ASSERT_EQ("1.2", *sopClassUids.begin());
+  ASSERT_EQ(2u, countSopClassUids);
+
+  index_->ClearMainDicomTags(a[2]);
+  index_->DeleteMetadata(a[3], MetadataType_Instance_SopClassUid);
+  ASSERT_TRUE(index_->LookupStudyAggregates(modalities, sopClassUids, countSopClassUids, a[1]));
+  ASSERT_TRUE(modalities.empty());
+  ASSERT_EQ(1u, countSopClassUids);
+
+  index_->DeleteResource(a[0]);
+  CheckTableRecordCount(0u, "StudyAggregates");
+}
+
+
+TEST_P(DatabaseWrapperTest, KeysetPagination)
+{
+  std::vector<int64_t> instances;
+
+  for (int i = 0; i < 10; i++)
+  {
+    std::string id = "instance" + boost::lexical_cast<std::string>(i);
+    instances.push_back(index_->CreateResource(id, ResourceType_Instance));
+    index_->SetMainDicomTag(instances.back(), DICOM_TAG_SOP_INSTANCE_UID, id);
+    index_->LogChange(instances.back(), ServerIndexChange(ChangeType_NewInstance, ResourceType_Instance, id));
+  }
+
+  index_->CreateResource("series", ResourceType_Series);
+
+  std::vector<int64_t> internalIds;
+  std::vector<std::string> publicIds;
+
+  // Walk the instances by pages of 4 resources
+  std::vector<std::string> walk;
+  int64_t after = 0;
+
+  for (;;)
+  {
+    index_->GetResourcesAfter(internalIds, publicIds, ResourceType_Instance, after, 4);
+    ASSERT_EQ(internalIds.size(), publicIds.size());
+    ASSERT_LE(internalIds.size(), 4u);
+
+    if (internalIds.empty())
+    {
+      break;
+    }
+
+    for (size_t i = 0; i < internalIds.size(); i++)
+    {
+      ASSERT_LT(after, internalIds[i]);
+      after = internalIds[i];
+      walk.push_back(publicIds[i]);
+    }
+  }
+
+  ASSERT_EQ(10u, walk.size());
+  for (size_t i = 0; i < walk.size(); i++)
+  {
+    ASSERT_EQ("instance" + boost::lexical_cast<std::string>(i), walk[i]);
+  }
+
+  index_->GetResourcesAfter(internalIds, publicIds, ResourceType_Instance, instances[7], 100);
+  ASSERT_EQ(2u, publicIds.size());
+  ASSERT_EQ("instance8", publicIds[0]);
+  ASSERT_EQ("instance9", publicIds[1]);
+
+  index_->GetResourcesAfter(internalIds, publicIds, ResourceType_Instance, 0, 0);
+  ASSERT_TRUE(publicIds.empty());
+
+  // Read the main DICOM tags of the whole page at once
+  std::vector<int64_t> ids;
+  ids.push_back(instances[3]);
+  ids.push_back(instances[1]);
+  ids.push_back(instances[3]);
+
+  DicomMap m1, m2, m3;
+  std::vector<DicomMap*> tags;
+  tags.push_back(&m1);
+  tags.push_back(&m2);
+  tags.push_back(&m3);
+
+  index_->GetMainDicomTags(tags, ids);
+  ASSERT_EQ("instance3", m1.GetValue(DICOM_TAG_SOP_INSTANCE_UID).GetContent());
+  ASSERT_EQ("instance1", m2.GetValue(DICOM_TAG_SOP_INSTANCE_UID).GetContent());
+  ASSERT_EQ(1u, m2.GetSize());
+
+  tags.pop_back();
+  ASSERT_THROW(index_->GetMainDicomTags(tags, ids), OrthancException);
+
+  // The changes of the deleted resources are removed
+  index_->DeleteResource(instances[0]);
+
+  std::list<ServerIndexChange> changes;
+  bool done;
+  index_->GetChanges(changes, done, 0, 100);
+  ASSERT_TRUE(done);
+  ASSERT_EQ(9u, changes.size());
+  ASSERT_EQ("instance1", changes.front().GetPublicId());
+  ASSERT_EQ("instance9", changes.back().GetPublicId());
+
+  index_->GetLastChange(changes);
+  ASSERT_EQ(1u, changes.size());
+  ASSERT_EQ("instance9", changes.front().GetPublicId());
+}
+
+
+TEST_P(DatabaseWrapperTest, SetOrientedLookups)
+{
+  int64_t a[] = {
+    index_->CreateResource("patient", ResourceType_Patient),   // 0
+    index_->CreateResource("study", ResourceType_Study),       // 1
+    index_->CreateResource("series", ResourceType_Series),     // 2
+    index_->CreateResource("instance", ResourceType_Instance)  // 3
+  };
+
+  index_->AttachChild(a[0], a[1]);
+  index_->AttachChild(a[1], a[2]);
+  index_->AttachChild(a[2], a[3]);
+
+  std::vector<int64_t> ids;
+  ids.push_back(a[3]);
+  ids.push_back(a[0]);
+  ids.push_back(a[2]);
+  ids.push_back(a[3]);
+
+  std::vector<std::string> publicIds;
+  index_->GetPublicIds(publicIds, ids);
+  ASSERT_EQ(4u, publicIds.size());
+  ASSERT_EQ("instance", publicIds[0]);
+  ASSERT_EQ("patient", publicIds[1]);
+  ASSERT_EQ("series", publicIds[2]);
+  ASSERT_EQ("instance", publicIds[3]);
+
+  std::vector<ResourceType> types;
+  index_->GetResourceTypes(types, ids);
+  ASSERT_EQ(4u, types.size());
+  ASSERT_EQ(ResourceType_Instance, types[0]);
+  ASSERT_EQ(ResourceType_Patient, types[1]);
+  ASSERT_EQ(ResourceType_Series, types[2]);
+  ASSERT_EQ(ResourceType_Instance, types[3]);
+
+  std::vector<int64_t> parents;
+  index_->LookupParents(parents, ids);
+  ASSERT_EQ(4u, parents.size());
+  ASSERT_EQ(a[2], parents[0]);
+  ASSERT_EQ(-1, parents[1]);
+  ASSERT_EQ(a[1], parents[2]);
+  ASSERT_EQ(a[2], parents[3]);
+
+  ids.clear();
+  index_->GetPublicIds(publicIds, ids);
+  ASSERT_TRUE(publicIds.empty());
+
+  // More resources than the number of IDs in one SQL statement
+  for (int i = 0; i < 1000; i++)
+  {
+    ids.push_back(a[i % 4]);
+  }
+
+  index_->GetPublicIds(publicIds, ids);
+  ASSERT_EQ(1000u, publicIds.size());
+  ASSERT_EQ("study", publicIds[997]);
+  ASSERT_EQ("series", publicIds[998]);
+
+  ids.push_back(a[3] + 100);  // Inexistent resource
+  ASSERT_THROW(index_->GetPublicIds(publicIds, ids), OrthancException);
+}
+
+
 TEST_P(DatabaseWrapperTest, PatientRecycling)
 {
   std::vector<int64_t> patients;
@@ -841,6 +1141,350 @@ TEST(ServerIndex, AttachmentRecycling)
 }
 
 
+namespace
+{
+  class StoreBatchThread : public boost::noncopyable
+  {
+  private:
+    ServerIndex&              index_;
+    unsigned int              thread_;
+    std::vector<StoreStatus>  status_;
+
+  public:
+    StoreBatchThread(ServerIndex& index,
+                     unsigned int thread) :
+      index_(index),
+      thread_(thread)
+    {
+    }
+
+    void operator() ()
+    {
+      for (unsigned int i = 0; i < 10; i++)
+      {
+        // All the threads share the same patient, and the instance
+        // "0" is stored twice by each thread
+        std::string id = boost::lexical_cast<std::string>(thread_) + "-" +
+          boost::lexical_cast<std::string>(i == 9 ? 0 : i);
+
+        DicomMap instance;
+        instance.SetValue(DICOM_TAG_PATIENT_ID, "patient", false);
+        instance.SetValue(DICOM_TAG_STUDY_INSTANCE_UID, "study", false);
+        instance.SetValue(DICOM_TAG_SERIES_INSTANCE_UID, "series-" + boost::lexical_cast<std::string>(thread_), false);
+        instance.SetValue(DICOM_TAG_SOP_INSTANCE_UID, "instance-" + id, false);
+
+        std::map<MetadataType, std::string> instanceMetadata;
+        DicomInstanceToStore toStore;
+        toStore.SetSummary(instance);
+
+        ServerIndex::Attachments attachments;
+        status_.push_back(index_.Store(instanceMetadata, toStore, attachments));
+      }
+    }
+
+    const std::vector<StoreStatus>& GetStatus() const
+    {
+      return status_;
+    }
+  };
+}
+
+
+TEST(ServerIndex, StoreBatch)
+{
+  const std::string path = "UnitTestsStorage";
+
+  SystemToolbox::RemoveFile(path + "/index");
+  FilesystemStorage storage(path);
+  DatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+  ServerContext context(db, storage, true /* running unit tests */,
+                        false /* don't reload jobs */);
+  ServerIndex& index = context.GetIndex();
+
+  index.SetStoreBatch(8, 5);
+
+  std::vector<StoreBatchThread*> workers;
+  boost::thread_group threads;
+
+  for (unsigned int i = 0; i < 4; i++)
+  {
+    workers.push_back(new StoreBatchThread(index, i));
+    threads.create_thread(boost::ref(*workers.back()));
+  }
+
+  threads.join_all();
+
+  for (size_t i = 0; i < workers.size(); i++)
+  {
+    const std::vector<StoreStatus>& status = workers[i]->GetStatus();
+    ASSERT_EQ(10u, status.size());
+
+    for (size_t j = 0; j < 9; j++)
+    {
+      ASSERT_EQ(StoreStatus_Success, status[j]);
+    }
+
+    ASSERT_EQ(StoreStatus_AlreadyStored, status[9]);
+    delete workers[i];
+  }
+
+  Json::Value tmp;
+  index.ComputeStatistics(tmp);
+  ASSERT_EQ(1, tmp["CountPatients"].asInt());
+  ASSERT_EQ(1, tmp["CountStudies"].asInt());
+  ASSERT_EQ(4, tmp["CountSeries"].asInt());
+  ASSERT_EQ(36, tmp["CountInstances"].asInt());
+
+  context.Stop();
+  db.Close();
+}
+
+
+TEST(ServerIndex, PaginationCursor)
+{
+  const std::string path = "UnitTestsStorage";
+
+  SystemToolbox::RemoveFile(path + "/index");
+  FilesystemStorage storage(path);
+  DatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+  ServerContext context(db, storage, true /* running unit tests */,
+                        false /* don't reload jobs */);
+  ServerIndex& index = context.GetIndex();
+
+  for (unsigned int i = 0; i < 6; i++)
+  {
+    DicomMap instance;
+    instance.SetValue(DICOM_TAG_PATIENT_ID, "patient", false);
+    instance.SetValue(DICOM_TAG_STUDY_INSTANCE_UID, "study", false);
+    instance.SetValue(DICOM_TAG_SERIES_INSTANCE_UID, "series", false);
+    instance.SetValue(DICOM_TAG_SOP_INSTANCE_UID, "instance-" + boost::lexical_cast<std::string>(i), false);
+
+    std::map<MetadataType, std::string> instanceMetadata;
+    DicomInstanceToStore toStore;
+    toStore.SetSummary(instance);
+
+    ServerIndex::Attachments attachments;
+    ASSERT_EQ(StoreStatus_Success, index.Store(instanceMetadata, toStore, attachments));
+  }
+
+  std::list<std::string> all, page;
+  std::string cursor;
+  index.GetAllUuidsAfter(all, cursor, ResourceType_Instance, "", 100);
+  ASSERT_EQ(6u, all.size());
+
+  index.GetAllUuidsAfter(page, cursor, ResourceType_Instance, "", 2);
+  ASSERT_EQ(2u, page.size());
+  ASSERT_EQ(all.front(), page.front());
+
+  // Delete the last resource of the page: Its public identifier
+  // cannot be used anymore, but the cursor can
+  const std::string last = page.back();
+  Json::Value tmp;
+  ASSERT_TRUE(index.DeleteResource(tmp, last, ResourceType_Instance));
+  ASSERT_THROW(index.GetAllUuidsAfter(page, cursor, ResourceType_Instance, last, 2), OrthancException);
+
+  std::vector<std::string> walk;
+  for (;;)
+  {
+    index.GetAllUuidsAfter(page, cursor, ResourceType_Instance, cursor, 2);
+    if (page.empty())
+    {
+      break;
+    }
+
+    walk.insert(walk.end(), page.begin(), page.end());
+  }
+
+  ASSERT_EQ(4u, walk.size());
+
+  std::list<std::string>::const_iterator it = all.begin();
+  std::advance(it, 2);
+  for (size_t i = 0; i < walk.size(); i++, ++it)
+  {
+    ASSERT_EQ(*it, walk[i]);
+  }
+
+  // The cursor does not move at the end of the walk
+  std::string previous = cursor;
+  index.GetAllUuidsAfter(page, cursor, ResourceType_Instance, cursor, 2);
+  ASSERT_TRUE(page.empty());
+  ASSERT_EQ(previous, cursor);
+
+  ASSERT_THROW(index.GetAllUuidsAfter(page, cursor, ResourceType_Instance, "cursor-nope", 2), OrthancException);
+
+  context.Stop();
+  db.Close();
+}
+
+
+TEST(ServerIndex, ReadOnlyConnections)
+{
+  const std::string path = "UnitTestsStorage";
+
+  {
+    DatabaseWrapper db;   // In-memory databases cannot be shared
+    db.Open();
+    ASSERT_TRUE(db.OpenReadOnlyConnection() == NULL);
+    db.Close();
+  }
+
+  SystemToolbox::RemoveFile(path + "/index");
+  SystemToolbox::RemoveFile(path + "/index-wal");
+  SystemToolbox::RemoveFile(path + "/index-shm");
+  FilesystemStorage storage(path);
+
+  DatabaseWrapper db(path + "/index");
+  db.SetExclusiveLocking(false);
+  db.Open();
+  ASSERT_THROW(db.SetExclusiveLocking(true), OrthancException);
+
+  ServerContext context(db, storage, true /* running unit tests */,
+                        false /* don't reload jobs */);
+  ServerIndex& index = context.GetIndex();
+
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    IDatabaseWrapper* reader = db.OpenReadOnlyConnection();
+    ASSERT_TRUE(reader != NULL);
+    index.AddReadOnlyConnection(reader);
+  }
+
+  DicomMap instance;
+  instance.SetValue(DICOM_TAG_PATIENT_ID, "patient", false);
+  instance.SetValue(DICOM_TAG_STUDY_INSTANCE_UID, "study", false);
+  instance.SetValue(DICOM_TAG_SERIES_INSTANCE_UID, "series", false);
+  instance.SetValue(DICOM_TAG_SOP_INSTANCE_UID, "instance", false);
+
+  std::map<MetadataType, std::string> instanceMetadata;
+  DicomInstanceToStore toStore;
+  toStore.SetSummary(instance);
+
+  ServerIndex::Attachments attachments;
+  ASSERT_EQ(StoreStatus_Success, index.Store(instanceMetadata, toStore, attachments));
+
+  // The read-only connections must see the committed instance
+  DicomInstanceHasher hasher(instance);
+
+  std::list<std::string> uuids;
+  index.GetAllUuids(uuids, ResourceType_Instance);
+  ASSERT_EQ(1u, uuids.size());
+  ASSERT_EQ(hasher.HashInstance(), uuids.front());
+
+  ResourceType type;
+  ASSERT_TRUE(index.LookupResourceType(type, hasher.HashSeries()));
+  ASSERT_EQ(ResourceType_Series, type);
+
+  std::string parent;
+  ASSERT_TRUE(index.LookupParent(parent, hasher.HashInstance(), ResourceType_Patient));
+  ASSERT_EQ(hasher.HashPatient(), parent);
+
+  DicomMap tags;
+  ASSERT_TRUE(index.GetMainDicomTags(tags, hasher.HashSeries(), ResourceType_Series, ResourceType_Series));
+  ASSERT_EQ("series", tags.GetValue(DICOM_TAG_SERIES_INSTANCE_UID).GetContent());
+
+  context.Stop();
+  db.Close();
+}
+
+
+TEST(ServerIndex, ExtraMainDicomTags)
+{
+  const std::string path = "UnitTestsStorage";
+  const DicomTag institution(0x0008, 0x0080);
+
+  SystemToolbox::RemoveFile(path + "/index");
+  FilesystemStorage storage(path);
+  DatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+  ServerContext context(db, storage, true /* running unit tests */,
+                        false /* don't reload jobs */);
+  ServerIndex& index = context.GetIndex();
+
+  std::set<DicomTag> extra;
+  extra.insert(institution);
+  ServerToolbox::SetExtraMainDicomTags(ResourceType_Study, extra);
+  ASSERT_EQ("Study:0008,0080", ServerToolbox::GetExtraMainDicomTagsSignature());
+
+  std::string expected;
+
+  for (unsigned int i = 0; i < 3; i++)
+  {
+    DicomMap instance;
+    instance.SetValue(DICOM_TAG_PATIENT_ID, "patient", false);
+    instance.SetValue(DICOM_TAG_STUDY_INSTANCE_UID, "study-" + boost::lexical_cast<std::string>(i), false);
+    instance.SetValue(DICOM_TAG_SERIES_INSTANCE_UID, "series-" + boost::lexical_cast<std::string>(i), false);
+    instance.SetValue(DICOM_TAG_SOP_INSTANCE_UID, "instance-" + boost::lexical_cast<std::string>(i), false);
+    instance.SetValue(institution, (i == 1 ? "HOSPITAL" : "CLINIC"), false);
+
+    if (i == 1)
+    {
+      DicomInstanceHasher hasher(instance);
+      expected = hasher.HashStudy();
+    }
+
+    std::map<MetadataType, std::string> instanceMetadata;
+    DicomInstanceToStore toStore;
+    toStore.SetSummary(instance);
+
+    ServerIndex::Attachments attachments;
+    ASSERT_EQ(StoreStatus_Success, index.Store(instanceMetadata, toStore, attachments));
+  }
+
+  {
+    // The constraint is evaluated by the database
+    LookupResource lookup(ResourceType_Study);
+    lookup.AddDicomConstraint(institution, "HOSPITAL", true);
+    ASSERT_FALSE(lookup.HasUnoptimizedConstraints());
+
+    std::vector<std::string> resources, instances;
+    index.FindCandidates(resources, instances, lookup);
+    ASSERT_EQ(1u, resources.size());
+    ASSERT_EQ(expected, resources[0]);
+  }
+
+  {
+    DicomMap tags;
+    ASSERT_TRUE(index.GetMainDicomTags(tags, expected, ResourceType_Study, ResourceType_Study));
+    ASSERT_EQ("HOSPITAL", tags.GetValue(institution).GetContent());
+  }
+
+  ServerToolbox::SetExtraMainDicomTags(ResourceType_Study, std::set<DicomTag>());
+  ASSERT_TRUE(ServerToolbox::GetExtraMainDicomTagsSignature().empty());
+
+  {
+    LookupResource lookup(ResourceType_Study);
+    lookup.AddDicomConstraint(institution, "HOSPITAL", true);
+    ASSERT_TRUE(lookup.HasUnoptimizedConstraints());
+
+    // The unoptimized constraint gives the same result on the
+    // DICOM-as-JSON summary, and in place on the binary summary
+    Json::Value json = Json::objectValue;
+    json[institution.Format()]["Name"] = "InstitutionName";
+    json[institution.Format()]["Type"] = "String";
+    json[institution.Format()]["Value"] = "HOSPITAL";
+
+    std::string encoded;
+    DicomBinarySummary::Encode(encoded, json);
+    ASSERT_TRUE(lookup.IsMatch(json));
+    ASSERT_TRUE(lookup.IsMatch(DicomBinarySummary(encoded)));
+
+    json[institution.Format()]["Value"] = "CLINIC";
+    DicomBinarySummary::Encode(encoded, json);
+    ASSERT_FALSE(lookup.IsMatch(json));
+    ASSERT_FALSE(lookup.IsMatch(DicomBinarySummary(encoded)));
+
+    DicomBinarySummary::Encode(encoded, Json::objectValue);
+    ASSERT_FALSE(lookup.IsMatch(Json::Value(Json::objectValue)));
+    ASSERT_FALSE(lookup.IsMatch(DicomBinarySummary(encoded)));
+  }
+
+  context.Stop();
+  db.Close();
+}
+
+
 TEST(LookupIdentifierQuery, NormalizeIdentifier)
 {
   ASSERT_EQ("H^L.LO", ServerToolbox::NormalizeIdentifier("   Hé^l.LO  %_  "));
@@ -227,6 +227,28 @@ TEST(BufferHttpSender, Basic)
 }
 
 
+TEST(BufferHttpSender, Range)
+{
+  for (int cs = 0; cs < 5; cs++)
+  {
+    BufferHttpSender sender;
+    sender.SetChunkSize(cs);
+    sender.GetBuffer() = "Hello world";
+    sender.SetupHttpCompression(false, false);
+    ASSERT_TRUE(sender.SetRange(3, 8));
+    ASSERT_EQ(11u, sender.GetContentLength());
+
+    std::string t;
+    while (sender.ReadNextChunk())
+    {
+      t.append(sender.GetChunkContent(), sender.GetChunkSize());
+    }
+
+    ASSERT_EQ("lo wo", t);
+  }
+}
+
+
 TEST(FilesystemHttpSender, Basic)
 {
   const std::string& path = "UnitTestsResults/stream";
@@ -35,10 +35,14 @@
 #include "gtest/gtest.h"
 
 #include "../Core/OrthancException.h"
+#include "../Core/Compression/ZipReader.h"
 #include "../Core/Compression/ZipWriter.h"
 #include "../Core/Compression/HierarchicalZipWriter.h"
+#include "../Core/SystemToolbox.h"
 #include "../Core/Toolbox.h"
 
+#include <boost/lexical_cast.hpp>
+
 
 using namespace Orthanc;
 
@@ -96,6 +100,102 @@ TEST(ZipWriter, Append)
 
 
 
+namespace
+{
+  class StringOutputStream : public Orthanc::ZipWriter::IOutputStream
+  {
+  private:
+    std::string&  target_;
+    unsigned int  countWrites_;
+    bool          isClosed_;
+
+  public:
+    StringOutputStream(std::string& target) :
+      target_(target),
+      countWrites_(0),
+      isClosed_(false)
+    {
+    }
+
+    virtual void Write(const std::string& chunk)
+    {
+      target_.append(chunk);
+      countWrites_++;
+    }
+
+    virtual void Close()
+    {
+      isClosed_ = true;
+    }
+  };
+}
+
+
+TEST(ZipWriter, Stream)
+{
+  // Incompressible content, so that the streamed bytes grow with it
+  std::string large;
+  large.resize(512 * 1024);
+
+  uint32_t seed = 42;
+  for (size_t i = 0; i < large.size(); i++)
+  {
+    seed = seed * 1103515245u + 12345u;
+    large[i] = static_cast<char>(seed >> 24);
+  }
+
+  for (int zip64 = 0; zip64 < 2; zip64++)
+  {
+    std::string s;
+
+    {
+      Orthanc::ZipWriter w;
+      w.AcquireOutputStream(new StringOutputStream(s), zip64 != 0);
+      ASSERT_TRUE(w.IsOpen());
+      ASSERT_TRUE(w.IsStreaming());
+      ASSERT_THROW(w.SetZip64(zip64 == 0), Orthanc::OrthancException);
+      ASSERT_THROW(w.SetAppendToExisting(true), Orthanc::OrthancException);
+
+      w.OpenFile("world/hello");
+      w.Write("Hello world 1");
+
+      w.OpenFile("world/large");
+      w.Write(large);
+
+      // The entry is sent to the stream before it is complete,
+      // without being buffered as a whole
+      ASSERT_EQ("PK\003\004", s.substr(0, 4));
+      ASSERT_GT(s.size(), large.size() / 2);
+      ASSERT_LT(s.size(), large.size() + 1024);
+
+      w.OpenFile("world/hello2");
+      w.Write("Hello world 2");
+
+      w.Close();
+      ASSERT_FALSE(w.IsOpen());
+      ASSERT_FALSE(w.IsStreaming());
+      ASSERT_THROW(w.Write("Nope"), Orthanc::OrthancException);
+    }
+
+    const std::string comment = "Created by Orthanc";
+    ASSERT_EQ(comment, s.substr(s.size() - comment.size()));
+    ASSERT_EQ("PK\005\006", s.substr(s.size() - comment.size() - 22, 4));
+
+    std::auto_ptr<Orthanc::ZipReader> reader(Orthanc::ZipReader::CreateFromMemory(s));
+    ASSERT_EQ(3u, reader->GetFilesCount());
+    ASSERT_EQ("world/large", reader->GetFilename(1));
+    ASSERT_EQ(large.size(), reader->GetUncompressedSize(1));
+
+    std::string content;
+    reader->ReadFile(content, 0);
+    ASSERT_EQ("Hello world 1", content);
+    reader->ReadFile(content, 1);
+    ASSERT_TRUE(content == large);
+    reader->ReadFile(content, 2);
+    ASSERT_EQ("Hello world 2", content);
+  }
+}
+
 
 
 namespace Orthanc
@@ -187,3 +287,183 @@ TEST(HierarchicalZipWriter, Basic)
 
   **/
 }
+
+
+
+TEST(ZipReader, Basic)
+{
+  for (int zip64 = 0; zip64 < 2; zip64++)
+  {
+    for (int level = 0; level <= 9; level += 9)
+    {
+      std::string large;
+      for (unsigned int i = 0; i < 100000; i++)
+      {
+        large += boost::lexical_cast<std::string>(i);
+      }
+
+      std::string s;
+
+      {
+        Orthanc::ZipWriter w;
+        w.SetCompressionLevel(static_cast<uint8_t>(level));
+        w.AcquireOutputStream(new StringOutputStream(s), zip64 != 0);
+        w.OpenFile("world/hello");
+        w.Write("Hello world");
+        w.OpenFile("empty");
+        w.OpenFile("large");
+        w.Write(large);
+        w.Close();
+      }
+
+      ASSERT_TRUE(Orthanc::ZipReader::IsZipMemoryBuffer(s.c_str(), s.size()));
+
+      std::auto_ptr<Orthanc::ZipReader> reader(Orthanc::ZipReader::CreateFromMemory(s));
+      ASSERT_EQ(3u, reader->GetFilesCount());
+      ASSERT_EQ("world/hello", reader->GetFilename(0));
+      ASSERT_EQ("empty", reader->GetFilename(1));
+      ASSERT_EQ("large", reader->GetFilename(2));
+      ASSERT_EQ(large.size(), reader->GetUncompressedSize(2));
+      ASSERT_THROW(reader->GetFilename(3), Orthanc::OrthancException);
+
+      // Random access to the files
+      std::string content;
+      reader->ReadFile(content, 2);
+      ASSERT_EQ(large, content);
+      reader->ReadFile(content, 0);
+      ASSERT_EQ("Hello world", content);
+      reader->ReadFile(content, 1);
+      ASSERT_TRUE(content.empty());
+    }
+  }
+}
+
+
+TEST(ZipReader, File)
+{
+  const std::string path = "UnitTestsResults/reader.zip";
+
+  {
+    Orthanc::ZipWriter w;
+    w.SetOutputPath(path.c_str());
+    w.Open();
+    w.OpenFile("a");
+    w.Write("Hello");
+    w.OpenFile("b/c");
+    w.Write("World");
+  }
+
+  std::auto_ptr<Orthanc::ZipReader> reader(Orthanc::ZipReader::CreateFromFile(path));
+  ASSERT_EQ(2u, reader->GetFilesCount());
+
+  std::string content;
+  reader->ReadFile(content, 1);
+  ASSERT_EQ("b/c", reader->GetFilename(1));
+  ASSERT_EQ("World", content);
+  reader->ReadFile(content, 0);
+  ASSERT_EQ("Hello", content);
+}
+
+
+TEST(ZipReader, Errors)
+{
+  ASSERT_FALSE(Orthanc::ZipReader::IsZipMemoryBuffer("PK", 2));
+  ASSERT_FALSE(Orthanc::ZipReader::IsZipMemoryBuffer("Hello world", 11));
+  ASSERT_THROW(Orthanc::ZipReader::CreateFromMemory("Hello world"), Orthanc::OrthancException);
+  ASSERT_THROW(Orthanc::ZipReader::CreateFromFile("UnitTestsResults/nope.zip"), Orthanc::OrthancException);
+
+  std::string s;
+
+  {
+    Orthanc::ZipWriter w;
+    w.SetCompressionLevel(0);
+    w.AcquireOutputStream(new StringOutputStream(s), false);
+    w.OpenFile("hello");
+    w.Write("Hello world");
+    w.Close();
+  }
+
+  // Corrupt the content of the stored file, and truncate the archive
+  size_t pos = s.find("Hello world");
+  ASSERT_NE(std::string::npos, pos);
+  s[pos] = 'h';
+
+  std::auto_ptr<Orthanc::ZipReader> reader(Orthanc::ZipReader::CreateFromMemory(s));
+  ASSERT_EQ(1u, reader->GetFilesCount());
+
+  std::string content;
+  ASSERT_THROW(reader->ReadFile(content, 0), Orthanc::OrthancException);
+
+  ASSERT_THROW(Orthanc::ZipReader::CreateFromMemory(s.substr(0, s.size() - 30)), Orthanc::OrthancException);
+}
+
+
+TEST(ZipReader, DeclaredSize)
+{
+  std::string large;
+  for (unsigned int i = 0; i < 100000; i++)
+  {
+    large += boost::lexical_cast<std::string>(i);
+  }
+
+  std::string s;
+
+  {
+    Orthanc::ZipWriter w;
+    w.SetCompressionLevel(9);
+    w.AcquireOutputStream(new StringOutputStream(s), false);
+    w.OpenFile("large");
+    w.Write(large);
+    w.Close();
+  }
+
+  // Offset of the uncompressed size in the central file header
+  size_t pos = s.find("PK\001\002");
+  ASSERT_NE(std::string::npos, pos);
+  pos += 24;
+
+  std::string content;
+
+  {
+    std::auto_ptr<Orthanc::ZipReader> reader(Orthanc::ZipReader::CreateFromMemory(s));
+    ASSERT_EQ(0u, reader->GetMaximumFileSize());
+
+    reader->SetMaximumFileSize(large.size() - 1);
+    ASSERT_THROW(reader->ReadFile(content, 0), Orthanc::OrthancException);
+
+    reader->SetMaximumFileSize(large.size());
+    reader->ReadFile(content, 0);
+    ASSERT_EQ(large, content);
+  }
+
+  // Overwrite the size announced by the central directory
+  for (unsigned int size = 0; size < 4; size++)
+  {
+    uint32_t declared;
+    switch (size)
+    {
+      case 0:
+        declared = 0xfffffff0u;  // Impossible ratio ("ZIP bomb")
+        break;
+      case 1:
+        declared = static_cast<uint32_t>(large.size() - 1);
+        break;
+      case 2:
+        declared = static_cast<uint32_t>(large.size() + 1);
+        break;
+      default:
+        declared = 0;
+        break;
+    }
+
+    std::string t = s;
+    for (unsigned int i = 0; i < 4; i++)
+    {
+      t[pos + i] = static_cast<char>((declared >> (8 * i)) & 0xff);
+    }
+
+    std::auto_ptr<Orthanc::ZipReader> reader(Orthanc::ZipReader::CreateFromMemory(t));
+    ASSERT_EQ(declared, reader->GetUncompressedSize(0));
+    ASSERT_THROW(reader->ReadFile(content, 0), Orthanc::OrthancException);
+  }
+}